@@ -1,26 +1,50 @@
+#include "bus.h"
 #include "types.h"
 
 #include <stdbool.h>
 #include <stdint.h>
 
+// Decoding information for all 256 opcodes, indexed by the opcode byte
+extern const OpcodeInfo opcode_table[256];
+
 /**
  * Parses the location in memory pointed to by 'pc' and creates an Instruction
  *
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
  * @param pc - The program counter (points to the current instruction in memory)
  *
  * @returns An Instruction with all the information needed about it
  */
-Instruction parseInstruction(uint8_t* mem, uint16_t pc);
+Instruction parseInstruction(const Bus* bus, uint16_t pc);
 
 /**
- * Execute the given instruction and set the appropriate flags
+ * Execute the given instruction and set the appropriate flags. N, V, Z and C are
+ * left lazily evaluated, so call syncFlags before reading P.
  *
  * @param instr - The instruction to execute
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ */
+void executeInstruction(Instruction instr, Bus* bus, Processor* processor);
+
+/**
+ * Add additional cycles to the given instruction if it crosses a page
+ *
+ * @param instr - The instruction to potentially add cycles to
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
+ * @param old_PC - The value of the PC before the instruction was executed
  */
-void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor);
+void addAdditionalCycles(Instruction* instr, const Bus* bus, Processor* processor,
+                         uint16_t old_PC);
+
+/**
+ * Compute any lazily evaluated flags into P. Must be called before reading P
+ * directly after running code with runInstructions.
+ *
+ * @param processor - The processor holding register values
+ */
+void syncFlags(Processor* processor);
 
 /**
  * Set the specified flag to the specified value
@@ -41,40 +65,31 @@ void setFlag(char flag, bool val, Processor* processor);
 bool getFlag(char flag, Processor* processor);
 
 /**
- * Return the required value based on the instruction's addressing mode
+ * Push the given value onto the stack (0x01FF - 0x0100)
  *
- * @param instr - The instruction to use for getting the required value
- * @param mem - The byte array serving as system memory
+ * @param val - The value to be pushed onto the stack
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- *
- * @returns The byte of data required by the instruction
  */
-uint8_t getVal(Instruction instr, uint8_t* mem, Processor processor);
+void stackPush(uint8_t val, Bus* bus, Processor* processor);
 
 /**
- * Return the required memory address based on the instruction's addressing mode
+ * Return and remove the value at the top of the stack
  *
- * @param instr - The instruction to use for getting the required value
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- *
- * @returns The memory address required by the instruction
  */
-uint16_t getAddr(Instruction instr, uint8_t* mem, Processor processor);
+uint8_t stackPull(Bus* bus, Processor* processor);
 
 /**
- * Push the given value onto the stack (0x01FF - 0x0100)
+ * Service a hardware interrupt (NMI or IRQ) between instructions: push the
+ * program counter and the processor status (with B clear), disable IRQs, and
+ * jump through the interrupt vector
  *
- * @param val - The value to be pushed onto the stack
- * @param mem - The byte array serving as system memory
+ * @param vector - The address of the interrupt vector ($FFFA for NMI, $FFFE for IRQ)
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- */
-void stackPush(uint8_t val, uint8_t** mem, Processor* processor);
-
-/**
- * Return and remove the value at the top of the stack
  *
- * @param mem - The byte array serving as system memory
- * @param processor - The processor holding register values
+ * @returns The number of cycles the interrupt takes
  */
-uint8_t stackPull(uint8_t** mem, Processor* processor);
+int interrupt(uint16_t vector, Bus* bus, Processor* processor);
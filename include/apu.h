@@ -0,0 +1,237 @@
+#ifndef APU_H
+#define APU_H
+
+#include "blip.h"
+#include "bus.h"
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define APU_SAMPLE_RATE  (48000)
+#define APU_FRAME_CYCLES (29781)  // CPU cycles of audio synthesized at a time (about a frame)
+
+// Called with each block of samples the APU finishes
+typedef void (*ApuOutput)(void* context, const int16_t* samples, int count);
+
+// Volume of the pulse and noise channels, either constant or decaying
+typedef struct {
+    bool start;       // Restart the decay on the next quarter frame
+    bool loop;        // Start over once the decay reaches 0 (also halts the length counter)
+    bool constant;    // Use period as the volume instead of the decay
+    uint8_t period;   // Quarter frames between decay steps (or the constant volume)
+    uint8_t divider;  // Quarter frames until the next decay step
+    uint8_t decay;    // 15 down to 0
+} Envelope;
+
+typedef struct {
+    uint8_t duty;     // Which of the 4 waveforms to play
+    uint8_t step;     // Position in the waveform (0-7)
+    uint16_t period;  // Timer period in APU cycles (2 CPU cycles), less one
+    uint32_t delay;   // CPU cycles until the timer next steps the waveform
+    uint8_t length;   // Half frames until the channel goes quiet
+    Envelope envelope;
+
+    bool sweep_enabled;
+    bool sweep_negate;
+    bool sweep_reload;
+    uint8_t sweep_period;
+    uint8_t sweep_shift;
+    uint8_t sweep_divider;
+
+    int amp;  // Level last given to the synthesizer
+} Pulse;
+
+typedef struct {
+    uint8_t step;     // Position in the waveform (0-31)
+    uint16_t period;  // Timer period in CPU cycles, less one
+    uint32_t delay;
+    uint8_t length;
+    bool control;  // Holds the linear counter at its reload value (and halts the length counter)
+
+    uint8_t linear;         // Quarter frames until the channel goes quiet
+    uint8_t linear_period;  // What the linear counter is reloaded with
+    bool linear_reload;
+
+    int amp;
+} Triangle;
+
+#define NOISE_JUMPS (32)  // Powers of 2 the shift register can be jumped ahead by
+
+typedef struct {
+    uint16_t lfsr;    // 15-bit shift register the output comes from
+    bool short_mode;  // Feed back from bit 6 instead of bit 1 (a 93 step loop)
+    uint16_t period;  // Timer period in CPU cycles
+    uint32_t delay;
+    uint8_t length;
+    Envelope envelope;
+
+    // Shifting is linear, so jumping ahead 2^k steps is a 15x15 bit matrix,
+    // stored as what each bit of the register turns into (for each mode)
+    uint16_t jumps[2][NOISE_JUMPS][15];
+
+    int amp;
+} Noise;
+
+// Plays 1-bit delta encoded samples, read from CPU memory a byte at a time
+typedef struct {
+    bool irq_enabled;
+    bool loop;
+    uint16_t period;  // CPU cycles per bit
+    uint32_t delay;
+    uint8_t level;  // Output level (0-127)
+
+    uint16_t sample_addr;    // Where the sample starts ($C000-$FFC0)
+    uint16_t sample_length;  // Bytes in the sample
+    uint16_t addr;           // Next byte to read
+    uint16_t remaining;      // Bytes left to read
+
+    uint8_t buffer;  // The byte read ahead
+    bool buffer_full;
+    uint8_t shift;  // The byte being played
+    uint8_t bits;   // Bits of it left
+    bool silent;    // Nothing was read in time for this byte
+
+    int amp;
+} Dmc;
+
+typedef struct APU {
+    Pulse pulse[2];
+    Triangle triangle;
+    Noise noise;
+    Dmc dmc;
+    uint8_t enabled;  // Which channels can play ($4015 bits 0-3)
+
+    // Frame counter, which clocks the envelopes and linear counter every
+    // quarter frame and the length counters and sweeps every half frame
+    bool five_step;        // 5 step sequence (no IRQ) instead of 4
+    bool irq_inhibit;      // No frame IRQ
+    bool frame_irq;        // Raised at the end of the 4 step sequence
+    bool dmc_irq;          // Raised when a sample with IRQs enabled ends
+    uint8_t frame_step;    // The next step of the sequence
+    uint64_t frame_start;  // CPU cycle the sequence started on
+
+    int dma_cycles;  // CPU cycles owed to DMC sample reads, cleared by the CPU stalling for them
+
+    struct Bus* bus;  // CPU bus DMC samples are read from
+
+    // The rest of the $4000 page (OAMDMA), which the APU's handlers pass on to
+    BusReadHandler next_read;
+    BusWriteHandler next_write;
+    void* next_read_context;
+    void* next_write_context;
+
+    // The APU only runs when the scheduler catches it up to the CPU (if it has one)
+    struct Scheduler* scheduler;
+    uint64_t synced_cycle;  // CPU cycle the APU has been run up to
+
+    // Channels add their changes to blip, which is read out every APU_FRAME_CYCLES
+    // cycles. Nothing is synthesized without an output.
+    Blip blip;
+    uint64_t audio_start;  // CPU cycle the current block of audio starts on
+    ApuOutput output;
+    void* output_context;
+    uint64_t samples;  // Samples output so far
+} APU;
+
+/**
+ * Allocate an APU in its power-on state
+ *
+ * @returns The new APU, or NULL if it couldn't be allocated
+ */
+APU* createAPU(void);
+
+/**
+ * Free an APU
+ *
+ * @param apu - The APU to free
+ */
+void freeAPU(APU* apu);
+
+/**
+ * Map the APU's registers into the CPU address space ($4000-$4013, $4015 and
+ * $4017). This has to be done after ppuMapRegisters and before
+ * controllersMapRegisters, since they share a page.
+ *
+ * @param apu - The APU
+ * @param bus - The CPU bus
+ */
+void apuMapRegisters(APU* apu, Bus* bus);
+
+/**
+ * Read $4015
+ *
+ * @param apu - The APU
+ *
+ * @returns Which channels are still playing and which IRQs are raised
+ */
+uint8_t apuReadStatus(APU* apu);
+
+/**
+ * Write one of the APU's registers
+ *
+ * @param apu - The APU
+ * @param addr - The CPU address of the register ($4000-$4017)
+ * @param val - The value to write
+ */
+void apuWriteRegister(APU* apu, uint16_t addr, uint8_t val);
+
+/**
+ * Run the APU up to a CPU cycle, from the cycle it was last run up to. Channels
+ * jump straight from one change in their output to the next.
+ *
+ * @param apu - The APU
+ * @param cycle - The CPU cycle to run up to
+ */
+void apuCatchUp(APU* apu, uint64_t cycle);
+
+/**
+ * Find the CPU cycle by which the APU next has to be run: the end of the
+ * current block of audio (if there's an output), the next DMC sample read
+ * (which stalls the CPU and may raise an IRQ), and the next frame IRQ
+ *
+ * @param apu - The APU
+ *
+ * @returns The CPU cycle of the next event
+ */
+uint64_t apuNextEvent(const APU* apu);
+
+/**
+ * Hand the APU over to a scheduler, so it only runs when the CPU needs it to
+ *
+ * @param apu - The APU
+ * @param scheduler - The scheduler driven by the CPU's cycle count
+ *
+ * @returns 0 if the APU was added to the scheduler
+ */
+int apuSchedule(APU* apu, Scheduler* scheduler);
+
+/**
+ * Start sending the APU's audio somewhere, as APU_SAMPLE_RATE 16-bit samples
+ *
+ * @param apu - The APU
+ * @param output - Called with each block of samples
+ * @param context - Passed to output
+ */
+void apuSetOutput(APU* apu, ApuOutput output, void* context);
+
+/**
+ * Send out the audio synthesized so far, without waiting for the end of the
+ * block (e.x. when the run stops)
+ *
+ * @param apu - The APU (caught up to the CPU)
+ */
+void apuFlush(APU* apu);
+
+/**
+ * Check if the APU is asserting an IRQ
+ *
+ * @param apu - The APU
+ *
+ * @returns true if the frame counter or DMC has raised an IRQ
+ */
+static inline bool apuIrq(const APU* apu) {
+    return apu->frame_irq || apu->dmc_irq;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BATCH_LINE_LENGTH (4096)
+
+typedef enum {
+    BATCH_DONE,   // Ran, with no hash to check
+    BATCH_PASS,   // Ended in the expected state
+    BATCH_FAIL,   // Ended in another state
+    BATCH_ERROR,  // The rom couldn't be loaded
+} BatchStatus;
+
+// A rom to run headless, and how the run went
+typedef struct {
+    char* rom_path;
+    uint64_t frames;  // Frames to run from reset
+    bool has_expected;
+    uint64_t expected_hash;  // saveStateHash the run should end in
+
+    BatchStatus status;
+    uint64_t hash;        // saveStateHash the run ended in
+    uint64_t frames_run;  // Less than frames if the CPU halted
+    uint64_t instructions;
+    double seconds;
+} BatchJob;
+
+// A manifest of roms to run. Each line is a rom (relative to the manifest),
+// the number of frames to run it for, and optionally the hash of the state it
+// should end in, e.x. "smb.nes 600 1f2e3d4c5b6a7988". Lines starting with #
+// are comments.
+typedef struct {
+    BatchJob* jobs;  // In manifest order
+    uint32_t count;
+    _Atomic uint32_t next;  // The next job for a worker to take
+
+    int workers;     // Threads the jobs ran on
+    double seconds;  // Wall time the whole batch took
+} Batch;
+
+/**
+ * Read a batch manifest from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The batch
+ * @returns NULL if the file couldn't be read or has an invalid line
+ */
+Batch* loadBatch(const char* path);
+
+/**
+ * Free a batch
+ *
+ * @param batch - The batch to free
+ */
+void freeBatch(Batch* batch);
+
+/**
+ * Find how many workers to run a batch on by default
+ *
+ * @returns The number of online cores
+ */
+int batchWorkers(void);
+
+/**
+ * Run every job in a batch. Workers take the next job as they finish one, so
+ * long runs don't hold the rest up.
+ *
+ * @param batch - The batch
+ * @param workers - The number of threads to run jobs on (the calling thread
+ *                  is one of them)
+ */
+void runBatch(Batch* batch, int workers);
+
+/**
+ * Print how each job in a batch went, with a summary line at the end
+ *
+ * @param batch - The batch (after runBatch)
+ * @param out - Where to print the report
+ *
+ * @returns The number of jobs that failed or couldn't be run
+ */
+uint32_t printBatchReport(const Batch* batch, FILE* out);
+
+#endif
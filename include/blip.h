@@ -0,0 +1,86 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+#define BLIP_PHASE_BITS  (5)
+#define BLIP_PHASES      (1 << BLIP_PHASE_BITS)  // Sub-sample positions a step can start at
+#define BLIP_WIDTH       (16)                    // Output samples each step is spread over
+#define BLIP_SIZE        (4096)                  // Output samples a frame can hold
+#define BLIP_KERNEL_BITS (14)                    // Fixed point fraction of the kernel and sum
+#define BLIP_BASS_SHIFT  (9)                     // How fast DC drains out (about 15 Hz)
+
+// Band-limited step synthesis. Sources only report when their output changes
+// (and by how much), in clock cycles, and each change is added to the output
+// as a step with no frequencies above the output's Nyquist rate. Synthesis
+// costs the same whether a change is one cycle or a million cycles after the
+// last one, and the output comes out already resampled.
+//
+// Changes are added over a frame of clock cycles, after which blipEndFrame
+// makes that frame's samples available to read.
+typedef struct {
+    uint64_t factor;  // Output samples per clock cycle (32.32 fixed point)
+    uint64_t offset;  // Output position of the frame's first cycle (32.32 fixed point)
+    int avail;        // Samples finished and ready to read
+    int32_t sum;      // Integrator turning the deltas back into samples
+
+    // Each phase's share of a step for each sample it's spread over
+    int16_t kernel[BLIP_PHASES][BLIP_WIDTH];
+    int32_t deltas[BLIP_SIZE + BLIP_WIDTH];
+} Blip;
+
+/**
+ * Set up an empty buffer
+ *
+ * @param blip - The buffer to set up
+ * @param clock_rate - The rate times are given in (cycles a second)
+ * @param sample_rate - The rate of the output (samples a second)
+ */
+void initBlip(Blip* blip, uint32_t clock_rate, uint32_t sample_rate);
+
+/**
+ * Drop everything in the buffer, e.x. after jumping to another point in time
+ *
+ * @param blip - The buffer
+ */
+void blipClear(Blip* blip);
+
+/**
+ * Add a change in the output
+ *
+ * @param blip - The buffer
+ * @param time - When the output changes (clock cycles from the start of the frame)
+ * @param delta - How much it changes by
+ */
+static inline void blipAddDelta(Blip* blip, uint32_t time, int delta) {
+    uint64_t pos = time * blip->factor + blip->offset;
+    int phase = (pos >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+    int32_t* out = blip->deltas + (pos >> 32);
+    const int16_t* kernel = blip->kernel[phase];
+
+    for (int i = 0; i < BLIP_WIDTH; i++) {
+        out[i] += kernel[i] * delta;
+    }
+}
+
+/**
+ * End a frame, making its samples available to read
+ *
+ * @param blip - The buffer
+ * @param clocks - The length of the frame in clock cycles (the next frame's
+ *                 times start from here)
+ */
+void blipEndFrame(Blip* blip, uint32_t clocks);
+
+/**
+ * Read finished samples out of the buffer
+ *
+ * @param blip - The buffer
+ * @param out - Where to write the samples
+ * @param count - The most samples to read
+ *
+ * @returns The number of samples read
+ */
+int blipReadSamples(Blip* blip, int16_t* out, int count);
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "bus.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLOCK_MAX_INSTRUCTIONS (32)
+#define BLOCK_MAX_BYTES        (BLOCK_MAX_INSTRUCTIONS * 3)
+
+// A run of pre-decoded instructions that ends with a branch, JMP, JSR, RTS, RTI
+// or BRK (or when it reaches BLOCK_MAX_INSTRUCTIONS)
+typedef struct Block {
+    uint16_t start;   // Address of the first instruction
+    uint16_t length;  // Number of bytes of memory the block was decoded from
+    int count;        // Number of instructions in the block
+    bool valid;       // Cleared once a write lands inside the block
+    uint64_t executions;
+
+    // The host memory behind the block's first and last bytes when it was
+    // decoded, so that a block is decoded again once a mapper switches banks
+    const uint8_t* pages[2];
+
+    // Set by the JIT (see jit.h)
+    void* native;            // Compiled code for the block (NULL if it hasn't been compiled)
+    uint32_t native_cycles;  // The most cycles the compiled code can take
+    bool jit_failed;         // The JIT can't compile the block, so don't try again
+
+    struct Block* next_retired;
+    Instruction instrs[BLOCK_MAX_INSTRUCTIONS];
+} Block;
+
+typedef struct BlockCache {
+    Block* blocks[0x10000];     // Cached blocks, indexed by start address
+    uint8_t code_map[0x10000];  // Number of cached blocks decoded from each byte
+    Block* retired;             // Invalidated blocks waiting to be freed
+
+    // Statistics
+    uint64_t hits;           // Block lookups that found a cached block
+    uint64_t misses;         // Block lookups that had to decode a new block
+    uint64_t invalidations;  // Blocks thrown away because of a write
+} BlockCache;
+
+/**
+ * Allocate an empty block cache
+ *
+ * @returns The new cache, or NULL if it couldn't be allocated
+ */
+BlockCache* createBlockCache(void);
+
+/**
+ * Free a block cache and all of the blocks in it
+ *
+ * @param cache - The cache to free
+ */
+void freeBlockCache(BlockCache* cache);
+
+/**
+ * Free every block that has been invalidated since the last call. Must only be
+ * called while none of those blocks are running.
+ *
+ * @param cache - The cache holding the retired blocks
+ */
+void freeRetiredBlocks(BlockCache* cache);
+
+/**
+ * Return the block starting at 'pc', decoding and caching it first if needed.
+ * A cached block whose bytes are now read from other host memory (because a
+ * mapper switched banks) is thrown away and decoded again.
+ *
+ * @param cache - The cache to look the block up in
+ * @param bus - The bus serving as the CPU address space
+ * @param pc - The address of the first instruction of the block
+ *
+ * @returns The cached block
+ */
+Block* lookupBlock(BlockCache* cache, const Bus* bus, uint16_t pc);
+
+/**
+ * Throw away every cached block that was decoded from the given address. Used
+ * by the store paths of the CPU when the address is known to hold code.
+ *
+ * @param cache - The cache to invalidate blocks in
+ * @param addr - The address that was written to
+ */
+void invalidateBlocks(BlockCache* cache, uint16_t addr);
+
+/**
+ * Throw away cached blocks decoded from 'addr' after a write to it
+ *
+ * @param cache - The cache to check (may be NULL)
+ * @param addr - The address that was written to
+ */
+static inline void notifyBlockCacheWrite(BlockCache* cache, uint16_t addr) {
+    if (cache != NULL && cache->code_map[addr] != 0) {
+        invalidateBlocks(cache, addr);
+    }
+}
+
+/**
+ * Execute the instructions of a block with executeInstruction, starting with
+ * the instruction at index 'first'. Stops early if the block overwrites itself,
+ * the processor halts, or one of the limits is reached.
+ *
+ * @param block - The block to execute
+ * @param first - The index of the first instruction to execute
+ * @param max_instrs - The maximum number of instructions to execute
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+int executeBlock(Block* block, int first, int max_instrs, Bus* bus, Processor* processor,
+                 uint64_t* cycles, uint64_t cycle_limit, int32_t stop_pc);
+
+/**
+ * Run cached blocks starting at the processor's PC until it halts, the PC
+ * reaches 'stop_pc', or the cycle count reaches 'cycle_limit'. Instructions are
+ * executed with executeInstruction, but are only decoded the first time their
+ * block runs.
+ *
+ * @param cache - The cache holding decoded blocks
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runBlocks(BlockCache* cache, Bus* bus, Processor* processor, uint64_t* cycles,
+                   uint64_t cycle_limit, int32_t stop_pc);
+
+/**
+ * Print the hit rate and invalidation counts of the cache
+ *
+ * @param cache - The cache to print statistics for
+ */
+void printBlockCacheStats(const BlockCache* cache);
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUS_PAGE_SIZE  (0x100)  // Bytes of address space covered by each page entry
+#define BUS_PAGE_COUNT (0x100)  // Pages in the 64 KiB CPU address space
+#define RAM_SIZE       (0x800)  // 2 KiB of internal RAM, mirrored up to $1FFF
+
+typedef uint8_t (*BusReadHandler)(void* context, uint16_t addr);
+typedef void (*BusWriteHandler)(void* context, uint16_t addr, uint8_t val);
+
+// The CPU address space, split into BUS_PAGE_COUNT pages of BUS_PAGE_SIZE bytes.
+// Each direction of a page is either backed directly by host memory (RAM, PRG
+// banks), or by a handler (memory-mapped registers) when the pointer is NULL.
+typedef struct Bus {
+    uint8_t* read_pages[BUS_PAGE_COUNT];   // Host memory each page is read from
+    uint8_t* write_pages[BUS_PAGE_COUNT];  // Host memory each page is written to
+
+    BusReadHandler read_handlers[BUS_PAGE_COUNT];
+    BusWriteHandler write_handlers[BUS_PAGE_COUNT];
+    void* read_contexts[BUS_PAGE_COUNT];   // Passed to the read handlers
+    void* write_contexts[BUS_PAGE_COUNT];  // Passed to the write handlers
+
+    uint8_t* flat_memory;  // What busFlatMemory returns, kept up to date by the map functions
+} Bus;
+
+/**
+ * Allocate a bus with nothing mapped (reads return 0 and writes are ignored)
+ *
+ * @returns The new bus, or NULL if it couldn't be allocated
+ */
+Bus* createBus(void);
+
+/**
+ * Allocate a bus that maps the whole address space to 64 KiB of host memory,
+ * which is how programs run with -r (and the unit tests) see memory
+ *
+ * @param mem - The 64 KiB byte array serving as system memory
+ *
+ * @returns The new bus, or NULL if it couldn't be allocated
+ */
+Bus* createFlatBus(uint8_t* mem);
+
+/**
+ * Free a bus (but not the memory mapped into it)
+ *
+ * @param bus - The bus to free
+ */
+void freeBus(Bus* bus);
+
+/**
+ * Map a range of the address space directly to host memory. The host memory is
+ * repeated over the range if it is smaller than it, which is how the NES
+ * mirrors its RAM and 16 KiB PRG-ROMs. Both sizes must be multiples of
+ * BUS_PAGE_SIZE.
+ *
+ * @param bus - The bus to map the memory into
+ * @param start - The first address of the range
+ * @param size - The size of the range (in bytes)
+ * @param host - The memory to map
+ * @param host_size - The size of the host memory (in bytes)
+ * @param writable - Whether writes go to the host memory, rather than being
+ *                   ignored
+ */
+void busMapMemory(Bus* bus, uint16_t start, uint32_t size, uint8_t* host, uint32_t host_size,
+                  bool writable);
+
+/**
+ * Point the reads of a range of the address space at host memory, leaving its
+ * writes mapped the way they were. This is how mappers switch PRG banks: only
+ * the page pointers change, and the size must be a multiple of BUS_PAGE_SIZE.
+ *
+ * @param bus - The bus to map the memory into
+ * @param start - The first address of the range
+ * @param size - The size of the range (in bytes)
+ * @param host - The memory to map (at least 'size' bytes)
+ */
+void busMapReadMemory(Bus* bus, uint16_t start, uint32_t size, uint8_t* host);
+
+/**
+ * Send reads and/or writes to a range of the address space to handlers. A NULL
+ * handler leaves that direction mapped the way it was.
+ *
+ * @param bus - The bus to map the handlers into
+ * @param start - The first address of the range (a multiple of BUS_PAGE_SIZE)
+ * @param size - The size of the range (a multiple of BUS_PAGE_SIZE)
+ * @param read_handler - Called for reads from the range (or NULL)
+ * @param write_handler - Called for writes to the range (or NULL)
+ * @param context - Passed to the handlers
+ */
+void busMapHandlers(Bus* bus, uint16_t start, uint32_t size, BusReadHandler read_handler,
+                    BusWriteHandler write_handler, void* context);
+
+/**
+ * Return the host memory behind the bus if every page is mapped, for both reads
+ * and writes, to consecutive bytes of it
+ *
+ * @param bus - The bus to check
+ *
+ * @returns The start of the 64 KiB of host memory, or NULL if the bus isn't flat
+ */
+uint8_t* busFlatMemory(const Bus* bus);
+
+/**
+ * Read a byte from the CPU address space
+ *
+ * @param bus - The bus to read from
+ * @param addr - The address to read
+ *
+ * @returns The byte at the address
+ */
+static inline uint8_t busRead(const Bus* bus, uint16_t addr) {
+    const uint8_t* page = bus->read_pages[addr >> 8];
+    if (__builtin_expect(page != NULL, 1)) {
+        return page[addr & 0xFF];
+    }
+    return bus->read_handlers[addr >> 8](bus->read_contexts[addr >> 8], addr);
+}
+
+/**
+ * Write a byte to the CPU address space
+ *
+ * @param bus - The bus to write to
+ * @param addr - The address to write
+ * @param val - The byte to write
+ */
+static inline void busWrite(Bus* bus, uint16_t addr, uint8_t val) {
+    uint8_t* page = bus->write_pages[addr >> 8];
+    if (__builtin_expect(page != NULL, 1)) {
+        page[addr & 0xFF] = val;
+        return;
+    }
+    bus->write_handlers[addr >> 8](bus->write_contexts[addr >> 8], addr, val);
+}
+
+#endif
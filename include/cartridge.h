@@ -1,19 +1,25 @@
 #include "types.h"
 
+#include <stdint.h>
 #include <stdio.h>
 
+#define HEADER_SIZE  (16)   // Size of the iNES/NES 2.0 header
+#define TRAINER_SIZE (512)  // Size of the optional trainer after the header
+
 /*
- * Read the contents of the rom file header and fill the cartridge metadata
+ * Parse the 16 byte rom file header into the cartridge metadata
  *
  * @param cart - The struct representing the cartridge data
- * @param rom_file - The file containing the rom data
+ * @param header - The first HEADER_SIZE bytes of the rom file
  *
- * @returns - 0 if the header is read correctly
+ * @returns - 0 if the header is valid
  */
-int readHeader(Cartridge* cart, FILE* rom_file);
+int parseHeader(Cartridge* cart, const uint8_t* header);
 
 /*
- * Load the contents of the given rom into a cartridge
+ * Load the contents of the given rom into a cartridge. The rom file is mapped
+ * read-only and the cartridge points straight into it, so nothing is copied
+ * (apart from CHR-ROM being decoded into chr_tiles).
  *
  * @param cart - The struct representing the cartridge data
  * @param rom_path - The path to the rom file
@@ -22,9 +28,35 @@ int readHeader(Cartridge* cart, FILE* rom_file);
  */
 int loadRom(Cartridge* cart, const char* rom_path);
 
+/*
+ * Unmap the rom file of a cartridge loaded by loadRom and free its decoded tiles
+ *
+ * @param cart - The struct representing the cartridge data
+ */
+void unloadRom(Cartridge* cart);
+
 /*
  * Print out the metadata of the cartridge
  *
  * @param cart - The struct representing the cartridge data
  */
 void printCartMetadata(const Cartridge* cart);
+
+/*
+ * Get the mapper number out of the header flags
+ *
+ * @param cart - The struct representing the cartridge data
+ *
+ * @returns - The iNES (or NES 2.0) mapper number
+ */
+int getMapperNumber(const Cartridge* cart);
+
+/*
+ * Hash the cartridge's PRG-ROM and CHR-ROM, e.x. to check that a recording was
+ * made with the same rom
+ *
+ * @param cart - The struct representing the cartridge data
+ *
+ * @returns - The 64-bit FNV-1a hash of the rom's contents
+ */
+uint64_t hashRom(const Cartridge* cart);
@@ -0,0 +1,85 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include "bus.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONTROLLER_PORTS (2)
+
+// Buttons of a standard controller, in the order they're read out of $4016/$4017
+#define BUTTON_A      (1 << 0)
+#define BUTTON_B      (1 << 1)
+#define BUTTON_SELECT (1 << 2)
+#define BUTTON_START  (1 << 3)
+#define BUTTON_UP     (1 << 4)
+#define BUTTON_DOWN   (1 << 5)
+#define BUTTON_LEFT   (1 << 6)
+#define BUTTON_RIGHT  (1 << 7)
+
+// The two standard controllers. Writing 1 to $4016 holds the strobe, which
+// keeps loading the buttons into each controller's shift register. Once it's
+// cleared, each read of $4016 (or $4017 for the second controller) shifts out
+// the next button, and reads past the eighth one return 1.
+typedef struct {
+    uint8_t buttons[CONTROLLER_PORTS];  // The buttons being held down
+    uint8_t shift[CONTROLLER_PORTS];
+    bool strobe;
+
+    // The rest of the $4000 page belongs to other components, so accesses
+    // that aren't for the controllers are passed on to whatever was mapped
+    // there before
+    BusReadHandler next_read;
+    BusWriteHandler next_write;
+    void* next_read_context;
+    void* next_write_context;
+} Controllers;
+
+/**
+ * Set up the controllers with no buttons held down
+ *
+ * @param controllers - The controllers
+ */
+void initControllers(Controllers* controllers);
+
+/**
+ * Map the controllers' registers into the CPU address space ($4016 and $4017).
+ * This has to be done after ppuMapRegisters, since they share a page with
+ * OAMDMA.
+ *
+ * @param controllers - The controllers
+ * @param bus - The CPU bus
+ */
+void controllersMapRegisters(Controllers* controllers, Bus* bus);
+
+/**
+ * Read $4016 or $4017
+ *
+ * @param controllers - The controllers
+ * @param port - The controller to read (0 for $4016, 1 for $4017)
+ *
+ * @returns The next button in bit 0, with the rest of the bits from open bus
+ */
+uint8_t controllersRead(Controllers* controllers, int port);
+
+/**
+ * Write $4016
+ *
+ * @param controllers - The controllers
+ * @param val - The value written (bit 0 is the strobe)
+ */
+void controllersWrite(Controllers* controllers, uint8_t val);
+
+/**
+ * Parse a set of buttons, e.x. "A+RIGHT" or "start" ("." for none)
+ *
+ * @param arg - The buttons, separated by +
+ * @param buttons - Set to the BUTTON_ bits
+ *
+ * @returns 0 if every button name is valid
+ * @returns -1 if one isn't
+ */
+int parseButtons(const char* arg, uint8_t* buttons);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include "apu.h"
+#include "bus.h"
+#include "cartridge.h"
+#include "controller.h"
+#include "jit.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "savestate.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "types.h"
+
+#include <stdint.h>
+
+// Everything one running NES needs. Nothing is shared between emulators, so
+// any number of them can run at once on different threads.
+typedef struct {
+    Cartridge cartridge;
+    Processor processor;
+    uint8_t ram[RAM_SIZE];
+    uint64_t cycles;        // The CPU's cycle count, which the PPU and APU are caught up to
+    uint64_t instructions;  // Instructions run so far
+
+    Bus* bus;
+    Mapper* mapper;
+    PPU* ppu;
+    APU* apu;
+    Scheduler scheduler;
+    Controllers controllers;
+
+    Machine machine;  // The parts above that a save state covers
+    Tracer* tracer;   // Optional, records every instruction (not freed with the emulator)
+    Jit* jit;         // Optional, runs the CPU instead of runInstructions (not freed with the
+                      // emulator)
+} Emulator;
+
+/**
+ * Load a rom and set up an emulator to run it from its reset vector
+ *
+ * @param rom_path - The iNES file to load
+ *
+ * @returns The emulator
+ * @returns NULL if the rom couldn't be loaded or its mapper isn't supported
+ */
+Emulator* createEmulator(const char* rom_path);
+
+/**
+ * Free an emulator and its rom
+ *
+ * @param emu - The emulator to free
+ */
+void freeEmulator(Emulator* emu);
+
+/**
+ * Run one instruction, then any interrupt that comes up
+ *
+ * @param emu - The emulator
+ */
+void emulatorStep(Emulator* emu);
+
+/**
+ * Run instructions until the scheduler's next event, an instruction that
+ * touches a memory-mapped register, or a halt, then take any interrupt that
+ * comes up. While tracing, or while an IRQ is held off by the I flag (so that
+ * it's taken right after the instruction that clears it), this runs one
+ * instruction at a time like emulatorStep.
+ *
+ * @param emu - The emulator
+ */
+void emulatorRun(Emulator* emu);
+
+/**
+ * Run until the PPU has finished the given number of frames, or the CPU halts.
+ * The PPU and APU are caught up to the CPU before returning.
+ *
+ * @param emu - The emulator
+ * @param frames - The number of frames to run
+ *
+ * @returns The number of frames finished
+ */
+uint64_t emulatorRunFrames(Emulator* emu, uint64_t frames);
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "emulator.h"
+#include "trace.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define GOLDEN_CHUNK      (1 << 14)  // Records decoded at a time
+#define GOLDEN_TEXT_CHUNK (1 << 20)  // Bytes of a text log read at a time (the longest a line can be)
+#define GOLDEN_CONTEXT    (8)        // Instructions shown before a divergence
+
+// A known good CPU trace, read a chunk at a time so that a log of any length
+// is validated in a fixed amount of memory. It's either a trace file recorded
+// with --trace (or converted with --encode-trace), whose records are read as
+// is, or a text log like nestest.log (or what -t prints), whose lines are
+// decoded into the same records.
+typedef struct {
+    FILE* file;
+    const char* path;
+    bool from_text;  // Decoded from a text log rather than read from a trace file
+    bool bytes;      // The records have the instruction bytes (a text log might not)
+
+    TraceRecord* records;  // The current chunk
+    size_t count;          // Records in the chunk
+    size_t next;           // The next record in the chunk to hand out
+    uint64_t read;         // Records handed out so far
+
+    // Text read from a text log but not decoded yet
+    char* text;
+    size_t text_start;
+    size_t text_end;
+    uint64_t line;  // Lines decoded so far
+
+    bool failed;  // The file couldn't be read or a line couldn't be decoded
+} GoldenLog;
+
+/**
+ * Open a golden log, telling trace files and text logs apart by their header
+ *
+ * @param path - The log to open
+ *
+ * @returns The log
+ * @returns NULL if it couldn't be opened
+ */
+GoldenLog* openGoldenLog(const char* path);
+
+/**
+ * Close a golden log
+ *
+ * @param log - The log to close
+ */
+void closeGoldenLog(GoldenLog* log);
+
+/**
+ * Take the next record from a golden log, reading another chunk when the
+ * current one runs out
+ *
+ * @param log - The log
+ *
+ * @returns The record, which stays valid until the next call
+ * @returns NULL at the end of the log, or if it couldn't be read ('failed' is set)
+ */
+const TraceRecord* goldenNext(GoldenLog* log);
+
+/**
+ * Decode a line of a text log. The program counter starts the line (with or
+ * without a '$'), optionally followed by the instruction's bytes, and the
+ * registers and cycle count are found by their labels (A:, X:, Y:, P:, SP: or
+ * S:, and CYC:), so both nestest.log and -t's formats can be read.
+ *
+ * @param line - The line (without its newline)
+ * @param record - Set to the registers and cycle count on the line
+ *
+ * @returns The number of instruction bytes on the line (0 if there aren't any)
+ * @returns -1 if the line can't be decoded
+ */
+int parseTraceLine(const char* line, TraceRecord* record);
+
+/**
+ * Convert a golden log into a trace file, so that it can be validated against
+ * without decoding text every time
+ *
+ * @param log_path - The log to convert
+ * @param trace_path - The trace file to write
+ *
+ * @returns The number of records written
+ * @returns -1 if the log couldn't be read or the trace file written
+ */
+long long encodeTraceLog(const char* log_path, const char* trace_path);
+
+/**
+ * Run an emulator one instruction at a time, checking the program counter,
+ * registers, P (apart from B, which only exists on the stack) and cycle count
+ * before each instruction against a golden log. The CPU starts out in the
+ * state of the log's first record (so nestest.log, which starts at $C000 for
+ * its automated mode, needs no setup of its own). It stops at the first
+ * instruction that doesn't match, printing the ones that led up to it.
+ *
+ * @param emu - The emulator
+ * @param golden_path - The golden log
+ * @param format - How to print instructions
+ * @param out - Where to print the result
+ *
+ * @returns The number of instructions that matched, if the whole log did
+ * @returns -1 if the emulator diverged from the log, or the log couldn't be read
+ */
+long long validateGolden(Emulator* emu, const char* golden_path, TraceFormat format, FILE* out);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "bus.h"
+#include "types.h"
+
+#include <stdint.h>
+
+// Passed as 'stop_pc' when the run should only end on a halt or the cycle limit
+#define NO_STOP_PC (-1)
+
+/**
+ * Run instructions starting at the processor's PC until it halts, the PC
+ * reaches 'stop_pc', or the cycle count reaches 'cycle_limit'. Every
+ * instruction behaves exactly as if it had gone through parseInstruction,
+ * executeInstruction and addAdditionalCycles.
+ *
+ * When built with THREADED_CORE, opcodes are dispatched straight to their
+ * handlers through a table of label addresses (GCC/Clang "labels as values")
+ * and the registers live in locals for the whole run. Otherwise this falls
+ * back to the parseInstruction/executeInstruction loop.
+ *
+ * An instruction that reads or writes a memory-mapped register ends the run.
+ * Its handler sees the cycle count at the start of the instruction, as it
+ * would under executeInstruction, and whatever it started (DMA, an NMI, a new
+ * scheduler deadline) is dealt with by the caller before the next run. The
+ * fallback can't tell which pages an instruction touched, so it only runs one
+ * instruction at a time on a bus with registers.
+ *
+ * The threaded core leaves N, V, Z and C lazily evaluated, so call syncFlags
+ * before reading P directly.
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runInstructions(Bus* bus, Processor* processor, uint64_t* cycles,
+                         uint64_t cycle_limit, int32_t stop_pc);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "blockcache.h"
+#include "bus.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JIT_CODE_SIZE (4 * 1024 * 1024)  // Size of the buffer holding compiled blocks
+#define JIT_THRESHOLD (16)               // Executions before a block gets compiled
+
+// A tier on top of the block cache that compiles hot blocks to x86-64 code
+typedef struct {
+    BlockCache* cache;
+
+    uint8_t* code;     // Buffer holding the compiled blocks (only writable while compiling)
+    size_t code_used;  // Bytes of 'code' already handed out
+
+    // Differential mode runs every compiled block a second time with
+    // executeInstruction (from the same state, on the same bus) and compares
+    // the results
+    bool differential;
+    uint8_t* saved_memory;   // The bus's writable pages from before a block ran
+    uint8_t* native_memory;  // The bus's writable pages after its compiled code ran
+
+    // Statistics
+    uint64_t compiled;        // Blocks compiled to native code
+    uint64_t rejected;        // Blocks that started with an instruction the JIT can't handle
+    uint64_t native_runs;     // Times a compiled block was run
+    uint64_t smc_exits;       // Compiled blocks that stopped early after writing to code
+    uint64_t register_exits;  // Compiled blocks that stopped before touching a register
+    uint64_t flushes;         // Times the code buffer filled up and was emptied
+    uint64_t mismatches;      // Differential runs that didn't match executeInstruction
+} Jit;
+
+/**
+ * Create a JIT on top of the given block cache
+ *
+ * @param cache - The cache whose blocks will be compiled
+ * @param differential - Check every compiled block against executeInstruction
+ *
+ * @returns The new JIT, or NULL if the host isn't x86-64 or allocation failed
+ */
+Jit* createJit(BlockCache* cache, bool differential);
+
+/**
+ * Free the JIT and its compiled code (but not its block cache)
+ *
+ * @param jit - The JIT to free
+ */
+void freeJit(Jit* jit);
+
+/**
+ * Run code starting at the processor's PC until it halts, the PC reaches
+ * 'stop_pc', the cycle count reaches 'cycle_limit', or an instruction touches
+ * a memory-mapped register. Blocks are run with executeInstruction until they
+ * have executed JIT_THRESHOLD times, and are then compiled. Compiled code
+ * reads and writes memory through the bus's page pointers, and leaves the
+ * block before any instruction that would touch a page with handlers, which
+ * the interpreter then runs. It only runs when the whole block is sure to
+ * finish before 'cycle_limit', so the run stops on the same instruction that
+ * runInstructions would.
+ *
+ * @param jit - The JIT to compile blocks with
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runJit(Jit* jit, Bus* bus, Processor* processor, uint64_t* cycles,
+                uint64_t cycle_limit, int32_t stop_pc);
+
+/**
+ * Print the number of compiled blocks, native runs and mismatches
+ *
+ * @param jit - The JIT to print statistics for
+ */
+void printJitStats(const Jit* jit);
+
+#endif
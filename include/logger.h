@@ -3,21 +3,141 @@
 
 #include "types.h"
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOG_BUFFER_SIZE (8192)  // Log lines are batched up to this many bytes before being written
+
+// Rate limited messages are all logged up to LOG_RATE_BURST times, and after
+// that only once every LOG_RATE_INTERVAL times
+#define LOG_RATE_BURST    (8)
+#define LOG_RATE_INTERVAL (4096)
+
+// How severe a log message is
+typedef enum {
+    LEVEL_DEBUG,
+    LEVEL_INFO,
+    LEVEL_WARNING,
+    LEVEL_ERROR,
+    LEVEL_NONE,  // Only used as a threshold, to turn logging off
+} LogLevel;
+
+// The part of the NES (or of the emulator) a log message is about
+typedef enum {
+    COMP_CPU,
+    COMP_PPU,
+    COMP_CART,
+    COMP_JIT,
+    COMP_SCHED,
+    COMP_PACE,
+    COMP_TRACE,
+    COMP_STATE,
+    COMP_BATCH,
+    COMP_APU,
+    COMP_COUNT,
+} LogComponent;
+
+// Messages below this level are compiled out entirely (e.x. -DLOG_FLOOR=LEVEL_INFO
+// for release builds)
+#ifndef LOG_FLOOR
+#ifdef NDEBUG
+#define LOG_FLOOR LEVEL_INFO
+#else
+#define LOG_FLOOR LEVEL_DEBUG
+#endif
+#endif
+
+// Messages below this level are skipped at runtime (see setLogLevel)
+extern LogLevel log_level;
+
+// Counts how often a rate limited message has come up (see LOG_LIMITED)
+typedef struct {
+    _Atomic uint64_t count;
+} LogLimit;
+
 /**
- * Print a log message to the console
+ * Check if messages of the given level are logged. This is a constant when the
+ * level is below LOG_FLOOR, so the compiler drops the message altogether.
+ */
+#define LOG_ENABLED(level) ((level) >= LOG_FLOOR && (level) >= log_level)
+
+/**
+ * Log a printf style message. Nothing after the level is evaluated unless
+ * messages of that level are logged.
  *
- * @param component - The component of the NES the message is related to (e.x.
- *                    CPU, PPU, etc.)
- * @param msg - The log message
+ * e.x. LOG(COMP_CPU, LEVEL_INFO, "Beginning program execution at $%04x", pc);
  */
-void printLog(const char* component, const char* msg, const char* level);
+#define LOG(component, level, ...)                         \
+    do {                                                   \
+        if (LOG_ENABLED(level)) {                          \
+            logMessage((component), (level), __VA_ARGS__); \
+        }                                                  \
+    } while (0)
 
 /**
- * Print a log message about an executed instruction and the processor status to
- * the console
+ * Log a message that can come up over and over again (e.x. once per
+ * instruction), only letting some of them through. Each use of the macro is
+ * limited separately.
+ */
+#define LOG_LIMITED(component, level, ...)                                         \
+    do {                                                                           \
+        static LogLimit log_limit_;                                                \
+        if (LOG_ENABLED(level) && logAllowed(&log_limit_, (component), (level))) { \
+            logMessage((component), (level), __VA_ARGS__);                         \
+        }                                                                          \
+    } while (0)
+
+/**
+ * Log a message. Use the LOG macro instead, which checks the level first.
+ *
+ * @param component - The component the message is about
+ * @param level - How severe the message is
+ * @param format - printf style format of the message
+ */
+void logMessage(LogComponent component, LogLevel level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/**
+ * Count a rate limited message, and decide if it should be logged
+ *
+ * @param limit - The message's counter
+ * @param component - The component the message is about
+ * @param level - How severe the message is
+ *
+ * @returns true if the message should be logged
+ */
+bool logAllowed(LogLimit* limit, LogComponent component, LogLevel level);
+
+/**
+ * Write out every buffered log line
+ */
+void flushLog(void);
+
+/**
+ * Set where log lines are written (stderr by default). Anything already
+ * buffered is written to the old file first.
+ *
+ * @param file - The file to write to (NULL for stderr)
+ */
+void setLogFile(FILE* file);
+
+/**
+ * Set the lowest level of message that gets logged
+ *
+ * @param level - The level
+ */
+void setLogLevel(LogLevel level);
+
+/**
+ * Parse a log level name (debug, info, warning, error or none)
+ *
+ * @param name - The name of the level
+ * @param level - Set to the level
  *
- * @param instr - The executed instruction
- * @param processor - The struct serving as the system procesor
+ * @returns 0 if the name is valid
+ * @returns -1 if it isn't
  */
-void printInstrLog(Instruction instr, Processor processor);
+int parseLogLevel(const char* name, LogLevel* level);
 #endif
@@ -0,0 +1,220 @@
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include "bus.h"
+#include "render.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PRG_RAM_SIZE  (0x2000)  // 8 KiB of PRG-RAM at $6000-$7FFF
+#define CHR_RAM_SIZE  (0x2000)  // 8 KiB of CHR-RAM for cartridges without CHR-ROM
+#define CHR_PAGE_SIZE (0x400)   // Size of the pattern table pages CHR banks are made of
+#define PRG_SLOT_SIZE (0x2000)  // Size of the smallest PRG-ROM bank any mapper switches
+#define PRG_SLOTS     (4)       // Number of PRG_SLOT_SIZE slots in $8000-$FFFF
+
+// How the PPU's 2 KiB of nametable memory is mirrored over its 4 nametables
+typedef enum {
+    MIRROR_HORIZONTAL,
+    MIRROR_VERTICAL,
+    MIRROR_SINGLE_LOW,   // Every nametable is the first 1 KiB
+    MIRROR_SINGLE_HIGH,  // Every nametable is the second 1 KiB
+    MIRROR_FOUR_SCREEN,  // The cartridge provides the other 2 KiB
+} Mirroring;
+
+struct Mapper;
+
+// The hooks a mapper implements. A NULL hook does nothing (or reads as 0).
+typedef struct {
+    const char* name;
+
+    // Set up the power-on banks
+    void (*reset)(struct Mapper* mapper);
+
+    // Accesses to the parts of $4020-$FFFF that aren't mapped straight to PRG
+    // memory. Reads of PRG-ROM and PRG-RAM never get here.
+    uint8_t (*cpuRead)(struct Mapper* mapper, uint16_t addr);
+    void (*cpuWrite)(struct Mapper* mapper, uint16_t addr, uint8_t val);
+
+    // Accesses to the pattern tables ($0000-$1FFF of the PPU address space)
+    uint8_t (*ppuRead)(struct Mapper* mapper, uint16_t addr);
+    void (*ppuWrite)(struct Mapper* mapper, uint16_t addr, uint8_t val);
+
+    // Called at the end of every rendered scanline
+    void (*scanline)(struct Mapper* mapper);
+
+    // Whether the mapper is asserting the CPU's IRQ line
+    bool (*irq)(const struct Mapper* mapper);
+} MapperOps;
+
+// A cartridge's mapper. Bank switching only repoints the bus's PRG pages and the
+// mapper's CHR pages into the cartridge's ROM, so no data is ever copied.
+typedef struct Mapper {
+    const MapperOps* ops;
+    int number;
+    Bus* bus;                     // The CPU bus the PRG banks are mapped into
+    struct Scheduler* scheduler;  // Synced before register writes (NULL if there isn't one)
+
+    uint8_t* prg_rom;
+    uint32_t prg_size;
+    uint8_t prg_ram[PRG_RAM_SIZE];
+    uint32_t prg_offsets[PRG_SLOTS];  // The PRG-ROM mapped at each 8 KiB of $8000-$FFFF
+
+    uint8_t* chr;           // CHR-ROM, or chr_ram if the cartridge doesn't have any
+    uint32_t chr_size;
+    bool chr_writable;      // Whether chr is RAM
+    uint8_t* chr_ram;
+    uint8_t* chr_pages[8];  // The CHR memory behind each 1 KiB of the pattern tables
+
+    // Tiles of chr decoded to palette indices (DECODED_TILE_SIZE bytes each).
+    // CHR-ROM tiles come from the cartridge, while CHR-RAM tiles are marked dirty
+    // when they're written and decoded again the next time they're rendered.
+    uint8_t* chr_tiles;
+    uint8_t* chr_tiles_owned;  // chr_tiles, if the mapper allocated them itself
+    uint8_t* tile_pages[8];    // The decoded tiles behind each 1 KiB of the pattern tables
+    bool tile_dirty[CHR_RAM_SIZE / CHR_TILE_SIZE];
+    uint8_t tile_row[8];            // Row returned to the PPU by mappers with a ppuRead hook
+    uint64_t tile_rebuilds;         // CHR-RAM tiles decoded again since power-on
+    uint32_t frame_tile_rebuilds;   // ... since the PPU last collected them
+
+    Mirroring mirroring;
+
+    // Registers of the individual mappers
+    union {
+        struct {
+            uint8_t shift;  // Shift register, with a marker bit above the bits written so far
+            uint8_t control;
+            uint8_t chr_bank0;
+            uint8_t chr_bank1;
+            uint8_t prg_bank;
+        } mmc1;
+        struct {
+            uint8_t bank_select;
+            uint8_t banks[8];  // R0-R7
+            uint8_t irq_latch;
+            uint8_t irq_counter;
+            bool irq_reload;
+            bool irq_enabled;
+            bool irq_pending;
+        } mmc3;
+    };
+} Mapper;
+
+/**
+ * Create the mapper for a cartridge and map its PRG memory into the bus
+ * ($6000-$7FFF PRG-RAM, $8000-$FFFF PRG-ROM)
+ *
+ * @param cart - The cartridge the mapper belongs to (must outlive the mapper)
+ * @param bus - The CPU bus to map the cartridge into
+ *
+ * @returns The new mapper, or NULL if the mapper isn't supported or allocation
+ *          failed
+ */
+Mapper* createMapper(Cartridge* cart, Bus* bus);
+
+/**
+ * Map PRG-ROM and CHR memory back in at the given offsets, e.x. the ones saved
+ * in a save state
+ *
+ * @param mapper - The cartridge's mapper
+ * @param prg_offsets - Offset into PRG-ROM of each 8 KiB of $8000-$FFFF
+ * @param chr_offsets - Offset into CHR memory of each 1 KiB of the pattern tables
+ *
+ * @returns 0 if the banks were mapped
+ * @returns -1 if an offset is past the end of the cartridge's memory
+ */
+int mapperRestoreBanks(Mapper* mapper, const uint32_t* prg_offsets, const uint32_t* chr_offsets);
+
+/**
+ * Free a mapper (but not the cartridge data it points to)
+ *
+ * @param mapper - The mapper to free
+ */
+void freeMapper(Mapper* mapper);
+
+/**
+ * Read a byte from the pattern tables
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address to read ($0000-$1FFF)
+ *
+ * @returns The byte at the address
+ */
+static inline uint8_t mapperPpuRead(Mapper* mapper, uint16_t addr) {
+    if (mapper->ops->ppuRead != NULL) {
+        return mapper->ops->ppuRead(mapper, addr);
+    }
+    return mapper->chr_pages[(addr >> 10) & 0x07][addr & (CHR_PAGE_SIZE - 1)];
+}
+
+/**
+ * Write a byte to the pattern tables (ignored unless the cartridge has CHR-RAM)
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address to write ($0000-$1FFF)
+ * @param val - The byte to write
+ */
+static inline void mapperPpuWrite(Mapper* mapper, uint16_t addr, uint8_t val) {
+    if (mapper->ops->ppuWrite != NULL) {
+        mapper->ops->ppuWrite(mapper, addr, val);
+    } else if (mapper->chr_writable) {
+        int page = (addr >> 10) & 0x07;
+        uint32_t offset = mapper->chr_pages[page] - mapper->chr + (addr & (CHR_PAGE_SIZE - 1));
+        mapper->chr[offset] = val;
+        mapper->tile_dirty[offset / CHR_TILE_SIZE] = true;
+    }
+}
+
+/**
+ * Get a row of a tile from the pattern tables, decoding it first if it's been
+ * written to (or if the mapper intercepts pattern table reads)
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address of the row's low plane byte ($0000-$1FFF)
+ *
+ * @returns The palette index (0-3) of each of the row's 8 pixels, left to right
+ */
+const uint8_t* mapperFetchTileRow(Mapper* mapper, uint16_t addr);
+
+/**
+ * Get a row of a tile from the pattern tables, already decoded
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address of the row's low plane byte ($0000-$1FFF)
+ *
+ * @returns The palette index (0-3) of each of the row's 8 pixels, left to right
+ */
+static inline const uint8_t* mapperTileRow(Mapper* mapper, uint16_t addr) {
+    const uint8_t* tile = mapper->tile_pages[(addr >> 10) & 0x07] + ((addr & 0x03F0) << 2);
+    bool dirty =
+        mapper->chr_writable && mapper->tile_dirty[(tile - mapper->chr_tiles) / DECODED_TILE_SIZE];
+    if (dirty || mapper->ops->ppuRead != NULL) {
+        return mapperFetchTileRow(mapper, addr);
+    }
+    return tile + ((addr & 0x07) << 3);
+}
+
+/**
+ * Let the mapper know that a scanline has been rendered
+ *
+ * @param mapper - The cartridge's mapper
+ */
+static inline void mapperScanline(Mapper* mapper) {
+    if (mapper->ops->scanline != NULL) {
+        mapper->ops->scanline(mapper);
+    }
+}
+
+/**
+ * Check if the mapper is asserting the CPU's IRQ line
+ *
+ * @param mapper - The cartridge's mapper
+ *
+ * @returns true if an IRQ is pending
+ */
+static inline bool mapperIrq(const Mapper* mapper) {
+    return mapper->ops->irq != NULL && mapper->ops->irq(mapper);
+}
+
+#endif
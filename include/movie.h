@@ -0,0 +1,149 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "controller.h"
+#include "savestate.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOVIE_MAGIC   "MADMOVIE"
+#define MOVIE_VERSION (1)
+
+// A recording of the buttons held down on every frame of a run. Replaying
+// those buttons from the same start state always ends in the same state, so
+// the movie keeps the hash of that state to check replays against.
+//
+// On disk (every value little endian):
+//   MOVIE_MAGIC, version (u32), rom hash (u64), final state hash (u64),
+//   frame count (u32), start state size (u32), the start state, then
+//   CONTROLLER_PORTS bytes of BUTTON_ bits for every frame
+typedef struct {
+    uint64_t rom_hash;    // hashRom of the cartridge the movie was recorded on
+    uint64_t final_hash;  // saveStateHash once every frame has run
+    uint8_t* start_state;
+    size_t state_size;
+
+    uint8_t* inputs;  // CONTROLLER_PORTS bytes a frame
+    uint32_t frames;
+    uint32_t capacity;  // Frames that fit in inputs
+} Movie;
+
+// A plain text script of the buttons to hold down while recording. Each line
+// is the frame (counted from the start of the run) the buttons are pressed
+// from, then the first controller's buttons and optionally the second's, e.x.
+// "120 START" or "300 A+RIGHT B". Lines starting with # are comments.
+typedef struct {
+    uint64_t frame;
+    uint8_t buttons[CONTROLLER_PORTS];
+} InputEvent;
+
+typedef struct {
+    InputEvent* events;  // In frame order
+    uint32_t count;
+    uint32_t next;  // The next event to reach
+} InputScript;
+
+/**
+ * Start recording a movie from the machine's current state
+ *
+ * @param rom_hash - hashRom of the cartridge
+ * @param machine - The machine
+ *
+ * @returns The movie
+ * @returns NULL if memory couldn't be allocated
+ */
+Movie* createMovie(uint64_t rom_hash, const Machine* machine);
+
+/**
+ * Free a movie
+ *
+ * @param movie - The movie to free
+ */
+void freeMovie(Movie* movie);
+
+/**
+ * Add a frame's buttons to the end of a movie
+ *
+ * @param movie - The movie
+ * @param buttons - The buttons held on each controller
+ *
+ * @returns 0 if the frame was added
+ * @returns -1 if memory couldn't be allocated
+ */
+int movieRecordFrame(Movie* movie, const uint8_t* buttons);
+
+/**
+ * Get the buttons held on a frame of a movie
+ *
+ * @param movie - The movie
+ * @param frame - The frame (less than movie->frames)
+ *
+ * @returns The buttons held on each controller
+ */
+static inline const uint8_t* movieFrame(const Movie* movie, uint32_t frame) {
+    return movie->inputs + (size_t)frame * CONTROLLER_PORTS;
+}
+
+/**
+ * Put the machine in a movie's start state
+ *
+ * @param movie - The movie
+ * @param machine - The machine
+ * @param rom_hash - hashRom of the machine's cartridge
+ *
+ * @returns 0 if the start state was loaded
+ * @returns -1 if the movie is for another rom or its start state is invalid
+ */
+int movieStart(const Movie* movie, Machine* machine, uint64_t rom_hash);
+
+/**
+ * Write a movie to a file
+ *
+ * @param movie - The movie
+ * @param path - The file to write
+ *
+ * @returns 0 if the movie was saved
+ * @returns -1 if the file couldn't be written
+ */
+int saveMovie(const Movie* movie, const char* path);
+
+/**
+ * Read a movie from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The movie
+ * @returns NULL if the file couldn't be read or isn't a valid movie
+ */
+Movie* loadMovie(const char* path);
+
+/**
+ * Read an input script from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The script
+ * @returns NULL if the file couldn't be read or has an invalid line
+ */
+InputScript* loadInputScript(const char* path);
+
+/**
+ * Free an input script
+ *
+ * @param script - The script to free
+ */
+void freeInputScript(InputScript* script);
+
+/**
+ * Find the buttons the script holds down on a frame. Frames have to be asked
+ * for in order.
+ *
+ * @param script - The script
+ * @param frame - The frame (counted from the start of the run)
+ * @param buttons - Set to the buttons held on each controller (left as they
+ *                  were if nothing changes on the frame)
+ */
+void inputScriptButtons(InputScript* script, uint64_t frame, uint8_t* buttons);
+
+#endif
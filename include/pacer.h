@@ -0,0 +1,94 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CPU_CLOCK_HZ (1789773)  // NTSC 2A03 clock rate
+
+// An NTSC frame is 29780.5 CPU cycles, so frame boundaries are tracked in
+// half cycles to keep them exact
+#define HALF_CYCLES_PER_FRAME (59561)
+
+#define PACER_MAX_LAG_NS (100000000)  // How far behind the pacer can fall before giving up on catching up
+
+// Keeps emulation running at a multiple of real time by sleeping once a frame,
+// rather than after every instruction
+typedef struct {
+    double speed;  // Multiple of real time to run at (0 for as fast as possible)
+
+    // The wall clock time that cycle 'base_cycle' was reached at. Every frame's
+    // deadline is measured from here rather than from the previous frame, so
+    // oversleeping doesn't add up over time.
+    uint64_t base_ns;
+    uint64_t base_cycle;
+
+    uint64_t next_frame;  // Half cycle count of the next frame boundary
+
+    uint64_t frames;     // Frame boundaries reached
+    uint64_t sleeps;     // Number of times the pacer slept
+    uint64_t resyncs;    // Number of times the pacer fell too far behind and started over
+    uint64_t slept_ns;   // Total time spent sleeping
+} Pacer;
+
+/**
+ * Parse a --speed argument: "unlimited", or a multiple of real time like "2x"
+ * or "0.5x" (the x is optional)
+ *
+ * @param arg - The argument to parse
+ * @param speed - Set to the multiple of real time, or 0 for unlimited
+ *
+ * @returns 0 if the argument is valid
+ * @returns -1 if it isn't
+ */
+int parseSpeed(const char* arg, double* speed);
+
+/**
+ * Start pacing from the given CPU cycle
+ *
+ * @param pacer - The pacer to set up
+ * @param speed - The multiple of real time to run at (0 for unlimited)
+ * @param cycle - The current CPU cycle
+ */
+void initPacer(Pacer* pacer, double speed, uint64_t cycle);
+
+/**
+ * Get the current time of the monotonic clock
+ *
+ * @returns The time in nanoseconds
+ */
+uint64_t pacerNow(void);
+
+/**
+ * Find when the given CPU cycle should be reached, going by the pacer's speed
+ *
+ * @param pacer - The pacer
+ * @param cycle - The CPU cycle
+ *
+ * @returns The monotonic clock time (in nanoseconds)
+ */
+uint64_t pacerDeadline(const Pacer* pacer, uint64_t cycle);
+
+/**
+ * Sleep until the CPU cycle is due, and move on to the next frame boundary. If
+ * emulation has fallen more than PACER_MAX_LAG_NS behind, pacing starts over
+ * from now instead of running flat out to catch up.
+ *
+ * @param pacer - The pacer
+ * @param cycle - The current CPU cycle
+ */
+void pacerWait(Pacer* pacer, uint64_t cycle);
+
+/**
+ * Check if the CPU has reached a frame boundary
+ *
+ * @param pacer - The pacer
+ * @param cycle - The current CPU cycle
+ *
+ * @returns true if pacerWait should be called
+ */
+static inline bool pacerDue(const Pacer* pacer, uint64_t cycle) {
+    return cycle * 2 >= pacer->next_frame;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include "bus.h"
+#include "mapper.h"
+#include "scheduler.h"
+#include "types.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PPU_DOTS_PER_SCANLINE  (341)
+#define PPU_SCANLINES          (262)  // 240 visible, 1 post-render, 20 vblank, 1 pre-render
+#define PPU_VBLANK_SCANLINE    (241)
+#define PPU_PRERENDER_LINE     (261)
+#define PPU_DOTS_PER_CPU_CYCLE (3)
+
+/**
+ * Allocate a PPU in its power-on state
+ *
+ * @param mapper - The cartridge's mapper, which provides the pattern tables
+ *
+ * @returns The new PPU, or NULL if it couldn't be allocated
+ */
+PPU* createPPU(Mapper* mapper);
+
+/**
+ * Free a PPU
+ *
+ * @param ppu - The PPU to free
+ */
+void freePPU(PPU* ppu);
+
+/**
+ * Map the PPU's registers into the CPU address space: $2000-$2007 (mirrored
+ * up to $3FFF) and OAMDMA at $4014
+ *
+ * @param ppu - The PPU
+ * @param bus - The CPU bus
+ */
+void ppuMapRegisters(PPU* ppu, Bus* bus);
+
+/**
+ * Read one of the PPU's registers
+ *
+ * @param ppu - The PPU
+ * @param addr - The CPU address of the register ($2000-$3FFF)
+ *
+ * @returns The value of the register
+ */
+uint8_t ppuReadRegister(PPU* ppu, uint16_t addr);
+
+/**
+ * Write one of the PPU's registers
+ *
+ * @param ppu - The PPU
+ * @param addr - The CPU address of the register ($2000-$3FFF)
+ * @param val - The value to write
+ */
+void ppuWriteRegister(PPU* ppu, uint16_t addr, uint8_t val);
+
+/**
+ * Copy a page of CPU memory into OAM, like a write to $4014
+ *
+ * @param ppu - The PPU
+ * @param page - The high byte of the CPU address to copy from
+ */
+void ppuOamDma(PPU* ppu, uint8_t page);
+
+/**
+ * Run the PPU for the given number of dots. Scanlines are rendered whole, at the
+ * point in the line where the PPU finishes fetching them (dot 257), so scroll
+ * changes take effect a scanline at a time.
+ *
+ * @param ppu - The PPU
+ * @param dots - The number of dots (3 per CPU cycle) to run for
+ */
+void ppuStep(PPU* ppu, int dots);
+
+/**
+ * Run the PPU up to a CPU cycle, from the cycle it was last run up to
+ *
+ * @param ppu - The PPU
+ * @param cycle - The CPU cycle to run up to
+ */
+void ppuCatchUp(PPU* ppu, uint64_t cycle);
+
+/**
+ * Find the CPU cycle by which the PPU next has to be run: the start of vblank
+ * (where it may raise an NMI), the end of the frame, and while rendering with a
+ * mapper that has IRQs, the next scanline the mapper is told about. Sprite zero
+ * hits and everything else only show up through the registers, which catch the
+ * PPU up themselves.
+ *
+ * @param ppu - The PPU
+ *
+ * @returns The CPU cycle of the next event
+ */
+uint64_t ppuNextEvent(const PPU* ppu);
+
+/**
+ * Hand the PPU over to a scheduler, so it only runs when the CPU needs it to.
+ * The mapper is synced through the scheduler too, since its registers change
+ * what the PPU does.
+ *
+ * @param ppu - The PPU
+ * @param scheduler - The scheduler driven by the CPU's cycle count
+ *
+ * @returns 0 if the PPU was added to the scheduler
+ */
+int ppuSchedule(PPU* ppu, Scheduler* scheduler);
+
+/**
+ * Convert the framebuffer to 32-bit ARGB pixels
+ *
+ * @param ppu - The PPU
+ * @param argb - SCREEN_WIDTH * SCREEN_HEIGHT pixels to write the frame to
+ */
+void ppuExpandFrame(const PPU* ppu, uint32_t* argb);
+
+/**
+ * Write a frame out as a binary PPM image
+ *
+ * @param file - Where to write the image
+ * @param kernels - The render kernels to convert the frame's colors with
+ * @param pixels - The frame's SCREEN_WIDTH * SCREEN_HEIGHT NES colors
+ *
+ * @returns 0 if the image was written
+ * @returns -1 if a write failed
+ */
+int writePpm(FILE* file, const struct RenderKernels* kernels, const uint8_t* pixels);
+
+/**
+ * Write the framebuffer out as a binary PPM image
+ *
+ * @param ppu - The PPU
+ * @param path - The path of the image to write
+ *
+ * @returns 0 if the image was written
+ */
+int ppuWritePpm(const PPU* ppu, const char* path);
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A ring of fixed size slots passed from one producer thread to one consumer
+// thread. Every slot is allocated up front, and like the tracer's ring each
+// side owns one index and only reads the other's, so it needs no locks. Unlike
+// the tracer's ring, a full queue never makes the producer wait: whatever it
+// was pushing is dropped and counted instead.
+typedef struct {
+    uint8_t* slots;
+    size_t slot_size;
+    uint32_t capacity;  // Slots in the ring (a power of 2)
+
+    // Written by the producer. 'cached_tail' is its last look at 'tail', so it
+    // only has to read the consumer's index when the ring seems full.
+    _Alignas(64) _Atomic uint64_t head;
+    uint64_t cached_tail;
+    uint64_t pushed;   // Slots handed to the consumer
+    uint64_t dropped;  // Pushes given up on because the ring was full
+
+    // Written by the consumer, with 'cached_head' its last look at 'head'
+    _Alignas(64) _Atomic uint64_t tail;
+    uint64_t cached_head;
+} Queue;
+
+/**
+ * Allocate a queue and all of its slots
+ *
+ * @param slot_size - The size of each slot in bytes
+ * @param capacity - The number of slots (a power of 2)
+ *
+ * @returns The queue, or NULL if it couldn't be allocated
+ */
+Queue* createQueue(size_t slot_size, uint32_t capacity);
+
+/**
+ * Free a queue and its slots
+ *
+ * @param queue - The queue to free
+ */
+void freeQueue(Queue* queue);
+
+/**
+ * Take the next free slot to fill in (producer only). Nothing is pushed until
+ * queuePublish is called.
+ *
+ * @param queue - The queue
+ *
+ * @returns The slot
+ * @returns NULL if the ring is full (and the push is counted as dropped)
+ */
+static inline void* queueReserve(Queue* queue) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head - queue->cached_tail == queue->capacity) {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head - queue->cached_tail == queue->capacity) {
+            queue->dropped++;
+            return NULL;
+        }
+    }
+    return queue->slots + (head & (queue->capacity - 1)) * queue->slot_size;
+}
+
+/**
+ * Hand the slot from queueReserve to the consumer (producer only)
+ *
+ * @param queue - The queue
+ */
+static inline void queuePublish(Queue* queue) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    queue->pushed++;
+}
+
+/**
+ * Look at the oldest slot pushed (consumer only)
+ *
+ * @param queue - The queue
+ *
+ * @returns The slot, which stays the consumer's until queuePop
+ * @returns NULL if the queue is empty
+ */
+static inline void* queueFront(Queue* queue) {
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail == queue->cached_head) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail == queue->cached_head) {
+            return NULL;
+        }
+    }
+    return queue->slots + (tail & (queue->capacity - 1)) * queue->slot_size;
+}
+
+/**
+ * Hand the slot from queueFront back to the producer (consumer only)
+ *
+ * @param queue - The queue
+ */
+static inline void queuePop(Queue* queue) {
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Check how many slots have been pushed and not yet popped
+ *
+ * @param queue - The queue
+ *
+ * @returns The number of slots in use
+ */
+static inline uint32_t queueLength(Queue* queue) {
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return atomic_load_explicit(&queue->head, memory_order_acquire) - tail;
+}
+
+#endif
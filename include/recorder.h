@@ -0,0 +1,88 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "blip.h"
+#include "queue.h"
+#include "render.h"
+#include "types.h"
+#include "wav.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RECORDER_FRAME_SLOTS (8)   // Finished frames that can wait to be written
+#define RECORDER_AUDIO_SLOTS (16)  // Blocks of samples that can wait to be written
+
+// A block of samples from the APU
+typedef struct {
+    int count;
+    int16_t samples[BLIP_SIZE];
+} AudioBlock;
+
+// Writes finished frames and audio from a background thread, so the emulation
+// thread never waits on a file. Everything goes through preallocated queues,
+// and anything that doesn't fit because the writer has fallen behind is dropped
+// (and counted) rather than waited for, so how fast the emulator runs doesn't
+// depend on the disk.
+typedef struct {
+    Queue* frames;  // SCREEN_WIDTH * SCREEN_HEIGHT NES colors each
+    Queue* audio;   // An AudioBlock each
+
+    // Only touched by the writer thread
+    FILE* video;  // Frames as binary PPM images, one after another (optional)
+    const char* video_path;
+    const RenderKernels* kernels;
+    WavWriter* wav;         // Optional
+    uint64_t frames_written;
+    bool failed;            // A video write failed (the rest are skipped)
+
+    _Atomic bool stopping;
+    pthread_t writer;
+} Recorder;
+
+/**
+ * Open the output files and start the thread that writes to them
+ *
+ * @param video_path - The file (or named pipe) to write frames to, or NULL
+ * @param wav_path - The WAV file (or named pipe) to write audio to, or NULL
+ *
+ * @returns The recorder
+ * @returns NULL if a file couldn't be opened or the thread couldn't be started
+ */
+Recorder* createRecorder(const char* video_path, const char* wav_path);
+
+/**
+ * Write out everything still queued, then stop the writer thread and close the
+ * files
+ *
+ * @param recorder - The recorder to free
+ *
+ * @returns 0 if everything that was queued was written
+ * @returns -1 if a write failed
+ */
+int freeRecorder(Recorder* recorder);
+
+/**
+ * Queue a finished frame to be written, without waiting
+ *
+ * @param recorder - The recorder
+ * @param pixels - The frame's SCREEN_WIDTH * SCREEN_HEIGHT NES colors
+ *
+ * @returns true if the frame was queued
+ * @returns false if the writer has fallen behind and the frame was dropped
+ */
+bool recorderPushFrame(Recorder* recorder, const uint8_t* pixels);
+
+/**
+ * Queue a block of samples to be written, without waiting (an ApuOutput)
+ *
+ * @param context - The recorder
+ * @param samples - The samples
+ * @param count - The number of samples (at most BLIP_SIZE)
+ */
+void recorderPushAudio(void* context, const int16_t* samples, int count);
+
+#endif
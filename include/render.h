@@ -0,0 +1,66 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+
+#define CHR_TILE_SIZE     (16)  // Size of a 2bpp tile in CHR memory
+#define DECODED_TILE_SIZE (64)  // Size of a tile decoded to one palette index (0-3) per pixel
+
+// The per-pixel loops of the PPU's renderer. Each instruction set gets its own
+// table of kernels, and the PPU picks the best one the CPU supports.
+typedef struct RenderKernels {
+    const char* name;
+
+    // Decode rows of 2bpp tiles into 8 pixels each (leftmost first). A pixel is
+    // its 2-bit color ORed with the tile's attribute byte, or 0 if transparent.
+    void (*decodeTiles)(const uint8_t* lo, const uint8_t* hi, const uint8_t* attrs, int count,
+                        uint8_t* out);
+
+    // Same as decodeTiles, but for rows that have already been decoded (8 palette
+    // indices each, see decodeChr)
+    void (*attributeTiles)(const uint8_t* const* rows, const uint8_t* attrs, int count,
+                           uint8_t* out);
+
+    // Pick the visible layer of each pixel of a scanline and look it up in the
+    // palette. Background pixels are palette entries $00-$0F (0 for
+    // transparent), and sprite pixels are $10-$1F with bit 5 set when they're
+    // behind the background (0 for no sprite).
+    void (*composite)(const uint8_t* bg, const uint8_t* sprites, const uint8_t* palette,
+                      uint8_t color_mask, uint8_t* out);
+
+    // Convert NES colors (palette indices $00-$3F) to 32-bit ARGB pixels
+    void (*expand)(const uint8_t* pixels, int count, uint32_t* argb);
+} RenderKernels;
+
+typedef enum {
+    RENDER_SCALAR,
+    RENDER_SSE2,
+    RENDER_AVX2,
+} RenderLevel;
+
+/**
+ * Get the render kernels for an instruction set
+ *
+ * @param level - The instruction set
+ *
+ * @returns The kernels, or NULL if the compiler or CPU doesn't support them
+ */
+const RenderKernels* getRenderKernels(RenderLevel level);
+
+/**
+ * Get the fastest render kernels the CPU supports
+ *
+ * @returns The kernels
+ */
+const RenderKernels* bestRenderKernels(void);
+
+/**
+ * Decode CHR tiles into 8x8 palette indices (0-3), row by row
+ *
+ * @param chr - The CHR memory to decode
+ * @param size - The size of chr (a multiple of CHR_TILE_SIZE)
+ * @param tiles - Where to write DECODED_TILE_SIZE bytes per tile
+ */
+void decodeChr(const uint8_t* chr, uint32_t size, uint8_t* tiles);
+
+#endif
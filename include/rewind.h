@@ -0,0 +1,121 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "savestate.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REWIND_ARENA_SIZE (4 * 1024 * 1024)  // Default memory for the history's deltas
+
+// Where one older state's delta is kept in the arena
+typedef struct {
+    size_t offset;
+    size_t size;
+} RewindEntry;
+
+// History of save states taken every few frames. Only the newest state is
+// kept whole. Each older state is stored as the XOR of it and the state after
+// it, run-length encoded, so the bytes that didn't change between the two
+// (most of RAM, VRAM and the framebuffer) take almost no space. Deltas are
+// packed into a ring arena that's allocated up front, and the oldest ones are
+// dropped when it fills up, so memory use never grows.
+typedef struct {
+    size_t state_size;
+    uint8_t* latest;   // The newest state, whole
+    uint8_t* scratch;  // The state being taken
+    uint8_t* packed;   // A delta being encoded (big enough for the worst case)
+    bool has_latest;
+
+    uint8_t* arena;
+    size_t arena_size;
+    size_t arena_head;  // Where the next delta goes
+
+    RewindEntry* entries;  // Ring of deltas, oldest first
+    uint32_t capacity;     // The most deltas kept, no matter how much room is left
+    uint32_t first;
+    uint32_t count;
+
+    uint32_t interval;    // Frames between states
+    uint64_t next_frame;  // Frame the next state is due at
+
+    uint64_t pushes;     // States taken
+    uint64_t evictions;  // Deltas dropped to make room
+} Rewind;
+
+/**
+ * Create a rewind history
+ *
+ * @param machine - The machine the states are taken from
+ * @param seconds - How much history to keep
+ * @param interval - Frames between states
+ * @param arena_size - Bytes to set aside for deltas (e.x. REWIND_ARENA_SIZE)
+ *
+ * @returns The history
+ * @returns NULL if the arguments are invalid or memory couldn't be allocated
+ */
+Rewind* createRewind(const Machine* machine, double seconds, uint32_t interval,
+                     size_t arena_size);
+
+/**
+ * Free a rewind history
+ *
+ * @param history - The history to free
+ */
+void freeRewind(Rewind* history);
+
+/**
+ * Take a state and add it to the history, dropping the oldest states if
+ * there's no room left
+ *
+ * @param history - The history
+ * @param machine - The machine
+ */
+void rewindPush(Rewind* history, const Machine* machine);
+
+/**
+ * Restore an earlier state, dropping every state after it from the history
+ *
+ * @param history - The history
+ * @param machine - The machine to restore
+ * @param steps - How many states back from the newest one to go (0 for the
+ *                newest one itself)
+ *
+ * @returns The number of states actually gone back (fewer than steps if the
+ *          history doesn't go back that far)
+ * @returns -1 if there's no history yet
+ */
+int rewindStep(Rewind* history, Machine* machine, uint32_t steps);
+
+/**
+ * Find how many states the history holds
+ *
+ * @param history - The history
+ *
+ * @returns The number of states that can be restored
+ */
+uint32_t rewindDepth(const Rewind* history);
+
+/**
+ * Find how much of the arena the history's deltas take up
+ *
+ * @param history - The history
+ *
+ * @returns The size of the deltas in bytes
+ */
+size_t rewindUsage(const Rewind* history);
+
+/**
+ * Check if the next state is due
+ *
+ * @param history - The history
+ * @param frame - The PPU's current frame
+ *
+ * @returns true if rewindPush should be called
+ */
+static inline bool rewindDue(const Rewind* history, uint64_t frame) {
+    return frame >= history->next_frame;
+}
+
+#endif
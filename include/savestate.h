@@ -0,0 +1,94 @@
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include "apu.h"
+#include "controller.h"
+#include "mapper.h"
+#include "types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATE_MAGIC   "MADSTATE"
+#define STATE_VERSION (1)
+
+// The parts of a running NES a save state covers. The PPU and mapper have to
+// belong to the same cartridge the state was saved from.
+typedef struct {
+    Processor* processor;
+    uint8_t* ram;  // The CPU's RAM_SIZE bytes of RAM
+    PPU* ppu;
+    Mapper* mapper;
+    uint64_t* cycles;          // The CPU's cycle count
+    Controllers* controllers;  // Optional (states without them leave them as they are)
+    APU* apu;                  // Optional, like the controllers
+} Machine;
+
+/**
+ * Find how big a save state of the machine is
+ *
+ * @param machine - The machine
+ *
+ * @returns The size of the state in bytes
+ */
+size_t saveStateSize(const Machine* machine);
+
+/**
+ * Save the machine's state into a buffer. Every value is stored little endian,
+ * so a state can be loaded on any host.
+ *
+ * @param machine - The machine to save
+ * @param buffer - Where to write the state
+ * @param size - The size of the buffer (at least saveStateSize bytes)
+ *
+ * @returns The number of bytes written
+ * @returns 0 if the buffer is too small
+ */
+size_t saveState(const Machine* machine, uint8_t* buffer, size_t size);
+
+/**
+ * Restore the machine's state from a buffer. Nothing is changed unless the
+ * whole state is valid.
+ *
+ * @param machine - The machine to restore
+ * @param buffer - The state
+ * @param size - The size of the state
+ *
+ * @returns 0 if the state was loaded
+ * @returns -1 if it's corrupt, from a newer version, or from another cartridge
+ */
+int loadState(Machine* machine, const uint8_t* buffer, size_t size);
+
+/**
+ * Hash the machine's state, e.x. to check that two runs ended up in exactly
+ * the same place
+ *
+ * @param machine - The machine
+ *
+ * @returns The 64-bit FNV-1a hash of the machine's save state
+ */
+uint64_t saveStateHash(const Machine* machine);
+
+/**
+ * Save the machine's state to a file
+ *
+ * @param machine - The machine to save
+ * @param path - The file to write
+ *
+ * @returns 0 if the state was saved
+ * @returns -1 if the file couldn't be written
+ */
+int saveStateFile(const Machine* machine, const char* path);
+
+/**
+ * Restore the machine's state from a file
+ *
+ * @param machine - The machine to restore
+ * @param path - The file to read
+ *
+ * @returns 0 if the state was loaded
+ * @returns -1 if the file couldn't be read or doesn't hold a valid state
+ */
+int loadStateFile(Machine* machine, const char* path);
+
+#endif
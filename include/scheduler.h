@@ -0,0 +1,82 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_COMPONENTS (4)
+#define SCHEDULER_NO_EVENT       (UINT64_MAX)  // nextEvent result when nothing is coming up
+
+// A part of the system that runs alongside the CPU (PPU, APU). Components run
+// lazily: they're only caught up to the CPU when the CPU is about to touch their
+// registers, or when the CPU reaches the next event they've scheduled.
+typedef struct {
+    const char* name;
+    void* context;  // Passed to the hooks
+
+    // Run the component up to the given CPU cycle
+    void (*catchUp)(void* context, uint64_t cycle);
+
+    // The CPU cycle by which the component next needs to be run because it
+    // might do something the CPU can see without asking (raise an NMI or IRQ,
+    // finish a frame), or SCHEDULER_NO_EVENT
+    uint64_t (*nextEvent)(void* context);
+} SchedulerComponent;
+
+typedef struct Scheduler {
+    uint64_t* clock;    // The CPU's cycle count, which everything is caught up to
+    uint64_t deadline;  // The earliest event of all the components
+
+    SchedulerComponent components[SCHEDULER_MAX_COMPONENTS];
+    int count;
+
+    uint64_t syncs;  // Number of times the components have been caught up
+} Scheduler;
+
+/**
+ * Set up a scheduler with no components
+ *
+ * @param scheduler - The scheduler to set up
+ * @param clock - The CPU's cycle count
+ */
+void initScheduler(Scheduler* scheduler, uint64_t* clock);
+
+/**
+ * Add a component to the scheduler, synced to the current CPU cycle
+ *
+ * @param scheduler - The scheduler
+ * @param component - The component to add
+ *
+ * @returns 0 if the component was added
+ * @returns -1 if the scheduler is full
+ */
+int schedulerAdd(Scheduler* scheduler, SchedulerComponent component);
+
+/**
+ * Catch every component up to the CPU, then find the next deadline
+ *
+ * @param scheduler - The scheduler
+ */
+void schedulerSync(Scheduler* scheduler);
+
+/**
+ * Find the next deadline again, after something the CPU did (like a register
+ * write) may have moved a component's next event
+ *
+ * @param scheduler - The scheduler
+ */
+void schedulerReschedule(Scheduler* scheduler);
+
+/**
+ * Check if the CPU has reached the next deadline, meaning the components have
+ * to be caught up before it runs any further
+ *
+ * @param scheduler - The scheduler
+ *
+ * @returns true if schedulerSync should be called
+ */
+static inline bool schedulerDue(const Scheduler* scheduler) {
+    return *scheduler->clock >= scheduler->deadline;
+}
+
+#endif
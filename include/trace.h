@@ -0,0 +1,180 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TRACE_MAGIC       "NESTRACE"
+#define TRACE_VERSION     (1)
+#define TRACE_RING_SIZE   (1 << 16)  // Records the ring holds (must be a power of 2)
+#define TRACE_LINE_LENGTH (128)      // Enough for any formatted record
+
+// One executed instruction, with the registers as they were before it ran.
+// Records are written to the trace file as is, in the host's byte order.
+typedef struct {
+    uint64_t cycles;      // CPU cycle count
+    uint16_t pc;          // Address of the instruction
+    uint8_t opcode;       // The opcode byte
+    uint8_t operands[2];  // The operand bytes (only the first length - 1 mean anything)
+    uint8_t a, x, y, p, s;
+    uint8_t reserved[6];  // Pads the record out to 24 bytes (always 0)
+} TraceRecord;
+
+_Static_assert(sizeof(TraceRecord) == 24, "Trace records should be 24 bytes");
+
+// Starts every trace file, so the formatter can tell it's reading one
+typedef struct {
+    char magic[8];         // TRACE_MAGIC, not null terminated
+    uint32_t version;      // TRACE_VERSION
+    uint32_t record_size;  // sizeof(TraceRecord)
+} TraceHeader;
+
+// How the formatter prints records
+typedef enum {
+    TRACE_FORMAT_TEXT,     // Registers and the instruction, like the disassembler prints it
+    TRACE_FORMAT_NESTEST,  // Lines in the same columns as nestest.log
+} TraceFormat;
+
+// Writes trace records to a file from a background thread. The CPU thread is
+// the only producer and the writer thread the only consumer, so the ring needs
+// no locks: each side owns one index and only reads the other's.
+typedef struct {
+    TraceRecord* records;
+
+    // Written by the CPU thread. 'cached_tail' is its last look at 'tail', so it
+    // only has to read the writer's index when the ring seems full.
+    _Alignas(64) _Atomic uint64_t head;
+    uint64_t cached_tail;
+    uint64_t stalls;  // Number of times the CPU thread waited for the writer
+
+    // Written by the writer thread
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic bool stopping;
+    uint64_t written;  // Records written to the file
+    bool failed;       // A write failed (the rest of the records are dropped)
+
+    FILE* file;
+    const char* path;
+    pthread_t writer;
+} Tracer;
+
+/**
+ * Write the header that starts every trace file
+ *
+ * @param file - The trace file, at its start
+ * @param file_path - The path of the trace file (for errors)
+ *
+ * @returns 0 on success
+ * @returns -1 if it couldn't be written
+ */
+int writeTraceHeader(FILE* file, const char* file_path);
+
+/**
+ * Open a trace file and start the thread that writes to it
+ *
+ * @param file_path - The file to write the trace to (kept for errors, so it has to outlive
+ *                    the tracer)
+ *
+ * @returns A pointer to the tracer, or NULL if the file couldn't be opened
+ */
+Tracer* createTracer(const char* file_path);
+
+/**
+ * Write out every record still in the ring, then stop the writer thread and
+ * close the trace file
+ *
+ * @param tracer - The tracer to free
+ *
+ * @returns 0 if every record was written
+ * @returns -1 if a write failed
+ */
+int freeTracer(Tracer* tracer);
+
+/**
+ * Wait for the writer thread to make room in the ring
+ *
+ * @param tracer - The tracer
+ */
+void traceWaitForSpace(Tracer* tracer);
+
+/**
+ * Record an instruction that is about to run. Unless the ring is full, this is
+ * only a few stores.
+ *
+ * @param tracer - The tracer
+ * @param instr - The instruction about to run
+ * @param processor - The processor holding register values (with P up to date)
+ * @param cycles - The CPU cycle count
+ */
+static inline void traceInstruction(Tracer* tracer, const Instruction* instr,
+                                    const Processor* processor, uint64_t cycles) {
+    uint64_t head = atomic_load_explicit(&tracer->head, memory_order_relaxed);
+    if (head - tracer->cached_tail == TRACE_RING_SIZE) {
+        traceWaitForSpace(tracer);
+    }
+
+    TraceRecord* record = &tracer->records[head & (TRACE_RING_SIZE - 1)];
+    record->cycles = cycles;
+    record->pc = processor->PC;
+    record->opcode = instr->opcode;
+    record->operands[0] = instr->addr & 0xFF;
+    record->operands[1] = instr->addr >> 8;
+    record->a = processor->A;
+    record->x = processor->X;
+    record->y = processor->Y;
+    record->p = processor->P;
+    record->s = processor->S;
+
+    // Publish the record to the writer thread
+    atomic_store_explicit(&tracer->head, head + 1, memory_order_release);
+}
+
+/**
+ * Parse a trace format name ("text" or "nestest")
+ *
+ * @param name - The name of the format
+ * @param format - Set to the format
+ *
+ * @returns 0 if the name is valid
+ * @returns -1 if it isn't
+ */
+int parseTraceFormat(const char* name, TraceFormat* format);
+
+/**
+ * Format a trace record as a line of text (without a newline)
+ *
+ * @param record - The record to format
+ * @param format - How to format it
+ * @param line - Buffer of at least TRACE_LINE_LENGTH bytes to write the line to
+ */
+void formatTraceRecord(const TraceRecord* record, TraceFormat format, char* line);
+
+/**
+ * Read and check the header at the start of a trace file
+ *
+ * @param file - The trace file, at its start
+ * @param file_path - The path of the trace file (for errors)
+ *
+ * @returns 0 if the file is a trace file this version can read
+ * @returns -1 if it isn't
+ */
+int readTraceHeader(FILE* file, const char* file_path);
+
+/**
+ * Print every record in a trace file as text
+ *
+ * @param file_path - The trace file to read
+ * @param format - How to format the records
+ * @param out - Where to print the records
+ *
+ * @returns The number of records printed
+ * @returns -1 if the file couldn't be read or isn't a trace file
+ */
+long long formatTraceFile(const char* file_path, TraceFormat format, FILE* out);
+
+#endif
@@ -2,21 +2,52 @@
 #define TYPES_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#define MEMORY_SPACE (2000)  // 2kb of memory
+#define MEMORY_SPACE (0x10000)  // 64 KiB CPU address space
+
+struct BlockCache;
+struct Bus;
+struct Mapper;
+struct RenderKernels;
+struct Scheduler;
 
 // A 6502 processor has 5 registers: A, X, Y, the Stack Pointer, and the Program Counter
+// Status flag bits of the P register (NV1BDIZC)
+#define FLAG_N 0x80
+#define FLAG_V 0x40
+#define FLAG_U 0x20
+#define FLAG_B 0x10
+#define FLAG_D 0x08
+#define FLAG_I 0x04
+#define FLAG_Z 0x02
+#define FLAG_C 0x01
+
 typedef struct {
     uint16_t PC;  // Program counter
     uint8_t S;    // Stack pointer
-    uint8_t P;    // Status flags NV1BDIZC
+    uint8_t P;    // Status flags NV1BDIZC (N, V, Z and C are stale while flags_lazy is set)
     uint8_t A;    // Accumulator
     uint8_t X;    // Index register X
     uint8_t Y;    // Index register Y
     bool halted;  // Only used for debugging purposes
+
+    // Lazily evaluated flags. Most instructions overwrite N and Z (and often C
+    // and V) before anything reads them, so while flags_lazy is set the results
+    // they come from are kept here instead, and syncFlags computes them into P.
+    bool flags_lazy;
+    uint8_t n_result;  // N is bit 7 of this
+    uint8_t z_result;  // Z is set when this is 0
+    uint8_t c_result;  // C (0 or 1)
+    uint8_t v_result;  // V is bit 7 of this
+
+    struct BlockCache* block_cache;  // Decoded code to invalidate on stores (NULL if unused)
 } Processor;
 
+#define SCREEN_WIDTH  (256)
+#define SCREEN_HEIGHT (240)
+
 typedef struct {
     // CPU-visible registers
     uint8_t ctrl;    // PPUCTRL register (mapped to $2000, write)
@@ -27,9 +58,11 @@ typedef struct {
     uint8_t oam_addr;  // OAMADDR register (mapped to $2003, write)
 
     uint8_t data_buffer;  // PPUDATA (mapped to $2007 read + write)
+    uint8_t open_bus;     // Last value on the PPU's data bus (what write-only registers read as)
 
     // Internal memory
-    uint8_t vram[2048];   // Nametables and attribute tables
+    uint8_t vram[4096];   // Nametables and attribute tables (the upper 2 KiB is only
+                          // used by four-screen cartridges)
     uint8_t palette[32];  // Palette data (addrs $3F00-$3FFF, mirrored after $3F1F)
 
     // VRAM Addressing
@@ -41,10 +74,30 @@ typedef struct {
     // Timing
     int scanline;
     int cycle;
+    uint64_t frame;  // Number of frames completed
+
+    uint32_t tile_rebuilds;       // CHR-RAM tiles the last frame had to decode again
+    uint32_t peak_tile_rebuilds;  // Most tile rebuilds in any one frame
 
     // NMI
     bool nmi_occurred;
     bool nmi_output;
+    bool nmi_line;     // Level of the NMI output (nmi_occurred && nmi_output)
+    bool nmi_pending;  // Set on the rising edge of NMI, cleared by the CPU servicing it
+
+    int dma_cycles;  // CPU cycles owed to OAM DMA, cleared by the CPU stalling for them
+
+    struct Mapper* mapper;  // Cartridge providing the pattern tables and mirroring
+    struct Bus* bus;        // CPU bus OAM DMA reads from
+
+    // The PPU only runs when the scheduler catches it up to the CPU (if it has one)
+    struct Scheduler* scheduler;
+    uint64_t synced_cycle;  // CPU cycle the PPU has been run up to
+
+    const struct RenderKernels* kernels;  // Pixel loops for the CPU's instruction set
+
+    // Palette indices (0-63) of the last rendered frame
+    uint8_t framebuffer[SCREEN_HEIGHT][SCREEN_WIDTH];
 } PPU;
 
 // All possible addressing modes in 6502 assembly
@@ -64,11 +117,85 @@ typedef enum {
     INDY,
 } AddrMode;
 
+// Every instruction the CPU knows how to execute (ILLEGAL marks an unimplemented opcode)
+typedef enum {
+    ILLEGAL,
+    ADC,
+    AND,
+    ASL,
+    BCC,
+    BCS,
+    BEQ,
+    BIT,
+    BMI,
+    BNE,
+    BPL,
+    BRK,
+    BVC,
+    BVS,
+    CLC,
+    CLD,
+    CLI,
+    CLV,
+    CMP,
+    CPX,
+    CPY,
+    DEC,
+    DEX,
+    DEY,
+    EOR,
+    INC,
+    INX,
+    INY,
+    JMP,
+    JSR,
+    LDA,
+    LDX,
+    LDY,
+    LSR,
+    NOP,
+    ORA,
+    PHA,
+    PHP,
+    PLA,
+    PLP,
+    ROL,
+    ROR,
+    RTI,
+    RTS,
+    SBC,
+    SEC,
+    SED,
+    SEI,
+    STA,
+    STX,
+    STY,
+    TAX,
+    TAY,
+    TSX,
+    TXA,
+    TXS,
+    TYA,
+
+    // Unofficial opcodes
+    SLO,
+} Mnemonic;
+
+// Everything about an opcode that is known before it is executed (see opcode_table)
+typedef struct {
+    Mnemonic mnemonic;
+    AddrMode addr_mode;
+    const char* name;   // The mnemonic as printed by the disassembler
+    uint8_t length;     // Length of the instruction (in bytes)
+    uint8_t cycles;     // Base number of cycles, before any penalties
+    bool page_penalty;  // Takes an extra cycle when its indexed address crosses a page
+} OpcodeInfo;
+
 // Storing information about an instruction in a format that is easier to work with
 typedef struct {
     uint8_t opcode;
     AddrMode addr_mode;
-    char* name;  // The 3 letter mnemonic of the instruction
+    const char* name;  // The 3 letter mnemonic of the instruction
 
     // Possible types of arguments to an instruction
     uint8_t imm;
@@ -82,17 +209,36 @@ typedef struct {
 
 typedef struct {
     uint8_t magic_num[4];  // value of 0x4E45531A indicates a valid NES rom
-    uint8_t prg_rom_size;  // 16 KB units
-    uint8_t chr_rom_size;  // 8 KB units
+    uint8_t prg_rom_size;  // 16 KB units (LSB of the size in NES 2.0)
+    uint8_t chr_rom_size;  // 8 KB units (LSB of the size in NES 2.0)
     uint8_t flags6;
     uint8_t flags7;
     uint8_t flags8;
     uint8_t flags9;
     uint8_t flags10;
-    uint8_t reserved[5];
+    uint8_t reserved[5];  // Flags 11-15 in NES 2.0, unused in iNES
+
+    // Decoded from the header
+    bool nes2;  // Whether the header is in the NES 2.0 format
+    int mapper;
+    int submapper;
+    uint32_t prg_rom_bytes;
+    uint32_t chr_rom_bytes;
+    uint32_t prg_ram_size;    // Volatile PRG-RAM (in bytes)
+    uint32_t prg_nvram_size;  // Battery-backed PRG-RAM (in bytes)
+    uint32_t chr_ram_size;    // Volatile CHR-RAM (in bytes)
+    uint32_t chr_nvram_size;  // Battery-backed CHR-RAM (in bytes)
+
+    // These point into the read-only mapping of the rom file
     uint8_t* trainer;
     uint8_t* prg_rom;
     uint8_t* chr_rom;
+
+    void* rom_data;  // The mapping of the rom file (NULL if no rom is loaded)
+    size_t rom_data_size;
+
+    // CHR-ROM decoded to a palette index (0-3) per pixel, 64 bytes per tile
+    uint8_t* chr_tiles;
 } Cartridge;
 
 #endif
@@ -1,5 +1,14 @@
+#ifndef UTILS_H
+#define UTILS_H
+
 #include "types.h"
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_SEED (0xcbf29ce484222325ULL)  // The FNV-1a offset basis
+
 // String formats to be filled in when printing 6502 instructions
 #define IMPL_FORMAT  "%s\n"
 #define ACCUM_FORMAT "%s A\n"
@@ -31,3 +40,77 @@ void printInstruction(Instruction instr);
  * @returns The two bytes concatenated (e.x. ms_byte = 1010, ls_byte = 0101 returns 10100101)
  */
 uint16_t concatenateBytes(uint16_t ms_byte, uint16_t ls_byte);
+
+/**
+ * Hash some bytes with 64-bit FNV-1a. Pass the hash of one buffer as the seed of
+ * the next to hash them as if they were one.
+ *
+ * @param hash - The hash so far (HASH_SEED to start a new one)
+ * @param data - The bytes to hash
+ * @param size - The number of bytes
+ *
+ * @returns The hash
+ */
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size);
+
+// ---------- Little Endian Helpers ----------
+
+// Files (save states, movies, WAVs) store every value little endian, so they
+// can be moved between hosts. Each helper returns or advances past the bytes it
+// handled, so a file is written or read front to back.
+
+static inline uint8_t* put16(uint8_t* out, uint16_t val) {
+    out[0] = val;
+    out[1] = val >> 8;
+    return out + 2;
+}
+
+static inline uint8_t* put32(uint8_t* out, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = val >> (8 * i);
+    }
+    return out + 4;
+}
+
+static inline uint8_t* put64(uint8_t* out, uint64_t val) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = val >> (8 * i);
+    }
+    return out + 8;
+}
+
+static inline uint8_t* putBytes(uint8_t* out, const void* data, size_t size) {
+    memcpy(out, data, size);
+    return out + size;
+}
+
+static inline uint16_t get16(const uint8_t** in) {
+    uint16_t val = (*in)[0] | ((*in)[1] << 8);
+    *in += 2;
+    return val;
+}
+
+static inline uint32_t get32(const uint8_t** in) {
+    uint32_t val = 0;
+    for (int i = 0; i < 4; i++) {
+        val |= (uint32_t)(*in)[i] << (8 * i);
+    }
+    *in += 4;
+    return val;
+}
+
+static inline uint64_t get64(const uint8_t** in) {
+    uint64_t val = 0;
+    for (int i = 0; i < 8; i++) {
+        val |= (uint64_t)(*in)[i] << (8 * i);
+    }
+    *in += 8;
+    return val;
+}
+
+static inline void getBytes(const uint8_t** in, void* data, size_t size) {
+    memcpy(data, *in, size);
+    *in += size;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define WAV_HEADER_SIZE (44)
+
+// Streams 16-bit mono samples out as a WAV file. The header goes out first
+// with the largest sizes it can hold, so a named pipe can be played as it's
+// written, and the real sizes are filled in at the end if the file can seek.
+typedef struct {
+    FILE* file;
+    const char* path;
+    bool seekable;
+    uint32_t sample_rate;
+    uint64_t samples;  // Samples written so far
+    bool failed;       // A write failed (the rest are skipped)
+} WavWriter;
+
+/**
+ * Open a WAV file and write its header
+ *
+ * @param path - The file (or named pipe) to write
+ * @param sample_rate - Samples a second
+ *
+ * @returns The writer
+ * @returns NULL if the file couldn't be opened
+ */
+WavWriter* createWavWriter(const char* path, uint32_t sample_rate);
+
+/**
+ * Close a WAV file, filling in the sizes in its header if it can
+ *
+ * @param wav - The writer to close
+ *
+ * @returns 0 if everything was written
+ * @returns -1 if a write failed
+ */
+int freeWavWriter(WavWriter* wav);
+
+/**
+ * Add samples to the end of a WAV file
+ *
+ * @param wav - The writer
+ * @param samples - The samples
+ * @param count - The number of samples
+ */
+void wavWrite(WavWriter* wav, const int16_t* samples, int count);
+
+#endif
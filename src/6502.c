@@ -1,1117 +1,717 @@
 #include "6502.h"
 
+#include "blockcache.h"
 #include "logger.h"
 #include "utils.h"
 
-#include <_stdio.h>
 #include <stdint.h>
 #include <stdio.h>
 
+// Instruction length (in bytes) implied by each addressing mode
+#define MODE_LENGTH_IMPL  1
+#define MODE_LENGTH_ACCUM 1
+#define MODE_LENGTH_IMM   2
+#define MODE_LENGTH_ZP    2
+#define MODE_LENGTH_ZPX   2
+#define MODE_LENGTH_ZPY   2
+#define MODE_LENGTH_REL   2
+#define MODE_LENGTH_ABS   3
+#define MODE_LENGTH_ABSX  3
+#define MODE_LENGTH_ABSY  3
+#define MODE_LENGTH_IND   3
+#define MODE_LENGTH_INDX  2
+#define MODE_LENGTH_INDY  2
+
+#define OPCODE(mnemonic, name, mode, cycles, page_penalty) \
+    {mnemonic, mode, name, MODE_LENGTH_##mode, cycles, page_penalty}
+
+// Opcodes without an entry are zero-initialized, which leaves them as ILLEGAL
+const OpcodeInfo opcode_table[256] = {
+    // ---------- ADC ----------
+    [0x69] = OPCODE(ADC, "ADC", IMM, 2, false),
+    [0x65] = OPCODE(ADC, "ADC", ZP, 3, false),
+    [0x75] = OPCODE(ADC, "ADC", ZPX, 4, false),
+    [0x6D] = OPCODE(ADC, "ADC", ABS, 4, false),
+    [0x7D] = OPCODE(ADC, "ADC", ABSX, 4, true),
+    [0x79] = OPCODE(ADC, "ADC", ABSY, 4, true),
+    [0x61] = OPCODE(ADC, "ADC", INDX, 6, false),
+    [0x71] = OPCODE(ADC, "ADC", INDY, 5, true),
+    // ---------- AND ----------
+    [0x29] = OPCODE(AND, "AND", IMM, 2, false),
+    [0x25] = OPCODE(AND, "AND", ZP, 3, false),
+    [0x35] = OPCODE(AND, "AND", ZPX, 4, false),
+    [0x2D] = OPCODE(AND, "AND", ABS, 4, false),
+    [0x3D] = OPCODE(AND, "AND", ABSX, 4, true),
+    [0x39] = OPCODE(AND, "AND", ABSY, 4, true),
+    [0x21] = OPCODE(AND, "AND", INDX, 6, false),
+    [0x31] = OPCODE(AND, "AND", INDY, 5, true),
+    // ---------- ASL ----------
+    [0x0A] = OPCODE(ASL, "ASL", ACCUM, 2, false),
+    [0x06] = OPCODE(ASL, "ASL", ZP, 5, false),
+    [0x16] = OPCODE(ASL, "ASL", ZPX, 6, false),
+    [0x0E] = OPCODE(ASL, "ASL", ABS, 6, false),
+    [0x1E] = OPCODE(ASL, "ASL", ABSX, 7, false),
+    // ---------- BCC ----------
+    [0x90] = OPCODE(BCC, "BCC", REL, 2, true),
+    // ---------- BCS ----------
+    [0xB0] = OPCODE(BCS, "BCS", REL, 2, true),
+    // ---------- BEQ ----------
+    [0xF0] = OPCODE(BEQ, "BEQ", REL, 2, true),
+    // ---------- BIT ----------
+    [0x24] = OPCODE(BIT, "BIT", ZP, 3, false),
+    [0x2C] = OPCODE(BIT, "BIT", ABS, 4, false),
+    // ---------- BMI ----------
+    [0x30] = OPCODE(BMI, "BMI", REL, 2, true),
+    // ---------- BNE ----------
+    [0xD0] = OPCODE(BNE, "BNE", REL, 2, true),
+    // ---------- BPL ----------
+    [0x10] = OPCODE(BPL, "BPL", REL, 2, true),
+    // ---------- BRK ----------
+    [0x00] = OPCODE(BRK, "BRK", IMPL, 7, false),
+    // ---------- BVC ----------
+    [0x50] = OPCODE(BVC, "BVC", REL, 2, true),
+    // ---------- BVS ----------
+    [0x70] = OPCODE(BVS, "BVS", REL, 2, true),
+    // ---------- CLC ----------
+    [0x18] = OPCODE(CLC, "CLC", IMPL, 2, false),
+    // ---------- CLD ----------
+    [0xD8] = OPCODE(CLD, "CLD", IMPL, 2, false),
+    // ---------- CLI ----------
+    [0x58] = OPCODE(CLI, "CLI", IMPL, 2, false),
+    // ---------- CLV ----------
+    [0xB8] = OPCODE(CLV, "CLV", IMPL, 2, false),
+    // ---------- CMP ----------
+    [0xC9] = OPCODE(CMP, "CMP", IMM, 2, false),
+    [0xC5] = OPCODE(CMP, "CMP", ZP, 3, false),
+    [0xD5] = OPCODE(CMP, "CMP", ZPX, 4, false),
+    [0xCD] = OPCODE(CMP, "CMP", ABS, 4, false),
+    [0xDD] = OPCODE(CMP, "CMP", ABSX, 4, true),
+    [0xD9] = OPCODE(CMP, "CMP", ABSY, 4, true),
+    [0xC1] = OPCODE(CMP, "CMP", INDX, 6, false),
+    [0xD1] = OPCODE(CMP, "CMP", INDY, 5, true),
+    // ---------- CPX ----------
+    [0xE0] = OPCODE(CPX, "CPX", IMM, 2, false),
+    [0xE4] = OPCODE(CPX, "CPX", ZP, 3, false),
+    [0xEC] = OPCODE(CPX, "CPX", ABS, 4, false),
+    // ---------- CPY ----------
+    [0xC0] = OPCODE(CPY, "CPY", IMM, 2, false),
+    [0xC4] = OPCODE(CPY, "CPY", ZP, 3, false),
+    [0xCC] = OPCODE(CPY, "CPY", ABS, 4, false),
+    // ---------- DEC ----------
+    [0xC6] = OPCODE(DEC, "DEC", ZP, 5, false),
+    [0xD6] = OPCODE(DEC, "DEC", ZPX, 6, false),
+    [0xCE] = OPCODE(DEC, "DEC", ABS, 6, false),
+    [0xDE] = OPCODE(DEC, "DEC", ABSX, 7, false),
+    // ---------- DEX ----------
+    [0xCA] = OPCODE(DEX, "DEX", IMPL, 2, false),
+    // ---------- DEY ----------
+    [0x88] = OPCODE(DEY, "DEY", IMPL, 2, false),
+    // ---------- EOR ----------
+    [0x49] = OPCODE(EOR, "EOR", IMM, 2, false),
+    [0x45] = OPCODE(EOR, "EOR", ZP, 3, false),
+    [0x55] = OPCODE(EOR, "EOR", ZPX, 4, false),
+    [0x4D] = OPCODE(EOR, "EOR", ABS, 4, false),
+    [0x5D] = OPCODE(EOR, "EOR", ABSX, 4, true),
+    [0x59] = OPCODE(EOR, "EOR", ABSY, 4, true),
+    [0x41] = OPCODE(EOR, "EOR", INDX, 6, false),
+    [0x51] = OPCODE(EOR, "EOR", INDY, 5, true),
+    // ---------- INC ----------
+    [0xE6] = OPCODE(INC, "INC", ZP, 5, false),
+    [0xF6] = OPCODE(INC, "INC", ZPX, 6, false),
+    [0xEE] = OPCODE(INC, "INC", ABS, 6, false),
+    [0xFE] = OPCODE(INC, "INC", ABSX, 7, false),
+    // ---------- INX ----------
+    [0xE8] = OPCODE(INX, "INX", IMPL, 2, false),
+    // ---------- INY ----------
+    [0xC8] = OPCODE(INY, "INY", IMPL, 2, false),
+    // ---------- JMP ----------
+    [0x4C] = OPCODE(JMP, "JMP", ABS, 3, false),
+    [0x6C] = OPCODE(JMP, "JMP", IND, 5, false),
+    // ---------- JSR ----------
+    [0x20] = OPCODE(JSR, "JSR", ABS, 6, false),
+    // ---------- LDA ----------
+    [0xA9] = OPCODE(LDA, "LDA", IMM, 2, false),
+    [0xA5] = OPCODE(LDA, "LDA", ZP, 3, false),
+    [0xB5] = OPCODE(LDA, "LDA", ZPX, 4, false),
+    [0xAD] = OPCODE(LDA, "LDA", ABS, 4, false),
+    [0xBD] = OPCODE(LDA, "LDA", ABSX, 4, true),
+    [0xB9] = OPCODE(LDA, "LDA", ABSY, 4, true),
+    [0xA1] = OPCODE(LDA, "LDA", INDX, 6, false),
+    [0xB1] = OPCODE(LDA, "LDA", INDY, 5, true),
+    // ---------- LDX ----------
+    [0xA2] = OPCODE(LDX, "LDX", IMM, 2, false),
+    [0xA6] = OPCODE(LDX, "LDX", ZP, 3, false),
+    [0xB6] = OPCODE(LDX, "LDX", ZPY, 4, false),
+    [0xAE] = OPCODE(LDX, "LDX", ABS, 4, false),
+    [0xBE] = OPCODE(LDX, "LDX", ABSY, 4, true),
+    // ---------- LDY ----------
+    [0xA0] = OPCODE(LDY, "LDY", IMM, 2, false),
+    [0xA4] = OPCODE(LDY, "LDY", ZP, 3, false),
+    [0xB4] = OPCODE(LDY, "LDY", ZPX, 4, false),
+    [0xAC] = OPCODE(LDY, "LDY", ABS, 4, false),
+    [0xBC] = OPCODE(LDY, "LDY", ABSX, 4, true),
+    // ---------- LSR ----------
+    [0x4A] = OPCODE(LSR, "LSR", ACCUM, 2, false),
+    [0x46] = OPCODE(LSR, "LSR", ZP, 5, false),
+    [0x56] = OPCODE(LSR, "LSR", ZPX, 6, false),
+    [0x4E] = OPCODE(LSR, "LSR", ABS, 6, false),
+    [0x5E] = OPCODE(LSR, "LSR", ABSX, 7, false),
+    // ---------- NOP ----------
+    [0xEA] = OPCODE(NOP, "NOP", IMPL, 2, false),
+    // ---------- ORA ----------
+    [0x09] = OPCODE(ORA, "ORA", IMM, 2, false),
+    [0x05] = OPCODE(ORA, "ORA", ZP, 3, false),
+    [0x15] = OPCODE(ORA, "ORA", ZPX, 4, false),
+    [0x0D] = OPCODE(ORA, "ORA", ABS, 4, false),
+    [0x1D] = OPCODE(ORA, "ORA", ABSX, 4, true),
+    [0x19] = OPCODE(ORA, "ORA", ABSY, 4, true),
+    [0x01] = OPCODE(ORA, "ORA", INDX, 6, false),
+    [0x11] = OPCODE(ORA, "ORA", INDY, 5, true),
+    // ---------- PHA ----------
+    [0x48] = OPCODE(PHA, "PHA", IMPL, 3, false),
+    // ---------- PHP ----------
+    [0x08] = OPCODE(PHP, "PHP", IMPL, 3, false),
+    // ---------- PLA ----------
+    [0x68] = OPCODE(PLA, "PLA", IMPL, 4, false),
+    // ---------- PLP ----------
+    [0x28] = OPCODE(PLP, "PLP", IMPL, 4, false),
+    // ---------- ROL ----------
+    [0x2A] = OPCODE(ROL, "ROL", ACCUM, 2, false),
+    [0x26] = OPCODE(ROL, "ROL", ZP, 5, false),
+    [0x36] = OPCODE(ROL, "ROL", ZPX, 6, false),
+    [0x2E] = OPCODE(ROL, "ROL", ABS, 6, false),
+    [0x3E] = OPCODE(ROL, "ROL", ABSX, 7, false),
+    // ---------- ROR ----------
+    [0x6A] = OPCODE(ROR, "ROR", ACCUM, 2, false),
+    [0x66] = OPCODE(ROR, "ROR", ZP, 5, false),
+    [0x76] = OPCODE(ROR, "ROR", ZPX, 6, false),
+    [0x6E] = OPCODE(ROR, "ROR", ABS, 6, false),
+    [0x7E] = OPCODE(ROR, "ROR", ABSX, 7, false),
+    // ---------- RTI ----------
+    [0x40] = OPCODE(RTI, "RTI", IMPL, 6, false),
+    // ---------- RTS ----------
+    [0x60] = OPCODE(RTS, "RTS", IMPL, 6, false),
+    // ---------- SBC ----------
+    [0xE9] = OPCODE(SBC, "SBC", IMM, 2, false),
+    [0xE5] = OPCODE(SBC, "SBC", ZP, 3, false),
+    [0xF5] = OPCODE(SBC, "SBC", ZPX, 4, false),
+    [0xED] = OPCODE(SBC, "SBC", ABS, 4, false),
+    [0xFD] = OPCODE(SBC, "SBC", ABSX, 4, true),
+    [0xF9] = OPCODE(SBC, "SBC", ABSY, 4, true),
+    [0xE1] = OPCODE(SBC, "SBC", INDX, 6, false),
+    [0xF1] = OPCODE(SBC, "SBC", INDY, 5, true),
+    // ---------- SEC ----------
+    [0x38] = OPCODE(SEC, "SEC", IMPL, 2, false),
+    // ---------- SED ----------
+    [0xF8] = OPCODE(SED, "SED", IMPL, 2, false),
+    // ---------- SEI ----------
+    [0x78] = OPCODE(SEI, "SEI", IMPL, 2, false),
+    // ---------- STA ----------
+    [0x85] = OPCODE(STA, "STA", ZP, 3, false),
+    [0x95] = OPCODE(STA, "STA", ZPX, 4, false),
+    [0x8D] = OPCODE(STA, "STA", ABS, 4, false),
+    [0x9D] = OPCODE(STA, "STA", ABSX, 5, false),
+    [0x99] = OPCODE(STA, "STA", ABSY, 5, false),
+    [0x81] = OPCODE(STA, "STA", INDX, 6, false),
+    [0x91] = OPCODE(STA, "STA", INDY, 6, false),
+    // ---------- STX ----------
+    [0x86] = OPCODE(STX, "STX", ZP, 3, false),
+    [0x96] = OPCODE(STX, "STX", ZPY, 4, false),
+    [0x8E] = OPCODE(STX, "STX", ABS, 4, false),
+    // ---------- STY ----------
+    [0x84] = OPCODE(STY, "STY", ZP, 3, false),
+    [0x94] = OPCODE(STY, "STY", ZPX, 4, false),
+    [0x8C] = OPCODE(STY, "STY", ABS, 4, false),
+    // ---------- TAX ----------
+    [0xAA] = OPCODE(TAX, "TAX", IMPL, 2, false),
+    // ---------- TAY ----------
+    [0xA8] = OPCODE(TAY, "TAY", IMPL, 2, false),
+    // ---------- TSX ----------
+    [0xBA] = OPCODE(TSX, "TSX", IMPL, 2, false),
+    // ---------- TXA ----------
+    [0x8A] = OPCODE(TXA, "TXA", IMPL, 2, false),
+    // ---------- TXS ----------
+    [0x9A] = OPCODE(TXS, "TXS", IMPL, 2, false),
+    // ---------- TYA ----------
+    [0x98] = OPCODE(TYA, "TYA", IMPL, 2, false),
+
+    // ----------- Unofficial Opcodes ----------
+    //
+    //  I'll be implementing these as necessary
+    // to get my target games working. Otherwise
+    //   implementing these opcodes is out of
+    //          scope for this project
+    //
+    // -----------------------------------------
+
+    // ---------- NOP ($1A) ----------
+    [0x1A] = OPCODE(NOP, "NOP ($1A)", IMPL, 2, false),
+    // ---------- NOP ($1C) ----------
+    [0x1C] = OPCODE(NOP, "NOP ($1C)", ABSX, 4, true),
+    // ---------- SLO ($1F) ----------
+    [0x1F] = OPCODE(SLO, "SLO", ABSX, 7, false),
+};
+
+/**
+ * Store a byte in memory, throwing away any cached blocks that were decoded
+ * from that address
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param addr - The address to write to
+ * @param val - The byte to write
+ * @param processor - The processor holding register values
+ */
+static inline void storeByte(Bus* bus, uint16_t addr, uint8_t val, Processor* processor) {
+    busWrite(bus, addr, val);
+    notifyBlockCacheWrite(processor->block_cache, addr);
+}
+
+/**
+ * Return P with any lazily evaluated flags filled in, without changing the
+ * processor
+ *
+ * @param processor - The processor holding register values
+ *
+ * @returns The exact value of the status register
+ */
+static inline uint8_t packFlags(const Processor* processor) {
+    if (!processor->flags_lazy) {
+        return processor->P;
+    }
+
+    return (processor->P & ~(FLAG_N | FLAG_V | FLAG_Z | FLAG_C)) | (processor->n_result & 0x80) |
+           ((processor->v_result & 0x80) >> 1) | (processor->z_result == 0 ? FLAG_Z : 0) |
+           (processor->c_result & 0x01);
+}
+
+/**
+ * Start evaluating N, V, Z and C lazily, taking their current values from P
+ *
+ * @param processor - The processor holding register values
+ */
+static inline void unpackFlags(Processor* processor) {
+    if (processor->flags_lazy) {
+        return;
+    }
+
+    processor->n_result = processor->P & FLAG_N;
+    processor->v_result = (processor->P & FLAG_V) << 1;
+    processor->z_result = !(processor->P & FLAG_Z);
+    processor->c_result = processor->P & FLAG_C;
+    processor->flags_lazy = true;
+}
+
+/**
+ * Set the "Zero" and "Negative" flags from a result (flags must be lazy)
+ *
+ * @param result - The value the flags describe
+ * @param processor - The processor holding register values
+ */
+static inline void setNZ(uint8_t result, Processor* processor) {
+    processor->n_result = result;
+    processor->z_result = result;
+}
+
+/**
+ * Compute any lazily evaluated flags into P
+ *
+ * @param processor - The processor holding register values
+ */
+void syncFlags(Processor* processor) {
+    processor->P = packFlags(processor);
+    processor->flags_lazy = false;
+}
+
 /**
  * Parses the location in memory pointed to by 'pc' and creates an Instruction
  *
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
  * @param pc - The program counter (points to the current instruction in memory)
  *
  * @returns An Instruction with all the information needed about it
  */
-Instruction parseInstruction(uint8_t* mem, uint16_t pc) {
+Instruction parseInstruction(const Bus* bus, uint16_t pc) {
     Instruction instruction;
-    char* err_msg;
 
-    instruction.opcode = mem[pc];
+    instruction.opcode = busRead(bus, pc);
 
-    switch (instruction.opcode) {
-        // ---------- ADC ----------
-        case 0x69:  // nice
-            instruction.name = "ADC";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0x65:
-            instruction.name = "ADC";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x75:
-            instruction.name = "ADC";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x6D:
-            instruction.name = "ADC";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0x7D:
-            instruction.name = "ADC";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0x79:
-            instruction.name = "ADC";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0x61:
-            instruction.name = "ADC";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0x71:
-            instruction.name = "ADC";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- AND ----------
-        case 0x29:
-            instruction.name = "AND";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0x25:
-            instruction.name = "AND";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x35:
-            instruction.name = "AND";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x2D:
-            instruction.name = "AND";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0x3D:
-            instruction.name = "AND";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0x39:
-            instruction.name = "AND";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0x21:
-            instruction.name = "AND";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0x31:
-            instruction.name = "AND";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- ASL ----------
-        case 0x0A:
-            instruction.name = "ASL";
-            instruction.addr_mode = ACCUM;
-            instruction.cycles = 2;
-            break;
-        case 0x06:
-            instruction.name = "ASL";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0x16:
-            instruction.name = "ASL";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0x0E:
-            instruction.name = "ASL";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0x1E:
-            instruction.name = "ASL";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- BCC ----------
-        case 0x90:
-            instruction.name = "BCC";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BCS ----------
-        case 0xB0:
-            instruction.name = "BCS";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BEQ ----------
-        case 0xF0:
-            instruction.name = "BEQ";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BIT ----------
-        case 0x24:
-            instruction.name = "BIT";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x2C:
-            instruction.name = "BIT";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        // ---------- BMI ----------
-        case 0x30:
-            instruction.name = "BMI";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BNE ----------
-        case 0xD0:
-            instruction.name = "BNE";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BPL ----------
-        case 0x10:
-            instruction.name = "BPL";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BRK ----------
-        case 0x00:
-            instruction.name = "BRK";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 7;
-            break;
-        // ---------- BVC ----------
-        case 0x50:
-            instruction.name = "BVC";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- BVS ----------
-        case 0x70:
-            instruction.name = "BVS";
-            instruction.addr_mode = REL;
-            instruction.cycles = 2;
-            break;
-        // ---------- CLC ----------
-        case 0x18:
-            instruction.name = "CLC";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- CLD ----------
-        case 0xD8:
-            instruction.name = "CLD";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- CLI ----------
-        case 0x58:
-            instruction.name = "CLI";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- CLV ----------
-        case 0xB8:
-            instruction.name = "CLV";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- CMP ----------
-        case 0xC9:
-            instruction.name = "CMP";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xC5:
-            instruction.name = "CMP";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xD5:
-            instruction.name = "CMP";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0xCD:
-            instruction.name = "CMP";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0xDD:
-            instruction.name = "CMP";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0xD9:
-            instruction.name = "CMP";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0xC1:
-            instruction.name = "CMP";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0xD1:
-            instruction.name = "CMP";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- CPX ----------
-        case 0xE0:
-            instruction.name = "CPX";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xE4:
-            instruction.name = "CPX";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xEC:
-            instruction.name = "CPX";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        // ---------- CPY ----------
-        case 0xC0:
-            instruction.name = "CPY";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xC4:
-            instruction.name = "CPY";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xCC:
-            instruction.name = "CPY";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        // ---------- DEC ----------
-        case 0xC6:
-            instruction.name = "DEC";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0xD6:
-            instruction.name = "DEC";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0xCE:
-            instruction.name = "DEC";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0xDE:
-            instruction.name = "DEC";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- DEX ----------
-        case 0xCA:
-            instruction.name = "DEX";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- DEY ----------
-        case 0x88:
-            instruction.name = "DEY";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- EOR ----------
-        case 0x49:
-            instruction.name = "EOR";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0x45:
-            instruction.name = "EOR";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x55:
-            instruction.name = "EOR";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x4D:
-            instruction.name = "EOR";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0x5D:
-            instruction.name = "EOR";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0x59:
-            instruction.name = "EOR";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0x41:
-            instruction.name = "EOR";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0x51:
-            instruction.name = "EOR";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- INC ----------
-        case 0xE6:
-            instruction.name = "INC";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0xF6:
-            instruction.name = "INC";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0xEE:
-            instruction.name = "INC";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0xFE:
-            instruction.name = "INC";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- INX ----------
-        case 0xE8:
-            instruction.name = "INX";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- INY ----------
-        case 0xC8:
-            instruction.name = "INY";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- JMP ----------
-        case 0x4C:
-            instruction.name = "JMP";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 3;
-            break;
-        case 0x6C:
-            instruction.name = "JMP";
-            instruction.addr_mode = IND;
-            instruction.cycles = 5;
-            break;
-        // ---------- JSR ----------
-        case 0x20:
-            instruction.name = "JSR";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        // ---------- LDA ----------
-        case 0xA9:
-            instruction.name = "LDA";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xA5:
-            instruction.name = "LDA";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xB5:
-            instruction.name = "LDA";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0xAD:
-            instruction.name = "LDA";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0xBD:
-            instruction.name = "LDA";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0xB9:
-            instruction.name = "LDA";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0xA1:
-            instruction.name = "LDA";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0xB1:
-            instruction.name = "LDA";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- LDX ----------
-        case 0xA2:
-            instruction.name = "LDX";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xA6:
-            instruction.name = "LDX";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xB6:
-            instruction.name = "LDX";
-            instruction.addr_mode = ZPY;
-            instruction.cycles = 4;
-            break;
-        case 0xAE:
-            instruction.name = "LDX";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0xBE:
-            instruction.name = "LDX";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        // ---------- LDY ----------
-        case 0xA0:
-            instruction.name = "LDY";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xA4:
-            instruction.name = "LDY";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xB4:
-            instruction.name = "LDY";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0xAC:
-            instruction.name = "LDY";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0xBC:
-            instruction.name = "LDY";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        // ---------- LSR ----------
-        case 0x4A:
-            instruction.name = "LSR";
-            instruction.addr_mode = ACCUM;
-            instruction.cycles = 2;
-            break;
-        case 0x46:
-            instruction.name = "LSR";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0x56:
-            instruction.name = "LSR";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0x4E:
-            instruction.name = "LSR";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0x5E:
-            instruction.name = "LSR";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- NOP ----------
-        case 0xEA:
-            instruction.name = "NOP";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- ORA ----------
-        case 0x09:
-            instruction.name = "ORA";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0x05:
-            instruction.name = "ORA";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x15:
-            instruction.name = "ORA";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x0D:
-            instruction.name = "ORA";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0x1D:
-            instruction.name = "ORA";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0x19:
-            instruction.name = "ORA";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0x01:
-            instruction.name = "ORA";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0x11:
-            instruction.name = "ORA";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- PHA ----------
-        case 0x48:
-            instruction.name = "PHA";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 3;
-            break;
-        // ---------- PHP ----------
-        case 0x08:
-            instruction.name = "PHP";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 3;
-            break;
-        // ---------- PLA ----------
-        case 0x68:
-            instruction.name = "PLA";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 4;
-            break;
-        // ---------- PLP ----------
-        case 0x28:
-            instruction.name = "PLP";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 4;
-            break;
-        // ---------- ROL ----------
-        case 0x2A:
-            instruction.name = "ROL";
-            instruction.addr_mode = ACCUM;
-            instruction.cycles = 2;
-            break;
-        case 0x26:
-            instruction.name = "ROL";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0x36:
-            instruction.name = "ROL";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0x2E:
-            instruction.name = "ROL";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0x3E:
-            instruction.name = "ROL";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- ROR ----------
-        case 0x6A:
-            instruction.name = "ROR";
-            instruction.addr_mode = ACCUM;
-            instruction.cycles = 2;
-            break;
-        case 0x66:
-            instruction.name = "ROR";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 5;
-            break;
-        case 0x76:
-            instruction.name = "ROR";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 6;
-            break;
-        case 0x6E:
-            instruction.name = "ROR";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 6;
-            break;
-        case 0x7E:
-            instruction.name = "ROR";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        // ---------- RTI ----------
-        case 0x40:
-            instruction.name = "RTI";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 6;
-            break;
-        // ---------- RTS ----------
-        case 0x60:
-            instruction.name = "RTS";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 6;
-            break;
-        // ---------- SBC ----------
-        case 0xE9:
-            instruction.name = "SBC";
-            instruction.addr_mode = IMM;
-            instruction.cycles = 2;
-            break;
-        case 0xE5:
-            instruction.name = "SBC";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0xF5:
-            instruction.name = "SBC";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0xED:
-            instruction.name = "SBC";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0xFD:
-            instruction.name = "SBC";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        case 0xF9:
-            instruction.name = "SBC";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 4;
-            break;
-        case 0xE1:
-            instruction.name = "SBC";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0xF1:
-            instruction.name = "SBC";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 5;
-            break;
-        // ---------- SEC ----------
-        case 0x38:
-            instruction.name = "SEC";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- SED ----------
-        case 0xF8:
-            instruction.name = "SED";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- SEI ----------
-        case 0x78:
-            instruction.name = "SEI";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- STA ----------
-        case 0x85:
-            instruction.name = "STA";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x95:
-            instruction.name = "STA";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x8D:
-            instruction.name = "STA";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        case 0x9D:
-            instruction.name = "STA";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 5;
-            break;
-        case 0x99:
-            instruction.name = "STA";
-            instruction.addr_mode = ABSY;
-            instruction.cycles = 5;
-            break;
-        case 0x81:
-            instruction.name = "STA";
-            instruction.addr_mode = INDX;
-            instruction.cycles = 6;
-            break;
-        case 0x91:
-            instruction.name = "STA";
-            instruction.addr_mode = INDY;
-            instruction.cycles = 6;
-            break;
-        // ---------- STX ----------
-        case 0x86:
-            instruction.name = "STX";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x96:
-            instruction.name = "STX";
-            instruction.addr_mode = ZPY;
-            instruction.cycles = 4;
-            break;
-        case 0x8E:
-            instruction.name = "STX";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        // ---------- STY ----------
-        case 0x84:
-            instruction.name = "STY";
-            instruction.addr_mode = ZP;
-            instruction.cycles = 3;
-            break;
-        case 0x94:
-            instruction.name = "STY";
-            instruction.addr_mode = ZPX;
-            instruction.cycles = 4;
-            break;
-        case 0x8C:
-            instruction.name = "STY";
-            instruction.addr_mode = ABS;
-            instruction.cycles = 4;
-            break;
-        // ---------- TAX ----------
-        case 0xAA:
-            instruction.name = "TAX";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- TAY ----------
-        case 0xA8:
-            instruction.name = "TAY";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- TSX ----------
-        case 0xBA:
-            instruction.name = "TSX";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- TXA ----------
-        case 0x8A:
-            instruction.name = "TXA";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- TXS ----------
-        case 0x9A:
-            instruction.name = "TXS";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- TYA ----------
-        case 0x98:
-            instruction.name = "TYA";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
+    const OpcodeInfo* info = &opcode_table[instruction.opcode];
+    instruction.name = info->name;
+    instruction.addr_mode = info->addr_mode;
+    instruction.length = info->length;
+    instruction.cycles = info->cycles;
 
-        // ----------- Unofficial Opcodes ----------
-        //
-        //  I'll be implementing these as necessary
-        // to get my target games working. Otherwise
-        //   implementing these opcodes is out of
-        //          scope for this project
-        //
-        // -----------------------------------------
+    if (info->mnemonic == ILLEGAL) {
+        LOG_LIMITED(COMP_CPU, LEVEL_WARNING, "$%04x: Invalid opcode 0x%02x", pc,
+                    instruction.opcode);
 
-        // ---------- NOP ($1A) ----------
-        case 0x1A:
-            instruction.name = "NOP ($1A)";
-            instruction.addr_mode = IMPL;
-            instruction.cycles = 2;
-            break;
-        // ---------- NOP ($1C) ----------
-        case 0x1C:
-            instruction.name = "NOP ($1C)";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 4;
-            break;
-        // ---------- SLO ($1F) ----------
-        case 0x1F:
-            instruction.name = "SLO";
-            instruction.addr_mode = ABSX;
-            instruction.cycles = 7;
-            break;
-        default:
-            asprintf(&err_msg, "$%04x: Invalid opcode 0x%02x", pc, instruction.opcode);
-            printLog("CPU", err_msg, "WARNING");
-            break;
+        // Treat it as a 1 byte NOP so that callers still make progress
+        instruction.name = "???";
+        instruction.length = 1;
     }
 
-    switch (instruction.addr_mode) {
-        case IMPL:
-            instruction.length = 1;
-            break;
-        case ACCUM:
-            instruction.length = 1;
-            break;
-        case IMM:
-            instruction.length = 2;
-            instruction.imm = mem[pc + 1];
-            break;
-        case ZP:
-            instruction.length = 2;
-            instruction.addr = mem[pc + 1];
-            break;
-        case ZPX:
-            instruction.length = 2;
-            instruction.addr = mem[pc + 1];
-            break;
-        case ZPY:
-            instruction.length = 2;
-            instruction.addr = mem[pc + 1];
-            break;
-        case REL:
-            instruction.length = 2;
-            instruction.offset = mem[pc + 1];
-            break;
-        case ABS:
-            instruction.length = 3;
-            instruction.addr = concatenateBytes(mem[pc + 2], mem[pc + 1]);
-            break;
-        case ABSX:
-            instruction.length = 3;
-            instruction.addr = concatenateBytes(mem[pc + 2], mem[pc + 1]);
-            break;
-        case ABSY:
-            instruction.length = 3;
-            instruction.addr = concatenateBytes(mem[pc + 2], mem[pc + 1]);
-            break;
-        case IND:
-            instruction.length = 3;
-            instruction.addr = concatenateBytes(mem[pc + 2], mem[pc + 1]);
-            break;
-        case INDX:
-            instruction.length = 2;
-            instruction.addr = mem[pc + 1];
-            break;
-        case INDY:
-            instruction.length = 2;
-            instruction.addr = mem[pc + 1];
-            break;
+    // Every operand is a single byte, except for the 16-bit address of the
+    // absolute and indirect modes
+    instruction.imm = 0;
+    instruction.addr = 0;
+    instruction.offset = 0;
+    if (instruction.length > 1) {
+        uint8_t operand = busRead(bus, pc + 1);
+        instruction.imm = operand;
+        instruction.offset = (int8_t)operand;
+        instruction.addr =
+            (instruction.length == 3) ? concatenateBytes(busRead(bus, pc + 2), operand) : operand;
     }
 
-    return instruction;
+    return instruction;
+}
+
+// ---------- Addressing modes ----------
+//
+// One function per addressing mode, so that each opcode below picks its
+// effective address calculation at compile time and reads its operand exactly
+// once. Every access goes through the bus, so indexed addresses wrap at $FFFF.
+
+static inline uint16_t addrZP(const Instruction* instr, const Bus* bus,
+                              const Processor* processor) {
+    return instr->addr;
+}
+
+static inline uint16_t addrZPX(const Instruction* instr, const Bus* bus,
+                               const Processor* processor) {
+    return instr->addr + processor->X;
+}
+
+static inline uint16_t addrZPY(const Instruction* instr, const Bus* bus,
+                               const Processor* processor) {
+    return instr->addr + processor->Y;
+}
+
+static inline uint16_t addrABS(const Instruction* instr, const Bus* bus,
+                               const Processor* processor) {
+    return instr->addr;
+}
+
+static inline uint16_t addrABSX(const Instruction* instr, const Bus* bus,
+                                const Processor* processor) {
+    return instr->addr + processor->X;
+}
+
+static inline uint16_t addrABSY(const Instruction* instr, const Bus* bus,
+                                const Processor* processor) {
+    return instr->addr + processor->Y;
+}
+
+static inline uint16_t addrINDX(const Instruction* instr, const Bus* bus,
+                                const Processor* processor) {
+    uint16_t pointer = instr->addr + processor->X;
+    return busRead(bus, pointer) | (busRead(bus, pointer + 1) << 8);
+}
+
+static inline uint16_t addrINDY(const Instruction* instr, const Bus* bus,
+                                const Processor* processor) {
+    uint16_t base = busRead(bus, instr->addr) | (busRead(bus, instr->addr + 1) << 8);
+    return base + processor->Y;
+}
+
+// Reads the operand of an instruction with the given addressing mode (the
+// immediate "mode" reads the operand from the instruction itself)
+#define READ_OPERAND(mode) (busRead(bus, addr##mode(&instr, bus, processor)))
+#define READ_IMM           (instr.imm)
+
+// ---------- Operations ----------
+
+/**
+ * Add the operand and the "Carry" flag to the accumulator
+ *
+ * @param operand - The value to add
+ * @param processor - The processor holding register values
+ */
+static inline void adc(uint8_t operand, Processor* processor) {
+    int16_t val = processor->A + operand + processor->c_result;
+
+    // Wrap val to 8 bits
+    uint8_t result = val & 0xFF;
+
+    processor->c_result = val > 0xFF;
+    processor->v_result = (processor->A ^ result) & ~(processor->A ^ operand);
+    setNZ(result, processor);
+
+    processor->A = result;
+}
+
+/**
+ * Subtract the operand and the inverse of the "Carry" flag from the accumulator
+ *
+ * @param operand - The value to subtract
+ * @param processor - The processor holding register values
+ */
+static inline void sbc(uint8_t operand, Processor* processor) {
+    int16_t val = processor->A - operand - (1 - processor->c_result);
+
+    // Wrap val to 8 bits
+    uint8_t result = val & 0xFF;
+
+    processor->c_result = val >= 0;
+    processor->v_result = (processor->A ^ result) & (processor->A ^ operand);
+    setNZ(result, processor);
+
+    processor->A = result;
+}
+
+static inline void and(uint8_t operand, Processor* processor) {
+    processor->A &= operand;
+    setNZ(processor->A, processor);
+}
+
+static inline void eor(uint8_t operand, Processor* processor) {
+    processor->A ^= operand;
+    setNZ(processor->A, processor);
+}
+
+static inline void ora(uint8_t operand, Processor* processor) {
+    processor->A |= operand;
+    setNZ(processor->A, processor);
+}
+
+static inline void lda(uint8_t operand, Processor* processor) {
+    processor->A = operand;
+    setNZ(operand, processor);
+}
+
+static inline void ldx(uint8_t operand, Processor* processor) {
+    processor->X = operand;
+    setNZ(operand, processor);
+}
+
+static inline void ldy(uint8_t operand, Processor* processor) {
+    processor->Y = operand;
+    setNZ(operand, processor);
+}
+
+/**
+ * Set the flags for a comparison between a register and the operand
+ *
+ * @param reg - The value of the register being compared
+ * @param operand - The value to compare against
+ * @param processor - The processor holding register values
+ */
+static inline void compare(uint8_t reg, uint8_t operand, Processor* processor) {
+    int16_t val = reg - operand;
+
+    processor->c_result = val >= 0;
+    setNZ(val & 0xFF, processor);
+}
+
+static inline void cmp(uint8_t operand, Processor* processor) {
+    compare(processor->A, operand, processor);
+}
+
+static inline void cpx(uint8_t operand, Processor* processor) {
+    compare(processor->X, operand, processor);
+}
+
+static inline void cpy(uint8_t operand, Processor* processor) {
+    compare(processor->Y, operand, processor);
+}
+
+static inline void bit(uint8_t operand, Processor* processor) {
+    // Z comes from A & M, while N and V are bits 7 and 6 of M itself
+    processor->z_result = processor->A & operand;
+    processor->n_result = operand;
+    processor->v_result = operand << 1;
+}
+
+// Read-modify-write operations take the old value and return the new one
+
+static inline uint8_t asl(uint8_t val, Processor* processor) {
+    processor->c_result = val >> 7;
+    val <<= 1;
+    setNZ(val, processor);
+    return val;
+}
+
+// LSR on the accumulator only updates "Carry" and "Zero"
+static inline uint8_t lsr(uint8_t val, Processor* processor) {
+    processor->c_result = val & 0x01;
+    val >>= 1;
+    processor->z_result = val;
+    return val;
+}
+
+// LSR on memory sets "Zero" from bit 7 of the result, which is always 0
+static inline uint8_t lsrMemory(uint8_t val, Processor* processor) {
+    processor->c_result = val & 0x01;
+    val >>= 1;
+    processor->z_result = 1;
+    return val;
+}
+
+static inline uint8_t rol(uint8_t val, Processor* processor) {
+    uint8_t result = (val << 1) | processor->c_result;
+    processor->c_result = val >> 7;
+    setNZ(result, processor);
+    return result;
+}
+
+static inline uint8_t ror(uint8_t val, Processor* processor) {
+    uint8_t result = (val >> 1) | (processor->c_result << 7);
+    processor->c_result = val & 0x01;
+    setNZ(result, processor);
+    return result;
+}
+
+// ROR on memory also copies the result into the accumulator
+static inline uint8_t rorMemory(uint8_t val, Processor* processor) {
+    processor->A = ror(val, processor);
+    return processor->A;
+}
+
+static inline uint8_t inc(uint8_t val, Processor* processor) {
+    val++;
+    setNZ(val, processor);
+    return val;
+}
+
+static inline uint8_t dec(uint8_t val, Processor* processor) {
+    val--;
+    setNZ(val, processor);
+    return val;
+}
+
+// An ASL followed by an ORA with the shifted value
+static inline uint8_t slo(uint8_t val, Processor* processor) {
+    val = asl(val, processor);
+    ora(val, processor);
+    return val;
+}
+
+/**
+ * Move the PC to the target of a branch if it's taken. The caller adds the
+ * length of the instruction afterwards, which is only accounted for when
+ * branching forwards.
+ *
+ * @param taken - Whether the branch condition holds
+ * @param instr - The branch instruction
+ * @param processor - The processor holding register values
+ */
+static inline void branch(bool taken, const Instruction* instr, Processor* processor) {
+    if (taken) {
+        uint16_t target = instr->offset + processor->PC;
+        processor->PC = (instr->offset >= 0) ? target - instr->length : target;
+    }
 }
 
+// ---------- Opcode cases ----------
+
+// An opcode that reads its operand
+#define READ_CASE(opcode, operation, mode)                  \
+    case opcode:                                            \
+        operation(READ_OPERAND(mode), processor);           \
+        break;
+
+#define IMM_CASE(opcode, operation)                         \
+    case opcode:                                            \
+        operation(READ_IMM, processor);                     \
+        break;
+
+// An opcode that reads a byte of memory and writes the result back
+#define MODIFY_CASE(opcode, operation, mode)                                             \
+    case opcode: {                                                                     \
+        uint16_t addr = addr##mode(&instr, bus, processor);                            \
+        storeByte(bus, addr, operation(busRead(bus, addr), processor), processor);     \
+        break;                                                                         \
+    }
+
+// An opcode that stores a register
+#define STORE_CASE(opcode, reg, mode)                                                      \
+    case opcode:                                                                         \
+        storeByte(bus, addr##mode(&instr, bus, processor), processor->reg,                 \
+                  processor);                                                            \
+        break;
+
 /**
- * Execute the given instruction and set the appropriate flags
+ * Execute the given instruction and set the appropriate flags. N, V, Z and C are
+ * left lazily evaluated, so call syncFlags before reading P.
  *
  * @param instr - The instruction to execute
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
  */
-void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor) {
-    // Some variables that may or may not be used for some instructions
-    int16_t val;
-    uint8_t result;
-    uint8_t operand;
+void executeInstruction(Instruction instr, Bus* bus, Processor* processor) {
+    uint16_t val;
     uint16_t irq_vector;
 
+    // N, V, Z and C are worked out from the saved results once the instruction is
+    // done (PLP and RTI write P directly, which turns this back off)
+    unpackFlags(processor);
+
     switch (instr.opcode) {
         // ---------- ADC ----------
-        case 0x69:  // Immediate
-        case 0x65:  // Zero Page
-        case 0x75:  // Zero Page X
-        case 0x6D:  // Absolute
-        case 0x7D:  // Absolute X
-        case 0x79:  // Absolute Y
-        case 0x61:  // Indirect X (Indexed Indirect)
-        case 0x71:  // Indirect Y (Indirect Indexed)
-            val = processor->A + getVal(instr, *mem, *processor) + getFlag('C', processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Carry" flag
-            setFlag('C', val > 0xFF, processor);
-
-            // Set the "Overflow" flag
-            operand = getVal(instr, *mem, *processor);
-            setFlag('V', ((processor->A ^ result) & 0x80) && !((processor->A ^ operand) & 0x80),
-                    processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0x69, adc)          // Immediate
+        READ_CASE(0x65, adc, ZP)     // Zero Page
+        READ_CASE(0x75, adc, ZPX)    // Zero Page X
+        READ_CASE(0x6D, adc, ABS)    // Absolute
+        READ_CASE(0x7D, adc, ABSX)   // Absolute X
+        READ_CASE(0x79, adc, ABSY)   // Absolute Y
+        READ_CASE(0x61, adc, INDX)   // Indirect X (Indexed Indirect)
+        READ_CASE(0x71, adc, INDY)   // Indirect Y (Indirect Indexed)
         // ---------- AND ----------
-        case 0x29:  // Immediate
-        case 0x25:  // Zero Page
-        case 0x35:  // Zero Page X
-        case 0x2D:  // Absolute
-        case 0x3D:  // Absolute X
-        case 0x39:  // Absolute Y
-        case 0x21:  // Indirect X
-        case 0x31:  // Indirect Y
-            val = processor->A & getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            uint8_t result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0x29, and)          // Immediate
+        READ_CASE(0x25, and, ZP)     // Zero Page
+        READ_CASE(0x35, and, ZPX)    // Zero Page X
+        READ_CASE(0x2D, and, ABS)    // Absolute
+        READ_CASE(0x3D, and, ABSX)   // Absolute X
+        READ_CASE(0x39, and, ABSY)   // Absolute Y
+        READ_CASE(0x21, and, INDX)   // Indirect X
+        READ_CASE(0x31, and, INDY)   // Indirect Y
         // ---------- ASL ----------
         case 0x0A:  // Accumulator
-            // Set the "Carry" flag
-            setFlag('C', (processor->A & 0x80) >> 7, processor);
-
-            processor->A <<= 1;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->A == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->A & 0x80) >> 7, processor);
-
-            break;
-        case 0x06:  // Zero Page
-        case 0x16:  // Zero Page X
-        case 0x0E:  // Absolute
-        case 0x1E:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-
-            // Set the "Carry" flag
-            setFlag('C', (val & 0x80) >> 7, processor);
-
-            val <<= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
+            processor->A = asl(processor->A, processor);
             break;
+        MODIFY_CASE(0x06, asl, ZP)   // Zero Page
+        MODIFY_CASE(0x16, asl, ZPX)  // Zero Page X
+        MODIFY_CASE(0x0E, asl, ABS)  // Absolute
+        MODIFY_CASE(0x1E, asl, ABSX) // Absolute X
         // ---------- BCC ----------
         case 0x90:  // Relative
-            if (getFlag('C', processor) == 0) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(!processor->c_result, &instr, processor);
             break;
         // ---------- BCS ----------
         case 0xB0:  // Relative
-            if (getFlag('C', processor) == 1) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(processor->c_result, &instr, processor);
             break;
         // ---------- BEQ ----------
         case 0xF0:  // Relative
-            if (getFlag('Z', processor) == 1) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(processor->z_result == 0, &instr, processor);
             break;
         // ---------- BIT ----------
-        case 0x24:  // Zero Page
-        case 0x2C:  // Absolute
-            val = processor->A & getVal(instr, *mem, *processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', val == 0, processor);
-
-            // Set the "Overflow" flag
-            setFlag('V', (val >> 6) & 1, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (val >> 7) & 1, processor);
-            break;
+        READ_CASE(0x24, bit, ZP)     // Zero Page
+        READ_CASE(0x2C, bit, ABS)    // Absolute
         // ---------- BMI ----------
         case 0x30:  // Relative
-            if (getFlag('N', processor) == 1) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(processor->n_result & 0x80, &instr, processor);
             break;
         // ---------- BNE ----------
-        case 0xD0:
-            if (getFlag('Z', processor) == 0) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+        case 0xD0:  // Relative
+            branch(processor->z_result != 0, &instr, processor);
             break;
         // ---------- BPL ----------
-        case 0x10:
-            if (getFlag('N', processor) == 0) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+        case 0x10:  // Relative
+            branch(!(processor->n_result & 0x80), &instr, processor);
             break;
         // ---------- BRK ----------
         case 0x00:  // Implied
             // Push the program counter onto the stack
-            stackPush((processor->PC >> 8) & 0xFF, mem, processor);
-            stackPush((processor->PC + 2) & 0xFF, mem, processor);
+            stackPush((processor->PC >> 8) & 0xFF, bus, processor);
+            stackPush((processor->PC + 2) & 0xFF, bus, processor);
 
             // Set the "Break" flag and push the processor status onto the stack
             setFlag('B', 1, processor);
-            stackPush(processor->P, mem, processor);
+            stackPush(packFlags(processor), bus, processor);
 
             // Set the program counter to the IRQ interrupt vector
-            irq_vector = (*mem)[0xFFFE] | ((*mem)[0xFFFF] << 8);
+            irq_vector = busRead(bus, 0xFFFE) | (busRead(bus, 0xFFFF) << 8);
             if (irq_vector == 0x0000) {
                 processor->halted = true;
             }
@@ -1119,27 +719,15 @@ void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor)
             break;
         // ---------- BVC ----------
         case 0x50:  // Relative
-            if (getFlag('V', processor) == 0) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(!(processor->v_result & 0x80), &instr, processor);
             break;
         // ---------- BVS ----------
         case 0x70:  // Relative
-            if (getFlag('V', processor) == 1) {
-                if (instr.offset >= 0) {
-                    processor->PC = getAddr(instr, *mem, *processor) - instr.length;
-                } else {
-                    processor->PC = getAddr(instr, *mem, *processor);
-                }
-            }
+            branch(processor->v_result & 0x80, &instr, processor);
             break;
         // ---------- CLC ----------
         case 0x18:  // Implied
-            setFlag('C', 0, processor);
+            processor->c_result = 0;
             break;
         // ---------- CLD ----------
         case 0xD8:  // Implied
@@ -1151,553 +739,224 @@ void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor)
             break;
         // ---------- CLV ----------
         case 0xB8:  // Implied
-            setFlag('V', 0, processor);
+            processor->v_result = 0;
             break;
         // ---------- CMP ----------
-        case 0xC9:  // Immediate
-        case 0xC5:  // Zero Page
-        case 0xD5:  // Zero Page X
-        case 0xCD:  // Absolute
-        case 0xDD:  // Absolute X
-        case 0xD9:  // Absolute Y
-        case 0xC1:  // Indirect X
-        case 0xD1:  // Indirect Y
-            val = processor->A - getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Carry" flag
-            setFlag('C', val >= 0, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            break;
+        IMM_CASE(0xC9, cmp)          // Immediate
+        READ_CASE(0xC5, cmp, ZP)     // Zero Page
+        READ_CASE(0xD5, cmp, ZPX)    // Zero Page X
+        READ_CASE(0xCD, cmp, ABS)    // Absolute
+        READ_CASE(0xDD, cmp, ABSX)   // Absolute X
+        READ_CASE(0xD9, cmp, ABSY)   // Absolute Y
+        READ_CASE(0xC1, cmp, INDX)   // Indirect X
+        READ_CASE(0xD1, cmp, INDY)   // Indirect Y
         // ---------- CPX ----------
-        case 0xE0:  // Immediate
-        case 0xE4:  // Zero Page
-        case 0xEC:  // Absolute
-            val = processor->X - getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Carry" flag
-            setFlag('C', val >= 0, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            break;
+        IMM_CASE(0xE0, cpx)          // Immediate
+        READ_CASE(0xE4, cpx, ZP)     // Zero Page
+        READ_CASE(0xEC, cpx, ABS)    // Absolute
         // ---------- CPY ----------
-        case 0xC0:  // Immediate
-        case 0xC4:  // Zero Page
-        case 0xCC:  // Absolute
-            val = processor->Y - getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Carry" flag
-            setFlag('C', val >= 0, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            break;
+        IMM_CASE(0xC0, cpy)          // Immediate
+        READ_CASE(0xC4, cpy, ZP)     // Zero Page
+        READ_CASE(0xCC, cpy, ABS)    // Absolute
         // ---------- DEC ----------
-        case 0xC6:  // Zero Page
-        case 0xD6:  // Zero Page X
-        case 0xCE:  // Absolute
-        case 0xDE:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-            val--;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
-            break;
+        MODIFY_CASE(0xC6, dec, ZP)   // Zero Page
+        MODIFY_CASE(0xD6, dec, ZPX)  // Zero Page X
+        MODIFY_CASE(0xCE, dec, ABS)  // Absolute
+        MODIFY_CASE(0xDE, dec, ABSX) // Absolute X
         // ---------- DEX ----------
         case 0xCA:  // Implied
-            processor->X--;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->X == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->X & 0x80) >> 7, processor);
-
+            processor->X = dec(processor->X, processor);
             break;
         // ---------- DEY ----------
         case 0x88:  // Implied
-            processor->Y--;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->Y == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->Y & 0x80) >> 7, processor);
-
+            processor->Y = dec(processor->Y, processor);
             break;
         // ---------- EOR ----------
-        case 0x49:  // Immediate
-        case 0x45:  // Zero Page
-        case 0x55:  // ZEro Page X
-        case 0x4D:  // Absolute
-        case 0x5D:  // Absolute X
-        case 0x59:  // Absolute Y
-        case 0x41:  // Indirect X
-        case 0x51:  // Indirect Y
-            val = processor->A ^ getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0x49, eor)          // Immediate
+        READ_CASE(0x45, eor, ZP)     // Zero Page
+        READ_CASE(0x55, eor, ZPX)    // Zero Page X
+        READ_CASE(0x4D, eor, ABS)    // Absolute
+        READ_CASE(0x5D, eor, ABSX)   // Absolute X
+        READ_CASE(0x59, eor, ABSY)   // Absolute Y
+        READ_CASE(0x41, eor, INDX)   // Indirect X
+        READ_CASE(0x51, eor, INDY)   // Indirect Y
         // ---------- INC ----------
-        case 0xE6:  // Zero Page
-        case 0xF6:  // Zero Page X
-        case 0xEE:  // Absolute
-        case 0xFE:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-            val++;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
-            break;
+        MODIFY_CASE(0xE6, inc, ZP)   // Zero Page
+        MODIFY_CASE(0xF6, inc, ZPX)  // Zero Page X
+        MODIFY_CASE(0xEE, inc, ABS)  // Absolute
+        MODIFY_CASE(0xFE, inc, ABSX) // Absolute X
         // ---------- INX ----------
         case 0xE8:  // Implied
-            processor->X++;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->X == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->X & 0x80) >> 7, processor);
-
+            processor->X = inc(processor->X, processor);
             break;
         // ---------- INY ----------
         case 0xC8:  // Implied
-            processor->Y++;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->Y == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->Y & 0x80) >> 7, processor);
-
+            processor->Y = inc(processor->Y, processor);
             break;
         // ---------- JMP ----------
+        // Subtracting length to make sure that the PC being incremented
+        // doesn't skip the next instruction
         case 0x4C:  // Absolute
+            processor->PC = instr.addr - instr.length;
+            break;
         case 0x6C:  // Indirect
-            // Subtracting length to make sure that the PC being incremented
-            // doesn't skip the next instruction
-            processor->PC = getAddr(instr, *mem, *processor) - instr.length;
+            val = busRead(bus, instr.addr) | (busRead(bus, instr.addr + 1) << 8);
+            processor->PC = val - instr.length;
             break;
         // ---------- JSR ----------
         case 0x20:  // Absolute
             // Push the most significant byte first, then the least significant
-            stackPush((processor->PC >> 8) & 0xFF, mem, processor);
-            stackPush((processor->PC + 2) & 0xFF, mem, processor);
+            stackPush((processor->PC >> 8) & 0xFF, bus, processor);
+            stackPush((processor->PC + 2) & 0xFF, bus, processor);
 
-            processor->PC = getAddr(instr, *mem, *processor) - instr.length;
+            processor->PC = instr.addr - instr.length;
             break;
         // ---------- LDA ----------
-        case 0xA9:  // Immediate
-        case 0xA5:  // Zero Page
-        case 0xB5:  // Zero Page X
-        case 0xAD:  // Absolute
-        case 0xBD:  // Absolute X
-        case 0xB9:  // Absolute Y
-        case 0xA1:  // Indirect X (Indexed Indirect)
-        case 0xB1:  // Indirect Y (Indirect Indexed)
-            val = getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative flag"
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0xA9, lda)          // Immediate
+        READ_CASE(0xA5, lda, ZP)     // Zero Page
+        READ_CASE(0xB5, lda, ZPX)    // Zero Page X
+        READ_CASE(0xAD, lda, ABS)    // Absolute
+        READ_CASE(0xBD, lda, ABSX)   // Absolute X
+        READ_CASE(0xB9, lda, ABSY)   // Absolute Y
+        READ_CASE(0xA1, lda, INDX)   // Indirect X (Indexed Indirect)
+        READ_CASE(0xB1, lda, INDY)   // Indirect Y (Indirect Indexed)
         // ---------- LDX ----------
-        case 0xA2:  // Immediate
-        case 0xA6:  // Zero Page
-        case 0xB6:  // Zero Page Y
-        case 0xAE:  // Absolute
-        case 0xBE:  // Absolute Y
-            val = getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative flag"
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->X = result;
-            break;
+        IMM_CASE(0xA2, ldx)          // Immediate
+        READ_CASE(0xA6, ldx, ZP)     // Zero Page
+        READ_CASE(0xB6, ldx, ZPY)    // Zero Page Y
+        READ_CASE(0xAE, ldx, ABS)    // Absolute
+        READ_CASE(0xBE, ldx, ABSY)   // Absolute Y
         // ---------- LDY ----------
-        case 0xA0:  // Immediate
-        case 0xA4:  // Zero Page
-        case 0xB4:  // Zero Page X
-        case 0xAC:  // Absolute
-        case 0xBC:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative flag"
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->Y = result;
-            break;
+        IMM_CASE(0xA0, ldy)          // Immediate
+        READ_CASE(0xA4, ldy, ZP)     // Zero Page
+        READ_CASE(0xB4, ldy, ZPX)    // Zero Page X
+        READ_CASE(0xAC, ldy, ABS)    // Absolute
+        READ_CASE(0xBC, ldy, ABSX)   // Absolute X
         // ---------- LSR ----------
         case 0x4A:  // Accumulator
-            // Set the "Carry" flag
-            setFlag('C', (processor->A & 0x01), processor);
-
-            processor->A >>= 1;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->A == 0, processor);
-            break;
-        case 0x46:  // Zero Page
-        case 0x56:  // Zero Page X
-        case 0x4E:  // Absolute
-        case 0x5E:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-
-            // Set the "Carry" flag
-            setFlag('C', (val & 0x01), processor);
-
-            val >>= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('Z', (result & 0x80) >> 7, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
+            processor->A = lsr(processor->A, processor);
             break;
+        MODIFY_CASE(0x46, lsrMemory, ZP)   // Zero Page
+        MODIFY_CASE(0x56, lsrMemory, ZPX)  // Zero Page X
+        MODIFY_CASE(0x4E, lsrMemory, ABS)  // Absolute
+        MODIFY_CASE(0x5E, lsrMemory, ABSX) // Absolute X
         // ---------- NOP ----------
         case 0xEA:  // Implied
             break;
         // ---------- ORA ----------
-        case 0x09:  // Immediate
-        case 0x05:  // Zero Page
-        case 0x15:  // Zero Page X
-        case 0x0D:  // Absolute
-        case 0x1D:  // Absolute X
-        case 0x19:  // Absolute Y
-        case 0x01:  // Indirect X
-        case 0x11:  // Indirect Y
-            val = processor->A | getVal(instr, *mem, *processor);
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0x09, ora)          // Immediate
+        READ_CASE(0x05, ora, ZP)     // Zero Page
+        READ_CASE(0x15, ora, ZPX)    // Zero Page X
+        READ_CASE(0x0D, ora, ABS)    // Absolute
+        READ_CASE(0x1D, ora, ABSX)   // Absolute X
+        READ_CASE(0x19, ora, ABSY)   // Absolute Y
+        READ_CASE(0x01, ora, INDX)   // Indirect X
+        READ_CASE(0x11, ora, INDY)   // Indirect Y
         // ---------- PHA ----------
         case 0x48:  // Implied
-            stackPush(processor->A, mem, processor);
+            stackPush(processor->A, bus, processor);
             break;
         // ---------- PHP ----------
         case 0x08:  // Implied
-            stackPush(processor->P, mem, processor);
+            stackPush(packFlags(processor), bus, processor);
             break;
         // ---------- PLA ----------
         case 0x68:  // Implied
-            processor->A = stackPull(mem, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->A == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->A & 0x80) >> 7, processor);
+            lda(stackPull(bus, processor), processor);
             break;
         // ---------- PLP ----------
         case 0x28:  // Implied
-            processor->P = stackPull(mem, processor);
+            processor->P = stackPull(bus, processor);
+            processor->flags_lazy = false;
             break;
         // ---------- ROL ----------
         case 0x2A:  // Accumulator
-            val = processor->A;
-            val <<= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set bit 0 to the current value of the "Carry" flag
-            if (getFlag('C', processor) == 1) {
-                result |= 0b00000001;
-            }
-
-            // Set the "Carry" flag to the old bit 7
-            setFlag('C', (val >> 8) & 0x01, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result >> 7) & 0x01, processor);
-
-            processor->A = result;
-            break;
-        case 0x26:  // Zero Page
-        case 0x36:  // Zero Page X
-        case 0x2E:  // Absolute
-        case 0x3E:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-            val <<= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set bit 0 to the current value of the "Carry" flag
-            if (getFlag('C', processor) == 1) {
-                result |= 0b00000001;
-            }
-
-            // Set the "Carry" flag to the old bit 7
-            setFlag('C', (val >> 8) & 0x01, processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result >> 7) & 0x01, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
+            processor->A = rol(processor->A, processor);
             break;
+        MODIFY_CASE(0x26, rol, ZP)   // Zero Page
+        MODIFY_CASE(0x36, rol, ZPX)  // Zero Page X
+        MODIFY_CASE(0x2E, rol, ABS)  // Absolute
+        MODIFY_CASE(0x3E, rol, ABSX) // Absolute X
         // ---------- ROR ----------
         case 0x6A:  // Accumulator
-            val = processor->A;
-
-            // Set new bit 7 to the current value of the "Carry" flag
-            if (getFlag('C', processor) == 1) {
-                val |= 0b100000000;
-            }
-
-            // Set the "Carry" flag to the old bit 0
-            setFlag('C', val & 0x01, processor);
-
-            val >>= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result >> 7) & 0x01, processor);
-
-            processor->A = result;
-            break;
-        case 0x66:  // Zero Page
-        case 0x76:  // Zero Page X
-        case 0x6E:  // Absolute
-        case 0x7E:  // Absolute X
-            val = getVal(instr, *mem, *processor);
-
-            // Set new bit 7 to the current value of the "Carry" flag
-            if (getFlag('C', processor) == 1) {
-                val |= 0b100000000;
-            }
-
-            // Set the "Carry" flag to the old bit 0
-            setFlag('C', val & 0x01, processor);
-
-            val >>= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result >> 7) & 0x01, processor);
-
-            processor->A = result;
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
+            processor->A = ror(processor->A, processor);
             break;
+        MODIFY_CASE(0x66, rorMemory, ZP)   // Zero Page
+        MODIFY_CASE(0x76, rorMemory, ZPX)  // Zero Page X
+        MODIFY_CASE(0x6E, rorMemory, ABS)  // Absolute
+        MODIFY_CASE(0x7E, rorMemory, ABSX) // Absolute X
         // ---------- RTI ----------
         case 0x40:  // Implied
             // Pull status flags
-            processor->P = stackPull(mem, processor);
+            processor->P = stackPull(bus, processor);
+            processor->flags_lazy = false;
 
             // Pull program counter (lsb first, then msb)
-            val = stackPull(mem, processor);
-            val = concatenateBytes(stackPull(mem, processor), val);
+            val = stackPull(bus, processor);
+            val = concatenateBytes(stackPull(bus, processor), val);
 
             processor->PC = val - instr.length;
             break;
         // ---------- RTS ----------
         case 0x60:  // Implied
             // Pull the least significant byte first, the the most significant
-            val = stackPull(mem, processor);
-            val = concatenateBytes(stackPull(mem, processor), val);
+            val = stackPull(bus, processor);
+            val = concatenateBytes(stackPull(bus, processor), val);
 
             processor->PC = val;
             break;
         // ---------- SBC ----------
-        case 0xE9:  // Immediate
-        case 0xE5:  // Zero Page
-        case 0xF5:  // Zero Page X
-        case 0xED:  // Absolute
-        case 0xFD:  // Absolute X
-        case 0xF9:  // Absolute Y
-        case 0xE1:  // Indirect X
-        case 0xF1:  // Indirect Y
-            val = processor->A - getVal(instr, *mem, *processor) - (1 - getFlag('C', processor));
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Carry" flag
-            setFlag('C', val >= 0, processor);
-
-            // Set the "Overflow" flag
-            operand = getVal(instr, *mem, *processor);
-            setFlag('V', ((processor->A ^ result) & 0x80) && ((processor->A ^ operand) & 0x80),
-                    processor);
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            processor->A = result;
-            break;
+        IMM_CASE(0xE9, sbc)          // Immediate
+        READ_CASE(0xE5, sbc, ZP)     // Zero Page
+        READ_CASE(0xF5, sbc, ZPX)    // Zero Page X
+        READ_CASE(0xED, sbc, ABS)    // Absolute
+        READ_CASE(0xFD, sbc, ABSX)   // Absolute X
+        READ_CASE(0xF9, sbc, ABSY)   // Absolute Y
+        READ_CASE(0xE1, sbc, INDX)   // Indirect X
+        READ_CASE(0xF1, sbc, INDY)   // Indirect Y
         // ---------- SEC ----------
-        case 0x38:
-            setFlag('C', 1, processor);
+        case 0x38:  // Implied
+            processor->c_result = 1;
             break;
         // ---------- SED ----------
-        case 0xF8:
+        case 0xF8:  // Implied
             setFlag('D', 1, processor);
             break;
         // ---------- SEI ----------
-        case 0x78:
+        case 0x78:  // Implied
             setFlag('I', 1, processor);
             break;
         // ---------- STA ----------
-        case 0x85:  // Zero Page
-        case 0x95:  // Zero Page X
-        case 0x8D:  // Absolute
-        case 0x9D:  // Absolute X
-        case 0x99:  // Absolute Y
-        case 0x81:  // Indirect X
-        case 0x91:  // Indirect Y
-            (*mem)[getAddr(instr, *mem, *processor)] = processor->A;
-            break;
+        STORE_CASE(0x85, A, ZP)      // Zero Page
+        STORE_CASE(0x95, A, ZPX)     // Zero Page X
+        STORE_CASE(0x8D, A, ABS)     // Absolute
+        STORE_CASE(0x9D, A, ABSX)    // Absolute X
+        STORE_CASE(0x99, A, ABSY)    // Absolute Y
+        STORE_CASE(0x81, A, INDX)    // Indirect X
+        STORE_CASE(0x91, A, INDY)    // Indirect Y
         // ---------- STX ----------
-        case 0x86:  // Zero Page
-        case 0x96:  // Zero Page Y
-        case 0x8E:  // Absolute
-            (*mem)[getAddr(instr, *mem, *processor)] = processor->X;
-            break;
+        STORE_CASE(0x86, X, ZP)      // Zero Page
+        STORE_CASE(0x96, X, ZPY)     // Zero Page Y
+        STORE_CASE(0x8E, X, ABS)     // Absolute
         // ---------- STY ----------
-        case 0x84:  // Zero Page
-        case 0x94:  // Zero Page X
-        case 0x8C:  // Absolute
-            (*mem)[getAddr(instr, *mem, *processor)] = processor->Y;
-            break;
+        STORE_CASE(0x84, Y, ZP)      // Zero Page
+        STORE_CASE(0x94, Y, ZPX)     // Zero Page X
+        STORE_CASE(0x8C, Y, ABS)     // Absolute
         // ---------- TAX ----------
         case 0xAA:  // Implied
-            processor->X = processor->A;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->X == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->X & 0x80) >> 7, processor);
+            ldx(processor->A, processor);
             break;
         // ---------- TAY ----------
         case 0xA8:  // Implied
-            processor->Y = processor->A;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->Y == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->Y & 0x80) >> 7, processor);
+            ldy(processor->A, processor);
             break;
         // ---------- TSX ----------
         case 0xBA:  // Implied
-            processor->X = processor->S;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->X == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->X & 0x80) >> 7, processor);
+            ldx(processor->S, processor);
             break;
         // ---------- TXA ----------
         case 0x8A:  // Implied
-            processor->A = processor->X;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->A == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->A & 0x80) >> 7, processor);
+            lda(processor->X, processor);
             break;
         // ---------- TXS ----------
         case 0x9A:  // Implied
@@ -1705,13 +964,7 @@ void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor)
             break;
         // ---------- TYA ----------
         case 0x98:  // Implied
-            processor->A = processor->Y;
-
-            // Set the "Zero" flag
-            setFlag('Z', processor->A == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (processor->A & 0x80) >> 7, processor);
+            lda(processor->Y, processor);
             break;
 
         // ----------- Unofficial Opcodes ----------
@@ -1727,51 +980,71 @@ void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor)
         case 0x1A:  // Implied
             break;
         // ---------- NOP ($1C) ----------
-        case 0x1C:
+        case 0x1C:  // Absolute X
             break;
         // ---------- SLO ($1F) ----------
-        case 0x1F:  // Absolute X
-            // Essentially a combination of 2 instructions
-            // Basically an ASL followed by an ORA
-
-            // ----- ASL -----
-
-            val = getVal(instr, *mem, *processor);
-
-            // Set the "Carry" flag
-            setFlag('C', (val & 0x80) >> 7, processor);
-
-            val <<= 1;
-
-            // Wrap val to 8 bits
-            result = val & 0xFF;
-
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
-
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
-
-            (*mem)[getAddr(instr, *mem, *processor)] = result;
-
-            // ----- ORA -----
+        // Essentially a combination of 2 instructions
+        // Basically an ASL followed by an ORA
+        MODIFY_CASE(0x1F, slo, ABSX) // Absolute X
+    }
 
-            val = processor->A | getVal(instr, *mem, *processor);
+    processor->P |= 0x20;  // Making sure that the unused bit ALWAYS remains 1
 
-            // Wrap val to 8 bits
-            result = val & 0xFF;
+    // N, V, Z and C stay lazy into the next instruction. Whoever reads P (a
+    // trace, a save state, a test) calls syncFlags first.
+}
 
-            // Set the "Zero" flag
-            setFlag('Z', result == 0, processor);
+/**
+ * Add additional cycles to the given instruction if it crosses a page
+ *
+ * @param instr - The instruction to potentially add cycles to
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param old_PC - The value of the PC before the instruction was executed
+ */
+void addAdditionalCycles(Instruction* instr, const Bus* bus, Processor* processor,
+                         uint16_t old_PC) {
+    // Only instructions that are flagged in the opcode table pay the penalty
+    // (e.x. stores always take their worst case number of cycles)
+    if (!opcode_table[instr->opcode].page_penalty) {
+        return;
+    }
 
-            // Set the "Negative" flag
-            setFlag('N', (result & 0x80) >> 7, processor);
+    // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
+    // Relative, check if a page was crossed and add an extra cycle
+    switch (instr->addr_mode) {
+        uint16_t addr;
+        case ABSX:
+            addr = instr->addr;
+            if (((addr + processor->X) & 0xFF00) != (addr & 0xFF00)) {
+                instr->cycles++;
+            }
+            break;
+        case ABSY:
+            addr = instr->addr;
+            if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
+                instr->cycles++;
+            }
+            break;
+        case INDY:
+            addr = concatenateBytes(busRead(bus, instr->addr + 1), busRead(bus, instr->addr));
+            if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
+                instr->cycles++;
+            }
+            break;
+        case REL:
+            if (processor->PC != old_PC + instr->length) {
+                // Branch succeeded
+                instr->cycles++;
 
-            processor->A = result;
+                if ((processor->PC & 0xFF00) != (old_PC & 0xFF00)) {
+                    // Page crossed
+                    instr->cycles++;
+                }
+            }
+        default:
             break;
     }
-
-    processor->P |= 0x20;  // Making sure that the unused bit ALWAYS remains 1
 }
 
 /**
@@ -1781,14 +1054,21 @@ void executeInstruction(Instruction instr, uint8_t** mem, Processor* processor)
  * @param val - The bit value to set the given flag to
  */
 void setFlag(char flag, bool val, Processor* processor) {
-    char* err_msg;
 
     switch (flag) {
         case 'N':
-            processor->P = (processor->P & ~0b10000000) | (val ? 0b10000000 : 0);
+            if (processor->flags_lazy) {
+                processor->n_result = val ? 0x80 : 0;
+            } else {
+                processor->P = (processor->P & ~0b10000000) | (val ? 0b10000000 : 0);
+            }
             break;
         case 'V':
-            processor->P = (processor->P & ~0b01000000) | (val ? 0b01000000 : 0);
+            if (processor->flags_lazy) {
+                processor->v_result = val ? 0x80 : 0;
+            } else {
+                processor->P = (processor->P & ~0b01000000) | (val ? 0b01000000 : 0);
+            }
             break;
         case 'B':
             processor->P = (processor->P & ~0b00010000) | (val ? 0b00010000 : 0);
@@ -1800,14 +1080,21 @@ void setFlag(char flag, bool val, Processor* processor) {
             processor->P = (processor->P & ~0b00000100) | (val ? 0b00000100 : 0);
             break;
         case 'Z':
-            processor->P = (processor->P & ~0b00000010) | (val ? 0b00000010 : 0);
+            if (processor->flags_lazy) {
+                processor->z_result = !val;
+            } else {
+                processor->P = (processor->P & ~0b00000010) | (val ? 0b00000010 : 0);
+            }
             break;
         case 'C':
-            processor->P = (processor->P & ~0b00000001) | (val ? 0b00000001 : 0);
+            if (processor->flags_lazy) {
+                processor->c_result = val;
+            } else {
+                processor->P = (processor->P & ~0b00000001) | (val ? 0b00000001 : 0);
+            }
             break;
         default:
-            asprintf(&err_msg, "Invalid flag %c", flag);
-            printLog("CPU", err_msg, "ERROR");
+            LOG(COMP_CPU, LEVEL_ERROR, "Invalid flag %c", flag);
             break;
     }
 }
@@ -1822,33 +1109,32 @@ void setFlag(char flag, bool val, Processor* processor) {
  */
 bool getFlag(char flag, Processor* processor) {
     bool val = 0;
-    char* err_msg;
 
+    uint8_t status = packFlags(processor);
     switch (flag) {
         case 'N':
-            val = (processor->P >> 7) & 1;
+            val = (status >> 7) & 1;
             break;
         case 'V':
-            val = (processor->P >> 6) & 1;
+            val = (status >> 6) & 1;
             break;
         case 'B':
-            val = (processor->P >> 4) & 1;
+            val = (status >> 4) & 1;
             break;
         case 'D':
-            val = (processor->P >> 3) & 1;
+            val = (status >> 3) & 1;
             break;
         case 'I':
-            val = (processor->P >> 2) & 1;
+            val = (status >> 2) & 1;
             break;
         case 'Z':
-            val = (processor->P >> 1) & 1;
+            val = (status >> 1) & 1;
             break;
         case 'C':
-            val = processor->P & 1;
+            val = status & 1;
             break;
         default:
-            asprintf(&err_msg, "Invalid flag %c", flag);
-            printLog("CPU", err_msg, "ERROR");
+            LOG(COMP_CPU, LEVEL_ERROR, "Invalid flag %c", flag);
             break;
     }
 
@@ -1856,148 +1142,48 @@ bool getFlag(char flag, Processor* processor) {
 }
 
 /**
- * Return the required value based on the instruction's addressing mode
+ * Push the given value onto the stack (0x01FF - 0x0100)
  *
- * @param instr - The instruction to use for getting the required value
- * @param mem - The byte array serving as system memory
+ * @param val - The value to be pushed onto the stack
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- *
- * @returns The byte of data required by the instruction
  */
-uint8_t getVal(Instruction instr, uint8_t* mem, Processor processor) {
-    uint8_t val = 0;
-    uint8_t lsb_addr;
-    uint8_t msb_addr;
-
-    switch (instr.addr_mode) {
-        case IMPL:
-            break;
-        case ACCUM:
-            val = processor.A;
-            break;
-        case IMM:
-            val = instr.imm;
-            break;
-        case ZP:
-            val = mem[instr.addr];
-            break;
-        case ZPX:
-            val = mem[instr.addr + processor.X];
-            break;
-        case ZPY:
-            val = mem[instr.addr + processor.Y];
-            break;
-        case ABS:
-            val = mem[instr.addr];
-            break;
-        case ABSX:
-            val = mem[instr.addr + processor.X];
-            break;
-        case ABSY:
-
-            val = mem[instr.addr + processor.Y];
-            break;
-        case INDX:
-            lsb_addr = mem[instr.addr + processor.X];
-            msb_addr = mem[instr.addr + processor.X + 1];
-            val = mem[concatenateBytes(msb_addr, lsb_addr)];
-            break;
-        case INDY:
-            lsb_addr = mem[instr.addr];
-            msb_addr = mem[instr.addr + 1];
-            val = mem[concatenateBytes(msb_addr, lsb_addr) + processor.Y];
-            break;
-        default:
-            printLog("CPU", "Addressing mode doesn't return a value", "ERROR");
-            break;
-    }
-
-    return val;
+void stackPush(uint8_t val, Bus* bus, Processor* processor) {
+    storeByte(bus, 0x0100 + processor->S, val, processor);
+    processor->S--;
 }
 
 /**
- * Return the required memory address based on the instruction's addressing mode
+ * Return and remove the value at the top of the stack
  *
- * @param instr - The instruction to use for getting the required value
- * @param mem - The byte array serving as system memory
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- *
- * @returns The memory address required by the instruction
  */
-uint16_t getAddr(Instruction instr, uint8_t* mem, Processor processor) {
-    uint16_t addr = 0;
-    uint8_t lsb_addr;
-    uint8_t msb_addr;
-
-    switch (instr.addr_mode) {
-        case IMPL:
-            break;
-        case ACCUM:
-            break;
-        case ZP:
-            addr = instr.addr;
-            break;
-        case ZPX:
-            addr = instr.addr + processor.X;
-            break;
-        case ZPY:
-            addr = instr.addr + processor.Y;
-            break;
-        case REL:
-            addr = instr.offset + processor.PC;
-            break;
-        case ABS:
-            addr = instr.addr;
-            break;
-        case ABSX:
-            addr = instr.addr + processor.X;
-            break;
-        case ABSY:
-            addr = instr.addr + processor.Y;
-            break;
-        case IND:
-            lsb_addr = mem[instr.addr];
-            msb_addr = mem[instr.addr + 1];
-            addr = concatenateBytes(msb_addr, lsb_addr);
-            break;
-        case INDX:
-            lsb_addr = mem[instr.addr + processor.X];
-            msb_addr = mem[instr.addr + processor.X + 1];
-            addr = concatenateBytes(msb_addr, lsb_addr);
-            break;
-        case INDY:
-            lsb_addr = mem[instr.addr];
-            msb_addr = mem[instr.addr + 1];
-            addr = concatenateBytes(msb_addr, lsb_addr) + processor.Y;
-            break;
-        default:
-            printLog("CPU", "Instruction doesn't support that addressing mode", "ERROR");
-            break;
-    }
-
-    return addr;
+uint8_t stackPull(Bus* bus, Processor* processor) {
+    processor->S++;
+    uint8_t val = busRead(bus, 0x0100 + processor->S);
+    return val;
 }
 
 /**
- * Push the given value onto the stack (0x01FF - 0x0100)
+ * Service a hardware interrupt (NMI or IRQ) between instructions: push the
+ * program counter and the processor status (with B clear), disable IRQs, and
+ * jump through the interrupt vector
  *
- * @param val - The value to be pushed onto the stack
- * @param mem - The byte array serving as system memory
+ * @param vector - The address of the interrupt vector ($FFFA for NMI, $FFFE for IRQ)
+ * @param bus - The bus serving as the CPU address space
  * @param processor - The processor holding register values
- */
-void stackPush(uint8_t val, uint8_t** mem, Processor* processor) {
-    (*mem)[0x0100 + processor->S] = val;
-    processor->S--;
-}
-
-/**
- * Return and remove the value at the top of the stack
  *
- * @param mem - The byte array serving as system memory
- * @param processor - The processor holding register values
+ * @returns The number of cycles the interrupt takes
  */
-uint8_t stackPull(uint8_t** mem, Processor* processor) {
-    processor->S++;
-    uint8_t val = (*mem)[0x0100 + processor->S];
-    return val;
+int interrupt(uint16_t vector, Bus* bus, Processor* processor) {
+    syncFlags(processor);
+
+    stackPush(processor->PC >> 8, bus, processor);
+    stackPush(processor->PC & 0xFF, bus, processor);
+    stackPush((processor->P & ~FLAG_B) | FLAG_U, bus, processor);
+    processor->P |= FLAG_I;
+
+    processor->PC = busRead(bus, vector) | (busRead(bus, vector + 1) << 8);
+    return 7;
 }
@@ -0,0 +1,800 @@
+#include "apu.h"
+
+#include "blip.h"
+#include "bus.h"
+#include "pacer.h"
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Linear approximation of the 2A03's mixer (nesdev's 0.00752, 0.00851,
+// 0.00494 and 0.00335 a step), scaled so everything at once stays in 16 bits
+#define PULSE_WEIGHT    (241)
+#define TRIANGLE_WEIGHT (272)
+#define NOISE_WEIGHT    (158)
+#define DMC_WEIGHT      (107)
+
+#define DMC_DMA_CYCLES (4)  // CPU cycles a DMC sample read stalls for
+
+// Frame counter steps, in CPU cycles from the start of the sequence
+#define FOUR_STEP_LENGTH (29830)
+#define FIVE_STEP_LENGTH (37282)
+static const uint32_t frame_steps[2][5] = {
+    {7457, 14913, 22371, 29829},
+    {7457, 14913, 22371, 29829, 37281},
+};
+
+static const uint8_t length_table[32] = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+static const uint8_t duty_table[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+};
+
+static const uint8_t triangle_table[32] = {
+    15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+};
+
+static const uint16_t noise_periods[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068,
+};
+
+static const uint16_t dmc_periods[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54,
+};
+
+// ---------- Synthesis ----------
+
+// Change a channel's level, telling the synthesizer if anyone's listening
+static void setAmp(APU* apu, int* amp, int level, int weight, uint64_t time) {
+    if (level != *amp) {
+        if (apu->output != NULL) {
+            blipAddDelta(&apu->blip, time - apu->audio_start, (level - *amp) * weight);
+        }
+        *amp = level;
+    }
+}
+
+/**
+ * Run a timer over a span of cycles without looking at what it clocks
+ *
+ * @param delay - Cycles until the timer next clocks (updated)
+ * @param period - Cycles between clocks
+ * @param span - Cycles to run for
+ *
+ * @returns The number of times the timer clocked
+ */
+static uint64_t skipTimer(uint32_t* delay, uint32_t period, uint64_t span) {
+    if (*delay > span) {
+        *delay -= span;
+        return 0;
+    }
+    span -= *delay;
+    *delay = period - span % period;
+    return 1 + span / period;
+}
+
+static int envelopeVolume(const Envelope* envelope) {
+    return envelope->constant ? envelope->period : envelope->decay;
+}
+
+// The period the sweep would change a pulse channel to. The first channel
+// negates with one's complement and the second with two's.
+static int sweepTarget(const Pulse* pulse, int channel) {
+    int change = pulse->period >> pulse->sweep_shift;
+    if (!pulse->sweep_negate) {
+        return pulse->period + change;
+    }
+    int target = pulse->period - change - (channel == 0);
+    return target < 0 ? 0 : target;
+}
+
+static int pulseVolume(const APU* apu, int channel) {
+    const Pulse* pulse = &apu->pulse[channel];
+    if (pulse->length == 0 || pulse->period < 8 || sweepTarget(pulse, channel) > 0x7FF) {
+        return 0;
+    }
+    return envelopeVolume(&pulse->envelope);
+}
+
+static int noiseVolume(const APU* apu) {
+    return apu->noise.length > 0 ? envelopeVolume(&apu->noise.envelope) : 0;
+}
+
+// Bring every channel's level up to date after a register write or a frame
+// counter step
+static void updateAmps(APU* apu) {
+    uint64_t time = apu->synced_cycle;
+    for (int channel = 0; channel < 2; channel++) {
+        Pulse* pulse = &apu->pulse[channel];
+        int level = duty_table[pulse->duty][pulse->step] ? pulseVolume(apu, channel) : 0;
+        setAmp(apu, &pulse->amp, level, PULSE_WEIGHT, time);
+    }
+    setAmp(apu, &apu->triangle.amp, triangle_table[apu->triangle.step], TRIANGLE_WEIGHT, time);
+    setAmp(apu, &apu->noise.amp, (apu->noise.lfsr & 1) ? 0 : noiseVolume(apu), NOISE_WEIGHT,
+           time);
+    setAmp(apu, &apu->dmc.amp, apu->dmc.level, DMC_WEIGHT, time);
+}
+
+// ---------- Channels ----------
+
+static void runPulse(APU* apu, int channel, uint64_t time, uint64_t end) {
+    Pulse* pulse = &apu->pulse[channel];
+    uint32_t period = (pulse->period + 1) * 2;
+    int volume = apu->output != NULL ? pulseVolume(apu, channel) : 0;
+
+    // Nothing to hear, so skip straight to the end
+    if (volume == 0) {
+        pulse->step = (pulse->step + skipTimer(&pulse->delay, period, end - time)) & 7;
+        return;
+    }
+
+    time += pulse->delay;
+    while (time <= end) {
+        pulse->step = (pulse->step + 1) & 7;
+        int level = duty_table[pulse->duty][pulse->step] ? volume : 0;
+        setAmp(apu, &pulse->amp, level, PULSE_WEIGHT, time);
+        time += period;
+    }
+    pulse->delay = time - end;
+}
+
+static void runTriangle(APU* apu, uint64_t time, uint64_t end) {
+    Triangle* triangle = &apu->triangle;
+    uint32_t period = triangle->period + 1;
+
+    // The waveform only moves while both counters are running, and periods
+    // this short are ultrasonic, so they're stepped without being heard
+    if (triangle->length == 0 || triangle->linear == 0) {
+        skipTimer(&triangle->delay, period, end - time);
+        return;
+    }
+    if (apu->output == NULL || triangle->period < 2) {
+        triangle->step = (triangle->step + skipTimer(&triangle->delay, period, end - time)) & 31;
+        return;
+    }
+
+    time += triangle->delay;
+    while (time <= end) {
+        triangle->step = (triangle->step + 1) & 31;
+        setAmp(apu, &triangle->amp, triangle_table[triangle->step], TRIANGLE_WEIGHT, time);
+        time += period;
+    }
+    triangle->delay = time - end;
+}
+
+// Run the shift register ahead, as if it were shifted steps times
+static uint16_t jumpNoise(const Noise* noise, uint16_t lfsr, uint64_t steps) {
+    for (int k = 0; steps != 0 && k < NOISE_JUMPS; k++, steps >>= 1) {
+        if (steps & 1) {
+            uint16_t next = 0;
+            for (int bit = 0; bit < 15; bit++) {
+                if (lfsr & (1 << bit)) {
+                    next ^= noise->jumps[noise->short_mode][k][bit];
+                }
+            }
+            lfsr = next;
+        }
+    }
+    return lfsr;
+}
+
+static void runNoise(APU* apu, uint64_t time, uint64_t end) {
+    Noise* noise = &apu->noise;
+    int volume = apu->output != NULL ? noiseVolume(apu) : 0;
+
+    // The shift register is part of the machine's state, so it still has to
+    // move when it can't be heard
+    if (volume == 0) {
+        uint64_t steps = skipTimer(&noise->delay, noise->period, end - time);
+        noise->lfsr = jumpNoise(noise, noise->lfsr, steps);
+        return;
+    }
+
+    int tap = noise->short_mode ? 6 : 1;
+    time += noise->delay;
+    while (time <= end) {
+        uint16_t feedback = (noise->lfsr ^ (noise->lfsr >> tap)) & 1;
+        noise->lfsr = (noise->lfsr >> 1) | (feedback << 14);
+        setAmp(apu, &noise->amp, (noise->lfsr & 1) ? 0 : volume, NOISE_WEIGHT, time);
+        time += noise->period;
+    }
+    noise->delay = time - end;
+}
+
+static void restartSample(Dmc* dmc) {
+    dmc->addr = dmc->sample_addr;
+    dmc->remaining = dmc->sample_length;
+}
+
+// Read the next byte of the sample into the buffer if it's empty
+static void fetchSample(APU* apu) {
+    Dmc* dmc = &apu->dmc;
+    if (dmc->buffer_full || dmc->remaining == 0) {
+        return;
+    }
+
+    dmc->buffer = apu->bus != NULL ? busRead(apu->bus, dmc->addr) : 0;
+    dmc->buffer_full = true;
+    dmc->addr = (dmc->addr == 0xFFFF) ? 0x8000 : dmc->addr + 1;
+    apu->dma_cycles += DMC_DMA_CYCLES;
+
+    if (--dmc->remaining == 0) {
+        if (dmc->loop) {
+            restartSample(dmc);
+        } else if (dmc->irq_enabled) {
+            apu->dmc_irq = true;
+        }
+    }
+}
+
+static void runDmc(APU* apu, uint64_t time, uint64_t end) {
+    Dmc* dmc = &apu->dmc;
+
+    // With nothing playing or left to read, only the bit counter moves
+    if (dmc->silent && !dmc->buffer_full && dmc->remaining == 0) {
+        uint64_t clocks = skipTimer(&dmc->delay, dmc->period, end - time);
+        dmc->bits = 8 - (8 - dmc->bits + clocks) % 8;
+        return;
+    }
+
+    time += dmc->delay;
+    while (time <= end) {
+        if (!dmc->silent) {
+            if (dmc->shift & 1) {
+                dmc->level += (dmc->level <= 125) ? 2 : 0;
+            } else {
+                dmc->level -= (dmc->level >= 2) ? 2 : 0;
+            }
+            dmc->shift >>= 1;
+            setAmp(apu, &dmc->amp, dmc->level, DMC_WEIGHT, time);
+        }
+
+        // Start on the next byte, which frees up the buffer for the one after
+        if (--dmc->bits == 0) {
+            dmc->bits = 8;
+            dmc->silent = !dmc->buffer_full;
+            if (dmc->buffer_full) {
+                dmc->shift = dmc->buffer;
+                dmc->buffer_full = false;
+                fetchSample(apu);
+            }
+        }
+        time += dmc->period;
+    }
+    dmc->delay = time - end;
+}
+
+static void runChannels(APU* apu, uint64_t time, uint64_t end) {
+    runPulse(apu, 0, time, end);
+    runPulse(apu, 1, time, end);
+    runTriangle(apu, time, end);
+    runNoise(apu, time, end);
+    runDmc(apu, time, end);
+}
+
+// ---------- Frame Counter ----------
+
+static void clockEnvelope(Envelope* envelope) {
+    if (envelope->start) {
+        envelope->start = false;
+        envelope->decay = 15;
+        envelope->divider = envelope->period;
+    } else if (envelope->divider > 0) {
+        envelope->divider--;
+    } else {
+        envelope->divider = envelope->period;
+        if (envelope->decay > 0) {
+            envelope->decay--;
+        } else if (envelope->loop) {
+            envelope->decay = 15;
+        }
+    }
+}
+
+static void clockSweep(Pulse* pulse, int channel) {
+    int target = sweepTarget(pulse, channel);
+    if (pulse->sweep_divider == 0 && pulse->sweep_enabled && pulse->sweep_shift > 0 &&
+        pulse->period >= 8 && target <= 0x7FF) {
+        pulse->period = target;
+    }
+
+    if (pulse->sweep_divider == 0 || pulse->sweep_reload) {
+        pulse->sweep_divider = pulse->sweep_period;
+        pulse->sweep_reload = false;
+    } else {
+        pulse->sweep_divider--;
+    }
+}
+
+static void clockLength(uint8_t* length, bool halt) {
+    if (*length > 0 && !halt) {
+        (*length)--;
+    }
+}
+
+static void quarterFrame(APU* apu) {
+    clockEnvelope(&apu->pulse[0].envelope);
+    clockEnvelope(&apu->pulse[1].envelope);
+    clockEnvelope(&apu->noise.envelope);
+
+    Triangle* triangle = &apu->triangle;
+    if (triangle->linear_reload) {
+        triangle->linear = triangle->linear_period;
+    } else if (triangle->linear > 0) {
+        triangle->linear--;
+    }
+    if (!triangle->control) {
+        triangle->linear_reload = false;
+    }
+}
+
+static void halfFrame(APU* apu) {
+    for (int channel = 0; channel < 2; channel++) {
+        clockLength(&apu->pulse[channel].length, apu->pulse[channel].envelope.loop);
+        clockSweep(&apu->pulse[channel], channel);
+    }
+    clockLength(&apu->triangle.length, apu->triangle.control);
+    clockLength(&apu->noise.length, apu->noise.envelope.loop);
+}
+
+static void clockFrameCounter(APU* apu) {
+    int step = apu->frame_step;
+    int last = apu->five_step ? 4 : 3;
+
+    if (step != 3 || !apu->five_step) {
+        quarterFrame(apu);
+    }
+    if (step == 1 || step == last) {
+        halfFrame(apu);
+    }
+    if (step == 3 && !apu->five_step && !apu->irq_inhibit) {
+        apu->frame_irq = true;
+    }
+
+    if (step == last) {
+        apu->frame_start += apu->five_step ? FIVE_STEP_LENGTH : FOUR_STEP_LENGTH;
+        apu->frame_step = 0;
+    } else {
+        apu->frame_step++;
+    }
+    updateAmps(apu);
+}
+
+// ---------- Registers ----------
+
+static void writeEnvelope(Envelope* envelope, uint8_t val) {
+    envelope->loop = val & 0x20;
+    envelope->constant = val & 0x10;
+    envelope->period = val & 0x0F;
+}
+
+static void writePulse(APU* apu, int channel, int reg, uint8_t val) {
+    Pulse* pulse = &apu->pulse[channel];
+    switch (reg) {
+        case 0:
+            pulse->duty = val >> 6;
+            writeEnvelope(&pulse->envelope, val);
+            break;
+        case 1:
+            pulse->sweep_enabled = val & 0x80;
+            pulse->sweep_period = (val >> 4) & 0x07;
+            pulse->sweep_negate = val & 0x08;
+            pulse->sweep_shift = val & 0x07;
+            pulse->sweep_reload = true;
+            break;
+        case 2:
+            pulse->period = (pulse->period & 0x0700) | val;
+            break;
+        case 3:
+            pulse->period = (pulse->period & 0x00FF) | ((val & 0x07) << 8);
+            if (apu->enabled & (1 << channel)) {
+                pulse->length = length_table[val >> 3];
+            }
+            pulse->step = 0;
+            pulse->envelope.start = true;
+            break;
+    }
+}
+
+/**
+ * Read $4015
+ *
+ * @param apu - The APU
+ *
+ * @returns Which channels are still playing and which IRQs are raised
+ */
+uint8_t apuReadStatus(APU* apu) {
+    uint8_t status = (apu->pulse[0].length > 0) | (apu->pulse[1].length > 0) << 1 |
+                     (apu->triangle.length > 0) << 2 | (apu->noise.length > 0) << 3 |
+                     (apu->dmc.remaining > 0) << 4 | apu->frame_irq << 6 | apu->dmc_irq << 7;
+
+    // Reading acknowledges the frame IRQ
+    apu->frame_irq = false;
+    return status;
+}
+
+/**
+ * Write one of the APU's registers
+ *
+ * @param apu - The APU
+ * @param addr - The CPU address of the register ($4000-$4017)
+ * @param val - The value to write
+ */
+void apuWriteRegister(APU* apu, uint16_t addr, uint8_t val) {
+    Triangle* triangle = &apu->triangle;
+    Noise* noise = &apu->noise;
+    Dmc* dmc = &apu->dmc;
+
+    switch (addr) {
+        case 0x4000:
+        case 0x4001:
+        case 0x4002:
+        case 0x4003:
+        case 0x4004:
+        case 0x4005:
+        case 0x4006:
+        case 0x4007:
+            writePulse(apu, (addr >> 2) & 1, addr & 0x03, val);
+            break;
+        case 0x4008:
+            triangle->control = val & 0x80;
+            triangle->linear_period = val & 0x7F;
+            break;
+        case 0x400A:
+            triangle->period = (triangle->period & 0x0700) | val;
+            break;
+        case 0x400B:
+            triangle->period = (triangle->period & 0x00FF) | ((val & 0x07) << 8);
+            if (apu->enabled & 0x04) {
+                triangle->length = length_table[val >> 3];
+            }
+            triangle->linear_reload = true;
+            break;
+        case 0x400C:
+            writeEnvelope(&noise->envelope, val);
+            break;
+        case 0x400E:
+            noise->short_mode = val & 0x80;
+            noise->period = noise_periods[val & 0x0F];
+            break;
+        case 0x400F:
+            if (apu->enabled & 0x08) {
+                noise->length = length_table[val >> 3];
+            }
+            noise->envelope.start = true;
+            break;
+        case 0x4010:
+            dmc->irq_enabled = val & 0x80;
+            dmc->loop = val & 0x40;
+            dmc->period = dmc_periods[val & 0x0F];
+            if (!dmc->irq_enabled) {
+                apu->dmc_irq = false;
+            }
+            break;
+        case 0x4011:
+            dmc->level = val & 0x7F;
+            break;
+        case 0x4012:
+            dmc->sample_addr = 0xC000 | (val << 6);
+            break;
+        case 0x4013:
+            dmc->sample_length = (val << 4) + 1;
+            break;
+        case 0x4015:
+            // Disabling a channel silences it right away
+            apu->enabled = val & 0x0F;
+            for (int channel = 0; channel < 2; channel++) {
+                if (!(val & (1 << channel))) {
+                    apu->pulse[channel].length = 0;
+                }
+            }
+            if (!(val & 0x04)) {
+                triangle->length = 0;
+            }
+            if (!(val & 0x08)) {
+                noise->length = 0;
+            }
+
+            // The DMC starts its sample over if it had finished
+            apu->dmc_irq = false;
+            if (!(val & 0x10)) {
+                dmc->remaining = 0;
+            } else if (dmc->remaining == 0) {
+                restartSample(dmc);
+                fetchSample(apu);
+            }
+            break;
+        case 0x4017:
+            // Restarts the sequence, with the 5 step one clocking everything
+            // straight away
+            apu->five_step = val & 0x80;
+            apu->irq_inhibit = val & 0x40;
+            if (apu->irq_inhibit) {
+                apu->frame_irq = false;
+            }
+            apu->frame_start = apu->synced_cycle;
+            apu->frame_step = 0;
+            if (apu->five_step) {
+                quarterFrame(apu);
+                halfFrame(apu);
+            }
+            break;
+        default:
+            break;
+    }
+    updateAmps(apu);
+}
+
+// Run the APU up to the CPU before the CPU sees or changes any of its state
+static void sync(APU* apu) {
+    if (apu->scheduler != NULL) {
+        apuCatchUp(apu, *apu->scheduler->clock);
+    }
+}
+
+// A register access can move the APU's next event (like acknowledging an IRQ
+// or starting a sample)
+static void reschedule(APU* apu) {
+    if (apu->scheduler != NULL) {
+        schedulerReschedule(apu->scheduler);
+    }
+}
+
+static uint8_t readHandler(void* context, uint16_t addr) {
+    APU* apu = context;
+    if (addr != 0x4015) {
+        return apu->next_read(apu->next_read_context, addr);
+    }
+
+    sync(apu);
+    uint8_t status = apuReadStatus(apu);
+    reschedule(apu);
+    return status;
+}
+
+static void writeHandler(void* context, uint16_t addr, uint8_t val) {
+    APU* apu = context;
+    if (addr > 0x4013 && addr != 0x4015 && addr != 0x4017) {
+        apu->next_write(apu->next_write_context, addr, val);
+        return;
+    }
+
+    sync(apu);
+    apuWriteRegister(apu, addr, val);
+    reschedule(apu);
+}
+
+/**
+ * Map the APU's registers into the CPU address space ($4000-$4013, $4015 and
+ * $4017). This has to be done after ppuMapRegisters and before
+ * controllersMapRegisters, since they share a page.
+ *
+ * @param apu - The APU
+ * @param bus - The CPU bus
+ */
+void apuMapRegisters(APU* apu, Bus* bus) {
+    int page = 0x4000 / BUS_PAGE_SIZE;
+    apu->bus = bus;
+    apu->next_read = bus->read_handlers[page];
+    apu->next_write = bus->write_handlers[page];
+    apu->next_read_context = bus->read_contexts[page];
+    apu->next_write_context = bus->write_contexts[page];
+
+    busMapHandlers(bus, 0x4000, BUS_PAGE_SIZE, readHandler, writeHandler, apu);
+}
+
+// ---------- Timing ----------
+
+// Hand the block of audio that just ended to the output
+static void endBlock(APU* apu) {
+    uint32_t clocks = apu->synced_cycle - apu->audio_start;
+    apu->audio_start = apu->synced_cycle;
+    if (apu->output == NULL) {
+        return;
+    }
+
+    int16_t samples[BLIP_SIZE];
+    blipEndFrame(&apu->blip, clocks);
+    int count = blipReadSamples(&apu->blip, samples, BLIP_SIZE);
+    apu->samples += count;
+    apu->output(apu->output_context, samples, count);
+}
+
+/**
+ * Run the APU up to a CPU cycle, from the cycle it was last run up to. Channels
+ * jump straight from one change in their output to the next.
+ *
+ * @param apu - The APU
+ * @param cycle - The CPU cycle to run up to
+ */
+void apuCatchUp(APU* apu, uint64_t cycle) {
+    while (apu->synced_cycle < cycle) {
+        // Stop at the next frame counter step and the end of the block of audio
+        uint64_t step = apu->frame_start + frame_steps[apu->five_step][apu->frame_step];
+        uint64_t block_end = apu->audio_start + APU_FRAME_CYCLES;
+        uint64_t end = cycle;
+        if (step < end) {
+            end = step;
+        }
+        if (block_end < end) {
+            end = block_end;
+        }
+
+        runChannels(apu, apu->synced_cycle, end);
+        apu->synced_cycle = end;
+
+        if (end == step) {
+            clockFrameCounter(apu);
+        }
+        if (end == block_end) {
+            endBlock(apu);
+        }
+    }
+}
+
+/**
+ * Find the CPU cycle by which the APU next has to be run: the end of the
+ * current block of audio (if there's an output), the next DMC sample read
+ * (which stalls the CPU and may raise an IRQ), and the next frame IRQ
+ *
+ * @param apu - The APU
+ *
+ * @returns The CPU cycle of the next event
+ */
+uint64_t apuNextEvent(const APU* apu) {
+    uint64_t next = SCHEDULER_NO_EVENT;
+    if (apu->output != NULL) {
+        next = apu->audio_start + APU_FRAME_CYCLES;
+    }
+
+    if (!apu->five_step && !apu->irq_inhibit && !apu->frame_irq) {
+        uint64_t irq = apu->frame_start + frame_steps[0][3];
+        if (irq < next) {
+            next = irq;
+        }
+    }
+
+    // The next byte is read once the one being played runs out
+    const Dmc* dmc = &apu->dmc;
+    if (dmc->remaining > 0) {
+        uint64_t read = apu->synced_cycle + dmc->delay + (uint64_t)(dmc->bits - 1) * dmc->period;
+        if (read < next) {
+            next = read;
+        }
+    }
+    return next;
+}
+
+static void catchUpHandler(void* context, uint64_t cycle) {
+    apuCatchUp(context, cycle);
+}
+
+static uint64_t nextEventHandler(void* context) {
+    return apuNextEvent(context);
+}
+
+/**
+ * Hand the APU over to a scheduler, so it only runs when the CPU needs it to
+ *
+ * @param apu - The APU
+ * @param scheduler - The scheduler driven by the CPU's cycle count
+ *
+ * @returns 0 if the APU was added to the scheduler
+ */
+int apuSchedule(APU* apu, Scheduler* scheduler) {
+    apu->scheduler = scheduler;
+    apu->synced_cycle = *scheduler->clock;
+    apu->frame_start = apu->synced_cycle;
+    apu->audio_start = apu->synced_cycle;
+
+    SchedulerComponent component = {
+        .name = "APU",
+        .context = apu,
+        .catchUp = catchUpHandler,
+        .nextEvent = nextEventHandler,
+    };
+    return schedulerAdd(scheduler, component);
+}
+
+// ---------- Output ----------
+
+/**
+ * Start sending the APU's audio somewhere, as APU_SAMPLE_RATE 16-bit samples
+ *
+ * @param apu - The APU
+ * @param output - Called with each block of samples
+ * @param context - Passed to output
+ */
+void apuSetOutput(APU* apu, ApuOutput output, void* context) {
+    apu->output = output;
+    apu->output_context = context;
+    apu->audio_start = apu->synced_cycle;
+    blipClear(&apu->blip);
+    if (apu->scheduler != NULL) {
+        schedulerReschedule(apu->scheduler);
+    }
+}
+
+/**
+ * Send out the audio synthesized so far, without waiting for the end of the
+ * block (e.x. when the run stops)
+ *
+ * @param apu - The APU (caught up to the CPU)
+ */
+void apuFlush(APU* apu) {
+    if (apu->synced_cycle > apu->audio_start) {
+        endBlock(apu);
+    }
+}
+
+// ---------- Setup ----------
+
+// Work out the jumps for both of the noise channel's modes, starting from a
+// single shift and squaring up
+static void makeNoiseJumps(Noise* noise) {
+    for (int mode = 0; mode < 2; mode++) {
+        int tap = mode ? 6 : 1;
+        for (int bit = 0; bit < 15; bit++) {
+            uint16_t lfsr = 1 << bit;
+            uint16_t feedback = (lfsr ^ (lfsr >> tap)) & 1;
+            noise->jumps[mode][0][bit] = (lfsr >> 1) | (feedback << 14);
+        }
+        for (int k = 1; k < NOISE_JUMPS; k++) {
+            for (int bit = 0; bit < 15; bit++) {
+                uint16_t half = noise->jumps[mode][k - 1][bit];
+                uint16_t next = 0;
+                for (int i = 0; i < 15; i++) {
+                    if (half & (1 << i)) {
+                        next ^= noise->jumps[mode][k - 1][i];
+                    }
+                }
+                noise->jumps[mode][k][bit] = next;
+            }
+        }
+    }
+}
+
+/**
+ * Allocate an APU in its power-on state
+ *
+ * @returns The new APU, or NULL if it couldn't be allocated
+ */
+APU* createAPU(void) {
+    APU* apu = calloc(1, sizeof(APU));
+    if (apu == NULL) {
+        return NULL;
+    }
+
+    apu->pulse[0].delay = 2;
+    apu->pulse[1].delay = 2;
+    apu->triangle.delay = 1;
+    apu->noise.lfsr = 1;
+    apu->noise.period = noise_periods[0];
+    apu->noise.delay = apu->noise.period;
+    makeNoiseJumps(&apu->noise);
+    apu->dmc.period = dmc_periods[0];
+    apu->dmc.delay = apu->dmc.period;
+    apu->dmc.bits = 8;
+    apu->dmc.silent = true;
+
+    initBlip(&apu->blip, CPU_CLOCK_HZ, APU_SAMPLE_RATE);
+    return apu;
+}
+
+/**
+ * Free an APU
+ *
+ * @param apu - The APU to free
+ */
+void freeAPU(APU* apu) {
+    free(apu);
+}
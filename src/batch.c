@@ -0,0 +1,257 @@
+#include "batch.h"
+
+#include "emulator.h"
+#include "logger.h"
+#include "savestate.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* status_names[] = {"DONE", "PASS", "FAIL", "ERROR"};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Find the path of a rom listed in a manifest
+ *
+ * @param manifest - The manifest's path
+ * @param rom - The rom as the manifest lists it
+ *
+ * @returns The rom's path (relative to the manifest unless it's absolute)
+ * @returns NULL if memory couldn't be allocated
+ */
+static char* romPath(const char* manifest, const char* rom) {
+    const char* slash = strrchr(manifest, '/');
+    size_t dir_length = (rom[0] == '/' || slash == NULL) ? 0 : slash - manifest + 1;
+
+    char* path = malloc(dir_length + strlen(rom) + 1);
+    if (path != NULL) {
+        memcpy(path, manifest, dir_length);
+        strcpy(path + dir_length, rom);
+    }
+    return path;
+}
+
+/**
+ * Read a batch manifest from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The batch
+ * @returns NULL if the file couldn't be read or has an invalid line
+ */
+Batch* loadBatch(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return NULL;
+    }
+
+    Batch* batch = calloc(1, sizeof(Batch));
+    uint32_t capacity = 0;
+    char line[BATCH_LINE_LENGTH];
+    int line_num = 0;
+
+    while (batch != NULL && fgets(line, sizeof(line), file) != NULL) {
+        line_num++;
+
+        char* save;
+        char* rom = strtok_r(line, " \t\r\n", &save);
+        if (rom == NULL || rom[0] == '#') {
+            continue;
+        }
+
+        BatchJob job = {0};
+        char* frames = strtok_r(NULL, " \t\r\n", &save);
+        char* hash = strtok_r(NULL, " \t\r\n", &save);
+        char* end = NULL;
+        bool valid = frames != NULL;
+        if (valid) {
+            job.frames = strtoull(frames, &end, 10);
+            valid = *end == '\0' && job.frames > 0;
+        }
+        if (valid && hash != NULL) {
+            job.has_expected = true;
+            job.expected_hash = strtoull(hash, &end, 16);
+            valid = *end == '\0';
+        }
+        if (!valid || strtok_r(NULL, " \t\r\n", &save) != NULL) {
+            fprintf(stderr, "ERROR: %s:%d: Expected e.x. \"smb.nes 600 1f2e3d4c5b6a7988\"\n",
+                    path, line_num);
+            freeBatch(batch);
+            batch = NULL;
+            break;
+        }
+
+        if (batch->count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            BatchJob* jobs = realloc(batch->jobs, capacity * sizeof(BatchJob));
+            if (jobs == NULL) {
+                freeBatch(batch);
+                batch = NULL;
+                break;
+            }
+            batch->jobs = jobs;
+        }
+
+        job.rom_path = romPath(path, rom);
+        batch->jobs[batch->count++] = job;
+        if (job.rom_path == NULL) {
+            freeBatch(batch);
+            batch = NULL;
+        }
+    }
+
+    fclose(file);
+    return batch;
+}
+
+/**
+ * Free a batch
+ *
+ * @param batch - The batch to free
+ */
+void freeBatch(Batch* batch) {
+    for (uint32_t i = 0; i < batch->count; i++) {
+        free(batch->jobs[i].rom_path);
+    }
+    free(batch->jobs);
+    free(batch);
+}
+
+/**
+ * Find how many workers to run a batch on by default
+ *
+ * @returns The number of online cores
+ */
+int batchWorkers(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? cores : 1;
+}
+
+/**
+ * Run a rom for its frames on an emulator of its own
+ *
+ * @param job - The job to run
+ */
+static void runJob(BatchJob* job) {
+    double start = now();
+    Emulator* emu = createEmulator(job->rom_path);
+    if (emu == NULL) {
+        LOG(COMP_BATCH, LEVEL_ERROR, "Failed to load %s", job->rom_path);
+        job->status = BATCH_ERROR;
+        return;
+    }
+
+    job->frames_run = emulatorRunFrames(emu, job->frames);
+    job->instructions = emu->instructions;
+    job->hash = saveStateHash(&emu->machine);
+    job->seconds = now() - start;
+    freeEmulator(emu);
+
+    if (!job->has_expected) {
+        job->status = BATCH_DONE;
+    } else {
+        job->status = job->hash == job->expected_hash ? BATCH_PASS : BATCH_FAIL;
+    }
+}
+
+static void* batchWorker(void* arg) {
+    Batch* batch = arg;
+    uint32_t next;
+    while ((next = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        runJob(&batch->jobs[next]);
+    }
+    return NULL;
+}
+
+/**
+ * Run every job in a batch. Workers take the next job as they finish one, so
+ * long runs don't hold the rest up.
+ *
+ * @param batch - The batch
+ * @param workers - The number of threads to run jobs on (the calling thread
+ *                  is one of them)
+ */
+void runBatch(Batch* batch, int workers) {
+    if (workers > (int)batch->count) {
+        workers = batch->count;
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    double start = now();
+    atomic_store(&batch->next, 0);
+
+    // Any threads that can't be started just leave more for the rest
+    pthread_t* threads = calloc(workers, sizeof(pthread_t));
+    int started = 0;
+    while (threads != NULL && started < workers - 1 &&
+           pthread_create(&threads[started], NULL, batchWorker, batch) == 0) {
+        started++;
+    }
+    if (started < workers - 1) {
+        LOG(COMP_BATCH, LEVEL_WARNING, "Only started %d of %d workers", started + 1, workers);
+    }
+
+    batchWorker(batch);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    batch->workers = started + 1;
+    batch->seconds = now() - start;
+}
+
+/**
+ * Print how each job in a batch went, with a summary line at the end
+ *
+ * @param batch - The batch (after runBatch)
+ * @param out - Where to print the report
+ *
+ * @returns The number of jobs that failed or couldn't be run
+ */
+uint32_t printBatchReport(const Batch* batch, FILE* out) {
+    uint32_t counts[4] = {0};
+    uint64_t instructions = 0;
+
+    fprintf(out, "%-6s %8s %14s %9s %12s  %-16s  %s\n", "RESULT", "FRAMES", "INSTRUCTIONS",
+            "SECONDS", "INSTR/S", "HASH", "ROM");
+    for (uint32_t i = 0; i < batch->count; i++) {
+        const BatchJob* job = &batch->jobs[i];
+        counts[job->status]++;
+        if (job->status == BATCH_ERROR) {
+            fprintf(out, "%-6s %8s %14s %9s %12s  %-16s  %s\n", status_names[job->status], "-",
+                    "-", "-", "-", "-", job->rom_path);
+            continue;
+        }
+
+        instructions += job->instructions;
+        double rate = job->seconds > 0 ? job->instructions / job->seconds : 0;
+        fprintf(out, "%-6s %8llu %14llu %9.3f %12.0f  %016llx  %s\n", status_names[job->status],
+                (unsigned long long)job->frames_run, (unsigned long long)job->instructions,
+                job->seconds, rate, (unsigned long long)job->hash, job->rom_path);
+    }
+
+    double rate = batch->seconds > 0 ? instructions / batch->seconds : 0;
+    fprintf(out,
+            "\nRan %u roms on %d worker%s in %.3f s (%.0f instr/s): "
+            "%u passed, %u failed, %u unchecked, %u errors\n",
+            batch->count, batch->workers, batch->workers == 1 ? "" : "s", batch->seconds, rate,
+            counts[BATCH_PASS], counts[BATCH_FAIL], counts[BATCH_DONE], counts[BATCH_ERROR]);
+
+    return counts[BATCH_FAIL] + counts[BATCH_ERROR];
+}
@@ -0,0 +1,115 @@
+#include "blip.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CUTOFF (0.9)  // Highest frequency kept, as a fraction of the output's Nyquist rate
+#define PI     (3.14159265358979323846)
+
+/**
+ * Work out each phase's kernel: a windowed sinc impulse (a step's derivative)
+ * centered on the phase's position in the middle of BLIP_WIDTH samples
+ *
+ * @param blip - The buffer
+ */
+static void makeKernel(Blip* blip) {
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double taps[BLIP_WIDTH];
+        double total = 0;
+        for (int i = 0; i < BLIP_WIDTH; i++) {
+            double x = i - BLIP_WIDTH / 2 + 0.5 - (double)phase / BLIP_PHASES;
+            double sinc = (x == 0) ? 1 : sin(PI * CUTOFF * x) / (PI * CUTOFF * x);
+            double angle = 2 * PI * x / BLIP_WIDTH;
+            double window = 0.42 + 0.5 * cos(angle) + 0.08 * cos(2 * angle);  // Blackman
+            taps[i] = sinc * window;
+            total += taps[i];
+        }
+
+        // Every phase has to add up to exactly one step, or DC would creep in
+        int sum = 0;
+        for (int i = 0; i < BLIP_WIDTH; i++) {
+            blip->kernel[phase][i] = lround(taps[i] / total * (1 << BLIP_KERNEL_BITS));
+            sum += blip->kernel[phase][i];
+        }
+        blip->kernel[phase][BLIP_WIDTH / 2] += (1 << BLIP_KERNEL_BITS) - sum;
+    }
+}
+
+/**
+ * Set up an empty buffer
+ *
+ * @param blip - The buffer to set up
+ * @param clock_rate - The rate times are given in (cycles a second)
+ * @param sample_rate - The rate of the output (samples a second)
+ */
+void initBlip(Blip* blip, uint32_t clock_rate, uint32_t sample_rate) {
+    blip->factor = ((uint64_t)sample_rate << 32) / clock_rate;
+    makeKernel(blip);
+    blipClear(blip);
+}
+
+/**
+ * Drop everything in the buffer, e.x. after jumping to another point in time
+ *
+ * @param blip - The buffer
+ */
+void blipClear(Blip* blip) {
+    blip->offset = 0;
+    blip->avail = 0;
+    blip->sum = 0;
+    memset(blip->deltas, 0, sizeof(blip->deltas));
+}
+
+/**
+ * End a frame, making its samples available to read
+ *
+ * @param blip - The buffer
+ * @param clocks - The length of the frame in clock cycles (the next frame's
+ *                 times start from here)
+ */
+void blipEndFrame(Blip* blip, uint32_t clocks) {
+    blip->offset += clocks * blip->factor;
+    blip->avail = blip->offset >> 32;
+    assert(blip->avail <= BLIP_SIZE);
+}
+
+/**
+ * Read finished samples out of the buffer
+ *
+ * @param blip - The buffer
+ * @param out - Where to write the samples
+ * @param count - The most samples to read
+ *
+ * @returns The number of samples read
+ */
+int blipReadSamples(Blip* blip, int16_t* out, int count) {
+    if (count > blip->avail) {
+        count = blip->avail;
+    }
+
+    int32_t sum = blip->sum;
+    for (int i = 0; i < count; i++) {
+        sum += blip->deltas[i];
+        int32_t sample = sum >> BLIP_KERNEL_BITS;
+        if (sample > INT16_MAX) {
+            sample = INT16_MAX;
+        } else if (sample < INT16_MIN) {
+            sample = INT16_MIN;
+        }
+        out[i] = sample;
+
+        // Leak a little of the sum away each sample, which takes out DC
+        sum -= sample * (1 << (BLIP_KERNEL_BITS - BLIP_BASS_SHIFT));
+    }
+    blip->sum = sum;
+
+    // Move the rest of the deltas (including the tails of the last steps) down
+    int remaining = blip->avail - count + BLIP_WIDTH;
+    memmove(blip->deltas, blip->deltas + count, remaining * sizeof(int32_t));
+    memset(blip->deltas + remaining, 0, count * sizeof(int32_t));
+    blip->offset -= (uint64_t)count << 32;
+    blip->avail -= count;
+    return count;
+}
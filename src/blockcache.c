@@ -0,0 +1,279 @@
+#include "blockcache.h"
+
+#include "6502.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Allocate an empty block cache
+ *
+ * @returns The new cache, or NULL if it couldn't be allocated
+ */
+BlockCache* createBlockCache(void) {
+    return calloc(1, sizeof(BlockCache));
+}
+
+/**
+ * Free every block that has been invalidated since the last call
+ *
+ * @param cache - The cache holding the retired blocks
+ */
+void freeRetiredBlocks(BlockCache* cache) {
+    while (cache->retired != NULL) {
+        Block* block = cache->retired;
+        cache->retired = block->next_retired;
+        free(block);
+    }
+}
+
+/**
+ * Free a block cache and all of the blocks in it
+ *
+ * @param cache - The cache to free
+ */
+void freeBlockCache(BlockCache* cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < 0x10000; i++) {
+        free(cache->blocks[i]);
+    }
+    freeRetiredBlocks(cache);
+    free(cache);
+}
+
+/**
+ * Check if the given instruction has to be the last one in a block
+ *
+ * @param mnemonic - The mnemonic of the instruction
+ *
+ * @returns true if the instruction can change the PC (or isn't a valid opcode)
+ */
+static bool endsBlock(Mnemonic mnemonic) {
+    switch (mnemonic) {
+        case BCC:
+        case BCS:
+        case BEQ:
+        case BMI:
+        case BNE:
+        case BPL:
+        case BVC:
+        case BVS:
+        case JMP:
+        case JSR:
+        case RTS:
+        case RTI:
+        case BRK:
+        case ILLEGAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Decode the block starting at 'pc' and add it to the cache
+ *
+ * @param cache - The cache to add the block to
+ * @param bus - The bus serving as the CPU address space
+ * @param pc - The address of the first instruction of the block
+ *
+ * @returns The new block
+ */
+static Block* buildBlock(BlockCache* cache, const Bus* bus, uint16_t pc) {
+    Block* block = malloc(sizeof(Block));
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->start = pc;
+    block->length = 0;
+    block->count = 0;
+    block->valid = true;
+    block->executions = 0;
+    block->native = NULL;
+    block->native_cycles = 0;
+    block->jit_failed = false;
+    block->next_retired = NULL;
+
+    uint16_t addr = pc;
+    while (block->count < BLOCK_MAX_INSTRUCTIONS) {
+        Instruction instr = parseInstruction(bus, addr);
+        block->instrs[block->count++] = instr;
+        block->length += instr.length;
+        addr += instr.length;
+
+        if (endsBlock(opcode_table[instr.opcode].mnemonic)) {
+            break;
+        }
+    }
+
+    block->pages[0] = bus->read_pages[pc >> 8];
+    block->pages[1] = bus->read_pages[(uint16_t)(pc + block->length - 1) >> 8];
+
+    for (int i = 0; i < block->length; i++) {
+        cache->code_map[(uint16_t)(pc + i)]++;
+    }
+    cache->blocks[pc] = block;
+
+    return block;
+}
+
+/**
+ * Return the block starting at 'pc', decoding and caching it first if needed
+ *
+ * @param cache - The cache to look the block up in
+ * @param bus - The bus serving as the CPU address space
+ * @param pc - The address of the first instruction of the block
+ *
+ * @returns The cached block
+ */
+Block* lookupBlock(BlockCache* cache, const Bus* bus, uint16_t pc) {
+    Block* block = cache->blocks[pc];
+
+    if (block != NULL) {
+        if (block->pages[0] == bus->read_pages[pc >> 8] &&
+            block->pages[1] == bus->read_pages[(uint16_t)(pc + block->length - 1) >> 8]) {
+            cache->hits++;
+            return block;
+        }
+
+        // The block was decoded from a bank that has since been switched out
+        invalidateBlocks(cache, pc);
+    }
+
+    cache->misses++;
+    return buildBlock(cache, bus, pc);
+}
+
+/**
+ * Throw away every cached block that was decoded from the given address
+ *
+ * @param cache - The cache to invalidate blocks in
+ * @param addr - The address that was written to
+ */
+void invalidateBlocks(BlockCache* cache, uint16_t addr) {
+    // Only blocks starting at most BLOCK_MAX_BYTES before the address can cover it
+    for (int back = 0; back < BLOCK_MAX_BYTES && cache->code_map[addr] != 0; back++) {
+        uint16_t start = addr - back;
+        Block* block = cache->blocks[start];
+
+        if (block == NULL || back >= block->length) {
+            continue;
+        }
+
+        for (int i = 0; i < block->length; i++) {
+            cache->code_map[(uint16_t)(start + i)]--;
+        }
+        cache->blocks[start] = NULL;
+
+        // The block may still be running, so only free it once it's safe to
+        block->valid = false;
+        block->next_retired = cache->retired;
+        cache->retired = block;
+
+        cache->invalidations++;
+    }
+}
+
+/**
+ * Execute the instructions of a block with executeInstruction, starting with
+ * the instruction at index 'first'
+ *
+ * @param block - The block to execute
+ * @param first - The index of the first instruction to execute
+ * @param max_instrs - The maximum number of instructions to execute
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address
+ *
+ * @returns The number of instructions executed
+ */
+int executeBlock(Block* block, int first, int max_instrs, Bus* bus, Processor* processor,
+                 uint64_t* cycles, uint64_t cycle_limit, int32_t stop_pc) {
+    int count = 0;
+
+    for (int i = first; i < block->count && count < max_instrs; i++) {
+        Instruction instr = block->instrs[i];
+        uint16_t old_PC = processor->PC;
+
+        executeInstruction(instr, bus, processor);
+        processor->PC += instr.length;
+
+        addAdditionalCycles(&instr, bus, processor, old_PC);
+        *cycles += instr.cycles;
+        count++;
+
+        // Leave the block early if it just overwrote itself
+        if (!block->valid || processor->halted || processor->PC == stop_pc ||
+            *cycles >= cycle_limit) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Run cached blocks starting at the processor's PC until it halts, the PC
+ * reaches 'stop_pc', or the cycle count reaches 'cycle_limit'
+ *
+ * @param cache - The cache holding decoded blocks
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runBlocks(BlockCache* cache, Bus* bus, Processor* processor, uint64_t* cycles,
+                   uint64_t cycle_limit, int32_t stop_pc) {
+    uint64_t count = 0;
+
+    // Stores made by executeInstruction have to invalidate this cache
+    BlockCache* old_cache = processor->block_cache;
+    processor->block_cache = cache;
+
+    while (!processor->halted && processor->PC != stop_pc && *cycles < cycle_limit) {
+        freeRetiredBlocks(cache);
+
+        Block* block = lookupBlock(cache, bus, processor->PC);
+        if (block == NULL) {
+            fprintf(stderr, "ERROR: Failed to allocate a block\n");
+            break;
+        }
+        block->executions++;
+
+        count += executeBlock(block, 0, block->count, bus, processor, cycles, cycle_limit, stop_pc);
+    }
+
+    freeRetiredBlocks(cache);
+    processor->block_cache = old_cache;
+
+    return count;
+}
+
+/**
+ * Print the hit rate and invalidation counts of the cache
+ *
+ * @param cache - The cache to print statistics for
+ */
+void printBlockCacheStats(const BlockCache* cache) {
+    uint64_t lookups = cache->hits + cache->misses;
+    double hit_rate = (lookups > 0) ? 100.0 * cache->hits / lookups : 0.0;
+
+    printf("--------- Block Cache Stats ---------\n");
+    printf("          Lookups: %llu\n", (unsigned long long)lookups);
+    printf("             Hits: %llu (%.2f%%)\n", (unsigned long long)cache->hits, hit_rate);
+    printf("           Misses: %llu\n", (unsigned long long)cache->misses);
+    printf("    Invalidations: %llu\n", (unsigned long long)cache->invalidations);
+    printf("-------------------------------------\n");
+}
@@ -0,0 +1,167 @@
+#include "bus.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Unmapped addresses read as 0 and ignore writes
+static uint8_t readUnmapped(void* context, uint16_t addr) {
+    return 0;
+}
+
+static void writeUnmapped(void* context, uint16_t addr, uint8_t val) {}
+
+/**
+ * Work out again whether every page is mapped, for both reads and writes, to
+ * consecutive bytes of host memory. The map functions call this after every
+ * change, so busFlatMemory doesn't have to look at the pages itself.
+ *
+ * @param bus - The bus to check
+ */
+static void updateFlatMemory(Bus* bus) {
+    uint8_t* base = bus->read_pages[0];
+    bus->flat_memory = NULL;
+    if (base == NULL) {
+        return;
+    }
+
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        uint8_t* host = base + page * BUS_PAGE_SIZE;
+        if (bus->read_pages[page] != host || bus->write_pages[page] != host) {
+            return;
+        }
+    }
+
+    bus->flat_memory = base;
+}
+
+/**
+ * Allocate a bus with nothing mapped (reads return 0 and writes are ignored)
+ *
+ * @returns The new bus, or NULL if it couldn't be allocated
+ */
+Bus* createBus(void) {
+    Bus* bus = calloc(1, sizeof(Bus));
+    if (bus == NULL) {
+        return NULL;
+    }
+
+    busMapHandlers(bus, 0x0000, 0x10000, readUnmapped, writeUnmapped, NULL);
+    return bus;
+}
+
+/**
+ * Allocate a bus that maps the whole address space to 64 KiB of host memory
+ *
+ * @param mem - The 64 KiB byte array serving as system memory
+ *
+ * @returns The new bus, or NULL if it couldn't be allocated
+ */
+Bus* createFlatBus(uint8_t* mem) {
+    Bus* bus = createBus();
+    if (bus == NULL) {
+        return NULL;
+    }
+
+    busMapMemory(bus, 0x0000, 0x10000, mem, 0x10000, true);
+    return bus;
+}
+
+/**
+ * Free a bus (but not the memory mapped into it)
+ *
+ * @param bus - The bus to free
+ */
+void freeBus(Bus* bus) {
+    free(bus);
+}
+
+/**
+ * Map a range of the address space directly to host memory, repeating the host
+ * memory over the range if it is smaller
+ *
+ * @param bus - The bus to map the memory into
+ * @param start - The first address of the range
+ * @param size - The size of the range (in bytes)
+ * @param host - The memory to map
+ * @param host_size - The size of the host memory (in bytes)
+ * @param writable - Whether writes go to the host memory, rather than being
+ *                   ignored
+ */
+void busMapMemory(Bus* bus, uint16_t start, uint32_t size, uint8_t* host, uint32_t host_size,
+                  bool writable) {
+    for (uint32_t offset = 0; offset < size; offset += BUS_PAGE_SIZE) {
+        int page = (start + offset) / BUS_PAGE_SIZE;
+        uint8_t* page_host = host + (offset % host_size);
+
+        bus->read_pages[page] = page_host;
+        if (writable) {
+            bus->write_pages[page] = page_host;
+        } else {
+            bus->write_pages[page] = NULL;
+            bus->write_handlers[page] = writeUnmapped;
+        }
+    }
+
+    updateFlatMemory(bus);
+}
+
+/**
+ * Point the reads of a range of the address space at host memory, leaving its
+ * writes mapped the way they were
+ *
+ * @param bus - The bus to map the memory into
+ * @param start - The first address of the range
+ * @param size - The size of the range (in bytes)
+ * @param host - The memory to map (at least 'size' bytes)
+ */
+void busMapReadMemory(Bus* bus, uint16_t start, uint32_t size, uint8_t* host) {
+    for (uint32_t offset = 0; offset < size; offset += BUS_PAGE_SIZE) {
+        bus->read_pages[(start + offset) / BUS_PAGE_SIZE] = host + offset;
+    }
+
+    updateFlatMemory(bus);
+}
+
+/**
+ * Send reads and/or writes to a range of the address space to handlers
+ *
+ * @param bus - The bus to map the handlers into
+ * @param start - The first address of the range (a multiple of BUS_PAGE_SIZE)
+ * @param size - The size of the range (a multiple of BUS_PAGE_SIZE)
+ * @param read_handler - Called for reads from the range (or NULL)
+ * @param write_handler - Called for writes to the range (or NULL)
+ * @param context - Passed to the handlers
+ */
+void busMapHandlers(Bus* bus, uint16_t start, uint32_t size, BusReadHandler read_handler,
+                    BusWriteHandler write_handler, void* context) {
+    for (uint32_t offset = 0; offset < size; offset += BUS_PAGE_SIZE) {
+        int page = (start + offset) / BUS_PAGE_SIZE;
+
+        if (read_handler != NULL) {
+            bus->read_pages[page] = NULL;
+            bus->read_handlers[page] = read_handler;
+            bus->read_contexts[page] = context;
+        }
+        if (write_handler != NULL) {
+            bus->write_pages[page] = NULL;
+            bus->write_handlers[page] = write_handler;
+            bus->write_contexts[page] = context;
+        }
+    }
+
+    updateFlatMemory(bus);
+}
+
+/**
+ * Return the host memory behind the bus if every page is mapped, for both reads
+ * and writes, to consecutive bytes of it
+ *
+ * @param bus - The bus to check
+ *
+ * @returns The start of the 64 KiB of host memory, or NULL if the bus isn't flat
+ */
+uint8_t* busFlatMemory(const Bus* bus) {
+    return bus->flat_memory;
+}
@@ -1,166 +1,195 @@
 #include "cartridge.h"
 
+#include "render.h"
+#include "utils.h"
+
+#include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size of a ROM in NES 2.0 notation, which is either a count of 'unit' sized
+// banks, or 2^E * (MM * 2 + 1) bytes when the MSB nibble is $F
+static uint64_t romSize(uint8_t lsb, uint8_t msb, uint32_t unit) {
+    if (msb == 0x0F) {
+        return ((uint64_t)1 << (lsb >> 2)) * ((lsb & 0x03) * 2 + 1);
+    }
+    return (uint64_t)((msb << 8) | lsb) * unit;
+}
+
+// Size of a RAM in NES 2.0 notation, which is 64 << shift bytes (or none)
+static uint32_t ramSize(uint8_t shift) {
+    return shift ? 64u << shift : 0;
+}
 
 /**
- * @brief Load the contents of the given rom into a cartridge
+ * Parse the 16 byte rom file header into the cartridge metadata
  *
  * @param cart - The struct representing the cartridge data
- * @param rom_path - The path to the rom file
+ * @param header - The first HEADER_SIZE bytes of the rom file
  *
- * @returns 0 if the rom was loaded properly
- * @returns -1 if there was an error opening the rom file
+ * @returns 0 if the header was parsed properly
  * @returns -2 if there was an error validating the magic number
- * @returns -3 if there was an error validating the PRG-ROM size
- * @returns -4 if there was an error validating the CHR-ROM size
- * @returns -5 if there was an error validating Flags 6
- * @returns -6 if there was an error validating Flags 7
- * @returns -7 if there was an error validating Flags 8
- * @returns -8 if there was an error validating Flags 9
- * @returns -9 if there was an error validating the reserved bits
- * @returns -10 if there was an error validating the read trainer size
- * @returns -11 if there was an error validating the read PRG-ROM size
- * @returns -12 if there was an error validating the read CHR-ROM size
+ * @returns -3 if the PRG-ROM or CHR-ROM are too big to load
  */
-int loadRom(Cartridge* cart, const char* rom_path) {
-    // Open the rom file and load its contents into the appropriate fields
-    FILE* rom_data = fopen(rom_path, "rb");
-
-    if (!rom_data) {
-        fprintf(stderr, "ERROR: Failed to open rom file\n");
-        return -1;
-    }
-
-    // Read magic number
-    int read_size = fread(&cart->magic_num, 1, 4, rom_data);
-
-    // Validate magic number
-    if (read_size != 4 || memcmp(cart->magic_num, "NES\x1A", 4) != 0) {
+int parseHeader(Cartridge* cart, const uint8_t* header) {
+    if (memcmp(header, "NES\x1A", 4) != 0) {
         fprintf(stderr, "ERROR: Failed to validate magic number\n");
         return -2;
     }
 
-    // Read PRG-ROM size
-    read_size = fread(&cart->prg_rom_size, 1, 1, rom_data);
+    memcpy(cart->magic_num, header, 4);
+    cart->prg_rom_size = header[4];
+    cart->chr_rom_size = header[5];
+    cart->flags6 = header[6];
+    cart->flags7 = header[7];
+    cart->flags8 = header[8];
+    cart->flags9 = header[9];
+    cart->flags10 = header[10];
+    memcpy(cart->reserved, &header[11], 5);
 
-    // Validate PRG-ROM size
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read PRG-ROM size\n");
-        return -3;
-    }
+    cart->nes2 = (cart->flags7 & 0x0C) == 0x08;
+    cart->mapper = getMapperNumber(cart);
 
-    // Read CHR-ROM size
-    read_size = fread(&cart->chr_rom_size, 1, 1, rom_data);
+    uint64_t prg_rom_bytes, chr_rom_bytes;
+    if (cart->nes2) {
+        cart->submapper = cart->flags8 >> 4;
+        prg_rom_bytes = romSize(cart->prg_rom_size, cart->flags9 & 0x0F, 16 * 1024);
+        chr_rom_bytes = romSize(cart->chr_rom_size, cart->flags9 >> 4, 8 * 1024);
+        cart->prg_ram_size = ramSize(cart->flags10 & 0x0F);
+        cart->prg_nvram_size = ramSize(cart->flags10 >> 4);
+        cart->chr_ram_size = ramSize(cart->reserved[0] & 0x0F);
+        cart->chr_nvram_size = ramSize(cart->reserved[0] >> 4);
+    } else {
+        // iNES only has the battery flag, and PRG-RAM sizes that almost no rom fills in
+        uint32_t prg_ram_size = (cart->flags8 ? cart->flags8 : 1) * 8 * 1024;
+        bool battery = cart->flags6 & 0x02;
 
-    // Validate CHR-ROM size
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read CHR-ROM size\n");
-        return -4;
+        cart->submapper = 0;
+        prg_rom_bytes = cart->prg_rom_size * 16 * 1024;
+        chr_rom_bytes = cart->chr_rom_size * 8 * 1024;
+        cart->prg_ram_size = battery ? 0 : prg_ram_size;
+        cart->prg_nvram_size = battery ? prg_ram_size : 0;
+        cart->chr_ram_size = cart->chr_rom_size ? 0 : 8 * 1024;
+        cart->chr_nvram_size = 0;
     }
 
-    // Read Flags 6
-    read_size = fread(&cart->flags6, 1, 1, rom_data);
-
-    // Validate Flags 6
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read Flags 6\n");
-        return -5;
+    if (prg_rom_bytes > UINT32_MAX || chr_rom_bytes > UINT32_MAX) {
+        fprintf(stderr, "ERROR: PRG-ROM or CHR-ROM size is too large\n");
+        return -3;
     }
+    cart->prg_rom_bytes = prg_rom_bytes;
+    cart->chr_rom_bytes = chr_rom_bytes;
 
-    // Read Flags 7
-    read_size = fread(&cart->flags7, 1, 1, rom_data);
-
-    // Validate Flags 7
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read Flags 7\n");
-        return -6;
-    }
+    return 0;
+}
 
-    // Read Flags 8
-    read_size = fread(&cart->flags8, 1, 1, rom_data);
+/**
+ * Load the contents of the given rom into a cartridge. The rom file is mapped
+ * read-only and the cartridge points straight into it, so nothing is copied
+ * (apart from CHR-ROM being decoded into chr_tiles).
+ *
+ * @param cart - The struct representing the cartridge data
+ * @param rom_path - The path to the rom file
+ *
+ * @returns 0 if the rom was loaded properly
+ * @returns -1 if there was an error opening or mapping the rom file, or
+ *          allocating its tiles
+ * @returns -2 if there was an error validating the magic number
+ * @returns -3 if the PRG-ROM or CHR-ROM are too big to load
+ * @returns -4 if the rom file is shorter than its header says
+ */
+int loadRom(Cartridge* cart, const char* rom_path) {
+    cart->rom_data = NULL;
+    cart->rom_data_size = 0;
+    cart->trainer = NULL;
+    cart->prg_rom = NULL;
+    cart->chr_rom = NULL;
+    cart->chr_tiles = NULL;
 
-    // Validate Flags 8
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read Flags 8\n");
-        return -7;
+    int fd = open(rom_path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Failed to open rom file\n");
+        return -1;
     }
 
-    // Read Flags 9
-    read_size = fread(&cart->flags9, 1, 1, rom_data);
-
-    // Validate Flags 9
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read Flags 9\n");
-        return -8;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "ERROR: Failed to read the size of the rom file\n");
+        close(fd);
+        return -1;
     }
-
-    // Read Flags 10
-    read_size = fread(&cart->flags10, 1, 1, rom_data);
-
-    // Validate Flags 10
-    if (read_size != 1) {
-        fprintf(stderr, "ERROR: Failed to properly read Flags 10\n");
-        return -8;
+    if (st.st_size < HEADER_SIZE) {
+        fprintf(stderr, "ERROR: Rom file is too short to have a header\n");
+        close(fd);
+        return -4;
     }
 
-    // Read reserved bits (should be 0)
-    read_size = fread(&cart->reserved, 1, 5, rom_data);
-
-    // Validate reserved bits
-    if (read_size != 5 || cart->reserved[0] != 0 || cart->reserved[1] != 0 ||
-        cart->reserved[2] != 0 || cart->reserved[3] != 0 || cart->reserved[4] != 0) {
-        fprintf(stderr, "ERROR: Failed to properly read reserved bits\n");
-        return -9;
+    // The mapping stays valid after the file is closed
+    size_t size = st.st_size;
+    uint8_t* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Failed to map rom file\n");
+        return -1;
     }
 
-    // If the trainer flag is set, read in the trainer section
-    if (cart->flags6 & 0x04) {
-        cart->trainer = malloc(512);
-        read_size = fread(cart->trainer, 1, 512, rom_data);
+    int result = parseHeader(cart, data);
+    if (result != 0) {
+        munmap(data, size);
+        return result;
+    }
 
-        // Validate trainer size
-        if (read_size != 512) {
-            fprintf(stderr, "ERROR: Failed to properly read trainer\n");
-            free(cart->trainer);
-            return -10;
-        }
-    } else {
-        cart->trainer = NULL;
+    uint64_t trainer_size = (cart->flags6 & 0x04) ? TRAINER_SIZE : 0;
+    uint64_t prg_offset = HEADER_SIZE + trainer_size;
+    uint64_t chr_offset = prg_offset + cart->prg_rom_bytes;
+    if (chr_offset + cart->chr_rom_bytes > size) {
+        fprintf(stderr, "ERROR: Rom file is shorter than its header says\n");
+        munmap(data, size);
+        return -4;
     }
 
-    // Read in the PRG-ROM data
-    cart->prg_rom = malloc(cart->prg_rom_size * 16 * 1024);
-    read_size = fread(cart->prg_rom, 1, cart->prg_rom_size * 16 * 1024, rom_data);
+    cart->rom_data = data;
+    cart->rom_data_size = size;
+    cart->trainer = trainer_size ? data + HEADER_SIZE : NULL;
+    cart->prg_rom = data + prg_offset;
+    cart->chr_rom = cart->chr_rom_bytes ? data + chr_offset : NULL;
 
-    // Validate PRG-ROM read size
-    if (read_size != cart->prg_rom_size * 16 * 1024) {
-        fprintf(stderr, "ERROR: Failed to properly read PRG-ROM");
-        if (cart->trainer) {
-            free(cart->trainer);
+    // CHR-ROM never changes, so its tiles only need to be decoded once
+    if (cart->chr_rom_bytes) {
+        cart->chr_tiles = malloc((size_t)cart->chr_rom_bytes / CHR_TILE_SIZE * DECODED_TILE_SIZE);
+        if (cart->chr_tiles == NULL) {
+            fprintf(stderr, "ERROR: Failed to allocate the CHR tile cache\n");
+            unloadRom(cart);
+            return -1;
         }
-        free(cart->prg_rom);
-        return -11;
+        decodeChr(cart->chr_rom, cart->chr_rom_bytes, cart->chr_tiles);
     }
 
-    // Read in the CHR-ROM data
-    cart->chr_rom = malloc(cart->chr_rom_size * 8 * 1024);
-    read_size = fread(cart->chr_rom, 1, cart->chr_rom_size * 8 * 1024, rom_data);
+    return 0;
+}
 
-    // Validate CHR-ROM read size
-    if (read_size != cart->chr_rom_size * 8 * 1024) {
-        fprintf(stderr, "ERROR: Failed to properly read CHR-ROM");
-        if (cart->trainer) {
-            free(cart->trainer);
-        }
-        free(cart->prg_rom);
-        free(cart->chr_rom);
-        return -12;
+/**
+ * Unmap the rom file of a cartridge loaded by loadRom and free its decoded tiles
+ *
+ * @param cart - The struct representing the cartridge data
+ */
+void unloadRom(Cartridge* cart) {
+    if (cart->rom_data != NULL) {
+        munmap(cart->rom_data, cart->rom_data_size);
     }
+    free(cart->chr_tiles);
 
-    return 0;
+    cart->rom_data = NULL;
+    cart->rom_data_size = 0;
+    cart->trainer = NULL;
+    cart->prg_rom = NULL;
+    cart->chr_rom = NULL;
+    cart->chr_tiles = NULL;
 }
 
 /**
@@ -169,8 +198,6 @@ int loadRom(Cartridge* cart, const char* rom_path) {
  * @param cart - The struct representing the cartridge data
  */
 void printCartMetadata(const Cartridge* cart) {
-    int mapper_num =
-        ((cart->flags8 & 0x0F) << 8) | ((cart->flags7 & 0xF0) << 4) | (cart->flags6 & 0xF0);
     char* console_type;
     switch (cart->flags7 & 0x03) {
         case 0:
@@ -188,10 +215,15 @@ void printCartMetadata(const Cartridge* cart) {
     }
 
     printf("--------------- ROM Data ---------------\n");
-    printf("       PRG-ROM Size: %d KB\n", cart->prg_rom_size * 16);
-    printf("       CHR-ROM Size: %d KB\n", cart->chr_rom_size * 8);
-    printf("             Mapper: %d\n", mapper_num);
-    printf("          Submapper: %d\n", cart->flags8 & 0xF0);
+    printf("             Format: %s\n", cart->nes2 ? "NES 2.0" : "iNES");
+    printf("       PRG-ROM Size: %u KB\n", cart->prg_rom_bytes / 1024);
+    printf("       CHR-ROM Size: %u KB\n", cart->chr_rom_bytes / 1024);
+    printf("       PRG-RAM Size: %u KB\n", cart->prg_ram_size / 1024);
+    printf("     PRG-NVRAM Size: %u KB\n", cart->prg_nvram_size / 1024);
+    printf("       CHR-RAM Size: %u KB\n", cart->chr_ram_size / 1024);
+    printf("     CHR-NVRAM Size: %u KB\n", cart->chr_nvram_size / 1024);
+    printf("             Mapper: %d\n", cart->mapper);
+    printf("          Submapper: %d\n", cart->submapper);
     printf("          Mirroring: %s\n", (cart->flags6 & 0x01) ? "Vertical" : "Horizontal");
     printf("            Battery: %s\n", (cart->flags6 & 0x02) ? "Present" : "Not Present");
     printf("            Trainer: %s\n", (cart->trainer != NULL) ? "Present" : "Not Present");
@@ -199,3 +231,39 @@ void printCartMetadata(const Cartridge* cart) {
     printf("       Console Type: %s\n", console_type);
     printf("----------------------------------------\n");
 }
+
+/**
+ * Get the mapper number out of the header flags
+ *
+ * @param cart - The struct representing the cartridge data
+ *
+ * @returns The iNES (or NES 2.0) mapper number
+ */
+int getMapperNumber(const Cartridge* cart) {
+    // The low nibble is in Flags 6 and the middle nibble in Flags 7
+    int mapper_num = (cart->flags6 >> 4) | (cart->flags7 & 0xF0);
+
+    if ((cart->flags7 & 0x0C) == 0x08) {
+        // NES 2.0 headers keep the high nibble in Flags 8
+        mapper_num |= (cart->flags8 & 0x0F) << 8;
+    } else if (cart->reserved[1] || cart->reserved[2] || cart->reserved[3] ||
+               cart->reserved[4]) {
+        // Old iNES dumps have junk (like "DiskDude!") from Flags 7 on
+        mapper_num &= 0x0F;
+    }
+
+    return mapper_num;
+}
+
+/**
+ * Hash the cartridge's PRG-ROM and CHR-ROM, e.x. to check that a recording was
+ * made with the same rom
+ *
+ * @param cart - The struct representing the cartridge data
+ *
+ * @returns The 64-bit FNV-1a hash of the rom's contents
+ */
+uint64_t hashRom(const Cartridge* cart) {
+    uint64_t hash = hashBytes(HASH_SEED, cart->prg_rom, cart->prg_rom_bytes);
+    return hashBytes(hash, cart->chr_rom, cart->chr_rom_bytes);
+}
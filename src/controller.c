@@ -0,0 +1,125 @@
+#include "controller.h"
+
+#include "bus.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#define OPEN_BUS (0x40)  // The upper bits of $4016/$4017 are left over from the address
+
+static const char* button_names[] = {"A", "B", "SELECT", "START", "UP", "DOWN", "LEFT", "RIGHT"};
+
+/**
+ * Set up the controllers with no buttons held down
+ *
+ * @param controllers - The controllers
+ */
+void initControllers(Controllers* controllers) {
+    *controllers = (Controllers){0};
+}
+
+static uint8_t readHandler(void* context, uint16_t addr) {
+    Controllers* controllers = context;
+    if (addr == 0x4016 || addr == 0x4017) {
+        return controllersRead(controllers, addr - 0x4016);
+    }
+    return controllers->next_read(controllers->next_read_context, addr);
+}
+
+static void writeHandler(void* context, uint16_t addr, uint8_t val) {
+    Controllers* controllers = context;
+    if (addr == 0x4016) {
+        controllersWrite(controllers, val);
+        return;
+    }
+    controllers->next_write(controllers->next_write_context, addr, val);
+}
+
+/**
+ * Map the controllers' registers into the CPU address space ($4016 and $4017).
+ * This has to be done after ppuMapRegisters, since they share a page with
+ * OAMDMA.
+ *
+ * @param controllers - The controllers
+ * @param bus - The CPU bus
+ */
+void controllersMapRegisters(Controllers* controllers, Bus* bus) {
+    int page = 0x4000 / BUS_PAGE_SIZE;
+    controllers->next_read = bus->read_handlers[page];
+    controllers->next_write = bus->write_handlers[page];
+    controllers->next_read_context = bus->read_contexts[page];
+    controllers->next_write_context = bus->write_contexts[page];
+
+    busMapHandlers(bus, 0x4000, BUS_PAGE_SIZE, readHandler, writeHandler, controllers);
+}
+
+/**
+ * Read $4016 or $4017
+ *
+ * @param controllers - The controllers
+ * @param port - The controller to read (0 for $4016, 1 for $4017)
+ *
+ * @returns The next button in bit 0, with the rest of the bits from open bus
+ */
+uint8_t controllersRead(Controllers* controllers, int port) {
+    // While the strobe is held, the shift register keeps being reloaded, so A
+    // is all that can be read
+    if (controllers->strobe) {
+        return OPEN_BUS | (controllers->buttons[port] & BUTTON_A);
+    }
+
+    uint8_t bit = controllers->shift[port] & 1;
+    controllers->shift[port] = (controllers->shift[port] >> 1) | 0x80;
+    return OPEN_BUS | bit;
+}
+
+/**
+ * Write $4016
+ *
+ * @param controllers - The controllers
+ * @param val - The value written (bit 0 is the strobe)
+ */
+void controllersWrite(Controllers* controllers, uint8_t val) {
+    // The shift registers are reloaded for as long as the strobe is held, so
+    // they're left with the buttons held down when it's cleared
+    if (controllers->strobe || (val & 1)) {
+        memcpy(controllers->shift, controllers->buttons, CONTROLLER_PORTS);
+    }
+    controllers->strobe = val & 1;
+}
+
+/**
+ * Parse a set of buttons, e.x. "A+RIGHT" or "start" ("." for none)
+ *
+ * @param arg - The buttons, separated by +
+ * @param buttons - Set to the BUTTON_ bits
+ *
+ * @returns 0 if every button name is valid
+ * @returns -1 if one isn't
+ */
+int parseButtons(const char* arg, uint8_t* buttons) {
+    *buttons = 0;
+    if (strcmp(arg, ".") == 0) {
+        return 0;
+    }
+
+    while (true) {
+        size_t length = strcspn(arg, "+");
+        int button = 0;
+        while (button < 8 && (strlen(button_names[button]) != length ||
+                              strncasecmp(arg, button_names[button], length) != 0)) {
+            button++;
+        }
+        if (button == 8) {
+            return -1;
+        }
+        *buttons |= 1 << button;
+
+        if (arg[length] == '\0') {
+            return 0;
+        }
+        arg += length + 1;
+    }
+}
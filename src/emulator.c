@@ -0,0 +1,211 @@
+#include "emulator.h"
+
+#include "6502.h"
+#include "apu.h"
+#include "bus.h"
+#include "cartridge.h"
+#include "controller.h"
+#include "interpreter.h"
+#include "jit.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Load a rom and set up an emulator to run it from its reset vector
+ *
+ * @param rom_path - The iNES file to load
+ *
+ * @returns The emulator
+ * @returns NULL if the rom couldn't be loaded or its mapper isn't supported
+ */
+Emulator* createEmulator(const char* rom_path) {
+    Emulator* emu = calloc(1, sizeof(Emulator));
+    if (emu == NULL) {
+        return NULL;
+    }
+
+    if (loadRom(&emu->cartridge, rom_path) != 0) {
+        free(emu);
+        return NULL;
+    }
+
+    // Set up the CPU memory map: 2 KiB of RAM mirrored up to $1FFF
+    emu->bus = createBus();
+    if (emu->bus == NULL) {
+        goto FAIL;
+    }
+    busMapMemory(emu->bus, 0x0000, 0x2000, emu->ram, RAM_SIZE, true);
+
+    // Map the cartridge into $6000-$FFFF
+    emu->mapper = createMapper(&emu->cartridge, emu->bus);
+    if (emu->mapper == NULL) {
+        goto FAIL;
+    }
+
+    emu->ppu = createPPU(emu->mapper);
+    if (emu->ppu == NULL) {
+        goto FAIL;
+    }
+    ppuMapRegisters(emu->ppu, emu->bus);
+
+    emu->apu = createAPU();
+    if (emu->apu == NULL) {
+        goto FAIL;
+    }
+    apuMapRegisters(emu->apu, emu->bus);
+
+    initControllers(&emu->controllers);
+    controllersMapRegisters(&emu->controllers, emu->bus);
+
+    // The PPU and APU run lazily, only catching up to the CPU at their events
+    // and when their (or the mapper's) registers are accessed
+    initScheduler(&emu->scheduler, &emu->cycles);
+    ppuSchedule(emu->ppu, &emu->scheduler);
+    apuSchedule(emu->apu, &emu->scheduler);
+
+    Processor* processor = &emu->processor;
+    // Reset leaves IRQs disabled until the rom is ready for them
+    processor->S = 0xFF;
+    processor->P = 0x34;
+    processor->PC = concatenateBytes(busRead(emu->bus, 0xFFFD), busRead(emu->bus, 0xFFFC));
+
+    emu->machine = (Machine){processor, emu->ram, emu->ppu, emu->mapper, &emu->cycles,
+                             &emu->controllers, emu->apu};
+    return emu;
+
+FAIL:
+    freeEmulator(emu);
+    return NULL;
+}
+
+/**
+ * Free an emulator and its rom
+ *
+ * @param emu - The emulator to free
+ */
+void freeEmulator(Emulator* emu) {
+    if (emu->apu) {
+        freeAPU(emu->apu);
+    }
+    if (emu->ppu) {
+        freePPU(emu->ppu);
+    }
+    if (emu->mapper) {
+        freeMapper(emu->mapper);
+    }
+    if (emu->bus) {
+        freeBus(emu->bus);
+    }
+    unloadRom(&emu->cartridge);
+    free(emu);
+}
+
+/**
+ * Run the CPU with the JIT if there is one, and runInstructions otherwise.
+ * Either way the run ends after an instruction that touches a memory-mapped
+ * register.
+ *
+ * @param emu - The emulator
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ */
+static void runCpu(Emulator* emu, uint64_t cycle_limit) {
+    if (emu->jit) {
+        emu->instructions += runJit(emu->jit, emu->bus, &emu->processor, &emu->cycles,
+                                    cycle_limit, NO_STOP_PC);
+    } else {
+        emu->instructions += runInstructions(emu->bus, &emu->processor, &emu->cycles,
+                                             cycle_limit, NO_STOP_PC);
+    }
+}
+
+/**
+ * Account for what happened during a run of instructions: add the cycles the
+ * CPU stalled for, catch the PPU and APU up if their next event is due, then
+ * take any interrupt that came up
+ *
+ * @param emu - The emulator
+ */
+static void finishRun(Emulator* emu) {
+    Processor* processor = &emu->processor;
+
+    // The CPU stalls while OAM DMA copies sprites and the DMC reads samples
+    emu->cycles += emu->ppu->dma_cycles + emu->apu->dma_cycles;
+    emu->ppu->dma_cycles = 0;
+    emu->apu->dma_cycles = 0;
+
+    // Catch the PPU and APU up once the CPU reaches their next event
+    if (schedulerDue(&emu->scheduler)) {
+        schedulerSync(&emu->scheduler);
+    }
+
+    // Interrupts are checked between instructions
+    if (emu->ppu->nmi_pending) {
+        emu->ppu->nmi_pending = false;
+        emu->cycles += interrupt(0xFFFA, emu->bus, processor);
+    } else if ((mapperIrq(emu->mapper) || apuIrq(emu->apu)) && !(processor->P & FLAG_I)) {
+        emu->cycles += interrupt(0xFFFE, emu->bus, processor);
+    }
+}
+
+/**
+ * Run one instruction, then any interrupt that comes up
+ *
+ * @param emu - The emulator
+ */
+void emulatorStep(Emulator* emu) {
+    Processor* processor = &emu->processor;
+
+    if (emu->tracer) {
+        Instruction instr = parseInstruction(emu->bus, processor->PC);
+        syncFlags(processor);
+        traceInstruction(emu->tracer, &instr, processor, emu->cycles);
+    }
+
+    runCpu(emu, emu->cycles + 1);
+    finishRun(emu);
+}
+
+/**
+ * Run instructions until the scheduler's next event, an instruction that
+ * touches a memory-mapped register, or a halt, then take any interrupt that
+ * comes up. While tracing, or while an IRQ is held off by the I flag (so that
+ * it's taken right after the instruction that clears it), this runs one
+ * instruction at a time like emulatorStep.
+ *
+ * @param emu - The emulator
+ */
+void emulatorRun(Emulator* emu) {
+    if (emu->tracer || mapperIrq(emu->mapper) || apuIrq(emu->apu)) {
+        emulatorStep(emu);
+        return;
+    }
+
+    uint64_t deadline = emu->scheduler.deadline;
+    runCpu(emu, deadline > emu->cycles ? deadline : emu->cycles + 1);
+    finishRun(emu);
+}
+
+/**
+ * Run until the PPU has finished the given number of frames, or the CPU halts.
+ * The PPU and APU are caught up to the CPU before returning.
+ *
+ * @param emu - The emulator
+ * @param frames - The number of frames to run
+ *
+ * @returns The number of frames finished
+ */
+uint64_t emulatorRunFrames(Emulator* emu, uint64_t frames) {
+    uint64_t start_frame = emu->ppu->frame;
+    uint64_t end_frame = start_frame + frames;
+    while (!emu->processor.halted && emu->ppu->frame < end_frame) {
+        emulatorRun(emu);
+    }
+    schedulerSync(&emu->scheduler);
+    return emu->ppu->frame - start_frame;
+}
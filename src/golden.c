@@ -0,0 +1,596 @@
+#include "golden.h"
+
+#include "6502.h"
+#include "bus.h"
+#include "emulator.h"
+#include "trace.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// B isn't a flag the CPU keeps, it only exists in the copies of P pushed to the
+// stack, so logs disagree on whether P shows it
+#define GOLDEN_P_MASK ((uint8_t)~FLAG_B)
+
+/**
+ * Return the value of a hex digit
+ *
+ * @param c - The character
+ *
+ * @returns The digit's value, or -1 if it isn't a hex digit
+ */
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Parse a hex number of at most 'digits' digits
+ *
+ * @param text - Where the number starts
+ * @param digits - The most digits to read
+ * @param value - Set to the number
+ *
+ * @returns Where the number ends, or NULL if there isn't one
+ */
+static const char* parseHex(const char* text, int digits, uint32_t* value) {
+    *value = 0;
+    int read = 0;
+    for (int digit; read < digits && (digit = hexDigit(text[read])) >= 0; read++) {
+        *value = (*value << 4) | digit;
+    }
+    return read > 0 ? text + read : NULL;
+}
+
+/**
+ * Find a labelled hex field (e.x. " A:") and parse its value
+ *
+ * @param text - Where to start looking
+ * @param label - The label in front of the value
+ * @param value - Set to the value
+ *
+ * @returns Where the value ends, or NULL if the field isn't there
+ */
+static const char* parseField(const char* text, const char* label, uint8_t* value) {
+    const char* field = strstr(text, label);
+    if (field == NULL) {
+        return NULL;
+    }
+
+    uint32_t parsed;
+    const char* end = parseHex(field + strlen(label), 2, &parsed);
+    *value = parsed;
+    return end;
+}
+
+/**
+ * Decode a line of a text log. The program counter starts the line (with or
+ * without a '$'), optionally followed by the instruction's bytes, and the
+ * registers and cycle count are found by their labels (A:, X:, Y:, P:, SP: or
+ * S:, and CYC:), so both nestest.log and -t's formats can be read.
+ *
+ * @param line - The line (without its newline)
+ * @param record - Set to the registers and cycle count on the line
+ *
+ * @returns The number of instruction bytes on the line (0 if there aren't any)
+ * @returns -1 if the line can't be decoded
+ */
+int parseTraceLine(const char* line, TraceRecord* record) {
+    memset(record, 0, sizeof(TraceRecord));
+
+    uint32_t pc;
+    const char* cursor = parseHex(line + (line[0] == '$'), 4, &pc);
+    if (cursor == NULL) {
+        return -1;
+    }
+    record->pc = pc;
+
+    // nestest.log follows the address with the bytes, e.x. "C000  4C F5 C5  JMP $C5F5".
+    // Mnemonics are 3 letters, so they never look like a byte.
+    int bytes = 0;
+    while (bytes < 3 && *cursor == ' ') {
+        const char* next = cursor;
+        while (*next == ' ') {
+            next++;
+        }
+        if (hexDigit(next[0]) < 0 || hexDigit(next[1]) < 0 || next[2] != ' ') {
+            break;
+        }
+
+        uint8_t byte = (hexDigit(next[0]) << 4) | hexDigit(next[1]);
+        if (bytes == 0) {
+            record->opcode = byte;
+        } else {
+            record->operands[bytes - 1] = byte;
+        }
+        bytes++;
+        cursor = next + 2;
+    }
+
+    // The fields come in this order in every format
+    if ((cursor = parseField(cursor, " A:", &record->a)) == NULL ||
+        (cursor = parseField(cursor, " X:", &record->x)) == NULL ||
+        (cursor = parseField(cursor, " Y:", &record->y)) == NULL ||
+        (cursor = parseField(cursor, " P:", &record->p)) == NULL) {
+        return -1;
+    }
+
+    const char* s = parseField(cursor, " SP:", &record->s);
+    if (s == NULL) {
+        s = parseField(cursor, " S:", &record->s);
+    }
+    if (s == NULL) {
+        return -1;
+    }
+
+    const char* cycles = strstr(s, " CYC:");
+    if (cycles == NULL || hexDigit(cycles[5]) < 0 || hexDigit(cycles[5]) > 9) {
+        return -1;
+    }
+    record->cycles = strtoull(cycles + 5, NULL, 10);
+
+    return bytes;
+}
+
+/**
+ * Move what's left of the last line read to the start of the text buffer and
+ * read more of a text log after it
+ *
+ * @param log - The log
+ *
+ * @returns true if there's more text
+ * @returns false at the end of the log (or if it couldn't be read)
+ */
+static bool readText(GoldenLog* log) {
+    size_t left = log->text_end - log->text_start;
+    memmove(log->text, log->text + log->text_start, left);
+    log->text_start = 0;
+    log->text_end = left;
+
+    if (left == GOLDEN_TEXT_CHUNK) {
+        fprintf(stderr, "ERROR: Line %llu of %s is too long\n", (unsigned long long)log->line + 1,
+                log->path);
+        log->failed = true;
+        return false;
+    }
+
+    size_t read = fread(log->text + left, 1, GOLDEN_TEXT_CHUNK - left, log->file);
+    if (read == 0) {
+        if (ferror(log->file)) {
+            fprintf(stderr, "ERROR: Failed to read %s\n", log->path);
+            log->failed = true;
+            return false;
+        }
+
+        // The last line doesn't have to end in a newline
+        if (left > 0) {
+            log->text[log->text_end++] = '\n';
+            return true;
+        }
+        return false;
+    }
+
+    log->text_end += read;
+    return true;
+}
+
+/**
+ * Decode the next chunk of a text log's lines
+ *
+ * @param log - The log
+ *
+ * @returns The number of records decoded
+ */
+static size_t decodeText(GoldenLog* log) {
+    size_t count = 0;
+    while (count < GOLDEN_CHUNK) {
+        char* start = log->text + log->text_start;
+        char* end = memchr(start, '\n', log->text_end - log->text_start);
+        if (end == NULL) {
+            if (!readText(log)) {
+                break;
+            }
+            continue;
+        }
+
+        // Lines can end in "\r\n", and blank lines are skipped
+        *end = '\0';
+        if (end > start && end[-1] == '\r') {
+            end[-1] = '\0';
+        }
+        log->text_start = end + 1 - log->text;
+        log->line++;
+        if (*start == '\0') {
+            continue;
+        }
+
+        int bytes = parseTraceLine(start, &log->records[count]);
+        if (bytes < 0) {
+            fprintf(stderr, "ERROR: Line %llu of %s isn't a trace line\n",
+                    (unsigned long long)log->line, log->path);
+            log->failed = true;
+            break;
+        }
+
+        // Whether a log has the instruction bytes is decided by its first line
+        if (log->read == 0 && count == 0) {
+            log->bytes = bytes > 0;
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Read the next chunk of a golden log into its records
+ *
+ * @param log - The log
+ *
+ * @returns The number of records in the chunk (0 at the end of the log)
+ */
+static size_t readChunk(GoldenLog* log) {
+    log->next = 0;
+    log->count = 0;
+    if (log->failed) {
+        return 0;
+    }
+
+    if (log->from_text) {
+        log->count = decodeText(log);
+    } else {
+        // Read bytes rather than records, so that a file cut off partway through
+        // a record doesn't go unnoticed
+        size_t read = fread(log->records, 1, GOLDEN_CHUNK * sizeof(TraceRecord), log->file);
+        log->count = read / sizeof(TraceRecord);
+        if (ferror(log->file)) {
+            fprintf(stderr, "ERROR: Failed to read %s\n", log->path);
+            log->failed = true;
+        } else if (read % sizeof(TraceRecord) != 0) {
+            fprintf(stderr, "ERROR: %s ends partway through a record\n", log->path);
+            log->failed = true;
+        }
+    }
+    return log->count;
+}
+
+/**
+ * Open a golden log, telling trace files and text logs apart by their header
+ *
+ * @param path - The log to open
+ *
+ * @returns The log
+ * @returns NULL if it couldn't be opened
+ */
+GoldenLog* openGoldenLog(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return NULL;
+    }
+
+    GoldenLog* log = calloc(1, sizeof(GoldenLog));
+    if (log == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    log->file = file;
+    log->path = path;
+    log->records = malloc(GOLDEN_CHUNK * sizeof(TraceRecord));
+    if (log->records == NULL) {
+        goto FAIL;
+    }
+
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    bool trace = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                 memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+    rewind(file);
+
+    if (trace) {
+        if (readTraceHeader(file, path) != 0) {
+            goto FAIL;
+        }
+        log->bytes = true;
+    } else {
+        // Room for a newline after a last line that doesn't end in one
+        log->from_text = true;
+        log->text = malloc(GOLDEN_TEXT_CHUNK + 1);
+        if (log->text == NULL) {
+            goto FAIL;
+        }
+    }
+    return log;
+
+FAIL:
+    closeGoldenLog(log);
+    return NULL;
+}
+
+/**
+ * Close a golden log
+ *
+ * @param log - The log to close
+ */
+void closeGoldenLog(GoldenLog* log) {
+    fclose(log->file);
+    free(log->records);
+    free(log->text);
+    free(log);
+}
+
+/**
+ * Take the next record from a golden log, reading another chunk when the
+ * current one runs out
+ *
+ * @param log - The log
+ *
+ * @returns The record, which stays valid until the next call
+ * @returns NULL at the end of the log, or if it couldn't be read ('failed' is set)
+ */
+const TraceRecord* goldenNext(GoldenLog* log) {
+    if (log->next == log->count && readChunk(log) == 0) {
+        return NULL;
+    }
+
+    log->read++;
+    return &log->records[log->next++];
+}
+
+/**
+ * Convert a golden log into a trace file, so that it can be validated against
+ * without decoding text every time
+ *
+ * @param log_path - The log to convert
+ * @param trace_path - The trace file to write
+ *
+ * @returns The number of records written
+ * @returns -1 if the log couldn't be read or the trace file written
+ */
+long long encodeTraceLog(const char* log_path, const char* trace_path) {
+    GoldenLog* log = openGoldenLog(log_path);
+    if (log == NULL) {
+        return -1;
+    }
+
+    FILE* file = fopen(trace_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", trace_path);
+        closeGoldenLog(log);
+        return -1;
+    }
+
+    long long written = 0;
+    bool failed = writeTraceHeader(file, trace_path) != 0;
+    size_t count;
+    while (!failed && (count = readChunk(log)) > 0) {
+        if (fwrite(log->records, sizeof(TraceRecord), count, file) != count) {
+            fprintf(stderr, "ERROR: Failed to write %s\n", trace_path);
+            failed = true;
+        }
+        written += count;
+    }
+
+    if (fclose(file) != 0 && !failed) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", trace_path);
+        failed = true;
+    }
+    failed |= log->failed;
+    closeGoldenLog(log);
+    return failed ? -1 : written;
+}
+
+/**
+ * Read a byte of the CPU address space without side effects, for showing an
+ * instruction's bytes (memory-mapped registers read as 0)
+ *
+ * @param bus - The bus
+ * @param addr - The address to read
+ *
+ * @returns The byte at the address
+ */
+static uint8_t peekByte(const Bus* bus, uint16_t addr) {
+    const uint8_t* page = bus->read_pages[addr >> 8];
+    return page != NULL ? page[addr & 0xFF] : 0;
+}
+
+/**
+ * Fill in a record's instruction bytes from memory
+ *
+ * @param bus - The bus
+ * @param record - The record (with its PC set)
+ */
+static void peekInstruction(const Bus* bus, TraceRecord* record) {
+    record->opcode = peekByte(bus, record->pc);
+    record->operands[0] = peekByte(bus, record->pc + 1);
+    record->operands[1] = peekByte(bus, record->pc + 2);
+}
+
+/**
+ * Record the CPU's state before its next instruction
+ *
+ * @param emu - The emulator
+ * @param record - Set to the state
+ */
+static void recordState(Emulator* emu, TraceRecord* record) {
+    Processor* processor = &emu->processor;
+    syncFlags(processor);
+
+    memset(record, 0, sizeof(TraceRecord));
+    record->cycles = emu->cycles;
+    record->pc = processor->PC;
+    record->a = processor->A;
+    record->x = processor->X;
+    record->y = processor->Y;
+    record->p = processor->P;
+    record->s = processor->S;
+    peekInstruction(emu->bus, record);
+}
+
+/**
+ * Start the CPU out in the state of a log's first record. The cycle count is
+ * only moved forward, since the PPU and APU have already been run up to it.
+ *
+ * @param emu - The emulator
+ * @param record - The first record
+ */
+static void seedState(Emulator* emu, const TraceRecord* record) {
+    Processor* processor = &emu->processor;
+    processor->PC = record->pc;
+    processor->A = record->a;
+    processor->X = record->x;
+    processor->Y = record->y;
+    processor->P = record->p | FLAG_U;
+    processor->S = record->s;
+    processor->flags_lazy = false;
+
+    if (record->cycles > emu->cycles) {
+        emu->cycles = record->cycles;
+    }
+}
+
+/**
+ * Compare the state in two records
+ *
+ * @param expected - The record from the golden log
+ * @param actual - The emulator's record
+ *
+ * @returns true if the PC, registers, P (apart from B) and cycle count match
+ */
+static bool recordsMatch(const TraceRecord* expected, const TraceRecord* actual) {
+    return expected->pc == actual->pc && expected->a == actual->a && expected->x == actual->x &&
+           expected->y == actual->y && ((expected->p ^ actual->p) & GOLDEN_P_MASK) == 0 &&
+           expected->s == actual->s && expected->cycles == actual->cycles;
+}
+
+/**
+ * Print the instructions leading up to a divergence, the expected and actual
+ * states, and what differs between them
+ *
+ * @param emu - The emulator
+ * @param log - The golden log
+ * @param context - The last GOLDEN_CONTEXT instructions that matched
+ * @param matched - The number of instructions that matched
+ * @param expected - The record from the golden log
+ * @param actual - The emulator's record
+ * @param format - How to print instructions
+ * @param out - Where to print
+ */
+static void printDivergence(const Emulator* emu, const GoldenLog* log, const TraceRecord* context,
+                            uint64_t matched, const TraceRecord* expected,
+                            const TraceRecord* actual, TraceFormat format, FILE* out) {
+    char line[TRACE_LINE_LENGTH];
+
+    fprintf(out, "Diverged from %s at instruction %llu:\n\n", log->path,
+            (unsigned long long)matched + 1);
+    uint64_t first = matched > GOLDEN_CONTEXT ? matched - GOLDEN_CONTEXT : 0;
+    for (uint64_t i = first; i < matched; i++) {
+        formatTraceRecord(&context[i % GOLDEN_CONTEXT], format, line);
+        fprintf(out, "  %s\n", line);
+    }
+
+    // Without bytes in the log, show what's in memory where it expected to be
+    TraceRecord shown = *expected;
+    if (!log->bytes) {
+        peekInstruction(emu->bus, &shown);
+    }
+    formatTraceRecord(&shown, format, line);
+    fprintf(out, "- %s\n", line);
+    formatTraceRecord(actual, format, line);
+    fprintf(out, "+ %s\n\n", line);
+
+    if (expected->pc != actual->pc) {
+        fprintf(out, "PC is $%04X, expected $%04X\n", actual->pc, expected->pc);
+    }
+    if (expected->a != actual->a) {
+        fprintf(out, "A is $%02X, expected $%02X\n", actual->a, expected->a);
+    }
+    if (expected->x != actual->x) {
+        fprintf(out, "X is $%02X, expected $%02X\n", actual->x, expected->x);
+    }
+    if (expected->y != actual->y) {
+        fprintf(out, "Y is $%02X, expected $%02X\n", actual->y, expected->y);
+    }
+    if ((expected->p ^ actual->p) & GOLDEN_P_MASK) {
+        fprintf(out, "P is $%02X, expected $%02X\n", actual->p, expected->p);
+    }
+    if (expected->s != actual->s) {
+        fprintf(out, "S is $%02X, expected $%02X\n", actual->s, expected->s);
+    }
+    if (expected->cycles != actual->cycles) {
+        fprintf(out, "The cycle count is %llu, expected %llu\n",
+                (unsigned long long)actual->cycles, (unsigned long long)expected->cycles);
+    }
+}
+
+/**
+ * Run an emulator one instruction at a time, checking the program counter,
+ * registers, P (apart from B, which only exists on the stack) and cycle count
+ * before each instruction against a golden log. The CPU starts out in the
+ * state of the log's first record (so nestest.log, which starts at $C000 for
+ * its automated mode, needs no setup of its own). It stops at the first
+ * instruction that doesn't match, printing the ones that led up to it.
+ *
+ * @param emu - The emulator
+ * @param golden_path - The golden log
+ * @param format - How to print instructions
+ * @param out - Where to print the result
+ *
+ * @returns The number of instructions that matched, if the whole log did
+ * @returns -1 if the emulator diverged from the log, or the log couldn't be read
+ */
+long long validateGolden(Emulator* emu, const char* golden_path, TraceFormat format, FILE* out) {
+    GoldenLog* log = openGoldenLog(golden_path);
+    if (log == NULL) {
+        return -1;
+    }
+
+    TraceRecord context[GOLDEN_CONTEXT];
+    TraceRecord actual;
+    uint64_t matched = 0;
+    bool diverged = false;
+
+    const TraceRecord* expected = goldenNext(log);
+    if (expected != NULL) {
+        seedState(emu, expected);
+    }
+
+    while (expected != NULL) {
+        if (emu->processor.halted) {
+            fprintf(out, "The CPU halted after %llu instructions, before the end of %s\n",
+                    (unsigned long long)matched, golden_path);
+            diverged = true;
+            break;
+        }
+
+        recordState(emu, &actual);
+        if (!recordsMatch(expected, &actual)) {
+            printDivergence(emu, log, context, matched, expected, &actual, format, out);
+            diverged = true;
+            break;
+        }
+
+        context[matched % GOLDEN_CONTEXT] = actual;
+        matched++;
+        emulatorStep(emu);
+        expected = goldenNext(log);
+    }
+
+    bool failed = diverged || log->failed;
+    if (!failed) {
+        fprintf(out, "Matched all %llu instructions of %s\n", (unsigned long long)matched,
+                golden_path);
+    }
+    closeGoldenLog(log);
+    return failed ? -1 : (long long)matched;
+}
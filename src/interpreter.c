@@ -0,0 +1,1378 @@
+#include "interpreter.h"
+
+#include "6502.h"
+#include "logger.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef THREADED_CORE
+
+// ---------- Memory and operand access ----------
+
+// A memory-mapped register sees the cycle count at the start of the instruction
+// touching it, as it would under executeInstruction, and touching one ends the
+// run after the instruction (see registerRead)
+#define READ(addr)         (coreRead(bus, addr, cycles, cycles_ptr, &cycle_limit))
+#define WRITE(addr, val)   (coreWrite(bus, addr, val, cycles, cycles_ptr, &cycle_limit))
+#define READ16(addr)       ((uint16_t)(READ(addr) | (READ((addr) + 1) << 8)))
+#define PUSH(val)          (WRITE(0x0100 + S--, val))
+#define PULL()             (READ(0x0100 + ++S))
+
+// The bytes of the current instruction. 'code' points straight into the host
+// memory behind the PC when the instruction sits inside a directly mapped page,
+// and at a copy read through the bus otherwise.
+#define OPERAND8  (code[1])
+#define OPERAND16 ((uint16_t)(code[1] | (code[2] << 8)))
+
+// Effective addresses, using the same arithmetic as executeInstruction. The indexed modes
+// record whether a page was crossed so that the cycle penalty can be applied.
+#define ADDR_ZP   (OPERAND8)
+#define ADDR_ZPX  ((uint16_t)(OPERAND8 + X))
+#define ADDR_ZPY  ((uint16_t)(OPERAND8 + Y))
+#define ADDR_ABS  (OPERAND16)
+#define ADDR_ABSX (indexAddr(OPERAND16, X, &crossed))
+#define ADDR_ABSY (indexAddr(OPERAND16, Y, &crossed))
+#define ADDR_INDX (READ16(OPERAND8 + X))
+#define ADDR_INDY (indexAddr(READ16(OPERAND8), Y, &crossed))
+
+// ---------- Flags ----------
+//
+// N, V, Z and C are evaluated lazily: handlers only save the values they come
+// from (in the same form as the lazy fields of Processor), and the bits of P
+// are only put together when something pushes P or the run ends.
+
+#define SET_NZ(val) (n_result = z_result = (val))
+
+#define FLAG_IS_SET_N (n_result & 0x80)
+#define FLAG_IS_SET_V (v_result & 0x80)
+#define FLAG_IS_SET_Z (z_result == 0)
+#define FLAG_IS_SET_C (c_result)
+
+#define PACK_P()                                                                  \
+    ((P & ~(FLAG_N | FLAG_V | FLAG_Z | FLAG_C)) | (n_result & 0x80) |             \
+     ((v_result & 0x80) >> 1) | (z_result == 0 ? FLAG_Z : 0) | c_result)
+
+#define UNPACK_P()                          \
+    do {                                    \
+        n_result = P & FLAG_N;              \
+        v_result = (P & FLAG_V) << 1;       \
+        z_result = !(P & FLAG_Z);           \
+        c_result = P & FLAG_C;              \
+    } while (0)
+
+// ---------- Operations ----------
+
+#define LOAD(reg, val)   \
+    do {                 \
+        (reg) = (val);   \
+        SET_NZ(reg);     \
+    } while (0)
+
+#define AND(val) LOAD(A, A & (val))
+#define EOR(val) LOAD(A, A ^ (val))
+#define ORA(val) LOAD(A, A | (val))
+
+#define ADC(val)                                                                \
+    do {                                                                        \
+        uint8_t operand = (val);                                                \
+        uint16_t sum = A + operand + c_result;                                  \
+        uint8_t result = sum & 0xFF;                                            \
+        c_result = sum > 0xFF;                                                  \
+        v_result = (A ^ result) & ~(A ^ operand);                               \
+        LOAD(A, result);                                                        \
+    } while (0)
+
+#define SBC(val)                                                                \
+    do {                                                                        \
+        uint8_t operand = (val);                                                \
+        int16_t diff = A - operand - (1 - c_result);                            \
+        uint8_t result = diff & 0xFF;                                           \
+        c_result = diff >= 0;                                                   \
+        v_result = (A ^ result) & (A ^ operand);                                \
+        LOAD(A, result);                                                        \
+    } while (0)
+
+#define COMPARE(reg, val)                        \
+    do {                                         \
+        int16_t diff = (reg) - (val);            \
+        c_result = diff >= 0;                    \
+        SET_NZ((uint8_t)(diff & 0xFF));          \
+    } while (0)
+
+// Z comes from A & M, while N and V are bits 7 and 6 of M itself
+#define BIT(val)                                 \
+    do {                                         \
+        uint8_t operand = (val);                 \
+        z_result = A & operand;                  \
+        n_result = operand;                      \
+        v_result = operand << 1;                 \
+    } while (0)
+
+// Read-modify-write operations work on an lvalue, either A or a temporary that
+// MODIFY writes back to memory
+#define MODIFY(addr, op)                 \
+    do {                                 \
+        uint16_t target = (addr);        \
+        uint8_t val = READ(target);      \
+        op(val);                         \
+        WRITE(target, val);              \
+    } while (0)
+
+#define ASL(val)                         \
+    do {                                 \
+        c_result = (val) >> 7;           \
+        (val) <<= 1;                     \
+        SET_NZ(val);                     \
+    } while (0)
+
+#define LSR(val)                         \
+    do {                                 \
+        c_result = (val) & 0x01;         \
+        (val) >>= 1;                     \
+        z_result = (val);                \
+    } while (0)
+
+// executeInstruction overwrites Z with bit 7 of the result, which is always 0
+#define LSR_MEMORY(val)                  \
+    do {                                 \
+        c_result = (val) & 0x01;         \
+        (val) >>= 1;                     \
+        z_result = 1;                    \
+    } while (0)
+
+#define ROL(val)                                     \
+    do {                                             \
+        uint8_t carry_in = c_result;                 \
+        c_result = (val) >> 7;                       \
+        (val) = ((val) << 1) | carry_in;             \
+        SET_NZ(val);                                 \
+    } while (0)
+
+#define ROR(val)                                     \
+    do {                                             \
+        uint8_t carry_in = c_result << 7;            \
+        c_result = (val) & 0x01;                     \
+        (val) = ((val) >> 1) | carry_in;             \
+        SET_NZ(val);                                 \
+    } while (0)
+
+// executeInstruction also copies the result of a memory ROR into A
+#define ROR_MEMORY(val) \
+    do {                \
+        ROR(val);       \
+        A = (val);      \
+    } while (0)
+
+#define INC(val)        \
+    do {                \
+        (val)++;        \
+        SET_NZ(val);    \
+    } while (0)
+
+#define DEC(val)        \
+    do {                \
+        (val)--;        \
+        SET_NZ(val);    \
+    } while (0)
+
+#define SLO(val)        \
+    do {                \
+        ASL(val);       \
+        ORA(val);       \
+    } while (0)
+
+// ---------- Dispatch ----------
+
+#define HANDLER(opcode) op_##opcode:
+
+#define DISPATCH()                                            \
+    do {                                                      \
+        if (PC == stop_pc || cycles >= cycle_limit) {         \
+            goto done;                                        \
+        }                                                     \
+        crossed = false;                                      \
+        count++;                                              \
+        code = fetchCode(bus, PC, fetched);                   \
+        goto *dispatch_table[code[0]];                        \
+    } while (0)
+
+// Charge the cycles of the instruction that just finished. executeInstruction
+// forces the unused bit of P on after every instruction.
+#define ACCOUNT(opcode)                                                           \
+    do {                                                                          \
+        cycles += opcode_table[0x##opcode].cycles;                                \
+        cycles += crossed && opcode_table[0x##opcode].page_penalty;               \
+        P |= FLAG_U;                                                              \
+    } while (0)
+
+#define FINISH(opcode)   \
+    do {                 \
+        ACCOUNT(opcode); \
+        DISPATCH();      \
+    } while (0)
+
+#define NEXT(opcode)                                \
+    do {                                            \
+        PC += opcode_table[0x##opcode].length;      \
+        FINISH(opcode);                             \
+    } while (0)
+
+// Branches use the same target arithmetic and extra cycles as
+// executeInstruction/addAdditionalCycles
+#define BRANCH(cond, opcode)                                           \
+    do {                                                               \
+        uint16_t old_PC = PC;                                          \
+        if (cond) {                                                    \
+            int8_t offset = OPERAND8;                                  \
+            PC = (offset >= 0) ? PC + offset : PC + offset + 2;        \
+        } else {                                                       \
+            PC += 2;                                                   \
+        }                                                              \
+        if (PC != (uint16_t)(old_PC + 2)) {                            \
+            cycles++;                                                  \
+            cycles += (PC & 0xFF00) != (old_PC & 0xFF00);              \
+        }                                                              \
+        FINISH(opcode);                                                \
+    } while (0)
+
+/**
+ * Return a pointer to the (up to 3) bytes of the instruction at 'pc'
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param pc - The address of the instruction
+ * @param fetched - Where to copy the bytes if they can't be read in place
+ *
+ * @returns The bytes of the instruction
+ */
+static inline const uint8_t* fetchCode(const Bus* bus, uint16_t pc, uint8_t* fetched) {
+    const uint8_t* page = bus->read_pages[pc >> 8];
+    if (page != NULL && (pc & 0xFF) <= BUS_PAGE_SIZE - 3) {
+        return page + (pc & 0xFF);
+    }
+
+    fetched[0] = busRead(bus, pc);
+    fetched[1] = busRead(bus, pc + 1);
+    fetched[2] = busRead(bus, pc + 2);
+    return fetched;
+}
+
+/**
+ * Read a memory-mapped register. The registers' owners (the PPU, APU and
+ * mapper) catch up to the CPU's published cycle count before they answer, so
+ * it's stored first. The run then ends after the instruction, since touching a
+ * register can start DMA, raise an NMI or move the scheduler's deadline, which
+ * the caller deals with between runs.
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param addr - The address to read
+ * @param cycles - The cycle count at the start of the instruction
+ * @param clock - The caller's cycle count, set to 'cycles'
+ * @param cycle_limit - Set to 0, so the run stops before the next instruction
+ *
+ * @returns The byte read
+ */
+static inline uint8_t registerRead(const Bus* bus, uint16_t addr, uint64_t cycles,
+                                   uint64_t* clock, uint64_t* cycle_limit) {
+    *clock = cycles;
+    *cycle_limit = 0;
+    return bus->read_handlers[addr >> 8](bus->read_contexts[addr >> 8], addr);
+}
+
+/**
+ * Write a memory-mapped register (see registerRead)
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param addr - The address to write
+ * @param val - The byte to write
+ * @param cycles - The cycle count at the start of the instruction
+ * @param clock - The caller's cycle count, set to 'cycles'
+ * @param cycle_limit - Set to 0, so the run stops before the next instruction
+ */
+static inline void registerWrite(Bus* bus, uint16_t addr, uint8_t val, uint64_t cycles,
+                                 uint64_t* clock, uint64_t* cycle_limit) {
+    *clock = cycles;
+    *cycle_limit = 0;
+    bus->write_handlers[addr >> 8](bus->write_contexts[addr >> 8], addr, val);
+}
+
+/**
+ * Read a byte through the bus, the same as busRead apart from how registers
+ * are handled
+ *
+ * @returns The byte read
+ */
+static inline uint8_t coreRead(const Bus* bus, uint16_t addr, uint64_t cycles, uint64_t* clock,
+                               uint64_t* cycle_limit) {
+    const uint8_t* page = bus->read_pages[addr >> 8];
+    if (__builtin_expect(page != NULL, 1)) {
+        return page[addr & 0xFF];
+    }
+    return registerRead(bus, addr, cycles, clock, cycle_limit);
+}
+
+/**
+ * Write a byte through the bus, the same as busWrite apart from how registers
+ * are handled
+ */
+static inline void coreWrite(Bus* bus, uint16_t addr, uint8_t val, uint64_t cycles,
+                             uint64_t* clock, uint64_t* cycle_limit) {
+    uint8_t* page = bus->write_pages[addr >> 8];
+    if (__builtin_expect(page != NULL, 1)) {
+        page[addr & 0xFF] = val;
+        return;
+    }
+    registerWrite(bus, addr, val, cycles, clock, cycle_limit);
+}
+
+/**
+ * Add an index register to a base address and note if it crossed a page
+ *
+ * @param base - The unindexed address
+ * @param index - The value of the index register
+ * @param crossed - Set to true if the result is on a different page than base
+ *
+ * @returns The indexed address
+ */
+static inline uint16_t indexAddr(uint16_t base, uint8_t index, bool* crossed) {
+    uint16_t addr = base + index;
+    *crossed = (addr & 0xFF00) != (base & 0xFF00);
+    return addr;
+}
+
+/**
+ * Log the same warning that parseInstruction prints for an unknown opcode
+ *
+ * @param pc - The address of the opcode
+ * @param opcode - The unknown opcode
+ */
+static void warnIllegalOpcode(uint16_t pc, uint8_t opcode) {
+    LOG_LIMITED(COMP_CPU, LEVEL_WARNING, "$%04x: Invalid opcode 0x%02x", pc, opcode);
+}
+
+/**
+ * Run instructions starting at the processor's PC until it halts, the PC
+ * reaches 'stop_pc', the cycle count reaches 'cycle_limit', or an instruction
+ * touches a memory-mapped register
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles_ptr - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runInstructions(Bus* bus, Processor* processor, uint64_t* cycles_ptr,
+                         uint64_t cycle_limit, int32_t stop_pc) {
+    // Filled in at compile time, so that emulators on several threads can share it
+    static const void* const dispatch_table[256] = {
+        [0 ... 255] = &&op_illegal,
+        [0x69] = &&op_69,
+        [0x65] = &&op_65,
+        [0x75] = &&op_75,
+        [0x6D] = &&op_6D,
+        [0x7D] = &&op_7D,
+        [0x79] = &&op_79,
+        [0x61] = &&op_61,
+        [0x71] = &&op_71,
+        [0x29] = &&op_29,
+        [0x25] = &&op_25,
+        [0x35] = &&op_35,
+        [0x2D] = &&op_2D,
+        [0x3D] = &&op_3D,
+        [0x39] = &&op_39,
+        [0x21] = &&op_21,
+        [0x31] = &&op_31,
+        [0x0A] = &&op_0A,
+        [0x06] = &&op_06,
+        [0x16] = &&op_16,
+        [0x0E] = &&op_0E,
+        [0x1E] = &&op_1E,
+        [0x90] = &&op_90,
+        [0xB0] = &&op_B0,
+        [0xF0] = &&op_F0,
+        [0x24] = &&op_24,
+        [0x2C] = &&op_2C,
+        [0x30] = &&op_30,
+        [0xD0] = &&op_D0,
+        [0x10] = &&op_10,
+        [0x00] = &&op_00,
+        [0x50] = &&op_50,
+        [0x70] = &&op_70,
+        [0x18] = &&op_18,
+        [0xD8] = &&op_D8,
+        [0x58] = &&op_58,
+        [0xB8] = &&op_B8,
+        [0xC9] = &&op_C9,
+        [0xC5] = &&op_C5,
+        [0xD5] = &&op_D5,
+        [0xCD] = &&op_CD,
+        [0xDD] = &&op_DD,
+        [0xD9] = &&op_D9,
+        [0xC1] = &&op_C1,
+        [0xD1] = &&op_D1,
+        [0xE0] = &&op_E0,
+        [0xE4] = &&op_E4,
+        [0xEC] = &&op_EC,
+        [0xC0] = &&op_C0,
+        [0xC4] = &&op_C4,
+        [0xCC] = &&op_CC,
+        [0xC6] = &&op_C6,
+        [0xD6] = &&op_D6,
+        [0xCE] = &&op_CE,
+        [0xDE] = &&op_DE,
+        [0xCA] = &&op_CA,
+        [0x88] = &&op_88,
+        [0x49] = &&op_49,
+        [0x45] = &&op_45,
+        [0x55] = &&op_55,
+        [0x4D] = &&op_4D,
+        [0x5D] = &&op_5D,
+        [0x59] = &&op_59,
+        [0x41] = &&op_41,
+        [0x51] = &&op_51,
+        [0xE6] = &&op_E6,
+        [0xF6] = &&op_F6,
+        [0xEE] = &&op_EE,
+        [0xFE] = &&op_FE,
+        [0xE8] = &&op_E8,
+        [0xC8] = &&op_C8,
+        [0x4C] = &&op_4C,
+        [0x6C] = &&op_6C,
+        [0x20] = &&op_20,
+        [0xA9] = &&op_A9,
+        [0xA5] = &&op_A5,
+        [0xB5] = &&op_B5,
+        [0xAD] = &&op_AD,
+        [0xBD] = &&op_BD,
+        [0xB9] = &&op_B9,
+        [0xA1] = &&op_A1,
+        [0xB1] = &&op_B1,
+        [0xA2] = &&op_A2,
+        [0xA6] = &&op_A6,
+        [0xB6] = &&op_B6,
+        [0xAE] = &&op_AE,
+        [0xBE] = &&op_BE,
+        [0xA0] = &&op_A0,
+        [0xA4] = &&op_A4,
+        [0xB4] = &&op_B4,
+        [0xAC] = &&op_AC,
+        [0xBC] = &&op_BC,
+        [0x4A] = &&op_4A,
+        [0x46] = &&op_46,
+        [0x56] = &&op_56,
+        [0x4E] = &&op_4E,
+        [0x5E] = &&op_5E,
+        [0xEA] = &&op_EA,
+        [0x09] = &&op_09,
+        [0x05] = &&op_05,
+        [0x15] = &&op_15,
+        [0x0D] = &&op_0D,
+        [0x1D] = &&op_1D,
+        [0x19] = &&op_19,
+        [0x01] = &&op_01,
+        [0x11] = &&op_11,
+        [0x48] = &&op_48,
+        [0x08] = &&op_08,
+        [0x68] = &&op_68,
+        [0x28] = &&op_28,
+        [0x2A] = &&op_2A,
+        [0x26] = &&op_26,
+        [0x36] = &&op_36,
+        [0x2E] = &&op_2E,
+        [0x3E] = &&op_3E,
+        [0x6A] = &&op_6A,
+        [0x66] = &&op_66,
+        [0x76] = &&op_76,
+        [0x6E] = &&op_6E,
+        [0x7E] = &&op_7E,
+        [0x40] = &&op_40,
+        [0x60] = &&op_60,
+        [0xE9] = &&op_E9,
+        [0xE5] = &&op_E5,
+        [0xF5] = &&op_F5,
+        [0xED] = &&op_ED,
+        [0xFD] = &&op_FD,
+        [0xF9] = &&op_F9,
+        [0xE1] = &&op_E1,
+        [0xF1] = &&op_F1,
+        [0x38] = &&op_38,
+        [0xF8] = &&op_F8,
+        [0x78] = &&op_78,
+        [0x85] = &&op_85,
+        [0x95] = &&op_95,
+        [0x8D] = &&op_8D,
+        [0x9D] = &&op_9D,
+        [0x99] = &&op_99,
+        [0x81] = &&op_81,
+        [0x91] = &&op_91,
+        [0x86] = &&op_86,
+        [0x96] = &&op_96,
+        [0x8E] = &&op_8E,
+        [0x84] = &&op_84,
+        [0x94] = &&op_94,
+        [0x8C] = &&op_8C,
+        [0xAA] = &&op_AA,
+        [0xA8] = &&op_A8,
+        [0xBA] = &&op_BA,
+        [0x8A] = &&op_8A,
+        [0x9A] = &&op_9A,
+        [0x98] = &&op_98,
+        [0x1A] = &&op_1A,
+        [0x1C] = &&op_1C,
+        [0x1F] = &&op_1F,
+    };
+
+    if (processor->halted) {
+        return 0;
+    }
+
+    // Keep everything the handlers touch in locals so that it can live in
+    // host registers for the whole run
+    uint16_t PC = processor->PC;
+    uint8_t A = processor->A;
+    uint8_t X = processor->X;
+    uint8_t Y = processor->Y;
+    uint8_t S = processor->S;
+    uint8_t P = processor->P;
+    uint8_t n_result, z_result, c_result, v_result;
+    if (processor->flags_lazy) {
+        n_result = processor->n_result;
+        z_result = processor->z_result;
+        c_result = processor->c_result;
+        v_result = processor->v_result;
+    } else {
+        UNPACK_P();
+    }
+    uint64_t cycles = *cycles_ptr;
+    uint64_t count = 0;
+    bool crossed = false;
+    const uint8_t* code;
+    uint8_t fetched[3];
+
+    DISPATCH();
+
+    // ---------- ADC ----------
+    HANDLER(69) {
+        ADC(OPERAND8);
+        NEXT(69);
+    }
+    HANDLER(65) {
+        ADC(READ(ADDR_ZP));
+        NEXT(65);
+    }
+    HANDLER(75) {
+        ADC(READ(ADDR_ZPX));
+        NEXT(75);
+    }
+    HANDLER(6D) {
+        ADC(READ(ADDR_ABS));
+        NEXT(6D);
+    }
+    HANDLER(7D) {
+        ADC(READ(ADDR_ABSX));
+        NEXT(7D);
+    }
+    HANDLER(79) {
+        ADC(READ(ADDR_ABSY));
+        NEXT(79);
+    }
+    HANDLER(61) {
+        ADC(READ(ADDR_INDX));
+        NEXT(61);
+    }
+    HANDLER(71) {
+        ADC(READ(ADDR_INDY));
+        NEXT(71);
+    }
+
+    // ---------- AND ----------
+    HANDLER(29) {
+        AND(OPERAND8);
+        NEXT(29);
+    }
+    HANDLER(25) {
+        AND(READ(ADDR_ZP));
+        NEXT(25);
+    }
+    HANDLER(35) {
+        AND(READ(ADDR_ZPX));
+        NEXT(35);
+    }
+    HANDLER(2D) {
+        AND(READ(ADDR_ABS));
+        NEXT(2D);
+    }
+    HANDLER(3D) {
+        AND(READ(ADDR_ABSX));
+        NEXT(3D);
+    }
+    HANDLER(39) {
+        AND(READ(ADDR_ABSY));
+        NEXT(39);
+    }
+    HANDLER(21) {
+        AND(READ(ADDR_INDX));
+        NEXT(21);
+    }
+    HANDLER(31) {
+        AND(READ(ADDR_INDY));
+        NEXT(31);
+    }
+
+    // ---------- ASL ----------
+    HANDLER(0A) {
+        ASL(A);
+        NEXT(0A);
+    }
+    HANDLER(06) {
+        MODIFY(ADDR_ZP, ASL);
+        NEXT(06);
+    }
+    HANDLER(16) {
+        MODIFY(ADDR_ZPX, ASL);
+        NEXT(16);
+    }
+    HANDLER(0E) {
+        MODIFY(ADDR_ABS, ASL);
+        NEXT(0E);
+    }
+    HANDLER(1E) {
+        MODIFY(ADDR_ABSX, ASL);
+        NEXT(1E);
+    }
+
+    // ---------- BCC ----------
+    HANDLER(90) {
+        BRANCH(!FLAG_IS_SET_C, 90);
+    }
+
+    // ---------- BCS ----------
+    HANDLER(B0) {
+        BRANCH(FLAG_IS_SET_C, B0);
+    }
+
+    // ---------- BEQ ----------
+    HANDLER(F0) {
+        BRANCH(FLAG_IS_SET_Z, F0);
+    }
+
+    // ---------- BIT ----------
+    HANDLER(24) {
+        BIT(READ(ADDR_ZP));
+        NEXT(24);
+    }
+    HANDLER(2C) {
+        BIT(READ(ADDR_ABS));
+        NEXT(2C);
+    }
+
+    // ---------- BMI ----------
+    HANDLER(30) {
+        BRANCH(FLAG_IS_SET_N, 30);
+    }
+
+    // ---------- BNE ----------
+    HANDLER(D0) {
+        BRANCH(!FLAG_IS_SET_Z, D0);
+    }
+
+    // ---------- BPL ----------
+    HANDLER(10) {
+        BRANCH(!FLAG_IS_SET_N, 10);
+    }
+
+    // ---------- BRK ----------
+    HANDLER(00) {
+        PUSH((PC >> 8) & 0xFF);
+        PUSH((PC + 2) & 0xFF);
+        P |= FLAG_B;
+        PUSH(PACK_P());
+
+        // A BRK without an IRQ vector is how test programs signal that they are done
+        PC = READ16(0xFFFE);
+        if (PC == 0x0000) {
+            processor->halted = true;
+        }
+
+        ACCOUNT(00);
+        if (processor->halted) {
+            goto done;
+        }
+        DISPATCH();
+    }
+
+    // ---------- BVC ----------
+    HANDLER(50) {
+        BRANCH(!FLAG_IS_SET_V, 50);
+    }
+
+    // ---------- BVS ----------
+    HANDLER(70) {
+        BRANCH(FLAG_IS_SET_V, 70);
+    }
+
+    // ---------- CLC ----------
+    HANDLER(18) {
+        c_result = 0;
+        NEXT(18);
+    }
+
+    // ---------- CLD ----------
+    HANDLER(D8) {
+        P &= ~FLAG_D;
+        NEXT(D8);
+    }
+
+    // ---------- CLI ----------
+    HANDLER(58) {
+        P &= ~FLAG_I;
+        NEXT(58);
+    }
+
+    // ---------- CLV ----------
+    HANDLER(B8) {
+        v_result = 0;
+        NEXT(B8);
+    }
+
+    // ---------- CMP ----------
+    HANDLER(C9) {
+        COMPARE(A, OPERAND8);
+        NEXT(C9);
+    }
+    HANDLER(C5) {
+        COMPARE(A, READ(ADDR_ZP));
+        NEXT(C5);
+    }
+    HANDLER(D5) {
+        COMPARE(A, READ(ADDR_ZPX));
+        NEXT(D5);
+    }
+    HANDLER(CD) {
+        COMPARE(A, READ(ADDR_ABS));
+        NEXT(CD);
+    }
+    HANDLER(DD) {
+        COMPARE(A, READ(ADDR_ABSX));
+        NEXT(DD);
+    }
+    HANDLER(D9) {
+        COMPARE(A, READ(ADDR_ABSY));
+        NEXT(D9);
+    }
+    HANDLER(C1) {
+        COMPARE(A, READ(ADDR_INDX));
+        NEXT(C1);
+    }
+    HANDLER(D1) {
+        COMPARE(A, READ(ADDR_INDY));
+        NEXT(D1);
+    }
+
+    // ---------- CPX ----------
+    HANDLER(E0) {
+        COMPARE(X, OPERAND8);
+        NEXT(E0);
+    }
+    HANDLER(E4) {
+        COMPARE(X, READ(ADDR_ZP));
+        NEXT(E4);
+    }
+    HANDLER(EC) {
+        COMPARE(X, READ(ADDR_ABS));
+        NEXT(EC);
+    }
+
+    // ---------- CPY ----------
+    HANDLER(C0) {
+        COMPARE(Y, OPERAND8);
+        NEXT(C0);
+    }
+    HANDLER(C4) {
+        COMPARE(Y, READ(ADDR_ZP));
+        NEXT(C4);
+    }
+    HANDLER(CC) {
+        COMPARE(Y, READ(ADDR_ABS));
+        NEXT(CC);
+    }
+
+    // ---------- DEC ----------
+    HANDLER(C6) {
+        MODIFY(ADDR_ZP, DEC);
+        NEXT(C6);
+    }
+    HANDLER(D6) {
+        MODIFY(ADDR_ZPX, DEC);
+        NEXT(D6);
+    }
+    HANDLER(CE) {
+        MODIFY(ADDR_ABS, DEC);
+        NEXT(CE);
+    }
+    HANDLER(DE) {
+        MODIFY(ADDR_ABSX, DEC);
+        NEXT(DE);
+    }
+
+    // ---------- DEX ----------
+    HANDLER(CA) {
+        X--;
+        SET_NZ(X);
+        NEXT(CA);
+    }
+
+    // ---------- DEY ----------
+    HANDLER(88) {
+        Y--;
+        SET_NZ(Y);
+        NEXT(88);
+    }
+
+    // ---------- EOR ----------
+    HANDLER(49) {
+        EOR(OPERAND8);
+        NEXT(49);
+    }
+    HANDLER(45) {
+        EOR(READ(ADDR_ZP));
+        NEXT(45);
+    }
+    HANDLER(55) {
+        EOR(READ(ADDR_ZPX));
+        NEXT(55);
+    }
+    HANDLER(4D) {
+        EOR(READ(ADDR_ABS));
+        NEXT(4D);
+    }
+    HANDLER(5D) {
+        EOR(READ(ADDR_ABSX));
+        NEXT(5D);
+    }
+    HANDLER(59) {
+        EOR(READ(ADDR_ABSY));
+        NEXT(59);
+    }
+    HANDLER(41) {
+        EOR(READ(ADDR_INDX));
+        NEXT(41);
+    }
+    HANDLER(51) {
+        EOR(READ(ADDR_INDY));
+        NEXT(51);
+    }
+
+    // ---------- INC ----------
+    HANDLER(E6) {
+        MODIFY(ADDR_ZP, INC);
+        NEXT(E6);
+    }
+    HANDLER(F6) {
+        MODIFY(ADDR_ZPX, INC);
+        NEXT(F6);
+    }
+    HANDLER(EE) {
+        MODIFY(ADDR_ABS, INC);
+        NEXT(EE);
+    }
+    HANDLER(FE) {
+        MODIFY(ADDR_ABSX, INC);
+        NEXT(FE);
+    }
+
+    // ---------- INX ----------
+    HANDLER(E8) {
+        X++;
+        SET_NZ(X);
+        NEXT(E8);
+    }
+
+    // ---------- INY ----------
+    HANDLER(C8) {
+        Y++;
+        SET_NZ(Y);
+        NEXT(C8);
+    }
+
+    // ---------- JMP ----------
+    HANDLER(4C) {
+        PC = OPERAND16;
+        FINISH(4C);
+    }
+    HANDLER(6C) {
+        PC = READ16(OPERAND16);
+        FINISH(6C);
+    }
+
+    // ---------- JSR ----------
+    HANDLER(20) {
+        PUSH((PC >> 8) & 0xFF);
+        PUSH((PC + 2) & 0xFF);
+        PC = OPERAND16;
+        FINISH(20);
+    }
+
+    // ---------- LDA ----------
+    HANDLER(A9) {
+        LOAD(A, OPERAND8);
+        NEXT(A9);
+    }
+    HANDLER(A5) {
+        LOAD(A, READ(ADDR_ZP));
+        NEXT(A5);
+    }
+    HANDLER(B5) {
+        LOAD(A, READ(ADDR_ZPX));
+        NEXT(B5);
+    }
+    HANDLER(AD) {
+        LOAD(A, READ(ADDR_ABS));
+        NEXT(AD);
+    }
+    HANDLER(BD) {
+        LOAD(A, READ(ADDR_ABSX));
+        NEXT(BD);
+    }
+    HANDLER(B9) {
+        LOAD(A, READ(ADDR_ABSY));
+        NEXT(B9);
+    }
+    HANDLER(A1) {
+        LOAD(A, READ(ADDR_INDX));
+        NEXT(A1);
+    }
+    HANDLER(B1) {
+        LOAD(A, READ(ADDR_INDY));
+        NEXT(B1);
+    }
+
+    // ---------- LDX ----------
+    HANDLER(A2) {
+        LOAD(X, OPERAND8);
+        NEXT(A2);
+    }
+    HANDLER(A6) {
+        LOAD(X, READ(ADDR_ZP));
+        NEXT(A6);
+    }
+    HANDLER(B6) {
+        LOAD(X, READ(ADDR_ZPY));
+        NEXT(B6);
+    }
+    HANDLER(AE) {
+        LOAD(X, READ(ADDR_ABS));
+        NEXT(AE);
+    }
+    HANDLER(BE) {
+        LOAD(X, READ(ADDR_ABSY));
+        NEXT(BE);
+    }
+
+    // ---------- LDY ----------
+    HANDLER(A0) {
+        LOAD(Y, OPERAND8);
+        NEXT(A0);
+    }
+    HANDLER(A4) {
+        LOAD(Y, READ(ADDR_ZP));
+        NEXT(A4);
+    }
+    HANDLER(B4) {
+        LOAD(Y, READ(ADDR_ZPX));
+        NEXT(B4);
+    }
+    HANDLER(AC) {
+        LOAD(Y, READ(ADDR_ABS));
+        NEXT(AC);
+    }
+    HANDLER(BC) {
+        LOAD(Y, READ(ADDR_ABSX));
+        NEXT(BC);
+    }
+
+    // ---------- LSR ----------
+    HANDLER(4A) {
+        LSR(A);
+        NEXT(4A);
+    }
+    HANDLER(46) {
+        MODIFY(ADDR_ZP, LSR_MEMORY);
+        NEXT(46);
+    }
+    HANDLER(56) {
+        MODIFY(ADDR_ZPX, LSR_MEMORY);
+        NEXT(56);
+    }
+    HANDLER(4E) {
+        MODIFY(ADDR_ABS, LSR_MEMORY);
+        NEXT(4E);
+    }
+    HANDLER(5E) {
+        MODIFY(ADDR_ABSX, LSR_MEMORY);
+        NEXT(5E);
+    }
+
+    // ---------- NOP ----------
+    HANDLER(EA) {
+        NEXT(EA);
+    }
+
+    // ---------- ORA ----------
+    HANDLER(09) {
+        ORA(OPERAND8);
+        NEXT(09);
+    }
+    HANDLER(05) {
+        ORA(READ(ADDR_ZP));
+        NEXT(05);
+    }
+    HANDLER(15) {
+        ORA(READ(ADDR_ZPX));
+        NEXT(15);
+    }
+    HANDLER(0D) {
+        ORA(READ(ADDR_ABS));
+        NEXT(0D);
+    }
+    HANDLER(1D) {
+        ORA(READ(ADDR_ABSX));
+        NEXT(1D);
+    }
+    HANDLER(19) {
+        ORA(READ(ADDR_ABSY));
+        NEXT(19);
+    }
+    HANDLER(01) {
+        ORA(READ(ADDR_INDX));
+        NEXT(01);
+    }
+    HANDLER(11) {
+        ORA(READ(ADDR_INDY));
+        NEXT(11);
+    }
+
+    // ---------- PHA ----------
+    HANDLER(48) {
+        PUSH(A);
+        NEXT(48);
+    }
+
+    // ---------- PHP ----------
+    HANDLER(08) {
+        PUSH(PACK_P());
+        NEXT(08);
+    }
+
+    // ---------- PLA ----------
+    HANDLER(68) {
+        LOAD(A, PULL());
+        NEXT(68);
+    }
+
+    // ---------- PLP ----------
+    HANDLER(28) {
+        P = PULL();
+        UNPACK_P();
+        NEXT(28);
+    }
+
+    // ---------- ROL ----------
+    HANDLER(2A) {
+        ROL(A);
+        NEXT(2A);
+    }
+    HANDLER(26) {
+        MODIFY(ADDR_ZP, ROL);
+        NEXT(26);
+    }
+    HANDLER(36) {
+        MODIFY(ADDR_ZPX, ROL);
+        NEXT(36);
+    }
+    HANDLER(2E) {
+        MODIFY(ADDR_ABS, ROL);
+        NEXT(2E);
+    }
+    HANDLER(3E) {
+        MODIFY(ADDR_ABSX, ROL);
+        NEXT(3E);
+    }
+
+    // ---------- ROR ----------
+    HANDLER(6A) {
+        ROR(A);
+        NEXT(6A);
+    }
+    HANDLER(66) {
+        MODIFY(ADDR_ZP, ROR_MEMORY);
+        NEXT(66);
+    }
+    HANDLER(76) {
+        MODIFY(ADDR_ZPX, ROR_MEMORY);
+        NEXT(76);
+    }
+    HANDLER(6E) {
+        MODIFY(ADDR_ABS, ROR_MEMORY);
+        NEXT(6E);
+    }
+    HANDLER(7E) {
+        MODIFY(ADDR_ABSX, ROR_MEMORY);
+        NEXT(7E);
+    }
+
+    // ---------- RTI ----------
+    HANDLER(40) {
+        P = PULL();
+        UNPACK_P();
+        PC = PULL();
+        PC |= PULL() << 8;
+        FINISH(40);
+    }
+
+    // ---------- RTS ----------
+    HANDLER(60) {
+        PC = PULL();
+        PC |= PULL() << 8;
+        PC++;
+        FINISH(60);
+    }
+
+    // ---------- SBC ----------
+    HANDLER(E9) {
+        SBC(OPERAND8);
+        NEXT(E9);
+    }
+    HANDLER(E5) {
+        SBC(READ(ADDR_ZP));
+        NEXT(E5);
+    }
+    HANDLER(F5) {
+        SBC(READ(ADDR_ZPX));
+        NEXT(F5);
+    }
+    HANDLER(ED) {
+        SBC(READ(ADDR_ABS));
+        NEXT(ED);
+    }
+    HANDLER(FD) {
+        SBC(READ(ADDR_ABSX));
+        NEXT(FD);
+    }
+    HANDLER(F9) {
+        SBC(READ(ADDR_ABSY));
+        NEXT(F9);
+    }
+    HANDLER(E1) {
+        SBC(READ(ADDR_INDX));
+        NEXT(E1);
+    }
+    HANDLER(F1) {
+        SBC(READ(ADDR_INDY));
+        NEXT(F1);
+    }
+
+    // ---------- SEC ----------
+    HANDLER(38) {
+        c_result = 1;
+        NEXT(38);
+    }
+
+    // ---------- SED ----------
+    HANDLER(F8) {
+        P |= FLAG_D;
+        NEXT(F8);
+    }
+
+    // ---------- SEI ----------
+    HANDLER(78) {
+        P |= FLAG_I;
+        NEXT(78);
+    }
+
+    // ---------- STA ----------
+    HANDLER(85) {
+        WRITE(ADDR_ZP, A);
+        NEXT(85);
+    }
+    HANDLER(95) {
+        WRITE(ADDR_ZPX, A);
+        NEXT(95);
+    }
+    HANDLER(8D) {
+        WRITE(ADDR_ABS, A);
+        NEXT(8D);
+    }
+    HANDLER(9D) {
+        WRITE(ADDR_ABSX, A);
+        NEXT(9D);
+    }
+    HANDLER(99) {
+        WRITE(ADDR_ABSY, A);
+        NEXT(99);
+    }
+    HANDLER(81) {
+        WRITE(ADDR_INDX, A);
+        NEXT(81);
+    }
+    HANDLER(91) {
+        WRITE(ADDR_INDY, A);
+        NEXT(91);
+    }
+
+    // ---------- STX ----------
+    HANDLER(86) {
+        WRITE(ADDR_ZP, X);
+        NEXT(86);
+    }
+    HANDLER(96) {
+        WRITE(ADDR_ZPY, X);
+        NEXT(96);
+    }
+    HANDLER(8E) {
+        WRITE(ADDR_ABS, X);
+        NEXT(8E);
+    }
+
+    // ---------- STY ----------
+    HANDLER(84) {
+        WRITE(ADDR_ZP, Y);
+        NEXT(84);
+    }
+    HANDLER(94) {
+        WRITE(ADDR_ZPX, Y);
+        NEXT(94);
+    }
+    HANDLER(8C) {
+        WRITE(ADDR_ABS, Y);
+        NEXT(8C);
+    }
+
+    // ---------- TAX ----------
+    HANDLER(AA) {
+        LOAD(X, A);
+        NEXT(AA);
+    }
+
+    // ---------- TAY ----------
+    HANDLER(A8) {
+        LOAD(Y, A);
+        NEXT(A8);
+    }
+
+    // ---------- TSX ----------
+    HANDLER(BA) {
+        LOAD(X, S);
+        NEXT(BA);
+    }
+
+    // ---------- TXA ----------
+    HANDLER(8A) {
+        LOAD(A, X);
+        NEXT(8A);
+    }
+
+    // ---------- TXS ----------
+    HANDLER(9A) {
+        S = X;
+        NEXT(9A);
+    }
+
+    // ---------- TYA ----------
+    HANDLER(98) {
+        LOAD(A, Y);
+        NEXT(98);
+    }
+
+    // ---------- NOP ($1A) ----------
+    HANDLER(1A) {
+        NEXT(1A);
+    }
+
+    // ---------- NOP ($1C) ----------
+    HANDLER(1C) {
+        // Only reads its operand, but still pays the page crossing penalty
+        (void)READ(ADDR_ABSX);
+        NEXT(1C);
+    }
+
+    // ---------- SLO ----------
+    HANDLER(1F) {
+        MODIFY(ADDR_ABSX, SLO);
+        NEXT(1F);
+    }
+
+
+    // ---------- Unknown opcodes ----------
+op_illegal:
+    warnIllegalOpcode(PC, code[0]);
+    PC++;
+    P |= FLAG_U;
+    DISPATCH();
+
+done:
+    processor->PC = PC;
+    processor->A = A;
+    processor->X = X;
+    processor->Y = Y;
+    processor->S = S;
+    processor->P = P;
+    *cycles_ptr = cycles;
+
+    // Leave the flags lazy, whoever looks at P next calls syncFlags
+    processor->flags_lazy = true;
+    processor->n_result = n_result;
+    processor->z_result = z_result;
+    processor->c_result = c_result;
+    processor->v_result = v_result;
+
+    return count;
+}
+
+#else
+
+/**
+ * Run instructions starting at the processor's PC until it halts, the PC
+ * reaches 'stop_pc', or the cycle count reaches 'cycle_limit'. Only one
+ * instruction is run on a bus with memory-mapped registers.
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runInstructions(Bus* bus, Processor* processor, uint64_t* cycles,
+                         uint64_t cycle_limit, int32_t stop_pc) {
+    uint64_t count = 0;
+
+    // executeInstruction doesn't say which pages it touched, so on a bus with
+    // memory-mapped registers only one instruction is run, the same as touching
+    // a register ends the threaded core's run
+    if (busFlatMemory(bus) == NULL && cycle_limit > *cycles + 1) {
+        cycle_limit = *cycles + 1;
+    }
+
+    while (!processor->halted && processor->PC != stop_pc && *cycles < cycle_limit) {
+        uint16_t old_PC = processor->PC;
+
+        Instruction instr = parseInstruction(bus, processor->PC);
+        executeInstruction(instr, bus, processor);
+        processor->PC += instr.length;
+
+        addAdditionalCycles(&instr, bus, processor, old_PC);
+        *cycles += instr.cycles;
+        count++;
+    }
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,1493 @@
+#include "jit.h"
+
+#include "6502.h"
+#include "interpreter.h"
+#include "logger.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+
+#include <sys/mman.h>
+
+// Why a compiled block stopped before its end
+typedef enum {
+    EXIT_NONE,
+    EXIT_SMC,        // It wrote to cached code
+    EXIT_REGISTERS,  // The next instruction touches a page with handlers
+} ExitReason;
+
+// Everything a compiled block reads and writes, passed to it in rdi
+typedef struct {
+    const Bus* bus;
+    uint8_t* code_map;
+    uint32_t cycles;      // Cycles used by the block
+    uint32_t executed;    // Instructions executed by the block
+    uint32_t write_addr;  // Address of the store that hit cached code (for EXIT_SMC)
+    uint16_t PC;
+    uint8_t A;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t S;
+    uint8_t P;
+    uint8_t reason;  // Why the block stopped early (an ExitReason)
+} JitContext;
+
+typedef void (*NativeBlock)(JitContext* ctx);
+
+// ---------- x86-64 encoding ----------
+//
+// While a block runs, the 6502 registers live in callee-saved host registers
+// and rbx/r9 hold the bus and the block cache's code map. Memory is reached
+// through the bus's page pointers, with r10/r11 holding the page and the offset
+// into it. eax, ecx, edx and esi are scratch, and r8d counts the cycles used by
+// page crossings (every other cycle is known when the block is compiled).
+
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RBP = 5, RSI = 6, RDI = 7, R8 = 8, R9 = 9 };
+enum { R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+#define REG_A        R12
+#define REG_X        R13
+#define REG_Y        R14
+#define REG_P        R15
+#define REG_S        RBP
+#define REG_BUS      RBX
+#define REG_CODE_MAP R9
+#define REG_CYCLES   R8
+#define REG_PAGE     R10
+#define REG_OFFSET   R11
+
+// Opcodes of the "op r/m32, r32" forms
+#define OP_ADD 0x01
+#define OP_OR  0x09
+#define OP_AND 0x21
+#define OP_SUB 0x29
+#define OP_XOR 0x31
+#define OP_MOV 0x89
+
+// Opcode extensions of the "op r/m32, imm" and shift forms
+#define EXT_ADD 0
+#define EXT_OR  1
+#define EXT_AND 4
+#define EXT_SUB 5
+#define EXT_XOR 6
+#define EXT_SHL 4
+#define EXT_SHR 5
+
+// Condition codes
+#define CC_E  0x4
+#define CC_NE 0x5
+
+typedef struct {
+    uint8_t* buf;
+    size_t len;
+    size_t cap;
+    bool full;  // Ran out of space, the code is incomplete
+} Emitter;
+
+#define EXIT_MAX_JUMPS (4)  // Most jumps one instruction makes to the same exit
+
+// An exit from the block that is emitted after the main body. It either leaves
+// after a store that hit cached code, or before an instruction that would
+// touch a page with handlers (so the interpreter can run it instead).
+typedef struct {
+    size_t patches[EXIT_MAX_JUMPS];  // Positions of the rel32s of the jumps to the exit
+    int jumps;
+    uint16_t pc;
+    uint32_t cycles;
+    uint32_t executed;
+    ExitReason reason;
+} PendingExit;
+
+static void emit8(Emitter* e, uint8_t byte) {
+    if (e->len < e->cap) {
+        e->buf[e->len++] = byte;
+    } else {
+        e->full = true;
+    }
+}
+
+static void emit16(Emitter* e, uint16_t val) {
+    emit8(e, val & 0xFF);
+    emit8(e, val >> 8);
+}
+
+static void emit32(Emitter* e, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+        emit8(e, (val >> (i * 8)) & 0xFF);
+    }
+}
+
+/**
+ * Emit a REX prefix if any of the registers need one. 'byte_reg' forces it so
+ * that registers 4-7 are spl/bpl/sil/dil rather than ah/ch/dh/bh.
+ */
+static void emitRex(Emitter* e, bool wide, int reg, int index, int base, bool byte_reg) {
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((index & 8) ? 0x02 : 0) |
+                  ((base & 8) ? 0x01 : 0);
+    if (rex != 0x40 || byte_reg) {
+        emit8(e, rex);
+    }
+}
+
+static void emitModRM(Emitter* e, int mod, int reg, int rm) {
+    emit8(e, (mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op dst, src
+static void emitOpRR(Emitter* e, uint8_t op, int dst, int src) {
+    emitRex(e, false, src, 0, dst, false);
+    emit8(e, op);
+    emitModRM(e, 3, src, dst);
+}
+
+// op dst, imm
+static void emitOpRI(Emitter* e, int ext, int dst, int32_t imm) {
+    emitRex(e, false, 0, 0, dst, false);
+    if (imm >= -128 && imm <= 127) {
+        emit8(e, 0x83);
+        emitModRM(e, 3, ext, dst);
+        emit8(e, (uint8_t)imm);
+    } else {
+        emit8(e, 0x81);
+        emitModRM(e, 3, ext, dst);
+        emit32(e, (uint32_t)imm);
+    }
+}
+
+// mov dst, imm
+static void emitMovRI(Emitter* e, int dst, uint32_t imm) {
+    emitRex(e, false, 0, 0, dst, false);
+    emit8(e, 0xB8 + (dst & 7));
+    emit32(e, imm);
+}
+
+// shl/shr dst, count
+static void emitShiftRI(Emitter* e, int ext, int dst, uint8_t count) {
+    emitRex(e, false, 0, 0, dst, false);
+    emit8(e, 0xC1);
+    emitModRM(e, 3, ext, dst);
+    emit8(e, count);
+}
+
+// not dst
+static void emitNot(Emitter* e, int dst) {
+    emitRex(e, false, 0, 0, dst, false);
+    emit8(e, 0xF7);
+    emitModRM(e, 3, 2, dst);
+}
+
+// setcc dst8; movzx dst, dst8
+static void emitSetcc(Emitter* e, int cc, int dst) {
+    emitRex(e, false, 0, 0, dst, dst >= 4);
+    emit8(e, 0x0F);
+    emit8(e, 0x90 + cc);
+    emitModRM(e, 3, 0, dst);
+
+    emitRex(e, false, dst, 0, dst, dst >= 4);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emitModRM(e, 3, dst, dst);
+}
+
+// mov dst, qword [rbx + index * 8 + disp]
+static void emitLoadPagePointer(Emitter* e, int dst, int index, uint32_t disp) {
+    emitRex(e, true, dst, index, REG_BUS, false);
+    emit8(e, 0x8B);
+    emitModRM(e, disp ? 2 : 0, dst, 4);
+    emit8(e, (3 << 6) | ((index & 7) << 3) | (REG_BUS & 7));
+    if (disp) {
+        emit32(e, disp);
+    }
+}
+
+// test reg, reg (all 64 bits)
+static void emitTest64(Emitter* e, int reg) {
+    emitRex(e, true, reg, 0, reg, false);
+    emit8(e, 0x85);
+    emitModRM(e, 3, reg, reg);
+}
+
+// movzx dst, byte [r10 + r11]
+static void emitLoadPage(Emitter* e, int dst) {
+    emitRex(e, false, dst, REG_OFFSET, REG_PAGE, false);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emitModRM(e, 0, dst, 4);
+    emit8(e, ((REG_OFFSET & 7) << 3) | (REG_PAGE & 7));
+}
+
+// mov byte [r10 + r11], al
+static void emitStorePage(Emitter* e) {
+    emitRex(e, false, RAX, REG_OFFSET, REG_PAGE, false);
+    emit8(e, 0x88);
+    emitModRM(e, 0, RAX, 4);
+    emit8(e, ((REG_OFFSET & 7) << 3) | (REG_PAGE & 7));
+}
+
+// movzx dst, byte [rdi + disp]
+static void emitLoadContext8(Emitter* e, int dst, uint8_t disp) {
+    emitRex(e, false, dst, 0, RDI, false);
+    emit8(e, 0x0F);
+    emit8(e, 0xB6);
+    emitModRM(e, 1, dst, RDI);
+    emit8(e, disp);
+}
+
+// mov dst, qword [rdi + disp]
+static void emitLoadContext64(Emitter* e, int dst, uint8_t disp) {
+    emitRex(e, true, dst, 0, RDI, false);
+    emit8(e, 0x8B);
+    emitModRM(e, 1, dst, RDI);
+    emit8(e, disp);
+}
+
+// mov byte [rdi + disp], src8
+static void emitStoreContext8(Emitter* e, int src, uint8_t disp) {
+    emitRex(e, false, src, 0, RDI, src >= 4);
+    emit8(e, 0x88);
+    emitModRM(e, 1, src, RDI);
+    emit8(e, disp);
+}
+
+// mov dword [rdi + disp], src
+static void emitStoreContext32(Emitter* e, int src, uint8_t disp) {
+    emitRex(e, false, src, 0, RDI, false);
+    emit8(e, 0x89);
+    emitModRM(e, 1, src, RDI);
+    emit8(e, disp);
+}
+
+// mov dword [rdi + disp], imm
+static void emitStoreContextImm32(Emitter* e, uint8_t disp, uint32_t imm) {
+    emit8(e, 0xC7);
+    emitModRM(e, 1, 0, RDI);
+    emit8(e, disp);
+    emit32(e, imm);
+}
+
+// mov word [rdi + disp], imm
+static void emitStoreContextImm16(Emitter* e, uint8_t disp, uint16_t imm) {
+    emit8(e, 0x66);
+    emit8(e, 0xC7);
+    emitModRM(e, 1, 0, RDI);
+    emit8(e, disp);
+    emit16(e, imm);
+}
+
+static void emitPush(Emitter* e, int reg) {
+    emitRex(e, false, 0, 0, reg, false);
+    emit8(e, 0x50 + (reg & 7));
+}
+
+static void emitPop(Emitter* e, int reg) {
+    emitRex(e, false, 0, 0, reg, false);
+    emit8(e, 0x58 + (reg & 7));
+}
+
+/**
+ * Emit a conditional jump with a placeholder target
+ *
+ * @returns The position of the rel32 to patch with patchJump
+ */
+static size_t emitJcc(Emitter* e, int cc) {
+    emit8(e, 0x0F);
+    emit8(e, 0x80 + cc);
+    size_t patch = e->len;
+    emit32(e, 0);
+    return patch;
+}
+
+static void patchJump(Emitter* e, size_t patch) {
+    if (e->full) {
+        return;
+    }
+    int32_t rel = (int32_t)(e->len - (patch + 4));
+    memcpy(e->buf + patch, &rel, sizeof(rel));
+}
+
+// ---------- Guest memory ----------
+
+/**
+ * Point r10 at the host memory of the page holding the address ecx + 'disp',
+ * and r11 at the offset into it (clobbers nothing else). If the page has
+ * handlers rather than memory, jump to 'bail' instead, which leaves the block
+ * before the instruction so that the interpreter can run it.
+ */
+static void emitGuestPage(Emitter* e, bool write, uint8_t disp, PendingExit* bail) {
+    emitOpRR(e, OP_MOV, REG_OFFSET, RCX);
+    if (disp) {
+        emitOpRI(e, EXT_ADD, REG_OFFSET, disp);
+    }
+    emitOpRR(e, OP_MOV, REG_PAGE, REG_OFFSET);
+    emitShiftRI(e, EXT_SHR, REG_PAGE, 8);
+    emitLoadPagePointer(e, REG_PAGE, REG_PAGE,
+                        write ? offsetof(Bus, write_pages) : offsetof(Bus, read_pages));
+    emitTest64(e, REG_PAGE);
+    size_t patch = emitJcc(e, CC_E);
+    if (bail->jumps < EXIT_MAX_JUMPS) {
+        bail->patches[bail->jumps++] = patch;
+    } else {
+        e->full = true;  // Can't happen, but never leave a jump unpatched
+    }
+    emitOpRI(e, EXT_AND, REG_OFFSET, 0xFF);
+}
+
+// Load the byte at ecx + 'disp' into dst
+static void emitLoadGuest(Emitter* e, int dst, uint8_t disp, PendingExit* bail) {
+    emitGuestPage(e, false, disp, bail);
+    emitLoadPage(e, dst);
+}
+
+// Store al at ecx
+static void emitStoreGuest(Emitter* e, PendingExit* bail) {
+    emitGuestPage(e, true, 0, bail);
+    emitStorePage(e);
+}
+
+// ---------- Block structure ----------
+
+static void emitPrologue(Emitter* e) {
+    emitPush(e, RBX);
+    emitPush(e, RBP);
+    emitPush(e, R12);
+    emitPush(e, R13);
+    emitPush(e, R14);
+    emitPush(e, R15);
+
+    emitLoadContext64(e, REG_BUS, offsetof(JitContext, bus));
+    emitLoadContext64(e, REG_CODE_MAP, offsetof(JitContext, code_map));
+    emitLoadContext8(e, REG_A, offsetof(JitContext, A));
+    emitLoadContext8(e, REG_X, offsetof(JitContext, X));
+    emitLoadContext8(e, REG_Y, offsetof(JitContext, Y));
+    emitLoadContext8(e, REG_S, offsetof(JitContext, S));
+    emitLoadContext8(e, REG_P, offsetof(JitContext, P));
+    emitOpRR(e, OP_XOR, REG_CYCLES, REG_CYCLES);
+}
+
+/**
+ * Emit the code that leaves the block with the PC at 'pc'. 'cycles' and
+ * 'executed' count everything up to and including the last instruction run.
+ * For a self-modifying exit, ecx must still hold the address that was written.
+ */
+static void emitExit(Emitter* e, uint16_t pc, uint32_t cycles, uint32_t executed,
+                     ExitReason reason) {
+    emitStoreContextImm16(e, offsetof(JitContext, PC), pc);
+    emitStoreContextImm32(e, offsetof(JitContext, executed), executed);
+    emitOpRI(e, EXT_ADD, REG_CYCLES, cycles);
+    emitStoreContext32(e, REG_CYCLES, offsetof(JitContext, cycles));
+    if (reason == EXIT_SMC) {
+        emitStoreContext32(e, RCX, offsetof(JitContext, write_addr));
+    }
+    if (reason != EXIT_NONE) {
+        emit8(e, 0xC6);  // mov byte [rdi + disp], reason
+        emitModRM(e, 1, 0, RDI);
+        emit8(e, offsetof(JitContext, reason));
+        emit8(e, reason);
+    }
+
+    emitStoreContext8(e, REG_A, offsetof(JitContext, A));
+    emitStoreContext8(e, REG_X, offsetof(JitContext, X));
+    emitStoreContext8(e, REG_Y, offsetof(JitContext, Y));
+    emitStoreContext8(e, REG_S, offsetof(JitContext, S));
+    emitStoreContext8(e, REG_P, offsetof(JitContext, P));
+
+    emitPop(e, R15);
+    emitPop(e, R14);
+    emitPop(e, R13);
+    emitPop(e, R12);
+    emitPop(e, RBP);
+    emitPop(e, RBX);
+    emit8(e, 0xC3);  // ret
+}
+
+// ---------- Instruction building blocks ----------
+
+// Set N and Z from the byte in eax (clobbers edx)
+static void emitSetNZ(Emitter* e) {
+    emitOpRI(e, EXT_AND, REG_P, ~0x82);
+    emitOpRR(e, OP_MOV, RDX, RAX);
+    emitOpRI(e, EXT_AND, RDX, 0x80);
+    emitOpRR(e, OP_OR, REG_P, RDX);
+    emit8(e, 0x85);  // test eax, eax
+    emitModRM(e, 3, RAX, RAX);
+    emitSetcc(e, CC_E, RDX);
+    emitShiftRI(e, EXT_SHL, RDX, 1);
+    emitOpRR(e, OP_OR, REG_P, RDX);
+}
+
+// Set esi to 1 if ecx and 'base' are on different pages, and 0 otherwise
+static void emitPagePenalty(Emitter* e, int base_reg, uint32_t base_imm, bool use_reg) {
+    emitOpRR(e, OP_MOV, RSI, RCX);
+    if (use_reg) {
+        emitOpRR(e, OP_XOR, RSI, base_reg);
+    } else {
+        emitOpRI(e, EXT_XOR, RSI, base_imm);
+    }
+    emitOpRI(e, EXT_AND, RSI, 0xFF00);
+    emitSetcc(e, CC_NE, RSI);
+}
+
+/**
+ * Emit the effective address calculation of an instruction into ecx (clobbers
+ * eax, edx and esi). Indexed addresses wrap at $FFFF, the same as on the bus.
+ * A page crossing penalty is left in esi rather than counted, so that the
+ * instruction can still bail out before its access without having used any
+ * cycles.
+ *
+ * @returns true if esi holds a penalty to add to the cycle count
+ */
+static bool emitAddress(Emitter* e, const Instruction* instr, PendingExit* bail) {
+    bool penalty = opcode_table[instr->opcode].page_penalty;
+
+    switch (instr->addr_mode) {
+        case ZP:
+        case ABS:
+            emitMovRI(e, RCX, instr->addr);
+            break;
+        case ZPX:
+            emitOpRR(e, OP_MOV, RCX, REG_X);
+            emitOpRI(e, EXT_ADD, RCX, instr->addr);
+            break;
+        case ZPY:
+            emitOpRR(e, OP_MOV, RCX, REG_Y);
+            emitOpRI(e, EXT_ADD, RCX, instr->addr);
+            break;
+        case ABSX:
+        case ABSY:
+            emitOpRR(e, OP_MOV, RCX, instr->addr_mode == ABSX ? REG_X : REG_Y);
+            emitOpRI(e, EXT_ADD, RCX, instr->addr);
+            if (penalty) {
+                emitPagePenalty(e, 0, instr->addr, false);
+            }
+            emitOpRI(e, EXT_AND, RCX, 0xFFFF);
+            break;
+        case INDX:
+        case INDY:
+            if (instr->addr_mode == INDX) {
+                emitOpRR(e, OP_MOV, RCX, REG_X);
+                emitOpRI(e, EXT_ADD, RCX, instr->addr);
+            } else {
+                emitMovRI(e, RCX, instr->addr);
+            }
+            emitLoadGuest(e, RAX, 0, bail);
+            emitLoadGuest(e, RDX, 1, bail);
+            emitShiftRI(e, EXT_SHL, RDX, 8);
+            emitOpRR(e, OP_OR, RAX, RDX);
+            emitOpRR(e, OP_MOV, RCX, RAX);
+            if (instr->addr_mode == INDY) {
+                emitOpRR(e, OP_ADD, RCX, REG_Y);
+                if (penalty) {
+                    emitPagePenalty(e, RAX, 0, true);
+                }
+                emitOpRI(e, EXT_AND, RCX, 0xFFFF);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return penalty && (instr->addr_mode == ABSX || instr->addr_mode == ABSY ||
+                       instr->addr_mode == INDY);
+}
+
+// Count the page crossing penalty left in esi by emitAddress
+static void emitPenalty(Emitter* e, bool penalty) {
+    if (penalty) {
+        emitOpRR(e, OP_ADD, REG_CYCLES, RSI);
+    }
+}
+
+// Load the operand of an instruction into eax
+static void emitOperand(Emitter* e, const Instruction* instr, PendingExit* bail) {
+    if (instr->addr_mode == IMM) {
+        emitMovRI(e, RAX, instr->imm);
+    } else {
+        bool penalty = emitAddress(e, instr, bail);
+        emitLoadGuest(e, RAX, 0, bail);
+        emitPenalty(e, penalty);
+    }
+}
+
+// Push al onto the stack, leaving the address written in ecx
+static void emitPushAL(Emitter* e, PendingExit* bail) {
+    emitOpRR(e, OP_MOV, RCX, REG_S);
+    emitOpRI(e, EXT_ADD, RCX, 0x0100);
+    emitStoreGuest(e, bail);
+    emitOpRI(e, EXT_SUB, REG_S, 1);
+    emitOpRI(e, EXT_AND, REG_S, 0xFF);
+}
+
+// Pull the top of the stack into eax (S only moves once the load can't bail)
+static void emitPull(Emitter* e, PendingExit* bail) {
+    emitOpRR(e, OP_MOV, RCX, REG_S);
+    emitOpRI(e, EXT_ADD, RCX, 1);
+    emitOpRI(e, EXT_AND, RCX, 0xFF);
+    emitOpRI(e, EXT_ADD, RCX, 0x0100);
+    emitLoadGuest(e, RAX, 0, bail);
+    emitOpRR(e, OP_MOV, REG_S, RCX);
+    emitOpRI(e, EXT_AND, REG_S, 0xFF);
+}
+
+// Copy eax into a register and set N and Z from it
+static void emitLoadRegister(Emitter* e, int reg) {
+    emitOpRR(e, OP_MOV, reg, RAX);
+    emitSetNZ(e);
+}
+
+// Set C (and clear V) from the 9-bit sum or signed difference in eax
+static void emitCarry(Emitter* e, bool borrow) {
+    emitOpRR(e, OP_MOV, RCX, RAX);
+    if (borrow) {
+        emitShiftRI(e, EXT_SHR, RCX, 31);
+        emitOpRI(e, EXT_XOR, RCX, 1);
+    } else {
+        emitShiftRI(e, EXT_SHR, RCX, 8);
+    }
+    emitOpRR(e, OP_OR, REG_P, RCX);
+}
+
+// Set V from the result in eax and the operand in esi
+static void emitOverflow(Emitter* e, bool subtract) {
+    emitOpRR(e, OP_MOV, RCX, RAX);
+    emitOpRR(e, OP_XOR, RCX, REG_A);
+    emitOpRR(e, OP_MOV, RDX, RSI);
+    emitOpRR(e, OP_XOR, RDX, REG_A);
+    if (!subtract) {
+        emitNot(e, RDX);
+    }
+    emitOpRR(e, OP_AND, RCX, RDX);
+    emitOpRI(e, EXT_AND, RCX, 0x80);
+    emitShiftRI(e, EXT_SHR, RCX, 1);
+    emitOpRR(e, OP_OR, REG_P, RCX);
+}
+
+/**
+ * Check if the JIT knows how to compile the given instruction
+ *
+ * @param instr - The instruction to check
+ *
+ * @returns true if compileInstruction supports it
+ */
+static bool canCompile(const Instruction* instr) {
+    switch (opcode_table[instr->opcode].mnemonic) {
+        case LDA:
+        case LDX:
+        case LDY:
+        case STA:
+        case STX:
+        case STY:
+        case AND:
+        case ORA:
+        case EOR:
+        case ADC:
+        case SBC:
+        case CMP:
+        case CPX:
+        case CPY:
+        case INC:
+        case DEC:
+        case INX:
+        case INY:
+        case DEX:
+        case DEY:
+        case TAX:
+        case TAY:
+        case TSX:
+        case TXA:
+        case TXS:
+        case TYA:
+        case CLC:
+        case CLD:
+        case CLI:
+        case CLV:
+        case SEC:
+        case SED:
+        case SEI:
+        case PHA:
+        case PHP:
+        case PLA:
+        case PLP:
+        case BCC:
+        case BCS:
+        case BEQ:
+        case BMI:
+        case BNE:
+        case BPL:
+        case BVC:
+        case BVS:
+            return true;
+        case ASL:
+        case LSR:
+        case ROL:
+        case ROR:
+            return instr->addr_mode == ACCUM;
+        case JMP:
+            return instr->addr_mode == ABS;
+        case NOP:
+            return instr->addr_mode == IMPL;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Emit the code for a single instruction
+ *
+ * @param e - The emitter to write to
+ * @param instr - The instruction to compile
+ * @param pc - The address of the instruction
+ * @param cycles - Cycles used by the block before this instruction
+ * @param executed - Instructions executed by the block before this one
+ * @param bail - The exit taken if the instruction would touch a page with
+ *               handlers
+ *
+ * @returns true if the instruction stored to memory and needs a code check
+ */
+static bool compileInstruction(Emitter* e, const Instruction* instr, uint16_t pc, uint32_t cycles,
+                               uint32_t executed, PendingExit* bail) {
+    Mnemonic mnemonic = opcode_table[instr->opcode].mnemonic;
+    bool stored = false;
+
+    switch (mnemonic) {
+        case LDA:
+        case LDX:
+        case LDY:
+            emitOperand(e, instr, bail);
+            emitLoadRegister(e, mnemonic == LDA ? REG_A : (mnemonic == LDX ? REG_X : REG_Y));
+            break;
+        case STA:
+        case STX:
+        case STY: {
+            bool penalty = emitAddress(e, instr, bail);
+            emitOpRR(e, OP_MOV, RAX, mnemonic == STA ? REG_A : (mnemonic == STX ? REG_X : REG_Y));
+            emitStoreGuest(e, bail);
+            emitPenalty(e, penalty);
+            stored = true;
+            break;
+        }
+        case AND:
+        case ORA:
+        case EOR:
+            emitOperand(e, instr, bail);
+            emitOpRR(e, mnemonic == AND ? OP_AND : (mnemonic == ORA ? OP_OR : OP_XOR), RAX, REG_A);
+            emitLoadRegister(e, REG_A);
+            break;
+        case ADC:
+            emitOperand(e, instr, bail);
+            emitOpRR(e, OP_MOV, RSI, RAX);
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_ADD, RAX, RSI);
+            emitOpRR(e, OP_MOV, RCX, REG_P);
+            emitOpRI(e, EXT_AND, RCX, 0x01);
+            emitOpRR(e, OP_ADD, RAX, RCX);
+            emitOpRI(e, EXT_AND, REG_P, ~0x41);
+            emitCarry(e, false);
+            emitOverflow(e, false);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitLoadRegister(e, REG_A);
+            break;
+        case SBC:
+            emitOperand(e, instr, bail);
+            emitOpRR(e, OP_MOV, RSI, RAX);
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_SUB, RAX, RSI);
+            emitOpRR(e, OP_MOV, RCX, REG_P);
+            emitOpRI(e, EXT_AND, RCX, 0x01);
+            emitOpRI(e, EXT_XOR, RCX, 0x01);
+            emitOpRR(e, OP_SUB, RAX, RCX);
+            emitOpRI(e, EXT_AND, REG_P, ~0x41);
+            emitCarry(e, true);
+            emitOverflow(e, true);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitLoadRegister(e, REG_A);
+            break;
+        case CMP:
+        case CPX:
+        case CPY:
+            emitOperand(e, instr, bail);
+            emitOpRR(e, OP_MOV, RSI, RAX);
+            emitOpRR(e, OP_MOV, RAX, mnemonic == CMP ? REG_A : (mnemonic == CPX ? REG_X : REG_Y));
+            emitOpRR(e, OP_SUB, RAX, RSI);
+            emitOpRI(e, EXT_AND, REG_P, ~0x01);
+            emitCarry(e, true);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitSetNZ(e);
+            break;
+        case INC:
+        case DEC: {
+            // Both pages are checked before anything is written
+            bool penalty = emitAddress(e, instr, bail);
+            emitLoadGuest(e, RAX, 0, bail);
+            emitOpRI(e, mnemonic == INC ? EXT_ADD : EXT_SUB, RAX, 1);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitStoreGuest(e, bail);
+            emitPenalty(e, penalty);
+            emitSetNZ(e);
+            stored = true;
+            break;
+        }
+        case INX:
+        case INY:
+        case DEX:
+        case DEY: {
+            int reg = (mnemonic == INX || mnemonic == DEX) ? REG_X : REG_Y;
+            emitOpRR(e, OP_MOV, RAX, reg);
+            emitOpRI(e, (mnemonic == INX || mnemonic == INY) ? EXT_ADD : EXT_SUB, RAX, 1);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitLoadRegister(e, reg);
+            break;
+        }
+        case TAX:
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitLoadRegister(e, REG_X);
+            break;
+        case TAY:
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitLoadRegister(e, REG_Y);
+            break;
+        case TSX:
+            emitOpRR(e, OP_MOV, RAX, REG_S);
+            emitLoadRegister(e, REG_X);
+            break;
+        case TXA:
+            emitOpRR(e, OP_MOV, RAX, REG_X);
+            emitLoadRegister(e, REG_A);
+            break;
+        case TYA:
+            emitOpRR(e, OP_MOV, RAX, REG_Y);
+            emitLoadRegister(e, REG_A);
+            break;
+        case TXS:
+            emitOpRR(e, OP_MOV, REG_S, REG_X);
+            break;
+        case CLC:
+            emitOpRI(e, EXT_AND, REG_P, ~0x01);
+            break;
+        case CLD:
+            emitOpRI(e, EXT_AND, REG_P, ~0x08);
+            break;
+        case CLI:
+            emitOpRI(e, EXT_AND, REG_P, ~0x04);
+            break;
+        case CLV:
+            emitOpRI(e, EXT_AND, REG_P, ~0x40);
+            break;
+        case SEC:
+            emitOpRI(e, EXT_OR, REG_P, 0x01);
+            break;
+        case SED:
+            emitOpRI(e, EXT_OR, REG_P, 0x08);
+            break;
+        case SEI:
+            emitOpRI(e, EXT_OR, REG_P, 0x04);
+            break;
+        case PHA:
+        case PHP:
+            emitOpRR(e, OP_MOV, RAX, mnemonic == PHA ? REG_A : REG_P);
+            emitPushAL(e, bail);
+            stored = true;
+            break;
+        case PLA:
+            emitPull(e, bail);
+            emitLoadRegister(e, REG_A);
+            break;
+        case PLP:
+            emitPull(e, bail);
+            emitOpRR(e, OP_MOV, REG_P, RAX);
+            break;
+        case ASL:
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_MOV, RCX, RAX);
+            emitShiftRI(e, EXT_SHR, RCX, 7);
+            emitOpRI(e, EXT_AND, REG_P, ~0x01);
+            emitOpRR(e, OP_OR, REG_P, RCX);
+            emitShiftRI(e, EXT_SHL, RAX, 1);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitLoadRegister(e, REG_A);
+            break;
+        case LSR:
+            // Matches executeInstruction, which leaves N alone for LSR A
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_MOV, RCX, RAX);
+            emitOpRI(e, EXT_AND, RCX, 0x01);
+            emitOpRI(e, EXT_AND, REG_P, ~0x03);
+            emitOpRR(e, OP_OR, REG_P, RCX);
+            emitShiftRI(e, EXT_SHR, RAX, 1);
+            emitOpRR(e, OP_MOV, REG_A, RAX);
+            emit8(e, 0x85);  // test eax, eax
+            emitModRM(e, 3, RAX, RAX);
+            emitSetcc(e, CC_E, RDX);
+            emitShiftRI(e, EXT_SHL, RDX, 1);
+            emitOpRR(e, OP_OR, REG_P, RDX);
+            break;
+        case ROL:
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_MOV, RCX, REG_P);
+            emitOpRI(e, EXT_AND, RCX, 0x01);
+            emitOpRR(e, OP_MOV, RDX, RAX);
+            emitShiftRI(e, EXT_SHR, RDX, 7);
+            emitOpRI(e, EXT_AND, REG_P, ~0x01);
+            emitOpRR(e, OP_OR, REG_P, RDX);
+            emitShiftRI(e, EXT_SHL, RAX, 1);
+            emitOpRR(e, OP_OR, RAX, RCX);
+            emitOpRI(e, EXT_AND, RAX, 0xFF);
+            emitLoadRegister(e, REG_A);
+            break;
+        case ROR:
+            emitOpRR(e, OP_MOV, RAX, REG_A);
+            emitOpRR(e, OP_MOV, RCX, REG_P);
+            emitOpRI(e, EXT_AND, RCX, 0x01);
+            emitShiftRI(e, EXT_SHL, RCX, 7);
+            emitOpRR(e, OP_MOV, RDX, RAX);
+            emitOpRI(e, EXT_AND, RDX, 0x01);
+            emitOpRI(e, EXT_AND, REG_P, ~0x01);
+            emitOpRR(e, OP_OR, REG_P, RDX);
+            emitShiftRI(e, EXT_SHR, RAX, 1);
+            emitOpRR(e, OP_OR, RAX, RCX);
+            emitLoadRegister(e, REG_A);
+            break;
+        case NOP:
+            break;
+        case JMP:
+            emitOpRI(e, EXT_OR, REG_P, 0x20);
+            emitExit(e, instr->addr, cycles + instr->cycles, executed + 1, EXIT_NONE);
+            break;
+        case BCC:
+        case BCS:
+        case BEQ:
+        case BMI:
+        case BNE:
+        case BPL:
+        case BVC:
+        case BVS: {
+            uint8_t mask;
+            bool taken_if_set;
+            switch (mnemonic) {
+                case BCC:
+                case BCS:
+                    mask = 0x01;
+                    break;
+                case BEQ:
+                case BNE:
+                    mask = 0x02;
+                    break;
+                case BVC:
+                case BVS:
+                    mask = 0x40;
+                    break;
+                default:
+                    mask = 0x80;
+                    break;
+            }
+            taken_if_set = (mnemonic == BCS || mnemonic == BEQ || mnemonic == BVS ||
+                            mnemonic == BMI);
+
+            // Same target arithmetic and extra cycles as executeInstruction and
+            // addAdditionalCycles, which are all known at compile time
+            uint16_t target = (instr->offset >= 0) ? pc + instr->offset : pc + instr->offset + 2;
+            uint16_t next = pc + 2;
+            uint32_t taken_cycles = cycles + instr->cycles;
+            if (target != next) {
+                taken_cycles += 1 + ((target & 0xFF00) != (pc & 0xFF00));
+            }
+
+            emitOpRI(e, EXT_OR, REG_P, 0x20);
+
+            // test r15d, mask
+            emitRex(e, false, 0, 0, REG_P, false);
+            emit8(e, 0xF7);
+            emitModRM(e, 3, 0, REG_P);
+            emit32(e, mask);
+
+            size_t not_taken = emitJcc(e, taken_if_set ? CC_E : CC_NE);
+            emitExit(e, target, taken_cycles, executed + 1, EXIT_NONE);
+            patchJump(e, not_taken);
+            emitExit(e, next, cycles + instr->cycles, executed + 1, EXIT_NONE);
+            break;
+        }
+        default:
+            break;
+    }
+
+    return stored;
+}
+
+// ---------- Compiling and running blocks ----------
+
+/**
+ * Drop every compiled block so the code buffer can be reused
+ *
+ * @param jit - The JIT to flush
+ */
+static void flushCode(Jit* jit) {
+    for (int i = 0; i < 0x10000; i++) {
+        if (jit->cache->blocks[i] != NULL) {
+            jit->cache->blocks[i]->native = NULL;
+        }
+    }
+    jit->code_used = 0;
+    jit->flushes++;
+}
+
+/**
+ * Check if an instruction is going to read or write a page of the bus that has
+ * handlers rather than memory, making the same accesses executeInstruction
+ * would
+ *
+ * @param bus - The bus serving as the CPU address space
+ * @param instr - The instruction about to run
+ * @param processor - The processor holding register values (NULL to only check
+ *                    the addresses known before the instruction runs)
+ *
+ * @returns true if the instruction touches a memory-mapped register
+ */
+static bool touchesRegisters(const Bus* bus, const Instruction* instr,
+                             const Processor* processor) {
+    bool reads = true;
+    bool writes = false;
+
+    switch (opcode_table[instr->opcode].mnemonic) {
+        case BRK:
+            if (bus->read_pages[0xFF] == NULL) {
+                return true;
+            }
+            // fall through
+        case PHA:
+        case PHP:
+        case PLA:
+        case PLP:
+        case JSR:
+        case RTS:
+        case RTI:
+            return bus->read_pages[0x01] == NULL || bus->write_pages[0x01] == NULL;
+        case STA:
+        case STX:
+        case STY:
+            reads = false;
+            writes = true;
+            break;
+        case ASL:
+        case LSR:
+        case ROL:
+        case ROR:
+        case INC:
+        case DEC:
+        case SLO:
+            writes = true;
+            break;
+        default:
+            break;
+    }
+
+    uint16_t addr;
+    switch (instr->addr_mode) {
+        case ZP:
+        case ABS:
+            addr = instr->addr;
+            break;
+        case IND:
+            return bus->read_pages[instr->addr >> 8] == NULL ||
+                   bus->read_pages[(uint16_t)(instr->addr + 1) >> 8] == NULL;
+        case ZPX:
+        case ABSX:
+            if (processor == NULL) {
+                return false;
+            }
+            addr = instr->addr + processor->X;
+            break;
+        case ZPY:
+        case ABSY:
+            if (processor == NULL) {
+                return false;
+            }
+            addr = instr->addr + processor->Y;
+            break;
+        case INDX:
+        case INDY: {
+            if (processor == NULL) {
+                return false;
+            }
+            uint16_t pointer = instr->addr + (instr->addr_mode == INDX ? processor->X : 0);
+            if (bus->read_pages[pointer >> 8] == NULL ||
+                bus->read_pages[(uint16_t)(pointer + 1) >> 8] == NULL) {
+                return true;
+            }
+            addr = busRead(bus, pointer) | (busRead(bus, pointer + 1) << 8);
+            if (instr->addr_mode == INDY) {
+                addr += processor->Y;
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+
+    return (reads && bus->read_pages[addr >> 8] == NULL) ||
+           (writes && bus->write_pages[addr >> 8] == NULL);
+}
+
+/**
+ * Make the code buffer writable (while a block is being compiled) or
+ * executable (the rest of the time), but never both at once
+ *
+ * @param jit - The JIT whose code buffer to protect
+ * @param writable - Whether to make it writable rather than executable
+ *
+ * @returns 0 on success, -1 if the protection couldn't be changed
+ */
+static int protectCode(Jit* jit, bool writable) {
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+    if (mprotect(jit->code, JIT_CODE_SIZE, prot) != 0) {
+        LOG(COMP_JIT, LEVEL_ERROR, "Failed to make the code buffer %s",
+            writable ? "writable" : "executable");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Compile as much of the block as the JIT supports (always starting with the
+ * first instruction) and attach the code to the block. Compiling stops at an
+ * instruction that always touches a memory-mapped register, since the
+ * compiled code would only ever bail out before it.
+ *
+ * @param jit - The JIT to compile with
+ * @param block - The block to compile
+ * @param bus - The bus serving as the CPU address space
+ */
+static void compileBlock(Jit* jit, Block* block, const Bus* bus) {
+    int supported = 0;
+    while (supported < block->count && canCompile(&block->instrs[supported]) &&
+           !touchesRegisters(bus, &block->instrs[supported], NULL)) {
+        supported++;
+    }
+
+    if (supported == 0) {
+        block->jit_failed = true;
+        jit->rejected++;
+        return;
+    }
+
+    if (protectCode(jit, true) != 0) {
+        block->jit_failed = true;
+        return;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Emitter e = {jit->code + jit->code_used, 0, JIT_CODE_SIZE - jit->code_used, false};
+        PendingExit exits[BLOCK_MAX_INSTRUCTIONS * 2];
+        int exit_count = 0;
+
+        emitPrologue(&e);
+
+        uint16_t pc = block->start;
+        uint32_t cycles = 0;
+        uint32_t max_cycles = 0;
+        bool ended = false;
+        for (int i = 0; i < supported; i++) {
+            const Instruction* instr = &block->instrs[i];
+            Mnemonic mnemonic = opcode_table[instr->opcode].mnemonic;
+
+            PendingExit* bail = &exits[exit_count];
+            *bail = (PendingExit){
+                .pc = pc,
+                .cycles = cycles,
+                .executed = i,
+                .reason = EXIT_REGISTERS,
+            };
+            bool stored = compileInstruction(&e, instr, pc, cycles, i, bail);
+            if (bail->jumps > 0) {
+                exit_count++;
+            }
+
+            pc += instr->length;
+            cycles += instr->cycles;
+
+            // A page crossing costs a cycle, and a taken branch one or two
+            max_cycles += instr->cycles + opcode_table[instr->opcode].page_penalty;
+            if (instr->addr_mode == REL) {
+                max_cycles += 2;
+            }
+
+            if (mnemonic == JMP || instr->addr_mode == REL) {
+                ended = true;
+                break;
+            }
+
+            // executeInstruction forces the unused bit of P on after every instruction
+            emitOpRI(&e, EXT_OR, REG_P, 0x20);
+
+            // Leave straight after a store that lands on cached code, so that
+            // the block can be invalidated before anything else runs
+            if (stored) {
+                emitRex(&e, false, 0, RCX, REG_CODE_MAP, false);
+                emit8(&e, 0x80);  // cmp byte [r9 + rcx], 0
+                emitModRM(&e, 0, 7, 4);
+                emit8(&e, (RCX << 3) | (REG_CODE_MAP & 7));
+                emit8(&e, 0);
+                exits[exit_count++] = (PendingExit){
+                    .patches = {emitJcc(&e, CC_NE)},
+                    .jumps = 1,
+                    .pc = pc,
+                    .cycles = cycles,
+                    .executed = i + 1,
+                    .reason = EXIT_SMC,
+                };
+            }
+        }
+
+        if (!ended) {
+            emitExit(&e, pc, cycles, supported, EXIT_NONE);
+        }
+
+        for (int i = 0; i < exit_count; i++) {
+            for (int jump = 0; jump < exits[i].jumps; jump++) {
+                patchJump(&e, exits[i].patches[jump]);
+            }
+            emitExit(&e, exits[i].pc, exits[i].cycles, exits[i].executed, exits[i].reason);
+        }
+
+        if (!e.full) {
+            block->native = e.buf;
+            block->native_cycles = max_cycles;
+            jit->code_used += e.len;
+            jit->compiled++;
+            protectCode(jit, false);
+            return;
+        }
+
+        flushCode(jit);
+    }
+
+    block->jit_failed = true;
+    protectCode(jit, false);
+}
+
+/**
+ * Check if 'stop_pc' is the address of an instruction inside the block (other
+ * than the first one)
+ */
+static bool stopsInsideBlock(const Block* block, int32_t stop_pc) {
+    if (stop_pc == NO_STOP_PC) {
+        return false;
+    }
+
+    uint16_t offset = (uint16_t)stop_pc - block->start;
+    return offset != 0 && offset < block->length;
+}
+
+/**
+ * Copy the pages the bus writes to host memory into (or out of) a snapshot of
+ * the address space. Pages that mirror the same host memory are copied once
+ * for each mirror, which leaves them consistent either way.
+ *
+ * @param bus - The bus whose pages are copied
+ * @param snapshot - MEMORY_SPACE bytes, indexed by CPU address
+ * @param save - Whether to copy the pages into the snapshot, rather than back
+ */
+static void copyWritablePages(const Bus* bus, uint8_t* snapshot, bool save) {
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        uint8_t* host = bus->write_pages[page];
+        if (host == NULL) {
+            continue;
+        }
+
+        uint8_t* copy = snapshot + page * BUS_PAGE_SIZE;
+        if (save) {
+            memcpy(copy, host, BUS_PAGE_SIZE);
+        } else {
+            memcpy(host, copy, BUS_PAGE_SIZE);
+        }
+    }
+}
+
+/**
+ * Check if the pages the bus writes to host memory still match a snapshot
+ * taken with copyWritablePages
+ */
+static bool writablePagesMatch(const Bus* bus, const uint8_t* snapshot) {
+    for (int page = 0; page < BUS_PAGE_COUNT; page++) {
+        const uint8_t* host = bus->write_pages[page];
+        if (host != NULL && memcmp(host, snapshot + page * BUS_PAGE_SIZE, BUS_PAGE_SIZE) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Run the compiled code of a block (and check it against executeInstruction in
+ * differential mode)
+ *
+ * @returns The number of instructions executed
+ */
+static int runNative(Jit* jit, Block* block, Bus* bus, Processor* processor, uint64_t* cycles) {
+    // Compiled code works on the exact value of P
+    syncFlags(processor);
+
+    JitContext ctx = {0};
+    ctx.bus = bus;
+    ctx.code_map = jit->cache->code_map;
+    ctx.PC = processor->PC;
+    ctx.A = processor->A;
+    ctx.X = processor->X;
+    ctx.Y = processor->Y;
+    ctx.S = processor->S;
+    ctx.P = processor->P;
+
+    Processor shadow_processor = *processor;
+    uint64_t shadow_cycles = *cycles;
+    if (jit->differential) {
+        // Compiled code only ever writes to host memory, so that's all there
+        // is to put back before executeInstruction has its turn
+        copyWritablePages(bus, jit->saved_memory, true);
+
+        // The shadow run mustn't invalidate blocks on behalf of the real one
+        shadow_processor.block_cache = NULL;
+    }
+
+    ((NativeBlock)block->native)(&ctx);
+    jit->native_runs++;
+
+    processor->PC = ctx.PC;
+    processor->A = ctx.A;
+    processor->X = ctx.X;
+    processor->Y = ctx.Y;
+    processor->S = ctx.S;
+    processor->P = ctx.P;
+    *cycles += ctx.cycles;
+
+    if (jit->differential) {
+        // executeInstruction runs the same instructions on the real bus, from
+        // the memory the block started with. They only touched host memory
+        // when compiled, so they don't reach a register unless the two differ.
+        copyWritablePages(bus, jit->native_memory, true);
+        copyWritablePages(bus, jit->saved_memory, false);
+        executeBlock(block, 0, ctx.executed, bus, &shadow_processor, &shadow_cycles, UINT64_MAX,
+                     NO_STOP_PC);
+        syncFlags(&shadow_processor);
+
+        if (shadow_processor.PC != processor->PC || shadow_processor.A != processor->A ||
+            shadow_processor.X != processor->X || shadow_processor.Y != processor->Y ||
+            shadow_processor.S != processor->S || shadow_processor.P != processor->P ||
+            shadow_cycles != *cycles || !writablePagesMatch(bus, jit->native_memory)) {
+            LOG(COMP_JIT, LEVEL_ERROR,
+                "JIT mismatch in block $%04x: PC=$%04x/$%04x A=$%02x/$%02x X=$%02x/$%02x "
+                "Y=$%02x/$%02x S=$%02x/$%02x P=$%02x/$%02x",
+                block->start, processor->PC, shadow_processor.PC, processor->A, shadow_processor.A,
+                processor->X, shadow_processor.X, processor->Y, shadow_processor.Y, processor->S,
+                shadow_processor.S, processor->P, shadow_processor.P);
+            jit->mismatches++;
+
+            // Trust executeInstruction (whose writes are the ones left in
+            // memory), and never run this block natively again
+            shadow_processor.block_cache = processor->block_cache;
+            *processor = shadow_processor;
+            *cycles = shadow_cycles;
+            block->native = NULL;
+            block->jit_failed = true;
+        }
+    }
+
+    if (ctx.reason == EXIT_REGISTERS) {
+        jit->register_exits++;
+    }
+    if (ctx.reason == EXIT_SMC) {
+        jit->smc_exits++;
+        notifyBlockCacheWrite(jit->cache, ctx.write_addr);
+    }
+
+    return ctx.executed;
+}
+
+/**
+ * Create a JIT on top of the given block cache
+ *
+ * @param cache - The cache whose blocks will be compiled
+ * @param differential - Check every compiled block against executeInstruction
+ *
+ * @returns The new JIT, or NULL if the host isn't x86-64 or allocation failed
+ */
+Jit* createJit(BlockCache* cache, bool differential) {
+    Jit* jit = calloc(1, sizeof(Jit));
+    if (jit == NULL) {
+        return NULL;
+    }
+
+    // Blocks are written while it's writable, then it's made executable (see
+    // protectCode)
+    jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (jit->code == MAP_FAILED) {
+        LOG(COMP_JIT, LEVEL_ERROR, "Failed to map memory for compiled code");
+        free(jit);
+        return NULL;
+    }
+
+    jit->cache = cache;
+    jit->differential = differential;
+    if (differential) {
+        jit->saved_memory = malloc(MEMORY_SPACE);
+        jit->native_memory = malloc(MEMORY_SPACE);
+        if (jit->saved_memory == NULL || jit->native_memory == NULL) {
+            freeJit(jit);
+            return NULL;
+        }
+    }
+
+    return jit;
+}
+
+/**
+ * Free the JIT and its compiled code (but not its block cache)
+ *
+ * @param jit - The JIT to free
+ */
+void freeJit(Jit* jit) {
+    if (jit == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < 0x10000; i++) {
+        if (jit->cache->blocks[i] != NULL) {
+            jit->cache->blocks[i]->native = NULL;
+        }
+    }
+
+    munmap(jit->code, JIT_CODE_SIZE);
+    free(jit->saved_memory);
+    free(jit->native_memory);
+    free(jit);
+}
+
+/**
+ * Run code starting at the processor's PC until it halts, the PC reaches
+ * 'stop_pc', the cycle count reaches 'cycle_limit', or an instruction touches a
+ * memory-mapped register
+ *
+ * @param jit - The JIT to compile blocks with
+ * @param bus - The bus serving as the CPU address space
+ * @param processor - The processor holding register values
+ * @param cycles - The running cycle count, incremented for every instruction
+ * @param cycle_limit - Stop once the cycle count reaches this value
+ * @param stop_pc - Stop before executing the instruction at this address (or
+ *                  NO_STOP_PC)
+ *
+ * @returns The number of instructions executed
+ */
+uint64_t runJit(Jit* jit, Bus* bus, Processor* processor, uint64_t* cycles,
+                uint64_t cycle_limit, int32_t stop_pc) {
+    BlockCache* cache = jit->cache;
+    uint64_t count = 0;
+    bool touched_registers = false;
+
+    // Only a bus with nothing but memory on it lets the interpreter run whole
+    // blocks without watching for registers
+    uint8_t* mem = busFlatMemory(bus);
+
+    // Stores made by executeInstruction have to invalidate the cache
+    BlockCache* old_cache = processor->block_cache;
+    processor->block_cache = cache;
+
+    while (!touched_registers && !processor->halted && processor->PC != stop_pc &&
+           *cycles < cycle_limit) {
+        freeRetiredBlocks(cache);
+
+        Block* block = lookupBlock(cache, bus, processor->PC);
+        if (block == NULL) {
+            fprintf(stderr, "ERROR: Failed to allocate a block\n");
+            break;
+        }
+        block->executions++;
+
+        if (block->native == NULL && !block->jit_failed && block->executions >= JIT_THRESHOLD) {
+            compileBlock(jit, block, bus);
+        }
+
+        // Compiled code can't stop partway, so it only runs when it's sure to
+        // finish before the cycle limit
+        int first = 0;
+        if (block->native != NULL && !stopsInsideBlock(block, stop_pc) &&
+            *cycles + block->native_cycles <= cycle_limit) {
+            first = runNative(jit, block, bus, processor, cycles);
+            count += first;
+
+            // Anything left over is an instruction the JIT doesn't handle, or
+            // one that touches a page with handlers
+            if (first == block->count || !block->valid || processor->PC == stop_pc ||
+                *cycles >= cycle_limit) {
+                continue;
+            }
+        }
+
+        if (mem != NULL) {
+            count += executeBlock(block, first, block->count - first, bus, processor, cycles,
+                                  cycle_limit, stop_pc);
+            continue;
+        }
+
+        // Otherwise the rest of the block runs an instruction at a time, and the
+        // run ends after one that touches a register, the same as with
+        // runInstructions. Its handler sees the cycle count at the start of the
+        // instruction, and whatever it changed (like a mapper's banks) is picked
+        // up by the caller before the next run.
+        for (int i = first; i < block->count; i++) {
+            touched_registers = touchesRegisters(bus, &block->instrs[i], processor);
+            count += executeBlock(block, i, 1, bus, processor, cycles, cycle_limit, stop_pc);
+
+            if (touched_registers || !block->valid || processor->halted ||
+                processor->PC == stop_pc || *cycles >= cycle_limit) {
+                break;
+            }
+        }
+    }
+
+    freeRetiredBlocks(cache);
+    processor->block_cache = old_cache;
+
+    return count;
+}
+
+#else
+
+// The JIT only knows how to generate x86-64 code
+
+Jit* createJit(BlockCache* cache, bool differential) {
+    LOG(COMP_JIT, LEVEL_WARNING, "The JIT is only supported on x86-64 hosts");
+    return NULL;
+}
+
+void freeJit(Jit* jit) {}
+
+uint64_t runJit(Jit* jit, Bus* bus, Processor* processor, uint64_t* cycles,
+                uint64_t cycle_limit, int32_t stop_pc) {
+    return runBlocks(jit->cache, bus, processor, cycles, cycle_limit, stop_pc);
+}
+
+#endif
+
+/**
+ * Print the number of compiled blocks, native runs and mismatches
+ *
+ * @param jit - The JIT to print statistics for
+ */
+void printJitStats(const Jit* jit) {
+    printf("------------- JIT Stats -------------\n");
+    printf("   Compiled blocks: %llu\n", (unsigned long long)jit->compiled);
+    printf("   Rejected blocks: %llu\n", (unsigned long long)jit->rejected);
+    printf("       Native runs: %llu\n", (unsigned long long)jit->native_runs);
+    printf("   SMC early exits: %llu\n", (unsigned long long)jit->smc_exits);
+    printf("    Register exits: %llu\n", (unsigned long long)jit->register_exits);
+    printf("      Code flushes: %llu\n", (unsigned long long)jit->flushes);
+    if (jit->differential) {
+        printf("        Mismatches: %llu\n", (unsigned long long)jit->mismatches);
+    }
+    printf("-------------------------------------\n");
+}
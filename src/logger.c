@@ -1,87 +1,172 @@
 #include "logger.h"
 
-#include "utils.h"
-
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
+#define LOG_LINE_LENGTH (512)  // Longer messages are cut short
+
+LogLevel log_level = LEVEL_INFO;
+
+static const char* level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR", "NONE"};
+static const char* component_names[COMP_COUNT] = {"CPU",  "PPU",   "CART",  "JIT",   "SCHED",
+                                                  "PACE", "TRACE", "STATE", "BATCH", "APU"};
+
+// Log lines are batched here and written out when it fills up, when an error
+// is logged, or when the program exits
+static char buffer[LOG_BUFFER_SIZE];
+static size_t buffered = 0;
+static FILE* log_file = NULL;  // NULL for stderr
+static bool flush_at_exit = false;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// The timestamp only changes once a second, so it's kept around rather than
+// being formatted for every line
+static time_t stamp_time = -1;
+static char stamp[32];
+
 /**
- * Print a log message to the console
- *
- * @param component - The component of the NES the message is related to (e.x.
- *                    CPU, PPU, etc.)
- * @param msg - The log message
- * @param level - The level of severity related to the log message
+ * Write out the buffer. The log mutex must be held.
  */
-void printLog(const char* component, const char* msg, const char* level) {
-    time_t now;
-    time(&now);
-    char* ptime = ctime(&now);
-    if (ptime[strlen(ptime) - 1] == '\n') {
-        ptime[strlen(ptime) - 1] = '\0';
+static void flushBuffer(void) {
+    if (buffered > 0) {
+        // Anything already printed to stdout goes first, so the two stay in order
+        // when they're sent to the same place
+        fflush(stdout);
+
+        FILE* file = log_file ? log_file : stderr;
+        fwrite(buffer, 1, buffered, file);
+        fflush(file);
+        buffered = 0;
     }
-    printf("%s %s [%s]: %s\n", ptime, level, component, msg);
 }
 
 /**
- * Print a log message about an executed instruction and the processor status to
- * the console
+ * Write out every buffered log line
+ */
+void flushLog(void) {
+    pthread_mutex_lock(&log_mutex);
+    flushBuffer();
+    pthread_mutex_unlock(&log_mutex);
+}
+
+/**
+ * Log a message. Use the LOG macro instead, which checks the level first.
  *
- * @param instr - The executed instruction
- * @param processor - The struct serving as the system procesor
+ * @param component - The component the message is about
+ * @param level - How severe the message is
+ * @param format - printf style format of the message
  */
-void printInstrLog(Instruction instr, Processor processor) {
-    time_t now;
-    time(&now);
-    char* ptime = ctime(&now);
-    if (ptime[strlen(ptime) - 1] == '\n') {
-        ptime[strlen(ptime) - 1] = '\0';
+void logMessage(LogComponent component, LogLevel level, const char* format, ...) {
+    char line[LOG_LINE_LENGTH];
+
+    pthread_mutex_lock(&log_mutex);
+
+    if (!flush_at_exit) {
+        atexit(flushLog);
+        flush_at_exit = true;
+    }
+
+    // e.x. "Sat Oct 17 02:54:14 2026"
+    time_t now = time(NULL);
+    if (now != stamp_time) {
+        struct tm local;
+        localtime_r(&now, &local);
+        strftime(stamp, sizeof(stamp), "%a %b %e %H:%M:%S %Y", &local);
+        stamp_time = now;
+    }
+
+    int length = snprintf(line, sizeof(line), "%s %s [%s]: ", stamp, level_names[level],
+                          component_names[component]);
+
+    va_list args;
+    va_start(args, format);
+    length += vsnprintf(line + length, sizeof(line) - length, format, args);
+    va_end(args);
+
+    // Make room for the newline if the message was cut short
+    if (length > LOG_LINE_LENGTH - 2) {
+        length = LOG_LINE_LENGTH - 2;
+    }
+    line[length++] = '\n';
+
+    if (buffered + length > LOG_BUFFER_SIZE) {
+        flushBuffer();
     }
+    memcpy(buffer + buffered, line, length);
+    buffered += length;
 
-    char* instr_string;
-    switch (instr.addr_mode) {
-        case IMPL:
-            asprintf(&instr_string, IMPL_FORMAT, instr.name);
-            break;
-        case ACCUM:
-            asprintf(&instr_string, ACCUM_FORMAT, instr.name);
-            break;
-        case IMM:
-            asprintf(&instr_string, IMM_FORMAT, instr.name, instr.imm);
-            break;
-        case ZP:
-            asprintf(&instr_string, ZP_FORMAT, instr.name, instr.addr);
-            break;
-        case ZPX:
-            asprintf(&instr_string, ZPX_FORMAT, instr.name, instr.addr);
-            break;
-        case ZPY:
-            asprintf(&instr_string, ZPY_FORMAT, instr.name, instr.addr);
-            break;
-        case REL:
-            asprintf(&instr_string, REL_FORMAT, instr.name, (uint8_t)instr.offset);
-            break;
-        case ABS:
-            asprintf(&instr_string, ABS_FORMAT, instr.name, instr.addr);
-            break;
-        case ABSX:
-            asprintf(&instr_string, ABSX_FORMAT, instr.name, instr.addr);
-            break;
-        case ABSY:
-            asprintf(&instr_string, ABSY_FORMAT, instr.name, instr.addr);
-            break;
-        case IND:
-            asprintf(&instr_string, IND_FORMAT, instr.name, instr.addr);
-            break;
-        case INDX:
-            asprintf(&instr_string, INDX_FORMAT, instr.name, instr.addr);
-            break;
-        case INDY:
-            asprintf(&instr_string, INDY_FORMAT, instr.name, instr.addr);
-            break;
+    // Errors are written out right away, in case the program is about to stop
+    if (level >= LEVEL_ERROR) {
+        flushBuffer();
     }
 
-    printf("%s DEBUG [CPU]: $%04x: %s", ptime, processor.PC, instr_string);
+    pthread_mutex_unlock(&log_mutex);
+}
+
+/**
+ * Count a rate limited message, and decide if it should be logged
+ *
+ * @param limit - The message's counter
+ * @param component - The component the message is about
+ * @param level - How severe the message is
+ *
+ * @returns true if the message should be logged
+ */
+bool logAllowed(LogLimit* limit, LogComponent component, LogLevel level) {
+    uint64_t count = atomic_fetch_add_explicit(&limit->count, 1, memory_order_relaxed) + 1;
+
+    if (count == LOG_RATE_BURST + 1) {
+        logMessage(component, level, "Only logging every %dth message like that from now on",
+                   LOG_RATE_INTERVAL);
+    }
+    return count <= LOG_RATE_BURST || count % LOG_RATE_INTERVAL == 0;
+}
+
+/**
+ * Set where log lines are written (stderr by default). Anything already
+ * buffered is written to the old file first.
+ *
+ * @param file - The file to write to (NULL for stderr)
+ */
+void setLogFile(FILE* file) {
+    pthread_mutex_lock(&log_mutex);
+    flushBuffer();
+    log_file = file;
+    pthread_mutex_unlock(&log_mutex);
+}
+
+/**
+ * Set the lowest level of message that gets logged
+ *
+ * @param level - The level
+ */
+void setLogLevel(LogLevel level) {
+    log_level = level;
+}
+
+/**
+ * Parse a log level name (debug, info, warning, error or none)
+ *
+ * @param name - The name of the level
+ * @param level - Set to the level
+ *
+ * @returns 0 if the name is valid
+ * @returns -1 if it isn't
+ */
+int parseLogLevel(const char* name, LogLevel* level) {
+    for (int i = LEVEL_DEBUG; i <= LEVEL_NONE; i++) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            *level = i;
+            return 0;
+        }
+    }
+    return -1;
 }
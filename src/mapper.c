@@ -0,0 +1,523 @@
+#include "mapper.h"
+
+#include "cartridge.h"
+#include "logger.h"
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ---------- Banking ----------
+
+/**
+ * Map a bank of PRG-ROM into the CPU address space. Banks past the end of the
+ * ROM wrap around, the same as the unconnected upper bank lines on a cartridge.
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The CPU address the bank starts at
+ * @param size - The size of the bank (in bytes)
+ * @param bank - The index of the bank (in units of 'size')
+ */
+static void mapPrgBank(Mapper* mapper, uint16_t addr, uint32_t size, int bank) {
+    // A ROM smaller than the bank is mirrored over it
+    uint32_t start = 0;
+    if (size > mapper->prg_size) {
+        for (uint32_t offset = 0; offset < size; offset += mapper->prg_size) {
+            busMapReadMemory(mapper->bus, addr + offset, mapper->prg_size, mapper->prg_rom);
+        }
+    } else {
+        start = (bank % (mapper->prg_size / size)) * size;
+        busMapReadMemory(mapper->bus, addr, size, mapper->prg_rom + start);
+    }
+
+    for (uint32_t offset = 0; offset < size; offset += PRG_SLOT_SIZE) {
+        mapper->prg_offsets[(addr + offset - 0x8000) / PRG_SLOT_SIZE] =
+            (start + offset) % mapper->prg_size;
+    }
+}
+
+/**
+ * Map a bank of CHR memory into the pattern tables
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address the bank starts at
+ * @param size - The size of the bank (in bytes)
+ * @param bank - The index of the bank (in units of 'size')
+ */
+static void mapChrBank(Mapper* mapper, uint16_t addr, uint32_t size, int bank) {
+    uint32_t count = mapper->chr_size / size;
+    uint8_t* host = mapper->chr + (count > 0 ? (bank % count) * size : 0);
+
+    for (uint32_t offset = 0; offset < size; offset += CHR_PAGE_SIZE) {
+        int page = (addr + offset) / CHR_PAGE_SIZE;
+        mapper->chr_pages[page] = host + offset % mapper->chr_size;
+        uint32_t chr_offset = mapper->chr_pages[page] - mapper->chr;
+        mapper->tile_pages[page] =
+            mapper->chr_tiles + chr_offset / CHR_TILE_SIZE * DECODED_TILE_SIZE;
+    }
+}
+
+/**
+ * Map PRG-ROM and CHR memory back in at the given offsets, e.x. the ones saved
+ * in a save state
+ *
+ * @param mapper - The cartridge's mapper
+ * @param prg_offsets - Offset into PRG-ROM of each 8 KiB of $8000-$FFFF
+ * @param chr_offsets - Offset into CHR memory of each 1 KiB of the pattern tables
+ *
+ * @returns 0 if the banks were mapped
+ * @returns -1 if an offset is past the end of the cartridge's memory
+ */
+int mapperRestoreBanks(Mapper* mapper, const uint32_t* prg_offsets, const uint32_t* chr_offsets) {
+    for (int slot = 0; slot < PRG_SLOTS; slot++) {
+        if (prg_offsets[slot] % PRG_SLOT_SIZE != 0 || prg_offsets[slot] >= mapper->prg_size) {
+            return -1;
+        }
+    }
+    for (int page = 0; page < 8; page++) {
+        if (chr_offsets[page] % CHR_PAGE_SIZE != 0 || chr_offsets[page] >= mapper->chr_size) {
+            return -1;
+        }
+    }
+
+    for (int slot = 0; slot < PRG_SLOTS; slot++) {
+        mapPrgBank(mapper, 0x8000 + slot * PRG_SLOT_SIZE, PRG_SLOT_SIZE,
+                   prg_offsets[slot] / PRG_SLOT_SIZE);
+    }
+    for (int page = 0; page < 8; page++) {
+        mapChrBank(mapper, page * CHR_PAGE_SIZE, CHR_PAGE_SIZE, chr_offsets[page] / CHR_PAGE_SIZE);
+    }
+    return 0;
+}
+
+// Index of the last bank of the given size
+static int lastPrgBank(const Mapper* mapper, uint32_t size) {
+    return mapper->prg_size / size - 1;
+}
+
+static void mapperCpuWrite(void* context, uint16_t addr, uint8_t val) {
+    Mapper* mapper = context;
+    if (mapper->ops->cpuWrite == NULL) {
+        return;
+    }
+
+    // Bank switches and IRQ registers change what the PPU does, so it has to
+    // catch up to the write first
+    if (mapper->scheduler != NULL) {
+        schedulerSync(mapper->scheduler);
+    }
+    mapper->ops->cpuWrite(mapper, addr, val);
+    if (mapper->scheduler != NULL) {
+        schedulerReschedule(mapper->scheduler);
+    }
+}
+
+static uint8_t mapperCpuRead(void* context, uint16_t addr) {
+    Mapper* mapper = context;
+    if (mapper->ops->cpuRead != NULL) {
+        return mapper->ops->cpuRead(mapper, addr);
+    }
+    return 0;
+}
+
+// ---------- Tile Cache ----------
+
+/**
+ * Get a row of a tile from the pattern tables, decoding it first if it's been
+ * written to (or if the mapper intercepts pattern table reads)
+ *
+ * @param mapper - The cartridge's mapper
+ * @param addr - The PPU address of the row's low plane byte ($0000-$1FFF)
+ *
+ * @returns The palette index (0-3) of each of the row's 8 pixels, left to right
+ */
+const uint8_t* mapperFetchTileRow(Mapper* mapper, uint16_t addr) {
+    // Mappers that intercept reads might not return the same thing twice, so
+    // their rows are never cached
+    if (mapper->ops->ppuRead != NULL) {
+        uint8_t lo = mapper->ops->ppuRead(mapper, addr);
+        uint8_t hi = mapper->ops->ppuRead(mapper, addr + 8);
+        for (int bit = 7; bit >= 0; bit--) {
+            mapper->tile_row[7 - bit] = ((lo >> bit) & 0x01) | (((hi >> bit) & 0x01) << 1);
+        }
+        return mapper->tile_row;
+    }
+
+    int page = (addr >> 10) & 0x07;
+    uint32_t offset = mapper->chr_pages[page] - mapper->chr + (addr & (CHR_PAGE_SIZE - 1));
+    uint32_t tile = offset / CHR_TILE_SIZE;
+    if (mapper->chr_writable && mapper->tile_dirty[tile]) {
+        decodeChr(mapper->chr + tile * CHR_TILE_SIZE, CHR_TILE_SIZE,
+                  mapper->chr_tiles + tile * DECODED_TILE_SIZE);
+        mapper->tile_dirty[tile] = false;
+        mapper->tile_rebuilds++;
+        mapper->frame_tile_rebuilds++;
+    }
+
+    return mapper->chr_tiles + tile * DECODED_TILE_SIZE + ((addr & 0x07) << 3);
+}
+
+// ---------- NROM (Mapper 0) ----------
+
+static void nromReset(Mapper* mapper) {
+    // A 16 KiB PRG-ROM is mirrored into $C000-$FFFF
+    mapPrgBank(mapper, 0x8000, 0x4000, 0);
+    mapPrgBank(mapper, 0xC000, 0x4000, 1);
+    mapChrBank(mapper, 0x0000, 0x2000, 0);
+}
+
+static const MapperOps nrom_ops = {
+    .name = "NROM",
+    .reset = nromReset,
+};
+
+// ---------- MMC1 (Mapper 1) ----------
+
+static void mmc1UpdateBanks(Mapper* mapper) {
+    uint8_t control = mapper->mmc1.control;
+
+    switch (control & 0x03) {
+        case 0:
+            mapper->mirroring = MIRROR_SINGLE_LOW;
+            break;
+        case 1:
+            mapper->mirroring = MIRROR_SINGLE_HIGH;
+            break;
+        case 2:
+            mapper->mirroring = MIRROR_VERTICAL;
+            break;
+        case 3:
+            mapper->mirroring = MIRROR_HORIZONTAL;
+            break;
+    }
+
+    uint8_t prg_bank = mapper->mmc1.prg_bank & 0x0F;
+    switch ((control >> 2) & 0x03) {
+        case 0:
+        case 1:
+            // Switch 32 KiB at $8000, ignoring the low bit of the bank number
+            mapPrgBank(mapper, 0x8000, 0x8000, prg_bank >> 1);
+            break;
+        case 2:
+            // Fix the first bank at $8000 and switch 16 KiB at $C000
+            mapPrgBank(mapper, 0x8000, 0x4000, 0);
+            mapPrgBank(mapper, 0xC000, 0x4000, prg_bank);
+            break;
+        case 3:
+            // Switch 16 KiB at $8000 and fix the last bank at $C000
+            mapPrgBank(mapper, 0x8000, 0x4000, prg_bank);
+            mapPrgBank(mapper, 0xC000, 0x4000, lastPrgBank(mapper, 0x4000));
+            break;
+    }
+
+    if (control & 0x10) {
+        // Two separate 4 KiB banks
+        mapChrBank(mapper, 0x0000, 0x1000, mapper->mmc1.chr_bank0);
+        mapChrBank(mapper, 0x1000, 0x1000, mapper->mmc1.chr_bank1);
+    } else {
+        // One 8 KiB bank, ignoring the low bit of the bank number
+        mapChrBank(mapper, 0x0000, 0x2000, mapper->mmc1.chr_bank0 >> 1);
+    }
+}
+
+static void mmc1Reset(Mapper* mapper) {
+    mapper->mmc1.shift = 0x10;
+    mapper->mmc1.control = 0x0C;
+    mapper->mmc1.chr_bank0 = 0;
+    mapper->mmc1.chr_bank1 = 0;
+    mapper->mmc1.prg_bank = 0;
+    mmc1UpdateBanks(mapper);
+}
+
+static void mmc1CpuWrite(Mapper* mapper, uint16_t addr, uint8_t val) {
+    if (addr < 0x8000) {
+        return;
+    }
+
+    // Writing a byte with bit 7 set resets the shift register
+    if (val & 0x80) {
+        mapper->mmc1.shift = 0x10;
+        mapper->mmc1.control |= 0x0C;
+        mmc1UpdateBanks(mapper);
+        return;
+    }
+
+    // Bits are shifted in LSB first. The marker bit reaches bit 0 on the fifth write.
+    bool full = mapper->mmc1.shift & 0x01;
+    mapper->mmc1.shift = (mapper->mmc1.shift >> 1) | ((val & 0x01) << 4);
+    if (!full) {
+        return;
+    }
+
+    uint8_t data = mapper->mmc1.shift;
+    switch ((addr >> 13) & 0x03) {
+        case 0:
+            mapper->mmc1.control = data;
+            break;
+        case 1:
+            mapper->mmc1.chr_bank0 = data;
+            break;
+        case 2:
+            mapper->mmc1.chr_bank1 = data;
+            break;
+        case 3:
+            mapper->mmc1.prg_bank = data;
+            break;
+    }
+    mapper->mmc1.shift = 0x10;
+    mmc1UpdateBanks(mapper);
+}
+
+static const MapperOps mmc1_ops = {
+    .name = "MMC1",
+    .reset = mmc1Reset,
+    .cpuWrite = mmc1CpuWrite,
+};
+
+// ---------- UxROM (Mapper 2) ----------
+
+static void uxromReset(Mapper* mapper) {
+    mapPrgBank(mapper, 0x8000, 0x4000, 0);
+    mapPrgBank(mapper, 0xC000, 0x4000, lastPrgBank(mapper, 0x4000));
+    mapChrBank(mapper, 0x0000, 0x2000, 0);
+}
+
+static void uxromCpuWrite(Mapper* mapper, uint16_t addr, uint8_t val) {
+    if (addr >= 0x8000) {
+        mapPrgBank(mapper, 0x8000, 0x4000, val);
+    }
+}
+
+static const MapperOps uxrom_ops = {
+    .name = "UxROM",
+    .reset = uxromReset,
+    .cpuWrite = uxromCpuWrite,
+};
+
+// ---------- CNROM (Mapper 3) ----------
+
+static void cnromCpuWrite(Mapper* mapper, uint16_t addr, uint8_t val) {
+    if (addr >= 0x8000) {
+        mapChrBank(mapper, 0x0000, 0x2000, val);
+    }
+}
+
+static const MapperOps cnrom_ops = {
+    .name = "CNROM",
+    .reset = nromReset,
+    .cpuWrite = cnromCpuWrite,
+};
+
+// ---------- MMC3 (Mapper 4) ----------
+
+static void mmc3UpdateBanks(Mapper* mapper) {
+    const uint8_t* banks = mapper->mmc3.banks;
+    int second_last = lastPrgBank(mapper, 0x2000) - 1;
+
+    // PRG mode 1 swaps $8000 and $C000
+    if (mapper->mmc3.bank_select & 0x40) {
+        mapPrgBank(mapper, 0x8000, 0x2000, second_last);
+        mapPrgBank(mapper, 0xC000, 0x2000, banks[6]);
+    } else {
+        mapPrgBank(mapper, 0x8000, 0x2000, banks[6]);
+        mapPrgBank(mapper, 0xC000, 0x2000, second_last);
+    }
+    mapPrgBank(mapper, 0xA000, 0x2000, banks[7]);
+    mapPrgBank(mapper, 0xE000, 0x2000, second_last + 1);
+
+    // CHR inversion swaps the 2 KiB banks (R0, R1) with the 1 KiB banks (R2-R5)
+    uint16_t inversion = (mapper->mmc3.bank_select & 0x80) ? 0x1000 : 0x0000;
+    mapChrBank(mapper, 0x0000 ^ inversion, 0x0800, banks[0] >> 1);
+    mapChrBank(mapper, 0x0800 ^ inversion, 0x0800, banks[1] >> 1);
+    mapChrBank(mapper, 0x1000 ^ inversion, 0x0400, banks[2]);
+    mapChrBank(mapper, 0x1400 ^ inversion, 0x0400, banks[3]);
+    mapChrBank(mapper, 0x1800 ^ inversion, 0x0400, banks[4]);
+    mapChrBank(mapper, 0x1C00 ^ inversion, 0x0400, banks[5]);
+}
+
+static void mmc3Reset(Mapper* mapper) {
+    mapper->mmc3.bank_select = 0;
+    for (int i = 0; i < 8; i++) {
+        mapper->mmc3.banks[i] = 0;
+    }
+    mapper->mmc3.banks[7] = 1;
+    mapper->mmc3.irq_latch = 0;
+    mapper->mmc3.irq_counter = 0;
+    mapper->mmc3.irq_reload = false;
+    mapper->mmc3.irq_enabled = false;
+    mapper->mmc3.irq_pending = false;
+    mmc3UpdateBanks(mapper);
+}
+
+static void mmc3CpuWrite(Mapper* mapper, uint16_t addr, uint8_t val) {
+    if (addr < 0x8000) {
+        return;
+    }
+
+    // Each 8 KiB range has one register at even addresses and one at odd addresses
+    bool odd = addr & 0x01;
+    switch ((addr >> 13) & 0x03) {
+        case 0:
+            if (odd) {
+                mapper->mmc3.banks[mapper->mmc3.bank_select & 0x07] = val;
+            } else {
+                mapper->mmc3.bank_select = val;
+            }
+            mmc3UpdateBanks(mapper);
+            break;
+        case 1:
+            // Odd addresses protect PRG-RAM, which isn't emulated
+            if (!odd && mapper->mirroring != MIRROR_FOUR_SCREEN) {
+                mapper->mirroring = (val & 0x01) ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+            }
+            break;
+        case 2:
+            if (odd) {
+                mapper->mmc3.irq_counter = 0;
+                mapper->mmc3.irq_reload = true;
+            } else {
+                mapper->mmc3.irq_latch = val;
+            }
+            break;
+        case 3:
+            mapper->mmc3.irq_enabled = odd;
+            if (!odd) {
+                mapper->mmc3.irq_pending = false;
+            }
+            break;
+    }
+}
+
+static void mmc3Scanline(Mapper* mapper) {
+    if (mapper->mmc3.irq_counter == 0 || mapper->mmc3.irq_reload) {
+        mapper->mmc3.irq_counter = mapper->mmc3.irq_latch;
+        mapper->mmc3.irq_reload = false;
+    } else {
+        mapper->mmc3.irq_counter--;
+    }
+
+    if (mapper->mmc3.irq_counter == 0 && mapper->mmc3.irq_enabled) {
+        mapper->mmc3.irq_pending = true;
+    }
+}
+
+static bool mmc3Irq(const Mapper* mapper) {
+    return mapper->mmc3.irq_pending;
+}
+
+static const MapperOps mmc3_ops = {
+    .name = "MMC3",
+    .reset = mmc3Reset,
+    .cpuWrite = mmc3CpuWrite,
+    .scanline = mmc3Scanline,
+    .irq = mmc3Irq,
+};
+
+// ---------- Mapper table ----------
+
+// Supported mappers, indexed by their iNES mapper number
+static const MapperOps* const mapper_table[] = {
+    [0] = &nrom_ops, [1] = &mmc1_ops, [2] = &uxrom_ops, [3] = &cnrom_ops, [4] = &mmc3_ops,
+};
+
+#define MAPPER_TABLE_SIZE ((int)(sizeof(mapper_table) / sizeof(mapper_table[0])))
+
+/**
+ * Create the mapper for a cartridge and map its PRG memory into the bus
+ *
+ * @param cart - The cartridge the mapper belongs to (must outlive the mapper)
+ * @param bus - The CPU bus to map the cartridge into
+ *
+ * @returns The new mapper, or NULL if the mapper isn't supported or allocation
+ *          failed
+ */
+Mapper* createMapper(Cartridge* cart, Bus* bus) {
+    int number = getMapperNumber(cart);
+    if (number >= MAPPER_TABLE_SIZE || mapper_table[number] == NULL) {
+        LOG(COMP_CART, LEVEL_ERROR, "Support for mapper %d has not yet been implemented", number);
+        return NULL;
+    }
+
+    // Banks are at least 8 KiB, so smaller or odd sized PRG-ROMs can't be mapped
+    uint32_t prg_size = cart->prg_rom_bytes;
+    if (prg_size == 0 || prg_size % 0x2000 != 0) {
+        LOG(COMP_CART, LEVEL_ERROR, "The cartridge's PRG-ROM isn't a multiple of 8 KiB");
+        return NULL;
+    }
+
+    Mapper* mapper = calloc(1, sizeof(Mapper));
+    if (mapper == NULL) {
+        return NULL;
+    }
+
+    mapper->ops = mapper_table[number];
+    mapper->number = number;
+    mapper->bus = bus;
+    mapper->prg_rom = cart->prg_rom;
+    mapper->prg_size = prg_size;
+
+    // Cartridges without CHR-ROM have 8 KiB of CHR-RAM instead
+    if (cart->chr_rom_bytes > 0) {
+        mapper->chr = cart->chr_rom;
+        mapper->chr_size = cart->chr_rom_bytes;
+    } else {
+        mapper->chr_ram = calloc(CHR_RAM_SIZE, sizeof(uint8_t));
+        if (mapper->chr_ram == NULL) {
+            free(mapper);
+            return NULL;
+        }
+        mapper->chr = mapper->chr_ram;
+        mapper->chr_size = CHR_RAM_SIZE;
+        mapper->chr_writable = true;
+    }
+
+    // loadRom decodes CHR-ROM up front, but cartridges put together some other
+    // way (and CHR-RAM) need their own tiles. Blank CHR-RAM decodes to all 0s.
+    if (cart->chr_rom_bytes > 0 && cart->chr_tiles != NULL) {
+        mapper->chr_tiles = cart->chr_tiles;
+    } else {
+        size_t tiles_size = (size_t)mapper->chr_size / CHR_TILE_SIZE * DECODED_TILE_SIZE;
+        mapper->chr_tiles_owned = calloc(tiles_size, sizeof(uint8_t));
+        if (mapper->chr_tiles_owned == NULL) {
+            free(mapper->chr_ram);
+            free(mapper);
+            return NULL;
+        }
+        if (!mapper->chr_writable) {
+            decodeChr(mapper->chr, mapper->chr_size, mapper->chr_tiles_owned);
+        }
+        mapper->chr_tiles = mapper->chr_tiles_owned;
+    }
+
+    if (cart->flags6 & 0x08) {
+        mapper->mirroring = MIRROR_FOUR_SCREEN;
+    } else {
+        mapper->mirroring = (cart->flags6 & 0x01) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
+    }
+
+    // PRG-RAM is plain memory. PRG-ROM is read straight from the cartridge, and
+    // writes to it go to the mapper's registers.
+    busMapMemory(bus, 0x6000, PRG_RAM_SIZE, mapper->prg_ram, PRG_RAM_SIZE, true);
+    busMapHandlers(bus, 0x4100, 0x1F00, mapperCpuRead, mapperCpuWrite, mapper);
+    busMapHandlers(bus, 0x8000, 0x8000, NULL, mapperCpuWrite, mapper);
+    mapper->ops->reset(mapper);
+
+    return mapper;
+}
+
+/**
+ * Free a mapper (but not the cartridge data it points to)
+ *
+ * @param mapper - The mapper to free
+ */
+void freeMapper(Mapper* mapper) {
+    if (mapper == NULL) {
+        return;
+    }
+
+    free(mapper->chr_tiles_owned);
+    free(mapper->chr_ram);
+    free(mapper);
+}
@@ -0,0 +1,281 @@
+#include "movie.h"
+
+#include "controller.h"
+#include "logger.h"
+#include "savestate.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_HEADER_SIZE (8 + 4 + 8 + 8 + 4 + 4)
+#define MOVIE_LINE_LENGTH (256)
+
+/**
+ * Start recording a movie from the machine's current state
+ *
+ * @param rom_hash - hashRom of the cartridge
+ * @param machine - The machine
+ *
+ * @returns The movie
+ * @returns NULL if memory couldn't be allocated
+ */
+Movie* createMovie(uint64_t rom_hash, const Machine* machine) {
+    Movie* movie = calloc(1, sizeof(Movie));
+    if (movie == NULL) {
+        return NULL;
+    }
+
+    movie->rom_hash = rom_hash;
+    movie->state_size = saveStateSize(machine);
+    movie->start_state = malloc(movie->state_size);
+    if (movie->start_state == NULL) {
+        freeMovie(movie);
+        return NULL;
+    }
+    saveState(machine, movie->start_state, movie->state_size);
+    return movie;
+}
+
+/**
+ * Free a movie
+ *
+ * @param movie - The movie to free
+ */
+void freeMovie(Movie* movie) {
+    free(movie->start_state);
+    free(movie->inputs);
+    free(movie);
+}
+
+/**
+ * Add a frame's buttons to the end of a movie
+ *
+ * @param movie - The movie
+ * @param buttons - The buttons held on each controller
+ *
+ * @returns 0 if the frame was added
+ * @returns -1 if memory couldn't be allocated
+ */
+int movieRecordFrame(Movie* movie, const uint8_t* buttons) {
+    if (movie->frames == movie->capacity) {
+        uint32_t capacity = movie->capacity ? movie->capacity * 2 : 1024;
+        uint8_t* inputs = realloc(movie->inputs, (size_t)capacity * CONTROLLER_PORTS);
+        if (inputs == NULL) {
+            return -1;
+        }
+        movie->inputs = inputs;
+        movie->capacity = capacity;
+    }
+
+    memcpy(movie->inputs + (size_t)movie->frames * CONTROLLER_PORTS, buttons, CONTROLLER_PORTS);
+    movie->frames++;
+    return 0;
+}
+
+/**
+ * Put the machine in a movie's start state
+ *
+ * @param movie - The movie
+ * @param machine - The machine
+ * @param rom_hash - hashRom of the machine's cartridge
+ *
+ * @returns 0 if the start state was loaded
+ * @returns -1 if the movie is for another rom or its start state is invalid
+ */
+int movieStart(const Movie* movie, Machine* machine, uint64_t rom_hash) {
+    if (movie->rom_hash != rom_hash) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Movie was recorded with another rom");
+        return -1;
+    }
+    return loadState(machine, movie->start_state, movie->state_size);
+}
+
+/**
+ * Write a movie to a file
+ *
+ * @param movie - The movie
+ * @param path - The file to write
+ *
+ * @returns 0 if the movie was saved
+ * @returns -1 if the file couldn't be written
+ */
+int saveMovie(const Movie* movie, const char* path) {
+    uint8_t header[MOVIE_HEADER_SIZE];
+    uint8_t* out = header;
+    memcpy(out, MOVIE_MAGIC, 8);
+    out = put32(out + 8, MOVIE_VERSION);
+    out = put64(out, movie->rom_hash);
+    out = put64(out, movie->final_hash);
+    out = put32(out, movie->frames);
+    put32(out, movie->state_size);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return -1;
+    }
+
+    size_t input_size = (size_t)movie->frames * CONTROLLER_PORTS;
+    int result = 0;
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(movie->start_state, 1, movie->state_size, file) != movie->state_size ||
+        fwrite(movie->inputs, 1, input_size, file) != input_size) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", path);
+        result = -1;
+    }
+    fclose(file);
+    return result;
+}
+
+/**
+ * Read a movie from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The movie
+ * @returns NULL if the file couldn't be read or isn't a valid movie
+ */
+Movie* loadMovie(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return NULL;
+    }
+
+    Movie* movie = calloc(1, sizeof(Movie));
+    uint8_t header[MOVIE_HEADER_SIZE];
+    if (movie == NULL || fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, MOVIE_MAGIC, 8) != 0) {
+        fprintf(stderr, "ERROR: %s is not a movie file\n", path);
+        goto FAIL;
+    }
+
+    const uint8_t* in = header + 8;
+    uint32_t version = get32(&in);
+    if (version > MOVIE_VERSION) {
+        fprintf(stderr, "ERROR: %s is from a newer version (%u)\n", path, version);
+        goto FAIL;
+    }
+    movie->rom_hash = get64(&in);
+    movie->final_hash = get64(&in);
+    movie->frames = get32(&in);
+    movie->capacity = movie->frames;
+    movie->state_size = get32(&in);
+
+    size_t input_size = (size_t)movie->frames * CONTROLLER_PORTS;
+    movie->start_state = malloc(movie->state_size);
+    movie->inputs = malloc(input_size ? input_size : 1);
+    if (movie->start_state == NULL || movie->inputs == NULL ||
+        fread(movie->start_state, 1, movie->state_size, file) != movie->state_size ||
+        fread(movie->inputs, 1, input_size, file) != input_size) {
+        fprintf(stderr, "ERROR: %s is cut short\n", path);
+        goto FAIL;
+    }
+
+    fclose(file);
+    return movie;
+
+FAIL:
+    if (movie) {
+        freeMovie(movie);
+    }
+    fclose(file);
+    return NULL;
+}
+
+/**
+ * Read an input script from a file
+ *
+ * @param path - The file to read
+ *
+ * @returns The script
+ * @returns NULL if the file couldn't be read or has an invalid line
+ */
+InputScript* loadInputScript(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return NULL;
+    }
+
+    InputScript* script = calloc(1, sizeof(InputScript));
+    uint32_t capacity = 0;
+    char line[MOVIE_LINE_LENGTH];
+    int line_num = 0;
+
+    while (script != NULL && fgets(line, sizeof(line), file) != NULL) {
+        line_num++;
+
+        char* save;
+        char* frame = strtok_r(line, " \t\r\n", &save);
+        if (frame == NULL || frame[0] == '#') {
+            continue;
+        }
+
+        InputEvent event = {0};
+        char* end;
+        event.frame = strtoull(frame, &end, 10);
+        bool valid = *end == '\0' &&
+                     (script->count == 0 || event.frame > script->events[script->count - 1].frame);
+
+        for (int port = 0; valid && port < CONTROLLER_PORTS; port++) {
+            char* buttons = strtok_r(NULL, " \t\r\n", &save);
+            if (buttons != NULL && parseButtons(buttons, &event.buttons[port]) != 0) {
+                valid = false;
+            }
+        }
+        if (!valid || strtok_r(NULL, " \t\r\n", &save) != NULL) {
+            fprintf(stderr, "ERROR: %s:%d: Expected e.x. \"120 A+RIGHT\" (in frame order)\n",
+                    path, line_num);
+            freeInputScript(script);
+            script = NULL;
+            break;
+        }
+
+        if (script->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            InputEvent* events = realloc(script->events, capacity * sizeof(InputEvent));
+            if (events == NULL) {
+                freeInputScript(script);
+                script = NULL;
+                break;
+            }
+            script->events = events;
+        }
+        script->events[script->count++] = event;
+    }
+
+    fclose(file);
+    return script;
+}
+
+/**
+ * Free an input script
+ *
+ * @param script - The script to free
+ */
+void freeInputScript(InputScript* script) {
+    free(script->events);
+    free(script);
+}
+
+/**
+ * Find the buttons the script holds down on a frame. Frames have to be asked
+ * for in order.
+ *
+ * @param script - The script
+ * @param frame - The frame (counted from the start of the run)
+ * @param buttons - Set to the buttons held on each controller (left as they
+ *                  were if nothing changes on the frame)
+ */
+void inputScriptButtons(InputScript* script, uint64_t frame, uint8_t* buttons) {
+    while (script->next < script->count && script->events[script->next].frame <= frame) {
+        memcpy(buttons, script->events[script->next].buttons, CONTROLLER_PORTS);
+        script->next++;
+    }
+}
@@ -1,54 +1,121 @@
 #include "6502.h"
+#include "apu.h"
+#include "batch.h"
+#include "blockcache.h"
+#include "bus.h"
 #include "cartridge.h"
+#include "controller.h"
+#include "emulator.h"
+#include "golden.h"
+#include "interpreter.h"
+#include "jit.h"
 #include "logger.h"
+#include "mapper.h"
+#include "movie.h"
+#include "pacer.h"
+#include "ppu.h"
+#include "recorder.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "scheduler.h"
+#include "trace.h"
 #include "types.h"
 #include "utils.h"
 
 #include <assert.h>
+#include <getopt.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <unistd.h>
 
-// Pointer to simulator memory
-uint8_t* memory;
 #define MAX_SIZE 50
 
-// Global cycle count variable for synchronizing the CPU, PPU, and APU
-uint64_t cycles = 0;
-
 int loadFile(uint8_t* mem, int start_addr, const char* file_path);
 int intToBin(uint8_t n);
-void addAdditionalCycles(Instruction* instr, Processor processor, uint16_t old_PC);
-void delayCycles(int cycles);
 
 #ifndef TEST
 
 int main(int argc, char** argv) {
     bool opt_disassemble = false, opt_run = false, opt_cart = false, opt_emu = false;
+    bool opt_block_cache = false, opt_jit = false, opt_verify = false, opt_format_trace = false;
 
     Processor processor;
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
-
-    Cartridge cartridge;
-    cartridge.trainer = NULL;
-    cartridge.prg_rom = NULL;
-    cartridge.chr_rom = NULL;
+    processor.block_cache = NULL;
+
+    // Programs run with -d and -r get the whole address space as RAM, while -e
+    // runs on an emulator with a memory map of its own
+    uint8_t* memory = NULL;
+    uint64_t cycles = 0;
+    Bus* bus = NULL;
+    BlockCache* block_cache = NULL;
+    Jit* jit = NULL;
+    Emulator* emu = NULL;
+    Tracer* tracer = NULL;
+    Rewind* history = NULL;
+    Movie* movie = NULL;
+    InputScript* script = NULL;
+    Recorder* recorder = NULL;
+
+    Cartridge cartridge = {0};
 
     char* data_file = NULL;
     char* rom_file = NULL;
+    char* frame_file = NULL;
+    uint64_t frame_limit = 0;
+    double speed = 1.0;
+    char* trace_file = NULL;
+    char* golden_file = NULL;
+    char* encode_file = NULL;
+    TraceFormat trace_format = TRACE_FORMAT_TEXT;
+    char* save_state_file = NULL;
+    char* load_state_file = NULL;
+    double rewind_seconds = 0;
+    uint32_t rewind_interval = 1;
+    uint32_t rewind_steps = 0;
+    char* record_file = NULL;
+    char* play_file = NULL;
+    char* input_file = NULL;
+    char* batch_file = NULL;
+    char* wav_file = NULL;
+    char* video_file = NULL;
+    int workers = 0;
+    int exit_code = EXIT_SUCCESS;
+
+    static const struct option long_options[] = {
+        {"speed", required_argument, NULL, 's'},
+        {"trace", required_argument, NULL, 'T'},
+        {"trace-format", required_argument, NULL, 'F'},
+        {"log-level", required_argument, NULL, 'L'},
+        {"save-state", required_argument, NULL, 'S'},
+        {"load-state", required_argument, NULL, 'R'},
+        {"rewind", required_argument, NULL, 'W'},
+        {"rewind-interval", required_argument, NULL, 'I'},
+        {"rewind-steps", required_argument, NULL, 'B'},
+        {"record", required_argument, NULL, 'M'},
+        {"play", required_argument, NULL, 'P'},
+        {"input", required_argument, NULL, 'N'},
+        {"batch", required_argument, NULL, 'A'},
+        {"jobs", required_argument, NULL, 'J'},
+        {"wav", required_argument, NULL, 'U'},
+        {"video", required_argument, NULL, 'V'},
+        {"golden", required_argument, NULL, 'G'},
+        {"encode-trace", required_argument, NULL, 'E'},
+        {NULL, 0, NULL, 0},
+    };
 
     int arg;
-    while ((arg = getopt(argc, argv, "d:r:c:e:")) != -1) {
+    while ((arg = getopt_long(argc, argv, "d:r:c:e:bjvf:o:t:", long_options, NULL)) != -1) {
         switch (arg) {
             case 'd':
                 opt_disassemble = true;
@@ -66,18 +133,143 @@ int main(int argc, char** argv) {
                 opt_emu = true;
                 rom_file = optarg;
                 break;
+            case 'b':
+                opt_block_cache = true;
+                break;
+            case 'j':
+                opt_jit = true;
+                break;
+            case 'v':
+                opt_jit = true;
+                opt_verify = true;
+                break;
+            case 'f':
+                frame_limit = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                frame_file = optarg;
+                break;
+            case 's':
+                if (parseSpeed(optarg, &speed) != 0) {
+                    fprintf(stderr, "ERROR: Invalid speed: %s (use unlimited or e.x. 2x)\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'T':
+                trace_file = optarg;
+                break;
+            case 't':
+                opt_format_trace = true;
+                trace_file = optarg;
+                break;
+            case 'F':
+                if (parseTraceFormat(optarg, &trace_format) != 0) {
+                    fprintf(stderr, "ERROR: Invalid trace format: %s (use text or nestest)\n",
+                            optarg);
+                    return -1;
+                }
+                break;
+            case 'L': {
+                LogLevel level;
+                if (parseLogLevel(optarg, &level) != 0) {
+                    fprintf(stderr, "ERROR: Invalid log level: %s (use e.x. debug or warning)\n",
+                            optarg);
+                    return -1;
+                }
+                setLogLevel(level);
+                break;
+            }
+            case 'S':
+                save_state_file = optarg;
+                break;
+            case 'R':
+                load_state_file = optarg;
+                break;
+            case 'W':
+                rewind_seconds = strtod(optarg, NULL);
+                break;
+            case 'I':
+                rewind_interval = strtoul(optarg, NULL, 10);
+                break;
+            case 'B':
+                rewind_steps = strtoul(optarg, NULL, 10);
+                break;
+            case 'M':
+                record_file = optarg;
+                break;
+            case 'P':
+                play_file = optarg;
+                break;
+            case 'N':
+                input_file = optarg;
+                break;
+            case 'A':
+                batch_file = optarg;
+                break;
+            case 'J':
+                workers = strtol(optarg, NULL, 10);
+                break;
+            case 'U':
+                wav_file = optarg;
+                break;
+            case 'V':
+                video_file = optarg;
+                break;
+            case 'G':
+                golden_file = optarg;
+                break;
+            case 'E':
+                encode_file = optarg;
+                break;
             default:
                 fprintf(stderr, "ERROR: Invalid argument: %c\n", optopt);
                 return -1;
         }
     }
 
+    if (opt_format_trace) {
+        // Print a trace recorded by -e --trace as text
+        long long records = formatTraceFile(trace_file, trace_format, stdout);
+        return records < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (encode_file != NULL) {
+        // Convert a text log (e.x. nestest.log) into a trace file for --golden
+        if (trace_file == NULL) {
+            fprintf(stderr, "ERROR: --encode-trace needs a --trace file to write\n");
+            return EXIT_FAILURE;
+        }
+        long long records = encodeTraceLog(encode_file, trace_file);
+        if (records < 0) {
+            return EXIT_FAILURE;
+        }
+        printf("Encoded %lld records from %s into %s\n", records, encode_file, trace_file);
+        return EXIT_SUCCESS;
+    }
+
+    if (batch_file != NULL) {
+        // Run every rom in the manifest headless, on a worker per core unless
+        // --jobs says otherwise
+        Batch* batch = loadBatch(batch_file);
+        if (batch == NULL) {
+            return EXIT_FAILURE;
+        }
+        runBatch(batch, workers > 0 ? workers : batchWorkers());
+        flushLog();
+        uint32_t failures = printBatchReport(batch, stdout);
+        freeBatch(batch);
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Allocate system memory
-    assert(memory == NULL);
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
     assert(memory != NULL);
     int prog_line_count = 0;
 
+    // Programs run with -d and -r see the whole address space as RAM
+    bus = createFlatBus(memory);
+    assert(bus != NULL);
+
     if (data_file != NULL) {
         prog_line_count = loadFile(memory, processor.PC, data_file);
     }
@@ -85,7 +277,7 @@ int main(int argc, char** argv) {
     if (opt_disassemble) {
         // Disassemble a 6502 assembly hexdump
         while (prog_line_count > 0) {
-            Instruction instr = parseInstruction(memory, processor.PC);
+            Instruction instr = parseInstruction(bus, processor.PC);
             printInstruction(instr);
             processor.PC += instr.length;
             prog_line_count -= instr.length;
@@ -95,36 +287,60 @@ int main(int argc, char** argv) {
         // Run a 6502 assembly program hexdump
         processor.halted = false;
 
-        while (processor.PC != 0x0600 + prog_line_count && !processor.halted) {
-            // Main loop
-            Instruction instr = parseInstruction(memory, processor.PC);
-            executeInstruction(instr, &memory, &processor);
-            processor.PC += instr.length;
-            cycles += instr.cycles;
+        // Main loop
+        if (opt_block_cache || opt_jit) {
+            block_cache = createBlockCache();
+            assert(block_cache != NULL);
+        }
+        if (opt_jit) {
+            jit = createJit(block_cache, opt_verify);
+        }
+
+        if (jit) {
+            runJit(jit, bus, &processor, &cycles, UINT64_MAX, 0x0600 + prog_line_count);
+        } else if (block_cache) {
+            runBlocks(block_cache, bus, &processor, &cycles, UINT64_MAX,
+                      0x0600 + prog_line_count);
+        } else {
+            runInstructions(bus, &processor, &cycles, UINT64_MAX, 0x0600 + prog_line_count);
         }
 
+        syncFlags(&processor);
         printf("-------- Debug Output --------\n");
         printf("     A=$%02x  X=$%02x  Y=$%02x\n", processor.A, processor.X, processor.Y);
         printf("      SP=$%02x  PC=$%04x\n", processor.S, processor.PC);
         printf("          NV-BDIZC\n");
         printf("          %08d\n", intToBin(processor.P));
         printf("------------------------------\n");
+
+        if (block_cache) {
+            printf("\n");
+            printBlockCacheStats(block_cache);
+        }
+        if (jit) {
+            printf("\n");
+            printJitStats(jit);
+        }
     }
     if (opt_cart) {
         // View ROM file metadata and beginning of PRG-ROM
         int result = loadRom(&cartridge, rom_file);
         if (result != 0) {
-            printLog("CART", "Failed to laod rom", "ERROR");
+            LOG(COMP_CART, LEVEL_ERROR, "Failed to load rom");
             return EXIT_FAILURE;
         }
 
         printCartMetadata(&cartridge);
 
-        // Print preview of instructions in PRG-ROM
+        // Print preview of instructions in PRG-ROM (mapped at $8000, like the CPU sees it)
+        uint32_t prg_size = cartridge.prg_rom_bytes;
+        busMapMemory(bus, 0x8000, 0x8000, cartridge.prg_rom, prg_size < 0x8000 ? prg_size : 0x8000,
+                     false);
+
         printf("\n------------ PRG-ROM Preview -----------\n");
-        uint16_t fake_PC = 0;
-        while (fake_PC < 10) {
-            Instruction instr = parseInstruction(cartridge.prg_rom, fake_PC);
+        uint16_t fake_PC = 0x8000;
+        while (fake_PC < 0x8000 + 10) {
+            Instruction instr = parseInstruction(bus, fake_PC);
             printInstruction(instr);
             fake_PC += instr.length;
         }
@@ -135,85 +351,297 @@ int main(int argc, char** argv) {
         printf("----------------------------------------\n");
         printf("     MadNES: A Crappy NES Emulator\n");
         printf("----------------------------------------\n\n");
-        printLog("CART", "Loading ROM...", "INFO");
-
-        int result = loadRom(&cartridge, rom_file);
-        if (result != 0) {
-            printLog("CART", "Failed to load rom", "ERROR");
-            return EXIT_FAILURE;
+        LOG(COMP_CART, LEVEL_INFO, "Loading ROM...");
+
+        // Load the rom and map it, the PPU, the APU, and the controllers into
+        // the CPU address space
+        emu = createEmulator(rom_file);
+        if (emu == NULL) {
+            LOG(COMP_CART, LEVEL_ERROR, "Failed to load rom");
+            exit_code = EXIT_FAILURE;
+            goto PROGRAM_EXIT;
         }
 
-        printLog("CART", "Success! ROM data loaded!", "INFO");
+        LOG(COMP_CART, LEVEL_INFO, "Finished mapping PRG-ROM into memory at $8000! (Mapper %d, %s)",
+            emu->mapper->number, emu->mapper->ops->name);
 
+        // Log lines are buffered, so write them out before printing anything else
+        flushLog();
         printf("\n");
-        printCartMetadata(&cartridge);
+        printCartMetadata(&emu->cartridge);
 
-        // Load the contents of PRG-ROM into memory
-        printLog("CART", "Loading PRG-ROM into memory...", "INFO");
-        int mapper_num = ((cartridge.flags8 & 0x0F) << 8) | ((cartridge.flags7 & 0xF0) << 4) |
-                         (cartridge.flags6 & 0xF0);
-        switch (mapper_num) {
-            case 0:
-                // Mapper 0
-                for (int i = 0; i < cartridge.prg_rom_size * 16 * 1024; i++) {
-                    memory[0x8000 + i] = cartridge.prg_rom[i];
-                }
-                printLog("CART", "Finished loading PRG-ROM into memory at $8000! (Mapper 0)",
-                         "INFO");
-                break;
-            default:
-                printf("INFO: Support for ROMs using mapper %d has not yet been implemented",
-                       mapper_num);
+        PPU* ppu = emu->ppu;
+
+        // Pick up where a previous run left off
+        if (load_state_file != NULL) {
+            if (loadStateFile(&emu->machine, load_state_file) != 0) {
+                exit_code = EXIT_FAILURE;
                 goto PROGRAM_EXIT;
+            }
+            LOG(COMP_STATE, LEVEL_INFO, "Loaded %s (frame %llu)", load_state_file,
+                (unsigned long long)ppu->frame);
         }
 
-        uint16_t reset_vector = concatenateBytes(memory[0xFFFD], memory[0xFFFC]);
-        processor.PC = reset_vector;
+        // A movie replays from its own start state. A recording starts from the
+        // state it saved, so the two start out exactly the same way.
+        if (play_file != NULL) {
+            movie = loadMovie(play_file);
+            if (movie == NULL) {
+                exit_code = EXIT_FAILURE;
+                goto PROGRAM_EXIT;
+            }
+            frame_limit = movie->frames;
+        } else if (record_file != NULL) {
+            movie = createMovie(hashRom(&emu->cartridge), &emu->machine);
+            assert(movie != NULL);
+        }
+        if (movie && movieStart(movie, &emu->machine, hashRom(&emu->cartridge)) != 0) {
+            exit_code = EXIT_FAILURE;
+            goto PROGRAM_EXIT;
+        }
+
+        if (input_file != NULL) {
+            script = loadInputScript(input_file);
+            if (script == NULL) {
+                exit_code = EXIT_FAILURE;
+                goto PROGRAM_EXIT;
+            }
+        }
 
         printf("\n");
-        char* prg_start_msg;
-        asprintf(&prg_start_msg, "Beginning program execution at $%04x", processor.PC);
-        printLog("CPU", prg_start_msg, "INFO");
+        LOG(COMP_CPU, LEVEL_INFO, "Beginning program execution at $%04x", emu->processor.PC);
+        flushLog();
         printf("\n");
 
-        processor.halted = false;
+        emu->processor.halted = false;
 
-        // Main loop
-        while (!processor.halted) {
-            uint16_t old_PC = processor.PC;
+        // Records go to a ring that a background thread writes out, so the CPU
+        // only has to fill in a record per instruction
+        if (trace_file != NULL) {
+            tracer = createTracer(trace_file);
+            if (tracer == NULL) {
+                exit_code = EXIT_FAILURE;
+                goto PROGRAM_EXIT;
+            }
+            emu->tracer = tracer;
+        }
+
+        // Frames and audio are written by a thread of their own, so the main
+        // loop never waits on a file. Audio is only synthesized when something's
+        // listening.
+        if (video_file != NULL || wav_file != NULL) {
+            recorder = createRecorder(video_file, wav_file);
+            if (recorder == NULL) {
+                exit_code = EXIT_FAILURE;
+                goto PROGRAM_EXIT;
+            }
+            if (wav_file != NULL) {
+                apuSetOutput(emu->apu, recorderPushAudio, recorder);
+            }
+        }
 
-            Instruction instr = parseInstruction(memory, processor.PC);
+        // -j compiles hot code, which goes through the bus like the interpreter
+        // does. Interrupts are taken between runs and push with stackPush, so
+        // the processor keeps the cache to invalidate the whole time.
+        if (opt_jit) {
+            block_cache = createBlockCache();
+            assert(block_cache != NULL);
+            jit = createJit(block_cache, opt_verify);
+            emu->jit = jit;
+            emu->processor.block_cache = jit ? block_cache : NULL;
+        }
 
-            // Logging messages
-            printInstrLog(instr, processor);
+        // Check every instruction against a known good log instead of running
+        // freely, stopping at the first one that differs
+        if (golden_file != NULL) {
+            if (validateGolden(emu, golden_file, trace_format, stdout) < 0) {
+                exit_code = EXIT_FAILURE;
+            }
+            goto PROGRAM_EXIT;
+        }
 
-            executeInstruction(instr, &memory, &processor);
-            processor.PC += instr.length;
+        // Keep the last --rewind seconds of states, so the run can step back from
+        // where it stopped
+        if (rewind_seconds > 0) {
+            history =
+                createRewind(&emu->machine, rewind_seconds, rewind_interval, REWIND_ARENA_SIZE);
+            if (history == NULL) {
+                LOG(COMP_STATE, LEVEL_ERROR, "Invalid rewind length or interval");
+                exit_code = EXIT_FAILURE;
+                goto PROGRAM_EXIT;
+            }
+        }
+
+        // Sleep once a frame to run at --speed times real time
+        Pacer pacer;
+        initPacer(&pacer, speed, emu->cycles);
+
+        // Main loop (-f stops after the given number of frames, and a movie
+        // stops at the end of its inputs, even if it has none)
+        uint64_t start_frame = ppu->frame;
+        uint64_t end_frame = start_frame + frame_limit;
+        bool limited = frame_limit != 0 || play_file != NULL;
+        uint64_t input_frame = UINT64_MAX;
+        uint64_t recorded_frame = ppu->frame;
+        bool driven = movie || script;
+        while (!emu->processor.halted && (!limited || ppu->frame < end_frame)) {
+            // The buttons change at the start of each frame
+            if (driven && ppu->frame != input_frame) {
+                input_frame = ppu->frame;
+                if (play_file) {
+                    memcpy(emu->controllers.buttons, movieFrame(movie, input_frame - start_frame),
+                           CONTROLLER_PORTS);
+                } else {
+                    if (script) {
+                        inputScriptButtons(script, input_frame - start_frame,
+                                           emu->controllers.buttons);
+                    }
+                    if (movie && movieRecordFrame(movie, emu->controllers.buttons) != 0) {
+                        LOG(COMP_STATE, LEVEL_ERROR, "Ran out of memory for the movie");
+                        exit_code = EXIT_FAILURE;
+                        goto PROGRAM_EXIT;
+                    }
+                }
+            }
+
+            emulatorRun(emu);
+
+            if (recorder && ppu->frame != recorded_frame) {
+                recorded_frame = ppu->frame;
+                recorderPushFrame(recorder, &ppu->framebuffer[0][0]);
+            }
+
+            if (pacerDue(&pacer, emu->cycles)) {
+                pacerWait(&pacer, emu->cycles);
+            }
+
+            if (history && rewindDue(history, ppu->frame)) {
+                rewindPush(history, &emu->machine);
+            }
+        }
+        schedulerSync(&emu->scheduler);
+
+        if (recorder) {
+            apuFlush(emu->apu);
+            if (video_file) {
+                LOG(COMP_PPU, LEVEL_INFO, "Queued %llu frames for %s (dropped %llu)",
+                    (unsigned long long)recorder->frames->pushed, video_file,
+                    (unsigned long long)recorder->frames->dropped);
+            }
+            if (wav_file) {
+                LOG(COMP_APU, LEVEL_INFO, "Queued %.2f s of audio for %s (dropped %llu blocks)",
+                    (double)emu->apu->samples / APU_SAMPLE_RATE, wav_file,
+                    (unsigned long long)recorder->audio->dropped);
+            }
+        }
 
-            // Add additional processor cycles if the instruction crosses a page
-            addAdditionalCycles(&instr, processor, old_PC);
+        // Replaying a movie has to end in exactly the state recording it did
+        if (movie) {
+            uint64_t hash = saveStateHash(&emu->machine);
+            if (play_file && hash == movie->final_hash) {
+                LOG(COMP_STATE, LEVEL_INFO, "Replayed %u frames of %s (state hash %016llx)",
+                    movie->frames, play_file, (unsigned long long)hash);
+            } else if (play_file) {
+                LOG(COMP_STATE, LEVEL_ERROR, "Replay of %s ended in state %016llx, not %016llx",
+                    play_file, (unsigned long long)hash, (unsigned long long)movie->final_hash);
+                exit_code = EXIT_FAILURE;
+            } else {
+                movie->final_hash = hash;
+                if (saveMovie(movie, record_file) == 0) {
+                    LOG(COMP_STATE, LEVEL_INFO, "Recorded %u frames to %s (state hash %016llx)",
+                        movie->frames, record_file, (unsigned long long)hash);
+                }
+            }
+        }
 
-            cycles += instr.cycles;
-            delayCycles(instr.cycles);
+        if (history) {
+            LOG(COMP_STATE, LEVEL_INFO, "Kept %u states in %zu bytes (took %llu, dropped %llu)",
+                rewindDepth(history), rewindUsage(history), (unsigned long long)history->pushes,
+                (unsigned long long)history->evictions);
+
+            // Step back before saving the state or writing the frame
+            if (rewind_steps > 0) {
+                int steps = rewindStep(history, &emu->machine, rewind_steps);
+                if (steps < 0) {
+                    exit_code = EXIT_FAILURE;
+                    goto PROGRAM_EXIT;
+                }
+                LOG(COMP_STATE, LEVEL_INFO, "Rewound %d states to frame %llu", steps,
+                    (unsigned long long)ppu->frame);
+            }
+        }
+
+        LOG(COMP_SCHED, LEVEL_INFO, "Caught the PPU and APU up %llu times in %llu CPU cycles",
+            (unsigned long long)emu->scheduler.syncs, (unsigned long long)emu->cycles);
+
+        if (speed > 0) {
+            LOG(COMP_PACE, LEVEL_INFO, "Slept %.1f ms over %llu frames (fell behind %llu times)",
+                pacer.slept_ns / 1e6, (unsigned long long)pacer.frames,
+                (unsigned long long)pacer.resyncs);
+        }
+
+        if (emu->mapper->chr_writable) {
+            LOG(COMP_PPU, LEVEL_INFO, "Decoded %llu CHR-RAM tiles again (at most %u in a frame)",
+                (unsigned long long)emu->mapper->tile_rebuilds, ppu->peak_tile_rebuilds);
+        }
+
+        if (jit) {
+            printf("\n");
+            printJitStats(jit);
+        }
+
+        if (tracer) {
+            LOG(COMP_TRACE, LEVEL_INFO,
+                "Traced %llu instructions to %s (waited on the writer %llu times)",
+                (unsigned long long)tracer->head, trace_file, (unsigned long long)tracer->stalls);
+        }
+
+        if (save_state_file && saveStateFile(&emu->machine, save_state_file) == 0) {
+            LOG(COMP_STATE, LEVEL_INFO, "Saved frame %llu to %s", (unsigned long long)ppu->frame,
+                save_state_file);
+        }
+
+        if (frame_file && ppuWritePpm(ppu, frame_file) == 0) {
+            LOG(COMP_PPU, LEVEL_INFO, "Wrote frame %llu to %s", (unsigned long long)ppu->frame,
+                frame_file);
         }
     }
 
 PROGRAM_EXIT:
-    // Free dynamic memory after run
+    // Free dynamic memory after run (freeing the tracer writes out the rest of the trace)
+    if (tracer && freeTracer(tracer) != 0) {
+        exit_code = EXIT_FAILURE;
+    }
+    if (history) {
+        freeRewind(history);
+    }
+    if (movie) {
+        freeMovie(movie);
+    }
+    if (script) {
+        freeInputScript(script);
+    }
+    if (recorder && freeRecorder(recorder) != 0) {
+        exit_code = EXIT_FAILURE;
+    }
     if (memory) {
         free(memory);
     }
-    if (cartridge.trainer) {
-        free(cartridge.trainer);
+    if (emu) {
+        freeEmulator(emu);
+    }
+    if (bus) {
+        freeBus(bus);
     }
-    if (cartridge.prg_rom) {
-        free(cartridge.prg_rom);
+    if (jit) {
+        freeJit(jit);
     }
-    if (cartridge.chr_rom) {
-        free(cartridge.chr_rom);
+    if (block_cache) {
+        freeBlockCache(block_cache);
     }
+    unloadRom(&cartridge);
 
-    return EXIT_SUCCESS;
+    return exit_code;
 }
 
 #endif
@@ -261,62 +689,3 @@ int loadFile(uint8_t* mem, int start_addr, const char* file_path) {
 int intToBin(uint8_t n) {
     return (n == 0 || n == 1 ? n : ((n % 2) + 10 * intToBin(n / 2)));
 }
-
-/**
- * Add additional cycles to the given instruction if it crosses a page
- *
- * @param instr - The instruction to potentially add cycles to
- * @param processor - The struct acting as the system processor
- * @param old_PC - The value of the PC before the instruction was executed
- */
-void addAdditionalCycles(Instruction* instr, Processor processor, uint16_t old_PC) {
-    // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
-    // Relative, check if a page was crossed and add an extra cycle
-    switch (instr->addr_mode) {
-        uint16_t addr;
-        case ABSX:
-            addr = instr->addr;
-            if (((addr + processor.X) & 0xFF00) != (addr & 0xFF00)) {
-                instr->cycles++;
-            }
-            break;
-        case ABSY:
-            addr = instr->addr;
-            if (((addr + processor.Y) & 0xFF00) != (addr & 0xFF00)) {
-                instr->cycles++;
-            }
-            break;
-        case INDY:
-            addr = concatenateBytes(memory[instr->addr + 1], memory[instr->addr]);
-            if (((addr + processor.Y) & 0xFF00) != (addr & 0xFF00)) {
-                instr->cycles++;
-            }
-            break;
-        case REL:
-            if (processor.PC != old_PC + instr->length) {
-                // Branch succeeded
-                instr->cycles++;
-
-                if ((processor.PC & 0xFF00) != (old_PC & 0xFF00)) {
-                    // Page crossed
-                    instr->cycles++;
-                }
-            }
-        default:
-            break;
-    }
-}
-
-/**
- * Sleep for the given amount of time
- *
- * @param cycles - the number of cycles to delay for
- */
-void delayCycles(int cycles) {
-    double delay = (1.0 / 1789773) * cycles;
-
-    struct timespec ts;
-    ts.tv_sec = (time_t)delay;
-    ts.tv_nsec = (long)((delay - ts.tv_sec) * 1e9);
-    nanosleep(&ts, NULL);
-}
@@ -0,0 +1,122 @@
+#include "pacer.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Parse a --speed argument: "unlimited", or a multiple of real time like "2x"
+ * or "0.5x" (the x is optional)
+ *
+ * @param arg - The argument to parse
+ * @param speed - Set to the multiple of real time, or 0 for unlimited
+ *
+ * @returns 0 if the argument is valid
+ * @returns -1 if it isn't
+ */
+int parseSpeed(const char* arg, double* speed) {
+    if (strcmp(arg, "unlimited") == 0) {
+        *speed = 0;
+        return 0;
+    }
+
+    char* end;
+    double value = strtod(arg, &end);
+    if (end == arg || !isfinite(value) || !(value > 0)) {
+        return -1;
+    }
+    if (*end == 'x' || *end == 'X') {
+        end++;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+
+    *speed = value;
+    return 0;
+}
+
+/**
+ * Get the current time of the monotonic clock
+ *
+ * @returns The time in nanoseconds
+ */
+uint64_t pacerNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Start pacing from the given CPU cycle
+ *
+ * @param pacer - The pacer to set up
+ * @param speed - The multiple of real time to run at (0 for unlimited)
+ * @param cycle - The current CPU cycle
+ */
+void initPacer(Pacer* pacer, double speed, uint64_t cycle) {
+    *pacer = (Pacer){0};
+    pacer->speed = speed;
+    pacer->base_ns = pacerNow();
+    pacer->base_cycle = cycle;
+    pacer->next_frame = cycle * 2 + HALF_CYCLES_PER_FRAME;
+}
+
+/**
+ * Find when the given CPU cycle should be reached, going by the pacer's speed
+ *
+ * @param pacer - The pacer
+ * @param cycle - The CPU cycle
+ *
+ * @returns The monotonic clock time (in nanoseconds)
+ */
+uint64_t pacerDeadline(const Pacer* pacer, uint64_t cycle) {
+    if (pacer->speed <= 0) {
+        return pacer->base_ns;
+    }
+
+    double elapsed = (double)(cycle - pacer->base_cycle) * 1e9 / (CPU_CLOCK_HZ * pacer->speed);
+    return pacer->base_ns + (uint64_t)elapsed;
+}
+
+/**
+ * Sleep until the CPU cycle is due, and move on to the next frame boundary. If
+ * emulation has fallen more than PACER_MAX_LAG_NS behind, pacing starts over
+ * from now instead of running flat out to catch up.
+ *
+ * @param pacer - The pacer
+ * @param cycle - The current CPU cycle
+ */
+void pacerWait(Pacer* pacer, uint64_t cycle) {
+    // A long instruction (or OAM DMA) can skip past more than one boundary
+    while (pacer->next_frame <= cycle * 2) {
+        pacer->next_frame += HALF_CYCLES_PER_FRAME;
+        pacer->frames++;
+    }
+
+    if (pacer->speed <= 0) {
+        return;
+    }
+
+    uint64_t deadline = pacerDeadline(pacer, cycle);
+    uint64_t now = pacerNow();
+    if (now >= deadline) {
+        if (now - deadline > PACER_MAX_LAG_NS) {
+            pacer->base_ns = now;
+            pacer->base_cycle = cycle;
+            pacer->resyncs++;
+        }
+        return;
+    }
+
+    uint64_t delay = deadline - now;
+    struct timespec ts;
+    ts.tv_sec = delay / 1000000000;
+    ts.tv_nsec = delay % 1000000000;
+    nanosleep(&ts, NULL);
+
+    pacer->sleeps++;
+    pacer->slept_ns += delay;
+}
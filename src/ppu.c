@@ -0,0 +1,725 @@
+#include "ppu.h"
+
+#include "bus.h"
+#include "logger.h"
+#include "mapper.h"
+#include "render.h"
+#include "scheduler.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// PPUCTRL bits
+#define CTRL_INCREMENT   0x04  // VRAM address increment per PPUDATA access (0: 1, 1: 32)
+#define CTRL_SPRITE_BASE 0x08  // Sprite pattern table for 8x8 sprites (0: $0000, 1: $1000)
+#define CTRL_BG_BASE     0x10  // Background pattern table (0: $0000, 1: $1000)
+#define CTRL_TALL        0x20  // Sprite size (0: 8x8, 1: 8x16)
+#define CTRL_NMI         0x80  // Generate an NMI at the start of vblank
+
+// PPUMASK bits
+#define MASK_GREYSCALE   0x01
+#define MASK_BG_LEFT     0x02  // Show the background in the leftmost 8 pixels
+#define MASK_SPRITE_LEFT 0x04  // Show sprites in the leftmost 8 pixels
+#define MASK_BG          0x08
+#define MASK_SPRITES     0x10
+
+// PPUSTATUS bits
+#define STATUS_OVERFLOW    0x20
+#define STATUS_SPRITE_ZERO 0x40
+#define STATUS_VBLANK      0x80
+
+#define OAM_DMA_CYCLES 513
+
+// ---------- PPU Memory ----------
+
+// Index into vram of a nametable address ($2000-$3EFF), after mirroring
+static uint16_t nametableIndex(const PPU* ppu, uint16_t addr) {
+    uint16_t table = (addr >> 10) & 0x03;
+    uint16_t offset = addr & 0x03FF;
+
+    switch (ppu->mapper->mirroring) {
+        case MIRROR_HORIZONTAL:
+            return ((table >> 1) << 10) | offset;
+        case MIRROR_VERTICAL:
+            return ((table & 0x01) << 10) | offset;
+        case MIRROR_SINGLE_LOW:
+            return offset;
+        case MIRROR_SINGLE_HIGH:
+            return 0x0400 | offset;
+        case MIRROR_FOUR_SCREEN:
+        default:
+            return (table << 10) | offset;
+    }
+}
+
+// Index into palette of a palette address ($3F00-$3FFF). The backdrop entries of
+// the sprite palettes ($3F10/$3F14/$3F18/$3F1C) are the background's.
+static uint8_t paletteIndex(uint16_t addr) {
+    addr &= 0x1F;
+    if ((addr & 0x13) == 0x10) {
+        addr &= 0x0F;
+    }
+    return addr;
+}
+
+static uint8_t ppuRead(PPU* ppu, uint16_t addr) {
+    addr &= 0x3FFF;
+    if (addr < 0x2000) {
+        return mapperPpuRead(ppu->mapper, addr);
+    }
+    if (addr < 0x3F00) {
+        return ppu->vram[nametableIndex(ppu, addr)];
+    }
+    return ppu->palette[paletteIndex(addr)];
+}
+
+static void ppuWrite(PPU* ppu, uint16_t addr, uint8_t val) {
+    addr &= 0x3FFF;
+    if (addr < 0x2000) {
+        mapperPpuWrite(ppu->mapper, addr, val);
+    } else if (addr < 0x3F00) {
+        ppu->vram[nametableIndex(ppu, addr)] = val;
+    } else {
+        ppu->palette[paletteIndex(addr)] = val & 0x3F;
+    }
+}
+
+// ---------- Registers ----------
+
+static void updateNmi(PPU* ppu) {
+    bool nmi = ppu->nmi_occurred && ppu->nmi_output;
+    if (nmi && !ppu->nmi_line) {
+        ppu->nmi_pending = true;
+    }
+    ppu->nmi_line = nmi;
+}
+
+/**
+ * Read one of the PPU's registers
+ *
+ * @param ppu - The PPU
+ * @param addr - The CPU address of the register ($2000-$3FFF)
+ *
+ * @returns The value of the register
+ */
+uint8_t ppuReadRegister(PPU* ppu, uint16_t addr) {
+    switch (addr & 0x07) {
+        case 2:
+            // PPUSTATUS (the low bits are whatever was last on the bus)
+            ppu->open_bus = (ppu->status & 0xE0) | (ppu->open_bus & 0x1F);
+            ppu->status &= ~STATUS_VBLANK;
+            ppu->nmi_occurred = false;
+            ppu->w = false;
+            updateNmi(ppu);
+            break;
+        case 4:
+            // OAMDATA
+            ppu->open_bus = ppu->oam[ppu->oam_addr];
+            break;
+        case 7:
+            // PPUDATA. Reads below the palettes are delayed by a buffer, while
+            // palette reads are immediate (and fill the buffer with the
+            // nametable byte "underneath" them).
+            if ((ppu->v & 0x3FFF) < 0x3F00) {
+                ppu->open_bus = ppu->data_buffer;
+                ppu->data_buffer = ppuRead(ppu, ppu->v);
+            } else {
+                ppu->open_bus = (ppu->open_bus & 0xC0) | ppuRead(ppu, ppu->v);
+                ppu->data_buffer = ppuRead(ppu, ppu->v - 0x1000);
+            }
+            ppu->v += (ppu->ctrl & CTRL_INCREMENT) ? 32 : 1;
+            break;
+        default:
+            // Write-only registers
+            break;
+    }
+
+    return ppu->open_bus;
+}
+
+/**
+ * Write one of the PPU's registers
+ *
+ * @param ppu - The PPU
+ * @param addr - The CPU address of the register ($2000-$3FFF)
+ * @param val - The value to write
+ */
+void ppuWriteRegister(PPU* ppu, uint16_t addr, uint8_t val) {
+    ppu->open_bus = val;
+
+    switch (addr & 0x07) {
+        case 0:
+            // PPUCTRL (the nametable select goes into t)
+            ppu->ctrl = val;
+            ppu->t = (ppu->t & 0xF3FF) | ((val & 0x03) << 10);
+            ppu->nmi_output = val & CTRL_NMI;
+            updateNmi(ppu);
+            break;
+        case 1:
+            // PPUMASK
+            ppu->mask = val;
+            break;
+        case 3:
+            // OAMADDR
+            ppu->oam_addr = val;
+            break;
+        case 4:
+            // OAMDATA
+            ppu->oam[ppu->oam_addr++] = val;
+            break;
+        case 5:
+            // PPUSCROLL (X, then Y)
+            if (!ppu->w) {
+                ppu->t = (ppu->t & 0xFFE0) | (val >> 3);
+                ppu->x = val & 0x07;
+            } else {
+                ppu->t = (ppu->t & 0x8C1F) | ((val & 0x07) << 12) | ((val & 0xF8) << 2);
+            }
+            ppu->w = !ppu->w;
+            break;
+        case 6:
+            // PPUADDR (high byte, then low byte)
+            if (!ppu->w) {
+                ppu->t = (ppu->t & 0x80FF) | ((val & 0x3F) << 8);
+            } else {
+                ppu->t = (ppu->t & 0xFF00) | val;
+                ppu->v = ppu->t;
+            }
+            ppu->w = !ppu->w;
+            break;
+        case 7:
+            // PPUDATA
+            ppuWrite(ppu, ppu->v, val);
+            ppu->v += (ppu->ctrl & CTRL_INCREMENT) ? 32 : 1;
+            break;
+        default:
+            // PPUSTATUS is read-only
+            break;
+    }
+}
+
+/**
+ * Copy a page of CPU memory into OAM, like a write to $4014
+ *
+ * @param ppu - The PPU
+ * @param page - The high byte of the CPU address to copy from
+ */
+void ppuOamDma(PPU* ppu, uint8_t page) {
+    for (int i = 0; i < 256; i++) {
+        ppu->oam[(ppu->oam_addr + i) & 0xFF] = busRead(ppu->bus, (page << 8) | i);
+    }
+    ppu->dma_cycles += OAM_DMA_CYCLES;
+}
+
+// Run the PPU up to the CPU before the CPU sees or changes any of its state
+static void sync(PPU* ppu) {
+    if (ppu->scheduler != NULL) {
+        ppuCatchUp(ppu, *ppu->scheduler->clock);
+    }
+}
+
+// A register write can move the PPU's next event (like enabling rendering does
+// for the mapper's scanline IRQs)
+static void reschedule(PPU* ppu) {
+    if (ppu->scheduler != NULL) {
+        schedulerReschedule(ppu->scheduler);
+    }
+}
+
+static uint8_t readRegisterHandler(void* context, uint16_t addr) {
+    sync(context);
+    return ppuReadRegister(context, addr);
+}
+
+static void writeRegisterHandler(void* context, uint16_t addr, uint8_t val) {
+    sync(context);
+    ppuWriteRegister(context, addr, val);
+    reschedule(context);
+}
+
+// OAMDMA is the PPU's only register in the $4000 page. The controllers are mapped
+// over it (see controller.c) and pass the rest of the page's writes on to here.
+static void writeDmaHandler(void* context, uint16_t addr, uint8_t val) {
+    if (addr == 0x4014) {
+        sync(context);
+        ppuOamDma(context, val);
+    }
+}
+
+/**
+ * Map the PPU's registers into the CPU address space: $2000-$2007 (mirrored
+ * up to $3FFF) and OAMDMA at $4014
+ *
+ * @param ppu - The PPU
+ * @param bus - The CPU bus
+ */
+void ppuMapRegisters(PPU* ppu, Bus* bus) {
+    ppu->bus = bus;
+    busMapHandlers(bus, 0x2000, 0x2000, readRegisterHandler, writeRegisterHandler, ppu);
+    busMapHandlers(bus, 0x4000, 0x0100, NULL, writeDmaHandler, ppu);
+}
+
+// ---------- Rendering ----------
+
+static bool renderingEnabled(const PPU* ppu) {
+    return ppu->mask & (MASK_BG | MASK_SPRITES);
+}
+
+// Move v down a pixel, wrapping from the bottom of a nametable into the one below
+static void incrementY(PPU* ppu) {
+    if ((ppu->v & 0x7000) != 0x7000) {
+        ppu->v += 0x1000;
+        return;
+    }
+
+    ppu->v &= ~0x7000;
+    int coarse_y = (ppu->v & 0x03E0) >> 5;
+    if (coarse_y == 29) {
+        coarse_y = 0;
+        ppu->v ^= 0x0800;
+    } else if (coarse_y == 31) {
+        // Rows 30 and 31 are the attribute table, and wrap without switching nametables
+        coarse_y = 0;
+    } else {
+        coarse_y++;
+    }
+    ppu->v = (ppu->v & ~0x03E0) | (coarse_y << 5);
+}
+
+/**
+ * Render the background of the current scanline, starting from the scroll
+ * position in v
+ *
+ * @param ppu - The PPU
+ * @param bg - Where to write each pixel's palette entry (0 for transparent)
+ */
+static void renderBackground(PPU* ppu, uint8_t* bg) {
+    uint16_t v = ppu->v;
+    uint16_t pattern_base = (ppu->ctrl & CTRL_BG_BASE) ? 0x1000 : 0x0000;
+    int fine_y = (v >> 12) & 0x07;
+
+    // 33 tiles, since fine X scrolling shifts part of one more onto the line
+    const uint8_t* rows[33];
+    uint8_t palettes[33];
+    for (int tile = 0; tile < 33; tile++) {
+        uint8_t index = ppuRead(ppu, 0x2000 | (v & 0x0FFF));
+        uint8_t attr = ppuRead(ppu, 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+        palettes[tile] = ((attr >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03) << 2;
+        rows[tile] = mapperTileRow(ppu->mapper, pattern_base + index * 16 + fine_y);
+
+        // Move to the next tile, wrapping into the next nametable over
+        if ((v & 0x001F) == 31) {
+            v = (v & ~0x001F) ^ 0x0400;
+        } else {
+            v++;
+        }
+    }
+
+    uint8_t pixels[33 * 8];
+    ppu->kernels->attributeTiles(rows, palettes, 33, pixels);
+    memcpy(bg, pixels + ppu->x, SCREEN_WIDTH);
+}
+
+/**
+ * Render the sprites on the current scanline
+ *
+ * @param ppu - The PPU
+ * @param bg - The background's palette entries (0 for transparent)
+ * @param sprites - Where to write each pixel's palette entry ($10-$1F, with bit 5
+ *                  set if it's behind the background, or 0 for no sprite)
+ */
+static void renderSprites(PPU* ppu, const uint8_t* bg, uint8_t* sprites) {
+    int height = (ppu->ctrl & CTRL_TALL) ? 16 : 8;
+
+    // Pick the first 8 sprites in OAM that are on this line (sprites are drawn a
+    // line below their Y coordinate)
+    int found[8];
+    int count = 0;
+    for (int i = 0; i < 64; i++) {
+        int row = ppu->scanline - (ppu->oam[i * 4] + 1);
+        if (row < 0 || row >= height) {
+            continue;
+        }
+        if (count == 8) {
+            ppu->status |= STATUS_OVERFLOW;
+            break;
+        }
+        found[count++] = i;
+    }
+
+    int left = (ppu->mask & MASK_SPRITE_LEFT) ? 0 : 8;
+    for (int s = 0; s < count; s++) {
+        const uint8_t* sprite = &ppu->oam[found[s] * 4];
+        uint8_t tile = sprite[1];
+        uint8_t attr = sprite[2];
+
+        int row = ppu->scanline - (sprite[0] + 1);
+        if (attr & 0x80) {
+            row = height - 1 - row;
+        }
+
+        uint16_t addr;
+        if (height == 16) {
+            // 8x16 sprites pick their pattern table with bit 0 of the tile number
+            addr = ((tile & 0x01) << 12) | ((tile & 0xFE) << 4);
+            if (row >= 8) {
+                addr += 16;
+                row -= 8;
+            }
+        } else {
+            addr = ((ppu->ctrl & CTRL_SPRITE_BASE) ? 0x1000 : 0x0000) | (tile << 4);
+        }
+        const uint8_t* pixels = mapperTileRow(ppu->mapper, addr + row);
+        uint8_t entry = 0x10 | ((attr & 0x03) << 2) | ((attr & 0x20) ? 0x20 : 0x00);
+        bool flip = attr & 0x40;
+
+        // Once a sprite has an opaque pixel somewhere, the sprites after it can't
+        // show there, even when it's behind the background
+        for (int px = 0; px < 8; px++) {
+            int x = sprite[3] + px;
+            if (x >= SCREEN_WIDTH) {
+                break;
+            }
+            uint8_t pixel = pixels[flip ? 7 - px : px];
+            if (pixel == 0 || sprites[x] != 0 || x < left) {
+                continue;
+            }
+            sprites[x] = entry | pixel;
+
+            if (found[s] == 0 && bg[x] != 0 && x != 255) {
+                ppu->status |= STATUS_SPRITE_ZERO;
+            }
+        }
+    }
+}
+
+/**
+ * Render the current scanline into the framebuffer
+ *
+ * @param ppu - The PPU
+ */
+static void renderScanline(PPU* ppu) {
+    uint8_t bg[SCREEN_WIDTH] = {0};
+    uint8_t sprites[SCREEN_WIDTH] = {0};
+
+    if (ppu->mask & MASK_BG) {
+        renderBackground(ppu, bg);
+        if (!(ppu->mask & MASK_BG_LEFT)) {
+            memset(bg, 0, 8);
+        }
+    }
+
+    if (ppu->mask & MASK_SPRITES) {
+        renderSprites(ppu, bg, sprites);
+    }
+
+    uint8_t color_mask = (ppu->mask & MASK_GREYSCALE) ? 0x30 : 0x3F;
+    ppu->kernels->composite(bg, sprites, ppu->palette, color_mask,
+                            ppu->framebuffer[ppu->scanline]);
+}
+
+// ---------- Timing ----------
+
+// Number of dots in the current scanline. The pre-render line of odd frames is a
+// dot short while rendering is enabled.
+static int scanlineLength(const PPU* ppu) {
+    if (ppu->scanline == PPU_PRERENDER_LINE && (ppu->frame & 1) && renderingEnabled(ppu)) {
+        return PPU_DOTS_PER_SCANLINE - 1;
+    }
+    return PPU_DOTS_PER_SCANLINE;
+}
+
+// The next dot in the current scanline where something happens
+static int nextEvent(const PPU* ppu) {
+    if (ppu->cycle < 1) {
+        return 1;
+    }
+    if (ppu->cycle < 257) {
+        return 257;
+    }
+    if (ppu->cycle < 260) {
+        return 260;
+    }
+    if (ppu->cycle < 280) {
+        return 280;
+    }
+    return scanlineLength(ppu);
+}
+
+// Handle whatever happens at the current dot
+static void handleEvent(PPU* ppu) {
+    bool rendering = renderingEnabled(ppu);
+    bool render_line = ppu->scanline < SCREEN_HEIGHT || ppu->scanline == PPU_PRERENDER_LINE;
+
+    switch (ppu->cycle) {
+        case 1:
+            if (ppu->scanline == PPU_VBLANK_SCANLINE) {
+                ppu->status |= STATUS_VBLANK;
+                ppu->nmi_occurred = true;
+                updateNmi(ppu);
+            } else if (ppu->scanline == PPU_PRERENDER_LINE) {
+                ppu->status &= ~(STATUS_VBLANK | STATUS_SPRITE_ZERO | STATUS_OVERFLOW);
+                ppu->nmi_occurred = false;
+                updateNmi(ppu);
+            }
+            break;
+        case 257:
+            if (ppu->scanline < SCREEN_HEIGHT) {
+                if (rendering) {
+                    renderScanline(ppu);
+                } else {
+                    memset(ppu->framebuffer[ppu->scanline], ppu->palette[0], SCREEN_WIDTH);
+                }
+            }
+            if (rendering && render_line) {
+                // Move down a line, and back to the left edge of the scroll
+                incrementY(ppu);
+                ppu->v = (ppu->v & ~0x041F) | (ppu->t & 0x041F);
+            }
+            break;
+        case 260:
+            // Roughly where the sprite fetches clock the MMC3's scanline counter
+            if (rendering && render_line) {
+                mapperScanline(ppu->mapper);
+            }
+            break;
+        case 280:
+            // Back to the top of the scroll for the next frame
+            if (rendering && ppu->scanline == PPU_PRERENDER_LINE) {
+                ppu->v = (ppu->v & ~0x7BE0) | (ppu->t & 0x7BE0);
+            }
+            break;
+        default:
+            // End of the scanline
+            ppu->cycle = 0;
+            ppu->scanline++;
+            if (ppu->scanline == PPU_SCANLINES) {
+                ppu->scanline = 0;
+                ppu->frame++;
+                LOG(COMP_PPU, LEVEL_DEBUG, "Finished frame %llu", (unsigned long long)ppu->frame);
+
+                // Collect the frame's CHR-RAM tile rebuilds
+                ppu->tile_rebuilds = ppu->mapper->frame_tile_rebuilds;
+                if (ppu->tile_rebuilds > ppu->peak_tile_rebuilds) {
+                    ppu->peak_tile_rebuilds = ppu->tile_rebuilds;
+                }
+                ppu->mapper->frame_tile_rebuilds = 0;
+            }
+            break;
+    }
+}
+
+/**
+ * Run the PPU for the given number of dots. Scanlines are rendered whole, at the
+ * point in the line where the PPU finishes fetching them (dot 257), so scroll
+ * changes take effect a scanline at a time.
+ *
+ * @param ppu - The PPU
+ * @param dots - The number of dots (3 per CPU cycle) to run for
+ */
+void ppuStep(PPU* ppu, int dots) {
+    while (dots > 0) {
+        int next = nextEvent(ppu);
+        if (next - ppu->cycle > dots) {
+            ppu->cycle += dots;
+            return;
+        }
+
+        dots -= next - ppu->cycle;
+        ppu->cycle = next;
+        handleEvent(ppu);
+    }
+}
+
+/**
+ * Run the PPU up to a CPU cycle, from the cycle it was last run up to
+ *
+ * @param ppu - The PPU
+ * @param cycle - The CPU cycle to run up to
+ */
+void ppuCatchUp(PPU* ppu, uint64_t cycle) {
+    if (cycle > ppu->synced_cycle) {
+        ppuStep(ppu, (cycle - ppu->synced_cycle) * PPU_DOTS_PER_CPU_CYCLE);
+        ppu->synced_cycle = cycle;
+    }
+}
+
+// Number of dots from the current one until the PPU gets to the given dot of the
+// given scanline, wrapping around into the next frame
+static int dotsUntil(const PPU* ppu, int scanline, int cycle) {
+    int dots = (scanline - ppu->scanline) * PPU_DOTS_PER_SCANLINE + cycle - ppu->cycle;
+    if (dots <= 0) {
+        dots += PPU_SCANLINES * PPU_DOTS_PER_SCANLINE;
+    }
+    return dots;
+}
+
+/**
+ * Find the CPU cycle by which the PPU next has to be run: the start of vblank
+ * (where it may raise an NMI), the end of the frame, and while rendering with a
+ * mapper that has IRQs, the next scanline the mapper is told about. Sprite zero
+ * hits and everything else only show up through the registers, which catch the
+ * PPU up themselves.
+ *
+ * @param ppu - The PPU
+ *
+ * @returns The CPU cycle of the next event
+ */
+uint64_t ppuNextEvent(const PPU* ppu) {
+    int dots = dotsUntil(ppu, PPU_VBLANK_SCANLINE, 1);
+    int frame_end = dotsUntil(ppu, 0, 0);
+    if (frame_end < dots) {
+        dots = frame_end;
+    }
+
+    if (renderingEnabled(ppu) && ppu->mapper->ops->irq != NULL) {
+        // The mapper is clocked at dot 260 of the visible and pre-render lines
+        int line = ppu->scanline;
+        if (ppu->cycle >= 260 || (line >= SCREEN_HEIGHT && line != PPU_PRERENDER_LINE)) {
+            if (line + 1 < SCREEN_HEIGHT) {
+                line++;
+            } else {
+                line = (line < PPU_PRERENDER_LINE) ? PPU_PRERENDER_LINE : 0;
+            }
+        }
+        int scanline = dotsUntil(ppu, line, 260);
+        if (scanline < dots) {
+            dots = scanline;
+        }
+    }
+
+    // The pre-render line of odd frames can be a dot short, so round towards
+    // being early
+    return ppu->synced_cycle + (dots - 1 + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE;
+}
+
+static void catchUpHandler(void* context, uint64_t cycle) {
+    ppuCatchUp(context, cycle);
+}
+
+static uint64_t nextEventHandler(void* context) {
+    return ppuNextEvent(context);
+}
+
+/**
+ * Hand the PPU over to a scheduler, so it only runs when the CPU needs it to.
+ * The mapper is synced through the scheduler too, since its registers change
+ * what the PPU does.
+ *
+ * @param ppu - The PPU
+ * @param scheduler - The scheduler driven by the CPU's cycle count
+ *
+ * @returns 0 if the PPU was added to the scheduler
+ */
+int ppuSchedule(PPU* ppu, Scheduler* scheduler) {
+    ppu->scheduler = scheduler;
+    ppu->synced_cycle = *scheduler->clock;
+    ppu->mapper->scheduler = scheduler;
+
+    SchedulerComponent component = {
+        .name = "PPU",
+        .context = ppu,
+        .catchUp = catchUpHandler,
+        .nextEvent = nextEventHandler,
+    };
+    return schedulerAdd(scheduler, component);
+}
+
+// ---------- Output ----------
+
+/**
+ * Convert the framebuffer to 32-bit ARGB pixels
+ *
+ * @param ppu - The PPU
+ * @param argb - SCREEN_WIDTH * SCREEN_HEIGHT pixels to write the frame to
+ */
+void ppuExpandFrame(const PPU* ppu, uint32_t* argb) {
+    ppu->kernels->expand(&ppu->framebuffer[0][0], SCREEN_WIDTH * SCREEN_HEIGHT, argb);
+}
+
+/**
+ * Write a frame out as a binary PPM image
+ *
+ * @param file - Where to write the image
+ * @param kernels - The render kernels to convert the frame's colors with
+ * @param pixels - The frame's SCREEN_WIDTH * SCREEN_HEIGHT NES colors
+ *
+ * @returns 0 if the image was written
+ * @returns -1 if a write failed
+ */
+int writePpm(FILE* file, const RenderKernels* kernels, const uint8_t* pixels) {
+    fprintf(file, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+
+    uint32_t argb[SCREEN_WIDTH];
+    uint8_t row[SCREEN_WIDTH * 3];
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        kernels->expand(pixels + y * SCREEN_WIDTH, SCREEN_WIDTH, argb);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            uint32_t color = argb[x];
+            row[x * 3] = color >> 16;
+            row[x * 3 + 1] = color >> 8;
+            row[x * 3 + 2] = color;
+        }
+        if (fwrite(row, 1, sizeof(row), file) != sizeof(row)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Write the framebuffer out as a binary PPM image
+ *
+ * @param ppu - The PPU
+ * @param path - The path of the image to write
+ *
+ * @returns 0 if the image was written
+ * @returns -1 if the file couldn't be written
+ */
+int ppuWritePpm(const PPU* ppu, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return -1;
+    }
+
+    int result = writePpm(file, ppu->kernels, &ppu->framebuffer[0][0]);
+    if (fclose(file) != 0 || result != 0) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// ---------- Setup ----------
+
+/**
+ * Allocate a PPU in its power-on state
+ *
+ * @param mapper - The cartridge's mapper, which provides the pattern tables
+ *
+ * @returns The new PPU, or NULL if it couldn't be allocated
+ */
+PPU* createPPU(Mapper* mapper) {
+    PPU* ppu = calloc(1, sizeof(PPU));
+    if (ppu == NULL) {
+        return NULL;
+    }
+
+    ppu->mapper = mapper;
+    ppu->kernels = bestRenderKernels();
+    return ppu;
+}
+
+/**
+ * Free a PPU
+ *
+ * @param ppu - The PPU to free
+ */
+void freePPU(PPU* ppu) {
+    free(ppu);
+}
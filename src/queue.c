@@ -0,0 +1,51 @@
+#include "queue.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE_SLOT_ALIGN (64)  // Slots start on their own cache line
+
+/**
+ * Allocate a queue and all of its slots
+ *
+ * @param slot_size - The size of each slot in bytes
+ * @param capacity - The number of slots (a power of 2)
+ *
+ * @returns The queue, or NULL if it couldn't be allocated
+ */
+Queue* createQueue(size_t slot_size, uint32_t capacity) {
+    if (slot_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return NULL;
+    }
+
+    // The indexes are kept on separate cache lines, so the queue has to be too
+    slot_size = (slot_size + QUEUE_SLOT_ALIGN - 1) & ~(size_t)(QUEUE_SLOT_ALIGN - 1);
+    Queue* queue = aligned_alloc(_Alignof(Queue), sizeof(Queue));
+    uint8_t* slots = aligned_alloc(QUEUE_SLOT_ALIGN, slot_size * capacity);
+    if (queue == NULL || slots == NULL) {
+        free(queue);
+        free(slots);
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(Queue));
+    queue->slots = slots;
+    queue->slot_size = slot_size;
+    queue->capacity = capacity;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+/**
+ * Free a queue and its slots
+ *
+ * @param queue - The queue to free
+ */
+void freeQueue(Queue* queue) {
+    free(queue->slots);
+    free(queue);
+}
@@ -0,0 +1,207 @@
+#include "recorder.h"
+
+#include "apu.h"
+#include "ppu.h"
+#include "queue.h"
+#include "render.h"
+#include "types.h"
+#include "wav.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RECORDER_WRITER_SLEEP_NS (1000000)  // How long the writer sleeps when there's nothing to do
+#define FRAME_SIZE               (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+/**
+ * Write out everything queued until the recorder is stopped and the queues
+ * are empty
+ *
+ * @param arg - The recorder
+ *
+ * @returns NULL
+ */
+static void* recorderWriter(void* arg) {
+    Recorder* recorder = arg;
+
+    while (true) {
+        // Checking for a stop before looking at the queues means everything
+        // pushed before freeRecorder was called is seen
+        bool stopping = atomic_load_explicit(&recorder->stopping, memory_order_acquire);
+        bool idle = true;
+
+        // Audio first, since it's the one that's heard when it's late
+        const AudioBlock* block;
+        while ((block = queueFront(recorder->audio)) != NULL) {
+            wavWrite(recorder->wav, block->samples, block->count);
+            queuePop(recorder->audio);
+            idle = false;
+        }
+
+        const uint8_t* pixels = queueFront(recorder->frames);
+        if (pixels != NULL) {
+            if (!recorder->failed) {
+                recorder->failed = writePpm(recorder->video, recorder->kernels, pixels) != 0;
+                recorder->frames_written += !recorder->failed;
+            }
+            queuePop(recorder->frames);
+            idle = false;
+        }
+
+        if (idle) {
+            if (stopping) {
+                break;
+            }
+
+            struct timespec ts = {0, RECORDER_WRITER_SLEEP_NS};
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Open the output files and start the thread that writes to them
+ *
+ * @param video_path - The file (or named pipe) to write frames to, or NULL
+ * @param wav_path - The WAV file (or named pipe) to write audio to, or NULL
+ *
+ * @returns The recorder
+ * @returns NULL if a file couldn't be opened or the thread couldn't be started
+ */
+Recorder* createRecorder(const char* video_path, const char* wav_path) {
+    Recorder* recorder = calloc(1, sizeof(Recorder));
+    if (recorder == NULL) {
+        return NULL;
+    }
+
+    // Every slot is allocated now, so nothing is allocated per frame
+    recorder->frames = createQueue(FRAME_SIZE, RECORDER_FRAME_SLOTS);
+    recorder->audio = createQueue(sizeof(AudioBlock), RECORDER_AUDIO_SLOTS);
+    recorder->kernels = bestRenderKernels();
+    recorder->video_path = video_path;
+    if (recorder->frames == NULL || recorder->audio == NULL) {
+        goto FAIL;
+    }
+
+    if (video_path != NULL) {
+        recorder->video = fopen(video_path, "wb");
+        if (recorder->video == NULL) {
+            fprintf(stderr, "ERROR: Failed to open %s\n", video_path);
+            goto FAIL;
+        }
+    }
+    if (wav_path != NULL) {
+        recorder->wav = createWavWriter(wav_path, APU_SAMPLE_RATE);
+        if (recorder->wav == NULL) {
+            goto FAIL;
+        }
+    }
+
+    atomic_init(&recorder->stopping, false);
+    if (pthread_create(&recorder->writer, NULL, recorderWriter, recorder) != 0) {
+        fprintf(stderr, "ERROR: Failed to start the recorder thread\n");
+        goto FAIL;
+    }
+    return recorder;
+
+FAIL:
+    if (recorder->video) {
+        fclose(recorder->video);
+    }
+    if (recorder->wav) {
+        freeWavWriter(recorder->wav);
+    }
+    if (recorder->frames) {
+        freeQueue(recorder->frames);
+    }
+    if (recorder->audio) {
+        freeQueue(recorder->audio);
+    }
+    free(recorder);
+    return NULL;
+}
+
+/**
+ * Write out everything still queued, then stop the writer thread and close the
+ * files
+ *
+ * @param recorder - The recorder to free
+ *
+ * @returns 0 if everything that was queued was written
+ * @returns -1 if a write failed
+ */
+int freeRecorder(Recorder* recorder) {
+    atomic_store_explicit(&recorder->stopping, true, memory_order_release);
+    pthread_join(recorder->writer, NULL);
+
+    int result = 0;
+    if (recorder->video) {
+        if (fclose(recorder->video) != 0 || recorder->failed) {
+            fprintf(stderr, "ERROR: Failed to write %s\n", recorder->video_path);
+            result = -1;
+        }
+    }
+    if (recorder->wav && freeWavWriter(recorder->wav) != 0) {
+        result = -1;
+    }
+
+    freeQueue(recorder->frames);
+    freeQueue(recorder->audio);
+    free(recorder);
+    return result;
+}
+
+/**
+ * Queue a finished frame to be written, without waiting
+ *
+ * @param recorder - The recorder
+ * @param pixels - The frame's SCREEN_WIDTH * SCREEN_HEIGHT NES colors
+ *
+ * @returns true if the frame was queued
+ * @returns false if the writer has fallen behind and the frame was dropped
+ */
+bool recorderPushFrame(Recorder* recorder, const uint8_t* pixels) {
+    if (recorder->video == NULL) {
+        return true;
+    }
+
+    uint8_t* slot = queueReserve(recorder->frames);
+    if (slot == NULL) {
+        return false;
+    }
+    memcpy(slot, pixels, FRAME_SIZE);
+    queuePublish(recorder->frames);
+    return true;
+}
+
+/**
+ * Queue a block of samples to be written, without waiting (an ApuOutput)
+ *
+ * @param context - The recorder
+ * @param samples - The samples
+ * @param count - The number of samples (at most BLIP_SIZE)
+ */
+void recorderPushAudio(void* context, const int16_t* samples, int count) {
+    Recorder* recorder = context;
+    assert(count <= BLIP_SIZE);
+    if (recorder->wav == NULL) {
+        return;
+    }
+
+    AudioBlock* block = queueReserve(recorder->audio);
+    if (block == NULL) {
+        return;
+    }
+    block->count = count;
+    memcpy(block->samples, samples, count * sizeof(int16_t));
+    queuePublish(recorder->audio);
+}
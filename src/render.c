@@ -0,0 +1,392 @@
+#include "render.h"
+
+#include "types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RENDER_X86
+#include <immintrin.h>
+#endif
+
+// RGB values of the 64 colors the 2C02 can output
+static const uint32_t nes_colors[64] = {
+    0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+    0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+    0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+    0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+    0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+    0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+    0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+    0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+};
+
+// ---------- Scalar ----------
+
+static void decodeTilesScalar(const uint8_t* lo, const uint8_t* hi, const uint8_t* attrs,
+                              int count, uint8_t* out) {
+    for (int tile = 0; tile < count; tile++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            uint8_t pixel = ((lo[tile] >> bit) & 0x01) | (((hi[tile] >> bit) & 0x01) << 1);
+            *out++ = pixel ? attrs[tile] | pixel : 0;
+        }
+    }
+}
+
+static void attributeTilesScalar(const uint8_t* const* rows, const uint8_t* attrs, int count,
+                                 uint8_t* out) {
+    for (int tile = 0; tile < count; tile++) {
+        for (int px = 0; px < 8; px++) {
+            uint8_t pixel = rows[tile][px];
+            *out++ = pixel ? attrs[tile] | pixel : 0;
+        }
+    }
+}
+
+// The palette entry a pixel shows: the sprite, unless there isn't one or it's
+// behind an opaque background pixel
+static inline uint8_t compositePixel(uint8_t bg, uint8_t sprite) {
+    if (sprite != 0 && (!(sprite & 0x20) || bg == 0)) {
+        return sprite & 0x1F;
+    }
+    return bg;
+}
+
+static void compositeScalar(const uint8_t* bg, const uint8_t* sprites, const uint8_t* palette,
+                            uint8_t color_mask, uint8_t* out) {
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        out[x] = palette[compositePixel(bg[x], sprites[x])] & color_mask;
+    }
+}
+
+static void expandScalar(const uint8_t* pixels, int count, uint32_t* argb) {
+    for (int i = 0; i < count; i++) {
+        argb[i] = 0xFF000000 | nes_colors[pixels[i] & 0x3F];
+    }
+}
+
+static const RenderKernels scalar_kernels = {
+    .name = "scalar",
+    .decodeTiles = decodeTilesScalar,
+    .attributeTiles = attributeTilesScalar,
+    .composite = compositeScalar,
+    .expand = expandScalar,
+};
+
+#ifdef RENDER_X86
+
+// ---------- SSE2 ----------
+
+// Decodes two tiles (16 pixels) at a time: each plane byte is broadcast over 8
+// lanes and tested against a different bit in each lane
+static void decodeTilesSse2(const uint8_t* lo, const uint8_t* hi, const uint8_t* attrs,
+                            int count, uint8_t* out) {
+    const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                                       (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m128i ones = _mm_set1_epi8(0x01);
+    const __m128i twos = _mm_set1_epi8(0x02);
+    const __m128i zero = _mm_setzero_si128();
+
+    int tile = 0;
+    for (; tile + 2 <= count; tile += 2) {
+        __m128i lo_v = _mm_unpacklo_epi64(_mm_set1_epi8(lo[tile]), _mm_set1_epi8(lo[tile + 1]));
+        __m128i hi_v = _mm_unpacklo_epi64(_mm_set1_epi8(hi[tile]), _mm_set1_epi8(hi[tile + 1]));
+        __m128i attr_v =
+            _mm_unpacklo_epi64(_mm_set1_epi8(attrs[tile]), _mm_set1_epi8(attrs[tile + 1]));
+
+        __m128i pixels =
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo_v, bits), bits), ones),
+                         _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi_v, bits), bits), twos));
+        __m128i transparent = _mm_cmpeq_epi8(pixels, zero);
+        pixels = _mm_or_si128(pixels, _mm_andnot_si128(transparent, attr_v));
+
+        _mm_storeu_si128((__m128i*)(out + tile * 8), pixels);
+    }
+
+    decodeTilesScalar(lo + tile, hi + tile, attrs + tile, count - tile, out + tile * 8);
+}
+
+static void attributeTilesSse2(const uint8_t* const* rows, const uint8_t* attrs, int count,
+                               uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+
+    int tile = 0;
+    for (; tile + 2 <= count; tile += 2) {
+        __m128i pixels = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)rows[tile]),
+                                            _mm_loadl_epi64((const __m128i*)rows[tile + 1]));
+        __m128i attr_v =
+            _mm_unpacklo_epi64(_mm_set1_epi8(attrs[tile]), _mm_set1_epi8(attrs[tile + 1]));
+
+        __m128i transparent = _mm_cmpeq_epi8(pixels, zero);
+        pixels = _mm_or_si128(pixels, _mm_andnot_si128(transparent, attr_v));
+        _mm_storeu_si128((__m128i*)(out + tile * 8), pixels);
+    }
+
+    attributeTilesScalar(rows + tile, attrs + tile, count - tile, out + tile * 8);
+}
+
+// Selects between the layers 16 pixels at a time. SSE2 can't shuffle bytes, so
+// the palette lookup itself stays scalar.
+static void compositeSse2(const uint8_t* bg, const uint8_t* sprites, const uint8_t* palette,
+                          uint8_t color_mask, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i behind_bit = _mm_set1_epi8(0x20);
+    const __m128i entry_mask = _mm_set1_epi8(0x1F);
+
+    uint8_t entries[16];
+    for (int x = 0; x < SCREEN_WIDTH; x += 16) {
+        __m128i bg_v = _mm_loadu_si128((const __m128i*)(bg + x));
+        __m128i sprite_v = _mm_loadu_si128((const __m128i*)(sprites + x));
+
+        // front = sprite != 0 && (!behind || bg == 0)
+        __m128i no_sprite = _mm_cmpeq_epi8(sprite_v, zero);
+        __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(sprite_v, behind_bit), behind_bit);
+        __m128i bg_opaque = _mm_xor_si128(_mm_cmpeq_epi8(bg_v, zero), _mm_set1_epi8(-1));
+        __m128i front = _mm_andnot_si128(_mm_or_si128(no_sprite, _mm_and_si128(behind, bg_opaque)),
+                                         _mm_set1_epi8(-1));
+
+        __m128i entry = _mm_or_si128(_mm_and_si128(front, _mm_and_si128(sprite_v, entry_mask)),
+                                     _mm_andnot_si128(front, bg_v));
+        _mm_storeu_si128((__m128i*)entries, entry);
+
+        for (int i = 0; i < 16; i++) {
+            out[x + i] = palette[entries[i]] & color_mask;
+        }
+    }
+}
+
+static const RenderKernels sse2_kernels = {
+    .name = "SSE2",
+    .decodeTiles = decodeTilesSse2,
+    .attributeTiles = attributeTilesSse2,
+    .composite = compositeSse2,
+    .expand = expandScalar,
+};
+
+// ---------- AVX2 ----------
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Decodes four tiles (32 pixels) at a time. The four plane bytes are broadcast
+// to every dword, then shuffled so each tile's byte fills 8 lanes.
+AVX2 static void decodeTilesAvx2(const uint8_t* lo, const uint8_t* hi, const uint8_t* attrs,
+                                 int count, uint8_t* out) {
+    const __m256i bits = _mm256_setr_epi8(
+        (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08,
+        0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40,
+        0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2,
+                                            2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i ones = _mm256_set1_epi8(0x01);
+    const __m256i twos = _mm256_set1_epi8(0x02);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int tile = 0;
+    for (; tile + 4 <= count; tile += 4) {
+        uint32_t lo4, hi4, attr4;
+        __builtin_memcpy(&lo4, lo + tile, 4);
+        __builtin_memcpy(&hi4, hi + tile, 4);
+        __builtin_memcpy(&attr4, attrs + tile, 4);
+
+        __m256i lo_v = _mm256_shuffle_epi8(_mm256_set1_epi32(lo4), spread);
+        __m256i hi_v = _mm256_shuffle_epi8(_mm256_set1_epi32(hi4), spread);
+        __m256i attr_v = _mm256_shuffle_epi8(_mm256_set1_epi32(attr4), spread);
+
+        __m256i pixels = _mm256_or_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(lo_v, bits), bits), ones),
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(hi_v, bits), bits), twos));
+        __m256i transparent = _mm256_cmpeq_epi8(pixels, zero);
+        pixels = _mm256_or_si256(pixels, _mm256_andnot_si256(transparent, attr_v));
+
+        _mm256_storeu_si256((__m256i*)(out + tile * 8), pixels);
+    }
+
+    decodeTilesScalar(lo + tile, hi + tile, attrs + tile, count - tile, out + tile * 8);
+}
+
+AVX2 static void attributeTilesAvx2(const uint8_t* const* rows, const uint8_t* attrs, int count,
+                                    uint8_t* out) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2,
+                                            2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i zero = _mm256_setzero_si256();
+
+    int tile = 0;
+    for (; tile + 4 <= count; tile += 4) {
+        uint64_t row[4];
+        for (int i = 0; i < 4; i++) {
+            __builtin_memcpy(&row[i], rows[tile + i], 8);
+        }
+        uint32_t attr4;
+        __builtin_memcpy(&attr4, attrs + tile, 4);
+
+        __m256i pixels = _mm256_setr_epi64x(row[0], row[1], row[2], row[3]);
+        __m256i attr_v = _mm256_shuffle_epi8(_mm256_set1_epi32(attr4), spread);
+
+        __m256i transparent = _mm256_cmpeq_epi8(pixels, zero);
+        pixels = _mm256_or_si256(pixels, _mm256_andnot_si256(transparent, attr_v));
+        _mm256_storeu_si256((__m256i*)(out + tile * 8), pixels);
+    }
+
+    attributeTilesScalar(rows + tile, attrs + tile, count - tile, out + tile * 8);
+}
+
+// Selects between the layers with per-lane masks, then looks the entries up in
+// the palette with byte shuffles (one for each half of the 32 entries)
+AVX2 static void compositeAvx2(const uint8_t* bg, const uint8_t* sprites, const uint8_t* palette,
+                               uint8_t color_mask, uint8_t* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i behind_bit = _mm256_set1_epi8(0x20);
+    const __m256i sprite_bit = _mm256_set1_epi8(0x10);
+    const __m256i entry_mask = _mm256_set1_epi8(0x1F);
+    const __m256i mask = _mm256_set1_epi8(color_mask);
+    const __m256i bg_palette =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)palette));
+    const __m256i sprite_palette =
+        _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(palette + 16)));
+
+    for (int x = 0; x < SCREEN_WIDTH; x += 32) {
+        __m256i bg_v = _mm256_loadu_si256((const __m256i*)(bg + x));
+        __m256i sprite_v = _mm256_loadu_si256((const __m256i*)(sprites + x));
+
+        // hidden = sprite == 0 || (behind && bg != 0)
+        __m256i no_sprite = _mm256_cmpeq_epi8(sprite_v, zero);
+        __m256i behind = _mm256_cmpeq_epi8(_mm256_and_si256(sprite_v, behind_bit), behind_bit);
+        __m256i bg_clear = _mm256_cmpeq_epi8(bg_v, zero);
+        __m256i hidden = _mm256_or_si256(no_sprite, _mm256_andnot_si256(bg_clear, behind));
+
+        __m256i entry =
+            _mm256_blendv_epi8(_mm256_and_si256(sprite_v, entry_mask), bg_v, hidden);
+        __m256i is_sprite = _mm256_cmpeq_epi8(_mm256_and_si256(entry, sprite_bit), sprite_bit);
+        __m256i color = _mm256_blendv_epi8(_mm256_shuffle_epi8(bg_palette, entry),
+                                           _mm256_shuffle_epi8(sprite_palette, entry), is_sprite);
+
+        _mm256_storeu_si256((__m256i*)(out + x), _mm256_and_si256(color, mask));
+    }
+}
+
+// Looks up each channel with byte shuffles (the 64 colors are four tables of
+// 16, picked by the top 2 bits of the color), then interleaves the channels
+// into ARGB pixels
+AVX2 static void expandAvx2(const uint8_t* pixels, int count, uint32_t* argb) {
+    __m256i tables[3][4];
+    for (int channel = 0; channel < 3; channel++) {
+        for (int table = 0; table < 4; table++) {
+            uint8_t bytes[16];
+            for (int i = 0; i < 16; i++) {
+                bytes[i] = nes_colors[table * 16 + i] >> (channel * 8);
+            }
+            tables[channel][table] =
+                _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)bytes));
+        }
+    }
+
+    const __m256i color_mask = _mm256_set1_epi8(0x3F);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i alpha = _mm256_set1_epi8(-1);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i color = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(pixels + i)),
+                                         color_mask);
+        __m256i row = _mm256_and_si256(_mm256_srli_epi16(color, 4), low_nibble);
+
+        __m256i channels[3];
+        for (int channel = 0; channel < 3; channel++) {
+            __m256i value = _mm256_shuffle_epi8(tables[channel][0], color);
+            for (int table = 1; table < 4; table++) {
+                __m256i in_table = _mm256_cmpeq_epi8(row, _mm256_set1_epi8(table));
+                value = _mm256_blendv_epi8(
+                    value, _mm256_shuffle_epi8(tables[channel][table], color), in_table);
+            }
+            channels[channel] = value;
+        }
+
+        // Bytes of each pixel in memory are B, G, R, A. Unpacking works within
+        // 128-bit lanes, so the results come out as pixels 0-3|16-19, 4-7|20-23,
+        // and so on, and get put back in order when they're stored.
+        __m256i bg_lo = _mm256_unpacklo_epi8(channels[0], channels[1]);
+        __m256i bg_hi = _mm256_unpackhi_epi8(channels[0], channels[1]);
+        __m256i ra_lo = _mm256_unpacklo_epi8(channels[2], alpha);
+        __m256i ra_hi = _mm256_unpackhi_epi8(channels[2], alpha);
+
+        __m256i p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);
+        __m256i p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);
+        __m256i p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);
+        __m256i p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);
+
+        _mm256_storeu_si256((__m256i*)(argb + i), _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256((__m256i*)(argb + i + 8), _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256((__m256i*)(argb + i + 16), _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256((__m256i*)(argb + i + 24), _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+
+    expandScalar(pixels + i, count - i, argb + i);
+}
+
+static const RenderKernels avx2_kernels = {
+    .name = "AVX2",
+    .decodeTiles = decodeTilesAvx2,
+    .attributeTiles = attributeTilesAvx2,
+    .composite = compositeAvx2,
+    .expand = expandAvx2,
+};
+
+#endif
+
+/**
+ * Get the render kernels for an instruction set
+ *
+ * @param level - The instruction set
+ *
+ * @returns The kernels, or NULL if the compiler or CPU doesn't support them
+ */
+const RenderKernels* getRenderKernels(RenderLevel level) {
+    switch (level) {
+        case RENDER_SCALAR:
+            return &scalar_kernels;
+#ifdef RENDER_X86
+        case RENDER_SSE2:
+            return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+        case RENDER_AVX2:
+            return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Get the fastest render kernels the CPU supports
+ *
+ * @returns The kernels
+ */
+const RenderKernels* bestRenderKernels(void) {
+    for (int level = RENDER_AVX2; level > RENDER_SCALAR; level--) {
+        const RenderKernels* kernels = getRenderKernels(level);
+        if (kernels != NULL) {
+            return kernels;
+        }
+    }
+    return &scalar_kernels;
+}
+
+/**
+ * Decode CHR tiles into 8x8 palette indices (0-3), row by row
+ *
+ * @param chr - The CHR memory to decode
+ * @param size - The size of chr (a multiple of CHR_TILE_SIZE)
+ * @param tiles - Where to write DECODED_TILE_SIZE bytes per tile
+ */
+void decodeChr(const uint8_t* chr, uint32_t size, uint8_t* tiles) {
+    static const uint8_t no_attrs[8] = {0};
+    const RenderKernels* kernels = bestRenderKernels();
+
+    // Each tile is 8 bytes of low plane followed by 8 bytes of high plane, so
+    // its rows decode like 8 tiles of a scanline
+    for (uint32_t offset = 0; offset + CHR_TILE_SIZE <= size; offset += CHR_TILE_SIZE) {
+        kernels->decodeTiles(chr + offset, chr + offset + 8, no_attrs, 8, tiles);
+        tiles += DECODED_TILE_SIZE;
+    }
+}
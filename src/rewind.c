@@ -0,0 +1,294 @@
+#include "rewind.h"
+
+#include "logger.h"
+#include "pacer.h"
+#include "savestate.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A delta is a list of runs: the number of bytes that are the same in both
+// states, then the number of bytes that differ, then those bytes XORed
+// together. Counts are LEB128 varints. At worst (every other byte differs)
+// that's 3 bytes for every 2 in the state.
+#define MAX_VARINT_SIZE   (10)
+#define MAX_PACKED_SIZE(n) ((n) / 2 * 3 + 2 * MAX_VARINT_SIZE + 2)
+
+static inline uint8_t* putVarint(uint8_t* out, size_t val) {
+    while (val >= 0x80) {
+        *out++ = (val & 0x7F) | 0x80;
+        val >>= 7;
+    }
+    *out++ = val;
+    return out;
+}
+
+static inline size_t getVarint(const uint8_t** in) {
+    size_t val = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *(*in)++;
+        val |= (size_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return val;
+}
+
+/**
+ * Encode the XOR of two states
+ *
+ * @param old_state - The older state
+ * @param new_state - The newer state
+ * @param size - The size of the states
+ * @param out - Where to write the delta (at least MAX_PACKED_SIZE(size) bytes)
+ *
+ * @returns The size of the delta
+ */
+static size_t packDelta(const uint8_t* old_state, const uint8_t* new_state, size_t size,
+                        uint8_t* out) {
+    uint8_t* start = out;
+    size_t i = 0;
+    while (i < size) {
+        size_t same = i;
+        while (i < size && old_state[i] == new_state[i]) {
+            i++;
+        }
+        size_t differ = i;
+        while (i < size && old_state[i] != new_state[i]) {
+            i++;
+        }
+
+        out = putVarint(out, differ - same);
+        out = putVarint(out, i - differ);
+        for (size_t j = differ; j < i; j++) {
+            *out++ = old_state[j] ^ new_state[j];
+        }
+    }
+    return out - start;
+}
+
+/**
+ * Apply a delta to a state, turning it into the other state the delta was
+ * made from
+ *
+ * @param state - The state to change
+ * @param delta - The delta
+ * @param size - The size of the delta
+ */
+static void applyDelta(uint8_t* state, const uint8_t* delta, size_t size) {
+    const uint8_t* in = delta;
+    while (in < delta + size) {
+        state += getVarint(&in);
+        size_t differ = getVarint(&in);
+        for (size_t j = 0; j < differ; j++) {
+            *state++ ^= *in++;
+        }
+    }
+}
+
+static inline RewindEntry* entryAt(Rewind* history, uint32_t index) {
+    return &history->entries[(history->first + index) % history->capacity];
+}
+
+static void dropOldest(Rewind* history) {
+    history->first = (history->first + 1) % history->capacity;
+    history->count--;
+    history->evictions++;
+}
+
+/**
+ * Find room for a delta in the arena, dropping the oldest deltas in the way
+ *
+ * @param history - The history
+ * @param size - The size of the delta
+ *
+ * @returns Where the delta goes
+ */
+static size_t makeRoom(Rewind* history, size_t size) {
+    // Deltas from the arena's last time around start at or after the head, and
+    // they're older than everything before it
+    if (history->arena_head + size > history->arena_size) {
+        while (history->count > 0 && entryAt(history, 0)->offset >= history->arena_head) {
+            dropOldest(history);
+        }
+        history->arena_head = 0;
+    }
+
+    while (history->count > 0 && entryAt(history, 0)->offset >= history->arena_head &&
+           entryAt(history, 0)->offset < history->arena_head + size) {
+        dropOldest(history);
+    }
+    return history->arena_head;
+}
+
+/**
+ * Create a rewind history
+ *
+ * @param machine - The machine the states are taken from
+ * @param seconds - How much history to keep
+ * @param interval - Frames between states
+ * @param arena_size - Bytes to set aside for deltas (e.x. REWIND_ARENA_SIZE)
+ *
+ * @returns The history
+ * @returns NULL if the arguments are invalid or memory couldn't be allocated
+ */
+Rewind* createRewind(const Machine* machine, double seconds, uint32_t interval,
+                     size_t arena_size) {
+    if (seconds <= 0 || interval == 0 || arena_size == 0) {
+        return NULL;
+    }
+
+    Rewind* history = calloc(1, sizeof(Rewind));
+    if (history == NULL) {
+        return NULL;
+    }
+
+    // An NTSC NES shows 2 * CPU_CLOCK_HZ / HALF_CYCLES_PER_FRAME (about 60.1)
+    // frames a second
+    double frames = seconds * 2 * CPU_CLOCK_HZ / HALF_CYCLES_PER_FRAME;
+    history->capacity = (uint32_t)(frames / interval);
+    if (history->capacity < frames / interval) {
+        history->capacity++;
+    }
+    history->interval = interval;
+
+    history->state_size = saveStateSize(machine);
+    history->latest = malloc(history->state_size);
+    history->scratch = malloc(history->state_size);
+    history->packed = malloc(MAX_PACKED_SIZE(history->state_size));
+    history->arena = malloc(arena_size);
+    history->arena_size = arena_size;
+    history->entries = calloc(history->capacity, sizeof(RewindEntry));
+
+    if (!history->latest || !history->scratch || !history->packed || !history->arena ||
+        !history->entries) {
+        freeRewind(history);
+        return NULL;
+    }
+    return history;
+}
+
+/**
+ * Free a rewind history
+ *
+ * @param history - The history to free
+ */
+void freeRewind(Rewind* history) {
+    free(history->latest);
+    free(history->scratch);
+    free(history->packed);
+    free(history->arena);
+    free(history->entries);
+    free(history);
+}
+
+/**
+ * Take a state and add it to the history, dropping the oldest states if
+ * there's no room left
+ *
+ * @param history - The history
+ * @param machine - The machine
+ */
+void rewindPush(Rewind* history, const Machine* machine) {
+    history->next_frame = machine->ppu->frame + history->interval;
+    history->pushes++;
+
+    if (!history->has_latest) {
+        saveState(machine, history->latest, history->state_size);
+        history->has_latest = true;
+        return;
+    }
+
+    // The delta turns the new state back into the one before it
+    saveState(machine, history->scratch, history->state_size);
+    size_t size =
+        packDelta(history->latest, history->scratch, history->state_size, history->packed);
+
+    uint8_t* swap = history->latest;
+    history->latest = history->scratch;
+    history->scratch = swap;
+
+    if (size > history->arena_size) {
+        // There's no going back past this state
+        LOG_LIMITED(COMP_STATE, LEVEL_WARNING, "Rewind delta (%zu bytes) is bigger than the arena",
+                    size);
+        while (history->count > 0) {
+            dropOldest(history);
+        }
+        return;
+    }
+
+    if (history->count == history->capacity) {
+        dropOldest(history);
+    }
+    size_t offset = makeRoom(history, size);
+    memcpy(history->arena + offset, history->packed, size);
+    history->arena_head = offset + size;
+
+    *entryAt(history, history->count) = (RewindEntry){offset, size};
+    history->count++;
+}
+
+/**
+ * Restore an earlier state, dropping every state after it from the history
+ *
+ * @param history - The history
+ * @param machine - The machine to restore
+ * @param steps - How many states back from the newest one to go (0 for the
+ *                newest one itself)
+ *
+ * @returns The number of states actually gone back (fewer than steps if the
+ *          history doesn't go back that far)
+ * @returns -1 if there's no history yet
+ */
+int rewindStep(Rewind* history, Machine* machine, uint32_t steps) {
+    if (!history->has_latest) {
+        return -1;
+    }
+
+    uint32_t taken = steps < history->count ? steps : history->count;
+    for (uint32_t i = 0; i < taken; i++) {
+        RewindEntry* entry = entryAt(history, history->count - 1);
+        applyDelta(history->latest, history->arena + entry->offset, entry->size);
+
+        // The newest delta was the last one written, so its space is free again
+        history->arena_head = entry->offset;
+        history->count--;
+    }
+
+    if (loadState(machine, history->latest, history->state_size) != 0) {
+        return -1;
+    }
+    history->next_frame = machine->ppu->frame + history->interval;
+    return taken;
+}
+
+/**
+ * Find how many states the history holds
+ *
+ * @param history - The history
+ *
+ * @returns The number of states that can be restored
+ */
+uint32_t rewindDepth(const Rewind* history) {
+    return history->has_latest ? history->count + 1 : 0;
+}
+
+/**
+ * Find how much of the arena the history's deltas take up
+ *
+ * @param history - The history
+ *
+ * @returns The size of the deltas in bytes
+ */
+size_t rewindUsage(const Rewind* history) {
+    size_t usage = 0;
+    for (uint32_t i = 0; i < history->count; i++) {
+        usage += history->entries[(history->first + i) % history->capacity].size;
+    }
+    return usage;
+}
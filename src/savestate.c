@@ -0,0 +1,665 @@
+#include "savestate.h"
+
+#include "6502.h"
+#include "apu.h"
+#include "logger.h"
+#include "controller.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A state is STATE_MAGIC and the version, followed by sections that each start
+// with a 4 character tag and their length. Loaders skip sections they don't
+// know, so new parts of the machine can be added without breaking old states.
+#define HEADER_SIZE         (8 + 4)
+#define SECTION_HEADER_SIZE (4 + 4)
+
+#define CPU_SECTION_SIZE  (2 + 5 + 8)
+#define PADS_SECTION_SIZE (CONTROLLER_PORTS * 2 + 1)
+#define ENVELOPE_SIZE     (6)
+#define PULSE_SIZE        (2 + 2 + 4 + 1 + ENVELOPE_SIZE + 6)
+#define TRIANGLE_SIZE     (1 + 2 + 4 + 5)
+#define NOISE_SIZE        (2 + 1 + 2 + 4 + 1 + ENVELOPE_SIZE)
+#define DMC_SIZE          (2 + 2 + 4 + 1 + 4 * 2 + 5)
+#define APU_SECTION_SIZE \
+    (2 * PULSE_SIZE + TRIANGLE_SIZE + NOISE_SIZE + DMC_SIZE + 6 + 8 + 2 + 8)
+#define PPU_SECTION_SIZE                                                                     \
+    (3 + sizeof(((PPU*)0)->oam) + 3 + sizeof(((PPU*)0)->vram) + sizeof(((PPU*)0)->palette) + \
+     2 * 2 + 2 + 2 * 2 + 8 + 4 + 2 + 8 + SCREEN_WIDTH * SCREEN_HEIGHT)
+// Where the scanline and cycle are in the PPU section, so they can be checked
+#define PPU_TIMING_OFFSET                                                                    \
+    (3 + sizeof(((PPU*)0)->oam) + 3 + sizeof(((PPU*)0)->vram) + sizeof(((PPU*)0)->palette) + \
+     2 * 2 + 2)
+
+// Every mapper register is a byte (or a bool), so they're stored as they are in
+// memory. MMC3's registers are the biggest.
+#define MAPPER_REGS_SIZE (sizeof(((Mapper*)0)->mmc3))
+#define MAPPER_SECTION_SIZE(chr_writable)                                      \
+    (2 + 4 + 4 + 1 + PRG_SLOTS * 4 + 8 * 4 + MAPPER_REGS_SIZE + PRG_RAM_SIZE + \
+     ((chr_writable) ? CHR_RAM_SIZE : 0))
+
+_Static_assert(sizeof(((Mapper*)0)->mmc1) <= MAPPER_REGS_SIZE,
+               "MMC3 should have the most registers");
+
+/**
+ * Write a section's tag and length
+ *
+ * @param out - Where to write the section header
+ * @param tag - The section's 4 character tag
+ * @param size - The size of the section (not counting the header)
+ *
+ * @returns Where the section's data goes
+ */
+static uint8_t* putSection(uint8_t* out, const char* tag, uint32_t size) {
+    out = putBytes(out, tag, 4);
+    return put32(out, size);
+}
+
+// ---------- Saving ----------
+
+/**
+ * Find how big a save state of the machine is
+ *
+ * @param machine - The machine
+ *
+ * @returns The size of the state in bytes
+ */
+size_t saveStateSize(const Machine* machine) {
+    size_t size = HEADER_SIZE + 4 * SECTION_HEADER_SIZE + CPU_SECTION_SIZE + RAM_SIZE +
+                  PPU_SECTION_SIZE + MAPPER_SECTION_SIZE(machine->mapper->chr_writable);
+    if (machine->controllers != NULL) {
+        size += SECTION_HEADER_SIZE + PADS_SECTION_SIZE;
+    }
+    if (machine->apu != NULL) {
+        size += SECTION_HEADER_SIZE + APU_SECTION_SIZE;
+    }
+    return size;
+}
+
+static uint8_t* saveCpu(uint8_t* out, const Machine* machine) {
+    // P might have flags that haven't been worked out yet
+    Processor processor = *machine->processor;
+    syncFlags(&processor);
+
+    out = putSection(out, "CPU ", CPU_SECTION_SIZE);
+    out = put16(out, processor.PC);
+    *out++ = processor.S;
+    *out++ = processor.P;
+    *out++ = processor.A;
+    *out++ = processor.X;
+    *out++ = processor.Y;
+    return put64(out, *machine->cycles);
+}
+
+static uint8_t* savePpu(uint8_t* out, const PPU* ppu) {
+    out = putSection(out, "PPU ", PPU_SECTION_SIZE);
+    *out++ = ppu->ctrl;
+    *out++ = ppu->mask;
+    *out++ = ppu->status;
+    out = putBytes(out, ppu->oam, sizeof(ppu->oam));
+    *out++ = ppu->oam_addr;
+    *out++ = ppu->data_buffer;
+    *out++ = ppu->open_bus;
+    out = putBytes(out, ppu->vram, sizeof(ppu->vram));
+    out = putBytes(out, ppu->palette, sizeof(ppu->palette));
+
+    out = put16(out, ppu->v);
+    out = put16(out, ppu->t);
+    *out++ = ppu->x;
+    *out++ = ppu->w;
+
+    out = put16(out, ppu->scanline);
+    out = put16(out, ppu->cycle);
+    out = put64(out, ppu->frame);
+
+    *out++ = ppu->nmi_occurred;
+    *out++ = ppu->nmi_output;
+    *out++ = ppu->nmi_line;
+    *out++ = ppu->nmi_pending;
+    out = put16(out, ppu->dma_cycles);
+    out = put64(out, ppu->synced_cycle);
+
+    return putBytes(out, ppu->framebuffer, sizeof(ppu->framebuffer));
+}
+
+static uint8_t* saveControllers(uint8_t* out, const Controllers* controllers) {
+    out = putSection(out, "PADS", PADS_SECTION_SIZE);
+    out = putBytes(out, controllers->buttons, CONTROLLER_PORTS);
+    out = putBytes(out, controllers->shift, CONTROLLER_PORTS);
+    *out++ = controllers->strobe;
+    return out;
+}
+
+static uint8_t* saveEnvelope(uint8_t* out, const Envelope* envelope) {
+    *out++ = envelope->start;
+    *out++ = envelope->loop;
+    *out++ = envelope->constant;
+    *out++ = envelope->period;
+    *out++ = envelope->divider;
+    *out++ = envelope->decay;
+    return out;
+}
+
+// Where the synthesizer is (the levels last given to it and the start of the
+// block of audio) isn't saved, since it only matters to audio already output
+// and a run has to end in the same state whether or not it's heard
+static uint8_t* saveApu(uint8_t* out, const APU* apu) {
+    out = putSection(out, "APU ", APU_SECTION_SIZE);
+    for (int channel = 0; channel < 2; channel++) {
+        const Pulse* pulse = &apu->pulse[channel];
+        *out++ = pulse->duty;
+        *out++ = pulse->step;
+        out = put16(out, pulse->period);
+        out = put32(out, pulse->delay);
+        *out++ = pulse->length;
+        out = saveEnvelope(out, &pulse->envelope);
+        *out++ = pulse->sweep_enabled;
+        *out++ = pulse->sweep_negate;
+        *out++ = pulse->sweep_reload;
+        *out++ = pulse->sweep_period;
+        *out++ = pulse->sweep_shift;
+        *out++ = pulse->sweep_divider;
+    }
+
+    const Triangle* triangle = &apu->triangle;
+    *out++ = triangle->step;
+    out = put16(out, triangle->period);
+    out = put32(out, triangle->delay);
+    *out++ = triangle->length;
+    *out++ = triangle->control;
+    *out++ = triangle->linear;
+    *out++ = triangle->linear_period;
+    *out++ = triangle->linear_reload;
+
+    const Noise* noise = &apu->noise;
+    out = put16(out, noise->lfsr);
+    *out++ = noise->short_mode;
+    out = put16(out, noise->period);
+    out = put32(out, noise->delay);
+    *out++ = noise->length;
+    out = saveEnvelope(out, &noise->envelope);
+
+    const Dmc* dmc = &apu->dmc;
+    *out++ = dmc->irq_enabled;
+    *out++ = dmc->loop;
+    out = put16(out, dmc->period);
+    out = put32(out, dmc->delay);
+    *out++ = dmc->level;
+    out = put16(out, dmc->sample_addr);
+    out = put16(out, dmc->sample_length);
+    out = put16(out, dmc->addr);
+    out = put16(out, dmc->remaining);
+    *out++ = dmc->buffer;
+    *out++ = dmc->buffer_full;
+    *out++ = dmc->shift;
+    *out++ = dmc->bits;
+    *out++ = dmc->silent;
+
+    *out++ = apu->enabled;
+    *out++ = apu->five_step;
+    *out++ = apu->irq_inhibit;
+    *out++ = apu->frame_irq;
+    *out++ = apu->dmc_irq;
+    *out++ = apu->frame_step;
+    out = put64(out, apu->frame_start);
+    out = put16(out, apu->dma_cycles);
+    return put64(out, apu->synced_cycle);
+}
+
+static uint8_t* saveMapper(uint8_t* out, const Mapper* mapper) {
+    out = putSection(out, "MAPR", MAPPER_SECTION_SIZE(mapper->chr_writable));
+
+    // Which cartridge the state belongs to
+    out = put16(out, mapper->number);
+    out = put32(out, mapper->prg_size);
+    out = put32(out, mapper->chr_size);
+
+    *out++ = mapper->mirroring;
+    for (int slot = 0; slot < PRG_SLOTS; slot++) {
+        out = put32(out, mapper->prg_offsets[slot]);
+    }
+    for (int page = 0; page < 8; page++) {
+        out = put32(out, mapper->chr_pages[page] - mapper->chr);
+    }
+    out = putBytes(out, &mapper->mmc3, MAPPER_REGS_SIZE);
+
+    out = putBytes(out, mapper->prg_ram, PRG_RAM_SIZE);
+    if (mapper->chr_writable) {
+        out = putBytes(out, mapper->chr_ram, CHR_RAM_SIZE);
+    }
+    return out;
+}
+
+/**
+ * Save the machine's state into a buffer. Every value is stored little endian,
+ * so a state can be loaded on any host.
+ *
+ * @param machine - The machine to save
+ * @param buffer - Where to write the state
+ * @param size - The size of the buffer (at least saveStateSize bytes)
+ *
+ * @returns The number of bytes written
+ * @returns 0 if the buffer is too small
+ */
+size_t saveState(const Machine* machine, uint8_t* buffer, size_t size) {
+    if (size < saveStateSize(machine)) {
+        return 0;
+    }
+
+    uint8_t* out = putBytes(buffer, STATE_MAGIC, 8);
+    out = put32(out, STATE_VERSION);
+
+    out = saveCpu(out, machine);
+    out = putSection(out, "RAM ", RAM_SIZE);
+    out = putBytes(out, machine->ram, RAM_SIZE);
+    out = savePpu(out, machine->ppu);
+    out = saveMapper(out, machine->mapper);
+    if (machine->controllers != NULL) {
+        out = saveControllers(out, machine->controllers);
+    }
+    if (machine->apu != NULL) {
+        out = saveApu(out, machine->apu);
+    }
+
+    return out - buffer;
+}
+
+// ---------- Loading ----------
+
+// Where each known section's data starts in a state being loaded
+typedef struct {
+    const uint8_t* cpu;
+    const uint8_t* ram;
+    const uint8_t* ppu;
+    const uint8_t* mapper;
+    const uint8_t* controllers;  // Optional
+    const uint8_t* apu;          // Optional
+} StateSections;
+
+/**
+ * Find the sections of a state, checking that each one is the right size and
+ * the mapper section is from the machine's cartridge
+ *
+ * @param machine - The machine the state is being loaded into
+ * @param buffer - The state
+ * @param size - The size of the state
+ * @param sections - Set to where each section starts
+ *
+ * @returns 0 if the state is valid
+ * @returns -1 if it isn't
+ */
+static int findSections(const Machine* machine, const uint8_t* buffer, size_t size,
+                        StateSections* sections) {
+    *sections = (StateSections){0};
+
+    if (size < HEADER_SIZE || memcmp(buffer, STATE_MAGIC, 8) != 0) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Not a save state");
+        return -1;
+    }
+    const uint8_t* in = buffer + 8;
+    uint32_t version = get32(&in);
+    if (version > STATE_VERSION) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Save state is from a newer version (%u)", version);
+        return -1;
+    }
+
+    const Mapper* mapper = machine->mapper;
+    while (in < buffer + size) {
+        if ((size_t)(buffer + size - in) < SECTION_HEADER_SIZE) {
+            LOG(COMP_STATE, LEVEL_ERROR, "Save state is cut short");
+            return -1;
+        }
+        const uint8_t* tag = in;
+        in += 4;
+        uint32_t length = get32(&in);
+        if (length > (size_t)(buffer + size - in)) {
+            LOG(COMP_STATE, LEVEL_ERROR, "Save state is cut short");
+            return -1;
+        }
+
+        const uint8_t** section = NULL;
+        size_t expected = length;
+        if (memcmp(tag, "CPU ", 4) == 0) {
+            section = &sections->cpu;
+            expected = CPU_SECTION_SIZE;
+        } else if (memcmp(tag, "RAM ", 4) == 0) {
+            section = &sections->ram;
+            expected = RAM_SIZE;
+        } else if (memcmp(tag, "PPU ", 4) == 0) {
+            section = &sections->ppu;
+            expected = PPU_SECTION_SIZE;
+        } else if (memcmp(tag, "MAPR", 4) == 0) {
+            section = &sections->mapper;
+            expected = MAPPER_SECTION_SIZE(mapper->chr_writable);
+        } else if (memcmp(tag, "PADS", 4) == 0) {
+            section = &sections->controllers;
+            expected = PADS_SECTION_SIZE;
+        } else if (memcmp(tag, "APU ", 4) == 0) {
+            section = &sections->apu;
+            expected = APU_SECTION_SIZE;
+        }
+
+        if (section != NULL) {
+            if (length != expected) {
+                LOG(COMP_STATE, LEVEL_ERROR, "Save state section %.4s is the wrong size", tag);
+                return -1;
+            }
+            *section = in;
+        }
+        in += length;
+    }
+
+    if (!sections->cpu || !sections->ram || !sections->ppu || !sections->mapper) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Save state is missing part of the machine");
+        return -1;
+    }
+
+    in = sections->mapper;
+    uint16_t number = get16(&in);
+    uint32_t prg_size = get32(&in);
+    uint32_t chr_size = get32(&in);
+    if (number != mapper->number || prg_size != mapper->prg_size || chr_size != mapper->chr_size) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Save state is from another cartridge");
+        return -1;
+    }
+
+    // The PPU indexes its tables by where it is on the screen
+    in = sections->ppu + PPU_TIMING_OFFSET;
+    uint16_t scanline = get16(&in);
+    uint16_t cycle = get16(&in);
+    if (scanline >= PPU_SCANLINES || cycle >= PPU_DOTS_PER_SCANLINE) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Save state has the PPU off the screen (%u, %u)", scanline,
+            cycle);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int loadMapper(Mapper* mapper, const uint8_t* in) {
+    in += 2 + 4 + 4;
+    Mirroring mirroring = *in++;
+
+    uint32_t prg_offsets[PRG_SLOTS];
+    uint32_t chr_offsets[8];
+    for (int slot = 0; slot < PRG_SLOTS; slot++) {
+        prg_offsets[slot] = get32(&in);
+    }
+    for (int page = 0; page < 8; page++) {
+        chr_offsets[page] = get32(&in);
+    }
+    if (mirroring > MIRROR_FOUR_SCREEN ||
+        mapperRestoreBanks(mapper, prg_offsets, chr_offsets) != 0) {
+        LOG(COMP_STATE, LEVEL_ERROR, "Save state has banks the cartridge doesn't");
+        return -1;
+    }
+
+    mapper->mirroring = mirroring;
+    getBytes(&in, &mapper->mmc3, MAPPER_REGS_SIZE);
+    getBytes(&in, mapper->prg_ram, PRG_RAM_SIZE);
+    if (mapper->chr_writable) {
+        getBytes(&in, mapper->chr_ram, CHR_RAM_SIZE);
+
+        // The decoded tiles are from before the state was loaded
+        memset(mapper->tile_dirty, true, sizeof(mapper->tile_dirty));
+    }
+    return 0;
+}
+
+static void loadEnvelope(Envelope* envelope, const uint8_t** in) {
+    envelope->start = *(*in)++;
+    envelope->loop = *(*in)++;
+    envelope->constant = *(*in)++;
+    envelope->period = *(*in)++;
+    envelope->divider = *(*in)++;
+    envelope->decay = *(*in)++;
+}
+
+static void loadApu(APU* apu, const uint8_t* in) {
+    for (int channel = 0; channel < 2; channel++) {
+        Pulse* pulse = &apu->pulse[channel];
+        pulse->duty = *in++ & 0x03;
+        pulse->step = *in++ & 0x07;
+        pulse->period = get16(&in);
+        pulse->delay = get32(&in);
+        pulse->length = *in++;
+        loadEnvelope(&pulse->envelope, &in);
+        pulse->sweep_enabled = *in++;
+        pulse->sweep_negate = *in++;
+        pulse->sweep_reload = *in++;
+        pulse->sweep_period = *in++;
+        pulse->sweep_shift = *in++;
+        pulse->sweep_divider = *in++;
+    }
+
+    Triangle* triangle = &apu->triangle;
+    triangle->step = *in++ & 0x1F;
+    triangle->period = get16(&in);
+    triangle->delay = get32(&in);
+    triangle->length = *in++;
+    triangle->control = *in++;
+    triangle->linear = *in++;
+    triangle->linear_period = *in++;
+    triangle->linear_reload = *in++;
+
+    Noise* noise = &apu->noise;
+    noise->lfsr = get16(&in);
+    noise->short_mode = *in++;
+    noise->period = get16(&in);
+    noise->delay = get32(&in);
+    noise->length = *in++;
+    loadEnvelope(&noise->envelope, &in);
+
+    Dmc* dmc = &apu->dmc;
+    dmc->irq_enabled = *in++;
+    dmc->loop = *in++;
+    dmc->period = get16(&in);
+    dmc->delay = get32(&in);
+    dmc->level = *in++;
+    dmc->sample_addr = get16(&in);
+    dmc->sample_length = get16(&in);
+    dmc->addr = get16(&in);
+    dmc->remaining = get16(&in);
+    dmc->buffer = *in++;
+    dmc->buffer_full = *in++;
+    dmc->shift = *in++;
+    dmc->bits = *in++;
+    dmc->silent = *in++;
+
+    apu->enabled = *in++;
+    apu->five_step = *in++;
+    apu->irq_inhibit = *in++;
+    apu->frame_irq = *in++;
+    apu->dmc_irq = *in++;
+    apu->frame_step = *in++;
+    apu->frame_start = get64(&in);
+    apu->dma_cycles = get16(&in);
+    apu->synced_cycle = get64(&in);
+
+    // Whatever was waiting to be synthesized belongs to another point in time
+    apu->audio_start = apu->synced_cycle;
+    blipClear(&apu->blip);
+}
+
+static void loadPpu(PPU* ppu, const uint8_t* in) {
+    ppu->ctrl = *in++;
+    ppu->mask = *in++;
+    ppu->status = *in++;
+    getBytes(&in, ppu->oam, sizeof(ppu->oam));
+    ppu->oam_addr = *in++;
+    ppu->data_buffer = *in++;
+    ppu->open_bus = *in++;
+    getBytes(&in, ppu->vram, sizeof(ppu->vram));
+    getBytes(&in, ppu->palette, sizeof(ppu->palette));
+
+    ppu->v = get16(&in);
+    ppu->t = get16(&in);
+    ppu->x = *in++ & 0x07;
+    ppu->w = *in++;
+
+    ppu->scanline = get16(&in);
+    ppu->cycle = get16(&in);
+    ppu->frame = get64(&in);
+
+    ppu->nmi_occurred = *in++;
+    ppu->nmi_output = *in++;
+    ppu->nmi_line = *in++;
+    ppu->nmi_pending = *in++;
+    ppu->dma_cycles = get16(&in);
+    ppu->synced_cycle = get64(&in);
+
+    getBytes(&in, ppu->framebuffer, sizeof(ppu->framebuffer));
+}
+
+/**
+ * Restore the machine's state from a buffer. Nothing is changed unless the
+ * whole state is valid.
+ *
+ * @param machine - The machine to restore
+ * @param buffer - The state
+ * @param size - The size of the state
+ *
+ * @returns 0 if the state was loaded
+ * @returns -1 if it's corrupt, from a newer version, or from another cartridge
+ */
+int loadState(Machine* machine, const uint8_t* buffer, size_t size) {
+    StateSections sections;
+    if (findSections(machine, buffer, size, &sections) != 0) {
+        return -1;
+    }
+
+    // The banks are checked as they're mapped, so the mapper goes first
+    if (loadMapper(machine->mapper, sections.mapper) != 0) {
+        return -1;
+    }
+
+    const uint8_t* in = sections.cpu;
+    Processor* processor = machine->processor;
+    processor->PC = get16(&in);
+    processor->S = *in++;
+    processor->P = *in++;
+    processor->A = *in++;
+    processor->X = *in++;
+    processor->Y = *in++;
+    processor->flags_lazy = false;
+    *machine->cycles = get64(&in);
+
+    memcpy(machine->ram, sections.ram, RAM_SIZE);
+    loadPpu(machine->ppu, sections.ppu);
+
+    if (machine->controllers != NULL && sections.controllers != NULL) {
+        in = sections.controllers;
+        getBytes(&in, machine->controllers->buttons, CONTROLLER_PORTS);
+        getBytes(&in, machine->controllers->shift, CONTROLLER_PORTS);
+        machine->controllers->strobe = *in;
+    }
+    if (machine->apu != NULL && sections.apu != NULL) {
+        loadApu(machine->apu, sections.apu);
+    }
+
+    // The PPU's (and APU's) next event has moved
+    if (machine->ppu->scheduler != NULL) {
+        schedulerReschedule(machine->ppu->scheduler);
+    }
+    return 0;
+}
+
+/**
+ * Hash the machine's state, e.x. to check that two runs ended up in exactly
+ * the same place
+ *
+ * @param machine - The machine
+ *
+ * @returns The 64-bit FNV-1a hash of the machine's save state
+ */
+uint64_t saveStateHash(const Machine* machine) {
+    size_t size = saveStateSize(machine);
+    uint8_t* buffer = malloc(size);
+    if (buffer == NULL) {
+        return 0;
+    }
+    saveState(machine, buffer, size);
+
+    uint64_t hash = hashBytes(HASH_SEED, buffer, size);
+    free(buffer);
+    return hash;
+}
+
+// ---------- Files ----------
+
+/**
+ * Save the machine's state to a file
+ *
+ * @param machine - The machine to save
+ * @param path - The file to write
+ *
+ * @returns 0 if the state was saved
+ * @returns -1 if the file couldn't be written
+ */
+int saveStateFile(const Machine* machine, const char* path) {
+    size_t size = saveStateSize(machine);
+    uint8_t* buffer = malloc(size);
+    if (buffer == NULL) {
+        return -1;
+    }
+    size = saveState(machine, buffer, size);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        free(buffer);
+        return -1;
+    }
+
+    int result = 0;
+    if (fwrite(buffer, 1, size, file) != size) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", path);
+        result = -1;
+    }
+    fclose(file);
+    free(buffer);
+    return result;
+}
+
+/**
+ * Restore the machine's state from a file
+ *
+ * @param machine - The machine to restore
+ * @param path - The file to read
+ *
+ * @returns 0 if the state was loaded
+ * @returns -1 if the file couldn't be read or doesn't hold a valid state
+ */
+int loadStateFile(Machine* machine, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    uint8_t* buffer = size > 0 ? malloc(size) : NULL;
+    if (buffer == NULL || fread(buffer, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "ERROR: Failed to read %s\n", path);
+        free(buffer);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    int result = loadState(machine, buffer, size);
+    free(buffer);
+    return result;
+}
@@ -0,0 +1,69 @@
+#include "scheduler.h"
+
+#include "logger.h"
+
+#include <stdint.h>
+
+/**
+ * Set up a scheduler with no components
+ *
+ * @param scheduler - The scheduler to set up
+ * @param clock - The CPU's cycle count
+ */
+void initScheduler(Scheduler* scheduler, uint64_t* clock) {
+    *scheduler = (Scheduler){0};
+    scheduler->clock = clock;
+    scheduler->deadline = SCHEDULER_NO_EVENT;
+}
+
+/**
+ * Add a component to the scheduler, synced to the current CPU cycle
+ *
+ * @param scheduler - The scheduler
+ * @param component - The component to add
+ *
+ * @returns 0 if the component was added
+ * @returns -1 if the scheduler is full
+ */
+int schedulerAdd(Scheduler* scheduler, SchedulerComponent component) {
+    if (scheduler->count == SCHEDULER_MAX_COMPONENTS) {
+        LOG(COMP_SCHED, LEVEL_ERROR, "Too many components to schedule");
+        return -1;
+    }
+
+    scheduler->components[scheduler->count++] = component;
+    schedulerSync(scheduler);
+    return 0;
+}
+
+/**
+ * Find the next deadline again, after something the CPU did (like a register
+ * write) may have moved a component's next event
+ *
+ * @param scheduler - The scheduler
+ */
+void schedulerReschedule(Scheduler* scheduler) {
+    uint64_t deadline = SCHEDULER_NO_EVENT;
+    for (int i = 0; i < scheduler->count; i++) {
+        const SchedulerComponent* component = &scheduler->components[i];
+        uint64_t event = component->nextEvent(component->context);
+        if (event < deadline) {
+            deadline = event;
+        }
+    }
+    scheduler->deadline = deadline;
+}
+
+/**
+ * Catch every component up to the CPU, then find the next deadline
+ *
+ * @param scheduler - The scheduler
+ */
+void schedulerSync(Scheduler* scheduler) {
+    for (int i = 0; i < scheduler->count; i++) {
+        const SchedulerComponent* component = &scheduler->components[i];
+        component->catchUp(component->context, *scheduler->clock);
+    }
+    scheduler->syncs++;
+    schedulerReschedule(scheduler);
+}
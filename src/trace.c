@@ -0,0 +1,457 @@
+#include "trace.h"
+
+#include "6502.h"
+#include "ppu.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_WRITER_SLEEP_NS (1000000)  // How long the writer sleeps when the ring is empty
+#define TRACE_READ_CHUNK      (4096)     // Records the formatter reads at a time
+#define TRACE_INSTR_LENGTH    (24)       // Enough for any disassembled instruction
+
+/**
+ * Drain the ring into the trace file until the tracer is stopped and the ring
+ * is empty
+ *
+ * @param arg - The tracer
+ *
+ * @returns NULL
+ */
+static void* traceWriter(void* arg) {
+    Tracer* tracer = arg;
+
+    while (true) {
+        // Checking for a stop before looking at the head means every record
+        // pushed before freeTracer was called is seen
+        bool stopping = atomic_load_explicit(&tracer->stopping, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&tracer->tail, memory_order_relaxed);
+        uint64_t head = atomic_load_explicit(&tracer->head, memory_order_acquire);
+
+        if (head == tail) {
+            if (stopping) {
+                break;
+            }
+
+            struct timespec ts = {0, TRACE_WRITER_SLEEP_NS};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        // Write everything up to the end of the ring in one go
+        uint64_t start = tail & (TRACE_RING_SIZE - 1);
+        uint64_t count = head - tail;
+        if (count > TRACE_RING_SIZE - start) {
+            count = TRACE_RING_SIZE - start;
+        }
+        // After a failed write the records are still taken off the ring, so
+        // the CPU thread never waits on a writer that can't make progress
+        if (!tracer->failed) {
+            size_t written =
+                fwrite(&tracer->records[start], sizeof(TraceRecord), count, tracer->file);
+            tracer->written += written;
+            tracer->failed = written != count;
+        }
+
+        // Hand the slots back to the CPU thread
+        atomic_store_explicit(&tracer->tail, tail + count, memory_order_release);
+    }
+
+    return NULL;
+}
+
+/**
+ * Write the header that starts every trace file
+ *
+ * @param file - The trace file, at its start
+ * @param file_path - The path of the trace file (for errors)
+ *
+ * @returns 0 on success
+ * @returns -1 if it couldn't be written
+ */
+int writeTraceHeader(FILE* file, const char* file_path) {
+    TraceHeader header = {.version = TRACE_VERSION, .record_size = sizeof(TraceRecord)};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", file_path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Open a trace file and start the thread that writes to it
+ *
+ * @param file_path - The file to write the trace to (kept for errors, so it has to outlive
+ *                    the tracer)
+ *
+ * @returns A pointer to the tracer, or NULL if the file couldn't be opened
+ */
+Tracer* createTracer(const char* file_path) {
+    FILE* file = fopen(file_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", file_path);
+        return NULL;
+    }
+
+    if (writeTraceHeader(file, file_path) != 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    // The indexes are kept on separate cache lines, so the tracer has to be too.
+    // Records are zeroed once, since nothing else ever writes their padding.
+    Tracer* tracer = aligned_alloc(_Alignof(Tracer), sizeof(Tracer));
+    TraceRecord* records = calloc(TRACE_RING_SIZE, sizeof(TraceRecord));
+    if (tracer == NULL || records == NULL) {
+        free(tracer);
+        free(records);
+        fclose(file);
+        return NULL;
+    }
+
+    memset(tracer, 0, sizeof(Tracer));
+    tracer->records = records;
+    tracer->file = file;
+    tracer->path = file_path;
+    atomic_init(&tracer->head, 0);
+    atomic_init(&tracer->tail, 0);
+    atomic_init(&tracer->stopping, false);
+
+    if (pthread_create(&tracer->writer, NULL, traceWriter, tracer) != 0) {
+        fprintf(stderr, "ERROR: Failed to start the trace writer thread\n");
+        free(records);
+        free(tracer);
+        fclose(file);
+        return NULL;
+    }
+
+    return tracer;
+}
+
+/**
+ * Write out every record still in the ring, then stop the writer thread and
+ * close the trace file
+ *
+ * @param tracer - The tracer to free
+ *
+ * @returns 0 if every record was written
+ * @returns -1 if a write failed
+ */
+int freeTracer(Tracer* tracer) {
+    atomic_store_explicit(&tracer->stopping, true, memory_order_release);
+    pthread_join(tracer->writer, NULL);
+
+    int result = 0;
+    if (fclose(tracer->file) != 0 || tracer->failed) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", tracer->path);
+        result = -1;
+    }
+    free(tracer->records);
+    free(tracer);
+    return result;
+}
+
+/**
+ * Wait for the writer thread to make room in the ring
+ *
+ * @param tracer - The tracer
+ */
+void traceWaitForSpace(Tracer* tracer) {
+    uint64_t head = atomic_load_explicit(&tracer->head, memory_order_relaxed);
+
+    // The writer has usually moved on since the CPU thread last looked
+    tracer->cached_tail = atomic_load_explicit(&tracer->tail, memory_order_acquire);
+    if (head - tracer->cached_tail < TRACE_RING_SIZE) {
+        return;
+    }
+
+    tracer->stalls++;
+    while (head - tracer->cached_tail == TRACE_RING_SIZE) {
+        sched_yield();
+        tracer->cached_tail = atomic_load_explicit(&tracer->tail, memory_order_acquire);
+    }
+}
+
+// ---------- Formatting ----------
+
+/**
+ * Parse a trace format name ("text" or "nestest")
+ *
+ * @param name - The name of the format
+ * @param format - Set to the format
+ *
+ * @returns 0 if the name is valid
+ * @returns -1 if it isn't
+ */
+int parseTraceFormat(const char* name, TraceFormat* format) {
+    if (strcmp(name, "text") == 0) {
+        *format = TRACE_FORMAT_TEXT;
+    } else if (strcmp(name, "nestest") == 0) {
+        *format = TRACE_FORMAT_NESTEST;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Check if an opcode is one nestest.log marks with a '*' (anything that isn't
+ * an official instruction)
+ *
+ * @param opcode - The opcode byte
+ *
+ * @returns true if the opcode is unofficial
+ */
+static bool isUnofficial(uint8_t opcode) {
+    Mnemonic mnemonic = opcode_table[opcode].mnemonic;
+
+    // The unofficial mnemonics come after all of the official ones, and the
+    // only official NOP is $EA
+    return mnemonic == ILLEGAL || mnemonic >= SLO || (mnemonic == NOP && opcode != 0xEA);
+}
+
+/**
+ * Write out a record's instruction the way the disassembler prints it
+ *
+ * @param record - The record holding the instruction
+ * @param out - Buffer of at least TRACE_INSTR_LENGTH bytes
+ */
+static void formatText(const TraceRecord* record, char* out) {
+    const OpcodeInfo* info = &opcode_table[record->opcode];
+    const char* name = info->mnemonic == ILLEGAL ? "???" : info->name;
+    uint8_t zp = record->operands[0];
+    uint16_t addr = concatenateBytes(record->operands[1], record->operands[0]);
+
+    switch (info->mnemonic == ILLEGAL ? IMPL : info->addr_mode) {
+        case IMPL:
+            snprintf(out, TRACE_INSTR_LENGTH, IMPL_FORMAT, name);
+            break;
+        case ACCUM:
+            snprintf(out, TRACE_INSTR_LENGTH, ACCUM_FORMAT, name);
+            break;
+        case IMM:
+            snprintf(out, TRACE_INSTR_LENGTH, IMM_FORMAT, name, zp);
+            break;
+        case ZP:
+            snprintf(out, TRACE_INSTR_LENGTH, ZP_FORMAT, name, zp);
+            break;
+        case ZPX:
+            snprintf(out, TRACE_INSTR_LENGTH, ZPX_FORMAT, name, zp);
+            break;
+        case ZPY:
+            snprintf(out, TRACE_INSTR_LENGTH, ZPY_FORMAT, name, zp);
+            break;
+        case REL:
+            snprintf(out, TRACE_INSTR_LENGTH, REL_FORMAT, name, zp);
+            break;
+        case ABS:
+            snprintf(out, TRACE_INSTR_LENGTH, ABS_FORMAT, name, addr);
+            break;
+        case ABSX:
+            snprintf(out, TRACE_INSTR_LENGTH, ABSX_FORMAT, name, addr);
+            break;
+        case ABSY:
+            snprintf(out, TRACE_INSTR_LENGTH, ABSY_FORMAT, name, addr);
+            break;
+        case IND:
+            snprintf(out, TRACE_INSTR_LENGTH, IND_FORMAT, name, addr);
+            break;
+        case INDX:
+            snprintf(out, TRACE_INSTR_LENGTH, INDX_FORMAT, name, zp);
+            break;
+        case INDY:
+            snprintf(out, TRACE_INSTR_LENGTH, INDY_FORMAT, name, zp);
+            break;
+    }
+
+    // The formats end the line, but records are formatted without a newline
+    out[strcspn(out, "\n")] = '\0';
+}
+
+/**
+ * Write out a record's instruction the way nestest.log does (upper case, with
+ * branch targets rather than offsets). nestest.log also shows the memory each
+ * instruction touches, which isn't recorded, so that part is left out.
+ *
+ * @param record - The record holding the instruction
+ * @param out - Buffer of at least TRACE_INSTR_LENGTH bytes
+ */
+static void formatNestest(const TraceRecord* record, char* out) {
+    const OpcodeInfo* info = &opcode_table[record->opcode];
+    uint8_t zp = record->operands[0];
+    uint16_t addr = concatenateBytes(record->operands[1], record->operands[0]);
+
+    // Unofficial NOPs are named e.x. "NOP ($1A)", but nestest.log only shows the mnemonic
+    char name[4] = "???";
+    if (info->mnemonic != ILLEGAL) {
+        memcpy(name, info->name, 3);
+    }
+
+    switch (info->mnemonic == ILLEGAL ? IMPL : info->addr_mode) {
+        case IMPL:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s", name);
+            break;
+        case ACCUM:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s A", name);
+            break;
+        case IMM:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s #$%02X", name, zp);
+            break;
+        case ZP:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%02X", name, zp);
+            break;
+        case ZPX:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%02X,X", name, zp);
+            break;
+        case ZPY:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%02X,Y", name, zp);
+            break;
+        case REL:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%04X", name,
+                     (uint16_t)(record->pc + 2 + (int8_t)zp));
+            break;
+        case ABS:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%04X", name, addr);
+            break;
+        case ABSX:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%04X,X", name, addr);
+            break;
+        case ABSY:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s $%04X,Y", name, addr);
+            break;
+        case IND:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s ($%04X)", name, addr);
+            break;
+        case INDX:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s ($%02X,X)", name, zp);
+            break;
+        case INDY:
+            snprintf(out, TRACE_INSTR_LENGTH, "%s ($%02X),Y", name, zp);
+            break;
+    }
+}
+
+/**
+ * Format a trace record as a line of text (without a newline)
+ *
+ * @param record - The record to format
+ * @param format - How to format it
+ * @param line - Buffer of at least TRACE_LINE_LENGTH bytes to write the line to
+ */
+void formatTraceRecord(const TraceRecord* record, TraceFormat format, char* line) {
+    char instr[TRACE_INSTR_LENGTH];
+
+    if (format == TRACE_FORMAT_TEXT) {
+        formatText(record, instr);
+        snprintf(line, TRACE_LINE_LENGTH,
+                 "$%04x: %-16s A:%02x X:%02x Y:%02x P:%02x S:%02x CYC:%llu", record->pc, instr,
+                 record->a, record->x, record->y, record->p, record->s,
+                 (unsigned long long)record->cycles);
+        return;
+    }
+
+    // e.x. "C000  4C F5 C5  JMP $C5F5    ...    A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7"
+    const OpcodeInfo* info = &opcode_table[record->opcode];
+    int length = info->mnemonic == ILLEGAL ? 1 : info->length;
+    char bytes[9];
+    if (length == 1) {
+        snprintf(bytes, sizeof(bytes), "%02X", record->opcode);
+    } else if (length == 2) {
+        snprintf(bytes, sizeof(bytes), "%02X %02X", record->opcode, record->operands[0]);
+    } else {
+        snprintf(bytes, sizeof(bytes), "%02X %02X %02X", record->opcode, record->operands[0],
+                 record->operands[1]);
+    }
+
+    formatNestest(record, instr);
+
+    // Rendering is off in nestest, so no dots are skipped and the PPU's position
+    // follows from the cycle count
+    uint64_t dots = record->cycles * PPU_DOTS_PER_CPU_CYCLE;
+    int scanline = (dots / PPU_DOTS_PER_SCANLINE) % PPU_SCANLINES;
+    int dot = dots % PPU_DOTS_PER_SCANLINE;
+
+    snprintf(line, TRACE_LINE_LENGTH,
+             "%04X  %-8s %c%-31s A:%02X X:%02X Y:%02X P:%02X SP:%02X PPU:%3d,%3d CYC:%llu",
+             record->pc, bytes, isUnofficial(record->opcode) ? '*' : ' ', instr, record->a,
+             record->x, record->y, record->p, record->s, scanline, dot,
+             (unsigned long long)record->cycles);
+}
+
+/**
+ * Read and check the header at the start of a trace file
+ *
+ * @param file - The trace file, at its start
+ * @param file_path - The path of the trace file (for errors)
+ *
+ * @returns 0 if the file is a trace file this version can read
+ * @returns -1 if it isn't
+ */
+int readTraceHeader(FILE* file, const char* file_path) {
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "ERROR: %s is not a trace file\n", file_path);
+        return -1;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "ERROR: %s is from an unsupported version (%u)\n", file_path,
+                header.version);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Print every record in a trace file as text
+ *
+ * @param file_path - The trace file to read
+ * @param format - How to format the records
+ * @param out - Where to print the records
+ *
+ * @returns The number of records printed
+ * @returns -1 if the file couldn't be read or isn't a trace file
+ */
+long long formatTraceFile(const char* file_path, TraceFormat format, FILE* out) {
+    FILE* file = fopen(file_path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", file_path);
+        return -1;
+    }
+
+    if (readTraceHeader(file, file_path) != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    TraceRecord* records = malloc(TRACE_READ_CHUNK * sizeof(TraceRecord));
+    if (records == NULL) {
+        fclose(file);
+        return -1;
+    }
+
+    long long count = 0;
+    char line[TRACE_LINE_LENGTH];
+    size_t read;
+    while ((read = fread(records, sizeof(TraceRecord), TRACE_READ_CHUNK, file)) > 0) {
+        for (size_t i = 0; i < read; i++) {
+            formatTraceRecord(&records[i], format, line);
+            fprintf(out, "%s\n", line);
+        }
+        count += read;
+    }
+
+    free(records);
+    fclose(file);
+    return count;
+}
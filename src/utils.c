@@ -3,6 +3,7 @@
 #include "types.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -66,3 +67,21 @@ void printInstruction(Instruction instr) {
 uint16_t concatenateBytes(uint16_t ms_byte, uint16_t ls_byte) {
     return (ms_byte << 8) | ls_byte;
 }
+
+/**
+ * Hash some bytes with 64-bit FNV-1a. Pass the hash of one buffer as the seed of
+ * the next to hash them as if they were one.
+ *
+ * @param hash - The hash so far (HASH_SEED to start a new one)
+ * @param data - The bytes to hash
+ * @param size - The number of bytes
+ *
+ * @returns The hash
+ */
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
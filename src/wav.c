@@ -0,0 +1,114 @@
+#include "wav.h"
+
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAV_CHUNK_SAMPLES (1024)  // Samples converted to little endian at a time
+
+/**
+ * Fill in a WAV header for 16-bit mono samples
+ *
+ * @param header - WAV_HEADER_SIZE bytes to fill in
+ * @param sample_rate - Samples a second
+ * @param data_size - The size of the samples in bytes
+ */
+static void makeHeader(uint8_t* header, uint32_t sample_rate, uint32_t data_size) {
+    uint8_t* out = header;
+    memcpy(out, "RIFF", 4);
+    out = put32(out + 4, data_size + WAV_HEADER_SIZE - 8);
+    memcpy(out, "WAVEfmt ", 8);
+    out = put32(out + 8, 16);
+    out = put16(out, 1);  // PCM
+    out = put16(out, 1);  // Mono
+    out = put32(out, sample_rate);
+    out = put32(out, sample_rate * 2);  // Bytes a second
+    out = put16(out, 2);                // Bytes a sample
+    out = put16(out, 16);               // Bits a sample
+    memcpy(out, "data", 4);
+    put32(out + 4, data_size);
+}
+
+/**
+ * Open a WAV file and write its header
+ *
+ * @param path - The file (or named pipe) to write
+ * @param sample_rate - Samples a second
+ *
+ * @returns The writer
+ * @returns NULL if the file couldn't be opened
+ */
+WavWriter* createWavWriter(const char* path, uint32_t sample_rate) {
+    WavWriter* wav = calloc(1, sizeof(WavWriter));
+    if (wav == NULL) {
+        return NULL;
+    }
+
+    wav->path = path;
+    wav->sample_rate = sample_rate;
+    wav->file = fopen(path, "wb");
+    if (wav->file == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", path);
+        free(wav);
+        return NULL;
+    }
+    wav->seekable = fseek(wav->file, 0, SEEK_SET) == 0;
+
+    uint8_t header[WAV_HEADER_SIZE];
+    makeHeader(header, sample_rate, UINT32_MAX - WAV_HEADER_SIZE);
+    wav->failed = fwrite(header, 1, sizeof(header), wav->file) != sizeof(header);
+    return wav;
+}
+
+/**
+ * Close a WAV file, filling in the sizes in its header if it can
+ *
+ * @param wav - The writer to close
+ *
+ * @returns 0 if everything was written
+ * @returns -1 if a write failed
+ */
+int freeWavWriter(WavWriter* wav) {
+    if (wav->seekable && !wav->failed && fseek(wav->file, 0, SEEK_SET) == 0) {
+        uint64_t data_size = wav->samples * 2;
+        uint8_t header[WAV_HEADER_SIZE];
+        makeHeader(header, wav->sample_rate,
+                   data_size > UINT32_MAX - WAV_HEADER_SIZE ? UINT32_MAX - WAV_HEADER_SIZE
+                                                            : data_size);
+        wav->failed = fwrite(header, 1, sizeof(header), wav->file) != sizeof(header);
+    }
+
+    int result = fclose(wav->file);
+    if (wav->failed || result != 0) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", wav->path);
+        result = -1;
+    }
+    free(wav);
+    return result;
+}
+
+/**
+ * Add samples to the end of a WAV file
+ *
+ * @param wav - The writer
+ * @param samples - The samples
+ * @param count - The number of samples
+ */
+void wavWrite(WavWriter* wav, const int16_t* samples, int count) {
+    uint8_t bytes[WAV_CHUNK_SAMPLES * 2];
+    while (count > 0 && !wav->failed) {
+        int chunk = count < WAV_CHUNK_SAMPLES ? count : WAV_CHUNK_SAMPLES;
+        for (int i = 0; i < chunk; i++) {
+            put16(bytes + i * 2, samples[i]);
+        }
+        wav->failed = fwrite(bytes, 2, chunk, wav->file) != (size_t)chunk;
+
+        wav->samples += chunk;
+        samples += chunk;
+        count -= chunk;
+    }
+}
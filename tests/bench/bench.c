@@ -0,0 +1,388 @@
+// Benchmarks for the CPU core, run with `make bench`. Every opcode is timed
+// through parseInstruction and executeInstruction on its own, and a few whole
+// programs are timed through runInstructions. Each measurement is repeated, and
+// the min, median and 99th percentile of the repetitions are written to a JSON
+// file so that runs from different builds can be compared.
+
+#include "6502.h"
+#include "bus.h"
+#include "interpreter.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_OUTPUT        "bench.json"
+#define BENCH_DEFAULT_REPS          (31)
+#define BENCH_OPCODE_ITERATIONS     (20000)    // Times each opcode is executed per repetition
+#define BENCH_WORKLOAD_CYCLES       (2000000)  // Cycles an endless loop runs for per repetition
+#define BENCH_WORKLOAD_INSTRUCTIONS (200000)   // Fewest instructions a repetition can run
+#define BENCH_PROGRAM_START         (0x0600)   // Where programs are loaded (like -r)
+#define BENCH_IRQ_TARGET            (0x0700)   // Where BRK jumps to (0 would halt)
+
+// Defined in nes.c
+int loadFile(uint8_t* mem, int start_addr, const char* file_path);
+
+// The min, median and 99th percentile of a set of repetitions
+typedef struct {
+    double min;
+    double median;
+    double p99;
+} Stats;
+
+// A whole program to time. Programs with a file run until they end, while the
+// synthetic ones loop forever and run for BENCH_WORKLOAD_CYCLES.
+typedef struct {
+    const char* name;
+    const char* file;       // A hexdump like the ones run with -r (or NULL)
+    const uint8_t* code;    // Used when there's no file
+    int code_size;
+} Workload;
+
+// Arithmetic and logic on the accumulator, with a few transfers
+static const uint8_t alu_loop[] = {
+    0x18,              // $0600: CLC
+    0x69, 0x13,        // $0601: ADC #$13
+    0x49, 0x5A,        // $0603: EOR #$5A
+    0x0A,              // $0605: ASL A
+    0x6A,              // $0606: ROR A
+    0x29, 0xF7,        // $0607: AND #$F7
+    0x09, 0x01,        // $0609: ORA #$01
+    0x38,              // $060B: SEC
+    0xE9, 0x07,        // $060C: SBC #$07
+    0xC9, 0x40,        // $060E: CMP #$40
+    0xAA,              // $0610: TAX
+    0xE8,              // $0611: INX
+    0x8A,              // $0612: TXA
+    0x4C, 0x00, 0x06,  // $0613: JMP $0600
+};
+
+// Branches that are taken some of the time, depending on a counter
+static const uint8_t branch_loop[] = {
+    0xE8,              // $0600: INX
+    0x8A,              // $0601: TXA
+    0x29, 0x03,        // $0602: AND #$03
+    0xF0, 0x04,        // $0604: BEQ $060A
+    0xC9, 0x02,        // $0606: CMP #$02
+    0xB0, 0x02,        // $0608: BCS $060C
+    0x30, 0x00,        // $060A: BMI $060C
+    0x4C, 0x00, 0x06,  // $060C: JMP $0600
+};
+
+// Copies through indexed and indirect addressing
+static const uint8_t memory_loop[] = {
+    0xA9, 0x00,        // $0600: LDA #$00
+    0x85, 0x10,        // $0602: STA $10
+    0x85, 0x12,        // $0604: STA $12
+    0xA9, 0x04,        // $0606: LDA #$04
+    0x85, 0x11,        // $0608: STA $11
+    0xA9, 0x05,        // $060A: LDA #$05
+    0x85, 0x13,        // $060C: STA $13
+    0xA2, 0x00,        // $060E: LDX #$00
+    0xBD, 0x00, 0x02,  // $0610: LDA $0200,X
+    0x9D, 0x00, 0x03,  // $0613: STA $0300,X
+    0xB1, 0x10,        // $0616: LDA ($10),Y
+    0x91, 0x12,        // $0618: STA ($12),Y
+    0xE6, 0x20,        // $061A: INC $20
+    0xC8,              // $061C: INY
+    0xE8,              // $061D: INX
+    0xD0, 0xF0,        // $061E: BNE $0610
+    0x4C, 0x0E, 0x06,  // $0620: JMP $060E
+};
+
+static const Workload workloads[] = {
+    {"snake", "input/snake.input", NULL, 0},
+    {"alu", NULL, alu_loop, sizeof(alu_loop)},
+    {"branch", NULL, branch_loop, sizeof(branch_loop)},
+    {"memory", NULL, memory_loop, sizeof(memory_loop)},
+};
+
+static const char* const mode_names[] = {
+    [IMPL] = "IMPL", [ACCUM] = "ACCUM", [IMM] = "IMM",   [ZP] = "ZP",     [ZPX] = "ZPX",
+    [ZPY] = "ZPY",   [REL] = "REL",     [ABS] = "ABS",   [ABSX] = "ABSX", [ABSY] = "ABSY",
+    [IND] = "IND",   [INDX] = "INDX",   [INDY] = "INDY",
+};
+
+// Keeps the compiler from throwing away work whose result is never used
+static volatile uint8_t sink;
+
+/**
+ * Return the current time
+ *
+ * @returns The time in nanoseconds
+ */
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Compare two doubles for qsort
+ */
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Summarize a set of repetitions (sorting them)
+ *
+ * @param samples - The result of each repetition
+ * @param count - The number of repetitions
+ *
+ * @returns Their min, median and 99th percentile (nearest rank)
+ */
+static Stats summarize(double* samples, int count) {
+    qsort(samples, count, sizeof(double), compareDoubles);
+
+    int p99 = (count * 99 + 99) / 100 - 1;
+    return (Stats){samples[0], samples[count / 2], samples[p99]};
+}
+
+/**
+ * Check whether an opcode is one of the unofficial ones
+ *
+ * @param opcode - The opcode
+ *
+ * @returns true if it isn't part of the documented instruction set
+ */
+static bool isUnofficial(uint8_t opcode) {
+    const OpcodeInfo* info = &opcode_table[opcode];
+    return info->mnemonic >= SLO || (info->mnemonic == NOP && opcode != 0xEA);
+}
+
+/**
+ * Put an opcode at the start of the program with operands that point at
+ * memory it can safely use, whatever its addressing mode
+ *
+ * @param mem - The 64 KiB of memory
+ * @param opcode - The opcode to set up
+ */
+static void setupOpcode(uint8_t* mem, uint8_t opcode) {
+    memset(mem, 0, MEMORY_SPACE);
+
+    // Zero page $20, absolute $0220 and a branch forward of $20
+    mem[BENCH_PROGRAM_START] = opcode;
+    mem[BENCH_PROGRAM_START + 1] = 0x20;
+    mem[BENCH_PROGRAM_START + 2] = 0x02;
+
+    // (zp,X) and (zp),Y read their pointer from $20, and JMP ($0220) goes back
+    // to the start of the program
+    mem[0x20] = 0x00;
+    mem[0x21] = 0x03;
+    mem[0x0220] = BENCH_PROGRAM_START & 0xFF;
+    mem[0x0221] = BENCH_PROGRAM_START >> 8;
+
+    mem[0xFFFE] = BENCH_IRQ_TARGET & 0xFF;
+    mem[0xFFFF] = BENCH_IRQ_TARGET >> 8;
+}
+
+/**
+ * Time an opcode going through parseInstruction and executeInstruction. The
+ * registers are put back before each execution so that every one of them does
+ * the same work.
+ *
+ * @param bus - A flat bus over 'mem'
+ * @param mem - The 64 KiB of memory
+ * @param opcode - The opcode to time
+ * @param reps - The number of repetitions
+ * @param samples - Set to the ns/instruction of each repetition
+ */
+static void benchOpcode(Bus* bus, uint8_t* mem, uint8_t opcode, int reps, double* samples) {
+    setupOpcode(mem, opcode);
+
+    Processor start = {0};
+    start.PC = BENCH_PROGRAM_START;
+    start.S = 0xFF;
+    start.P = 0x30;
+
+    // The first repetition isn't counted, so caches and branch predictors are warm
+    for (int rep = -1; rep < reps; rep++) {
+        uint64_t begin = nowNs();
+        for (int i = 0; i < BENCH_OPCODE_ITERATIONS; i++) {
+            Processor processor = start;
+            Instruction instr = parseInstruction(bus, processor.PC);
+            executeInstruction(instr, bus, &processor);
+            sink = processor.A;
+        }
+        uint64_t elapsed = nowNs() - begin;
+
+        if (rep >= 0) {
+            samples[rep] = (double)elapsed / BENCH_OPCODE_ITERATIONS;
+        }
+    }
+}
+
+/**
+ * Time a whole program running through runInstructions. Programs that end
+ * quickly are run again, from a fresh copy of memory, until a repetition has
+ * run at least BENCH_WORKLOAD_INSTRUCTIONS instructions.
+ *
+ * @param bus - A flat bus over 'mem'
+ * @param mem - The 64 KiB of memory
+ * @param workload - The program to run
+ * @param reps - The number of repetitions
+ * @param samples - Set to the ns/instruction of each repetition
+ * @param instructions - Set to the number of instructions in a repetition
+ *
+ * @returns 0 on success
+ * @returns -1 if the program couldn't be loaded
+ */
+static int benchWorkload(Bus* bus, uint8_t* mem, const Workload* workload, int reps,
+                         double* samples, uint64_t* instructions) {
+    uint8_t* image = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    if (image == NULL) {
+        return -1;
+    }
+
+    int size = workload->code_size;
+    if (workload->file != NULL) {
+        size = loadFile(image, BENCH_PROGRAM_START, workload->file);
+        if (size < 0) {
+            free(image);
+            return -1;
+        }
+    } else {
+        memcpy(image + BENCH_PROGRAM_START, workload->code, size);
+    }
+
+    // Files end when they run off the end of the program, loops at the cycle limit
+    uint64_t cycle_limit = workload->file != NULL ? UINT64_MAX : BENCH_WORKLOAD_CYCLES;
+    int32_t stop_pc = workload->file != NULL ? BENCH_PROGRAM_START + size : NO_STOP_PC;
+
+    for (int rep = -1; rep < reps; rep++) {
+        uint64_t elapsed = 0;
+        *instructions = 0;
+
+        while (*instructions < BENCH_WORKLOAD_INSTRUCTIONS) {
+            memcpy(mem, image, MEMORY_SPACE);
+
+            Processor processor = {0};
+            processor.PC = BENCH_PROGRAM_START;
+            processor.S = 0xFF;
+            processor.P = 0x30;
+            uint64_t cycles = 0;
+
+            uint64_t begin = nowNs();
+            uint64_t executed = runInstructions(bus, &processor, &cycles, cycle_limit, stop_pc);
+            elapsed += nowNs() - begin;
+            sink = processor.A;
+
+            if (executed == 0) {
+                break;
+            }
+            *instructions += executed;
+        }
+
+        if (rep >= 0) {
+            samples[rep] = (double)elapsed / (*instructions > 0 ? *instructions : 1);
+        }
+    }
+
+    free(image);
+    return 0;
+}
+
+/**
+ * Write a set of stats as JSON fields
+ *
+ * @param file - The file to write to
+ * @param stats - The stats to write
+ */
+static void writeStats(FILE* file, Stats stats) {
+    fprintf(file, "\"min_ns\": %.3f, \"median_ns\": %.3f, \"p99_ns\": %.3f", stats.min,
+            stats.median, stats.p99);
+}
+
+int main(int argc, char** argv) {
+    const char* output_path = argc > 1 ? argv[1] : BENCH_DEFAULT_OUTPUT;
+    int reps = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_REPS;
+    if (reps <= 0) {
+        fprintf(stderr, "Usage: %s [output.json] [repetitions]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* mem = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    double* samples = malloc(reps * sizeof(double));
+    Bus* bus = mem ? createFlatBus(mem) : NULL;
+    FILE* output = fopen(output_path, "w");
+    if (output == NULL) {
+        fprintf(stderr, "ERROR: Failed to open %s\n", output_path);
+    }
+    if (bus == NULL || samples == NULL || output == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef THREADED_CORE
+    const char* core = "threaded";
+#else
+    const char* core = "switch";
+#endif
+    fprintf(output, "{\n  \"core\": \"%s\",\n  \"repetitions\": %d,\n", core, reps);
+
+    fprintf(output, "  \"opcodes\": [\n");
+    bool first = true;
+    double total_median = 0;
+    int timed = 0;
+    for (int opcode = 0; opcode < 256; opcode++) {
+        const OpcodeInfo* info = &opcode_table[opcode];
+        if (info->mnemonic == ILLEGAL) {
+            continue;
+        }
+
+        benchOpcode(bus, mem, opcode, reps, samples);
+        Stats stats = summarize(samples, reps);
+        total_median += stats.median;
+        timed++;
+
+        fprintf(output, "%s    {\"opcode\": \"0x%02X\", \"name\": \"%s\", \"mode\": \"%s\", ",
+                first ? "" : ",\n", opcode, info->name, mode_names[info->addr_mode]);
+        fprintf(output, "\"official\": %s, ", isUnofficial(opcode) ? "false" : "true");
+        writeStats(output, stats);
+        fprintf(output, "}");
+        first = false;
+    }
+    fprintf(output, "\n  ],\n");
+    printf("Timed %d opcodes (mean of the medians %.2f ns/instruction)\n", timed,
+           total_median / timed);
+
+    fprintf(output, "  \"workloads\": [\n");
+    int result = EXIT_SUCCESS;
+    first = true;
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        uint64_t instructions;
+        if (benchWorkload(bus, mem, &workloads[i], reps, samples, &instructions) != 0) {
+            result = EXIT_FAILURE;
+            continue;
+        }
+        Stats stats = summarize(samples, reps);
+
+        fprintf(output, "%s    {\"name\": \"%s\", \"instructions\": %llu, ", first ? "" : ",\n",
+                workloads[i].name, (unsigned long long)instructions);
+        writeStats(output, stats);
+        fprintf(output, "}");
+        first = false;
+
+        printf("%-8s %10llu instructions  min %.2f  median %.2f  p99 %.2f ns/instruction\n",
+               workloads[i].name, (unsigned long long)instructions, stats.min, stats.median,
+               stats.p99);
+    }
+    fprintf(output, "\n  ]\n}\n");
+
+    if (fclose(output) != 0) {
+        fprintf(stderr, "ERROR: Failed to write %s\n", output_path);
+        result = EXIT_FAILURE;
+    } else {
+        printf("Wrote %s\n", output_path);
+    }
+
+    freeBus(bus);
+    free(samples);
+    free(mem);
+    return result;
+}
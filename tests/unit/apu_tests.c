@@ -0,0 +1,332 @@
+#include "apu.h"
+#include "blip.h"
+#include "bus.h"
+#include "pacer.h"
+#include "wav.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES (2 * APU_SAMPLE_RATE)
+
+// ---------- Test Setup/Cleanup ----------
+
+static APU* apu;
+static APU* other;
+static Bus* test_bus;
+static uint8_t prg[0x4000];
+
+static int16_t* samples;
+static int sample_count;
+
+static void init_test() {
+    apu = createAPU();
+    other = createAPU();
+    test_bus = createBus();
+    memset(prg, 0, sizeof(prg));
+    busMapMemory(test_bus, 0xC000, 0x4000, prg, sizeof(prg), false);
+    apuMapRegisters(apu, test_bus);
+
+    samples = calloc(MAX_SAMPLES, sizeof(int16_t));
+    sample_count = 0;
+}
+
+static void clean_test() {
+    freeAPU(apu);
+    freeAPU(other);
+    freeBus(test_bus);
+    free(samples);
+}
+
+// Collect the APU's output in samples
+static void collectSamples(void* context, const int16_t* block, int count) {
+    (void)context;
+    if (sample_count + count <= MAX_SAMPLES) {
+        memcpy(samples + sample_count, block, count * sizeof(int16_t));
+    }
+    sample_count += count;
+}
+
+// ---------- Tests ----------
+
+void test_apu_status() {
+    // Lengths only load while their channel is enabled
+    busWrite(test_bus, 0x4003, 0x08);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4015) & 0x0F, 0);
+
+    busWrite(test_bus, 0x4015, 0x0F);
+    busWrite(test_bus, 0x4003, 0x08);
+    busWrite(test_bus, 0x4007, 0x08);
+    busWrite(test_bus, 0x400B, 0x08);
+    busWrite(test_bus, 0x400F, 0x08);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 254);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4015) & 0x0F, 0x0F);
+
+    // Disabling a channel clears its length
+    busWrite(test_bus, 0x4015, 0x0E);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4015) & 0x0F, 0x0E);
+}
+
+void test_apu_length_counter() {
+    busWrite(test_bus, 0x4015, 0x01);
+    busWrite(test_bus, 0x4000, 0x10);
+    busWrite(test_bus, 0x4003, 0x18);  // Length 2
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 2);
+
+    // Lengths count down on the two half frames of the sequence
+    apuCatchUp(apu, 14912);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 2);
+    apuCatchUp(apu, 14913);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 1);
+    apuCatchUp(apu, 29829);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 0);
+    CU_ASSERT_EQUAL(apuReadStatus(apu) & 0x01, 0);
+
+    // The loop flag halts it
+    busWrite(test_bus, 0x4000, 0x30);
+    busWrite(test_bus, 0x4003, 0x18);
+    apuCatchUp(apu, 29830 + 29829);
+    CU_ASSERT_EQUAL(apu->pulse[0].length, 2);
+}
+
+void test_apu_frame_irq() {
+    // Blocks of audio only end when there's an output
+    CU_ASSERT_EQUAL(apuNextEvent(apu), 29829);
+    apuSetOutput(apu, collectSamples, NULL);
+    CU_ASSERT_EQUAL(apuNextEvent(apu), APU_FRAME_CYCLES);
+    apuCatchUp(apu, APU_FRAME_CYCLES);
+    CU_ASSERT_EQUAL(apuNextEvent(apu), 29829);
+
+    apuCatchUp(apu, 29828);
+    CU_ASSERT_FALSE(apuIrq(apu));
+    apuCatchUp(apu, 29829);
+    CU_ASSERT_TRUE(apuIrq(apu));
+
+    // Reading $4015 acknowledges it
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4015) & 0x40, 0x40);
+    CU_ASSERT_FALSE(apuIrq(apu));
+
+    // Neither the inhibited 4 step sequence nor the 5 step one raise it
+    busWrite(test_bus, 0x4017, 0x40);
+    apuCatchUp(apu, 29830 + 2 * 29830);
+    CU_ASSERT_FALSE(apuIrq(apu));
+    busWrite(test_bus, 0x4017, 0x80);
+    apuCatchUp(apu, 29830 + 5 * 37282);
+    CU_ASSERT_FALSE(apuIrq(apu));
+}
+
+void test_apu_dmc() {
+    prg[0] = 0xFF;
+    busWrite(test_bus, 0x4011, 64);
+    busWrite(test_bus, 0x4010, 0x8F);  // IRQ, 54 cycles a bit
+    busWrite(test_bus, 0x4012, 0x00);  // $C000
+    busWrite(test_bus, 0x4013, 0x00);  // 1 byte
+
+    // Enabling it reads the first byte straight away, stalling the CPU
+    busWrite(test_bus, 0x4015, 0x10);
+    CU_ASSERT_EQUAL(apu->dma_cycles, 4);
+    CU_ASSERT_TRUE(apu->dmc.buffer_full);
+    CU_ASSERT_EQUAL(apu->dmc.remaining, 0);
+    CU_ASSERT_TRUE(apuIrq(apu));
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4015) & 0x90, 0x80);
+
+    // The new rate starts after the timer's current (power-on) period. The
+    // byte starts once the silent one before it ends, each 1 going up 2.
+    uint64_t start = 428 + 7 * 54;
+    apuCatchUp(apu, start);
+    CU_ASSERT_EQUAL(apu->dmc.level, 64);
+    CU_ASSERT_FALSE(apu->dmc.buffer_full);
+    apuCatchUp(apu, start + 8 * 54);
+    CU_ASSERT_EQUAL(apu->dmc.level, 80);
+    CU_ASSERT_TRUE(apu->dmc.silent);
+
+    // Turning the IRQ off acknowledges it, and a looping sample starts over
+    busWrite(test_bus, 0x4010, 0x4F);
+    CU_ASSERT_FALSE(apuIrq(apu));
+    busWrite(test_bus, 0x4013, 0x01);  // 17 bytes
+    busWrite(test_bus, 0x4015, 0x10);
+    CU_ASSERT_EQUAL(apu->dmc.remaining, 16);
+    CU_ASSERT_EQUAL(apu->dmc.addr, 0xC001);
+    CU_ASSERT_EQUAL(apu->dma_cycles, 8);
+
+    // The next byte is read as soon as this one starts
+    uint64_t next = start + 8 * 54 + 8 * 54;
+    CU_ASSERT_EQUAL(apuNextEvent(apu), next);
+    apuCatchUp(apu, next);
+    CU_ASSERT_EQUAL(apu->dmc.remaining, 15);
+
+    apuCatchUp(apu, next + 16 * 8 * 54);
+    CU_ASSERT_EQUAL(apu->dmc.remaining, 16);
+    CU_ASSERT_EQUAL(apu->dmc.addr, 0xC001);
+    CU_ASSERT_EQUAL(apu->dma_cycles, 8 + 17 * 4);
+    CU_ASSERT_FALSE(apuIrq(apu));
+}
+
+void test_apu_output() {
+    apuSetOutput(apu, collectSamples, NULL);
+
+    // A 50% square at 1789773 / (16 * 254) = 440.4 Hz
+    busWrite(test_bus, 0x4015, 0x01);
+    busWrite(test_bus, 0x4000, 0xBF);
+    busWrite(test_bus, 0x4002, 253);
+    busWrite(test_bus, 0x4003, 0x08);
+    apuCatchUp(apu, CPU_CLOCK_HZ);
+    apuFlush(apu);
+
+    CU_ASSERT(sample_count >= APU_SAMPLE_RATE - 1 && sample_count <= APU_SAMPLE_RATE + 1);
+    CU_ASSERT_EQUAL(apu->samples, sample_count);
+
+    // Count the cycles once the leak has centered the wave
+    int rises = 0;
+    int16_t peak = 0;
+    for (int i = APU_SAMPLE_RATE / 10; i < sample_count; i++) {
+        rises += samples[i - 1] < 0 && samples[i] >= 0;
+        peak = samples[i] > peak ? samples[i] : peak;
+    }
+    CU_ASSERT(rises >= 394 && rises <= 398);
+    CU_ASSERT(peak > 15 * 241 / 4);
+
+    // Silence stays silent
+    sample_count = 0;
+    busWrite(test_bus, 0x4015, 0x00);
+    apuCatchUp(apu, 3 * CPU_CLOCK_HZ);
+    CU_ASSERT_EQUAL(samples[sample_count - 1], 0);
+}
+
+void test_apu_noise_jump() {
+    // With the volume at 0 the shift register is jumped ahead instead of shifted
+    for (int mode = 0; mode < 2; mode++) {
+        apuSetOutput(other, collectSamples, NULL);
+        apuWriteRegister(apu, 0x4015, 0x08);
+        apuWriteRegister(other, 0x4015, 0x08);
+        apuWriteRegister(apu, 0x400C, 0x30);
+        apuWriteRegister(other, 0x400C, 0x3F);
+        apuWriteRegister(apu, 0x400E, mode ? 0x80 : 0x00);
+        apuWriteRegister(other, 0x400E, mode ? 0x80 : 0x00);
+        apuWriteRegister(apu, 0x400F, 0xF8);
+        apuWriteRegister(other, 0x400F, 0xF8);
+
+        for (uint64_t cycle = 1000; cycle < 200000; cycle = cycle * 3 / 2 + 7) {
+            apuCatchUp(apu, mode * 200000 + cycle);
+            apuCatchUp(other, mode * 200000 + cycle);
+            CU_ASSERT_EQUAL(apu->noise.lfsr, other->noise.lfsr);
+            CU_ASSERT_EQUAL(apu->noise.delay, other->noise.delay);
+        }
+    }
+}
+
+void test_apu_blip() {
+    Blip* blip = malloc(sizeof(Blip));
+    initBlip(blip, CPU_CLOCK_HZ, APU_SAMPLE_RATE);
+
+    // Every phase of the kernel adds up to one step
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        int sum = 0;
+        for (int i = 0; i < BLIP_WIDTH; i++) {
+            sum += blip->kernel[phase][i];
+        }
+        CU_ASSERT_EQUAL(sum, 1 << BLIP_KERNEL_BITS);
+    }
+
+    // A step settles at its height, then leaks away
+    int16_t out[BLIP_SIZE];
+    blipAddDelta(blip, 1000, 10000);
+    blipEndFrame(blip, 29781);
+    CU_ASSERT_EQUAL(blipReadSamples(blip, out, BLIP_SIZE), 798);
+    CU_ASSERT_EQUAL(out[20], 0);
+    CU_ASSERT(out[40] > 9800 && out[40] <= 10000);
+    CU_ASSERT(out[797] > 0 && out[797] < out[40] / 2);
+    free(blip);
+}
+
+void test_apu_wav() {
+    char path[] = "/tmp/madnes_wav_XXXXXX";
+    close(mkstemp(path));
+
+    WavWriter* wav = createWavWriter(path, APU_SAMPLE_RATE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(wav);
+    const int16_t data[] = {1, -2, 0x1234};
+    wavWrite(wav, data, 3);
+    CU_ASSERT_EQUAL(freeWavWriter(wav), 0);
+
+    // The sizes are filled in once the samples are written
+    uint8_t bytes[64];
+    FILE* file = fopen(path, "rb");
+    CU_ASSERT_EQUAL(fread(bytes, 1, sizeof(bytes), file), WAV_HEADER_SIZE + 6);
+    fclose(file);
+    CU_ASSERT_EQUAL(memcmp(bytes, "RIFF", 4), 0);
+    CU_ASSERT_EQUAL(bytes[4], WAV_HEADER_SIZE - 8 + 6);
+    CU_ASSERT_EQUAL(memcmp(bytes + 8, "WAVEfmt ", 8), 0);
+    CU_ASSERT_EQUAL(bytes[24] | bytes[25] << 8, APU_SAMPLE_RATE);
+    CU_ASSERT_EQUAL(memcmp(bytes + 36, "data", 4), 0);
+    CU_ASSERT_EQUAL(bytes[40], 6);
+    CU_ASSERT_EQUAL(bytes[44], 0x01);
+    CU_ASSERT_EQUAL(bytes[46], 0xFE);
+    CU_ASSERT_EQUAL(bytes[47], 0xFF);
+    CU_ASSERT_EQUAL(bytes[48], 0x34);
+    CU_ASSERT_EQUAL(bytes[49], 0x12);
+
+    unlink(path);
+    CU_ASSERT_PTR_NULL(createWavWriter("/tmp/madnes_no_such_dir/out.wav", APU_SAMPLE_RATE));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_apu_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("APU Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Status", test_apu_status) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Length Counter", test_apu_length_counter) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Frame IRQ", test_apu_frame_irq) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "DMC", test_apu_dmc) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Output", test_apu_output) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Noise Jump", test_apu_noise_jump) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Blip", test_apu_blip) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "WAV", test_apu_wav) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
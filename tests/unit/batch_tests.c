@@ -0,0 +1,219 @@
+#include "batch.h"
+#include "cartridge.h"
+#include "emulator.h"
+#include "savestate.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Batch* batch;
+static char dir[32];
+static char manifest_path[64];
+static char rom_path[64];
+
+/**
+ * Write an NROM rom that turns on NMIs and counts them in $10
+ */
+static void writeRom() {
+    uint8_t prg[0x4000] = {0};
+    const uint8_t code[] = {0xA9, 0x80, 0x8D, 0x00, 0x20, 0xE8, 0x4C, 0x05, 0x80};
+    const uint8_t nmi[] = {0xE6, 0x10, 0x40};
+    const uint8_t vectors[] = {0x10, 0x80, 0x00, 0x80, 0x10, 0x80};
+    memcpy(prg, code, sizeof(code));
+    memcpy(prg + 0x10, nmi, sizeof(nmi));
+    memcpy(prg + 0x3FFA, vectors, sizeof(vectors));
+
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1};
+    FILE* file = fopen(rom_path, "wb");
+    fwrite(header, 1, HEADER_SIZE, file);
+    fwrite(prg, 1, sizeof(prg), file);
+    for (int i = 0; i < 0x2000; i++) {
+        fputc(0, file);
+    }
+    fclose(file);
+}
+
+/**
+ * Write the manifest for a test to read
+ *
+ * @param contents - What to write to it
+ */
+static void writeManifest(const char* contents) {
+    FILE* file = fopen(manifest_path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+/**
+ * Find the hash of the state the test rom ends in
+ *
+ * @param frames - The number of frames to run it for
+ *
+ * @returns The hash
+ */
+static uint64_t romHash(uint64_t frames) {
+    Emulator* emu = createEmulator(rom_path);
+    emulatorRunFrames(emu, frames);
+    uint64_t hash = saveStateHash(&emu->machine);
+    freeEmulator(emu);
+    return hash;
+}
+
+static void init_test() {
+    batch = NULL;
+    strcpy(dir, "/tmp/madnes_batch_XXXXXX");
+    mkdtemp(dir);
+    sprintf(manifest_path, "%s/roms.txt", dir);
+    sprintf(rom_path, "%s/test.nes", dir);
+    writeRom();
+}
+
+static void clean_test() {
+    if (batch) {
+        freeBatch(batch);
+    }
+    unlink(manifest_path);
+    unlink(rom_path);
+    rmdir(dir);
+}
+
+// ---------- Tests ----------
+
+void test_batch_manifest() {
+    writeManifest("# Roms to check\n"
+                  "test.nes 60 00000000DEADBEEF\n"
+                  "\n"
+                  "/roms/other.nes 600\n");
+
+    batch = loadBatch(manifest_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    CU_ASSERT_EQUAL(batch->count, 2);
+
+    // Roms are found relative to the manifest
+    CU_ASSERT_STRING_EQUAL(batch->jobs[0].rom_path, rom_path);
+    CU_ASSERT_EQUAL(batch->jobs[0].frames, 60);
+    CU_ASSERT_TRUE(batch->jobs[0].has_expected);
+    CU_ASSERT_EQUAL(batch->jobs[0].expected_hash, 0xDEADBEEF);
+
+    CU_ASSERT_STRING_EQUAL(batch->jobs[1].rom_path, "/roms/other.nes");
+    CU_ASSERT_EQUAL(batch->jobs[1].frames, 600);
+    CU_ASSERT_FALSE(batch->jobs[1].has_expected);
+}
+
+void test_batch_rejects() {
+    // No frames, bad frames, bad hash, and too many fields
+    writeManifest("test.nes\n");
+    CU_ASSERT_PTR_NULL(loadBatch(manifest_path));
+    writeManifest("test.nes 0\n");
+    CU_ASSERT_PTR_NULL(loadBatch(manifest_path));
+    writeManifest("test.nes 60 xyz\n");
+    CU_ASSERT_PTR_NULL(loadBatch(manifest_path));
+    writeManifest("test.nes 60 1234 extra\n");
+    CU_ASSERT_PTR_NULL(loadBatch(manifest_path));
+}
+
+void test_batch_run() {
+    char contents[256];
+    sprintf(contents,
+            "test.nes 20 %llx\n"
+            "test.nes 30 %llx\n"
+            "test.nes 20 1234\n"
+            "test.nes 5\n"
+            "missing.nes 5\n",
+            (unsigned long long)romHash(20), (unsigned long long)romHash(30));
+    writeManifest(contents);
+
+    batch = loadBatch(manifest_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    runBatch(batch, 3);
+    CU_ASSERT_EQUAL(batch->workers, 3);
+
+    // Every machine runs on its own, whichever worker picks it up
+    CU_ASSERT_EQUAL(batch->jobs[0].status, BATCH_PASS);
+    CU_ASSERT_EQUAL(batch->jobs[0].frames_run, 20);
+    CU_ASSERT(batch->jobs[0].instructions > 0);
+    CU_ASSERT_EQUAL(batch->jobs[1].status, BATCH_PASS);
+    CU_ASSERT_EQUAL(batch->jobs[2].status, BATCH_FAIL);
+    CU_ASSERT_EQUAL(batch->jobs[2].hash, batch->jobs[0].hash);
+    CU_ASSERT_EQUAL(batch->jobs[3].status, BATCH_DONE);
+    CU_ASSERT_EQUAL(batch->jobs[4].status, BATCH_ERROR);
+
+    // The report counts the failures
+    FILE* out = tmpfile();
+    CU_ASSERT_EQUAL(printBatchReport(batch, out), 2);
+    fclose(out);
+
+    // A batch never gets more workers than it has jobs
+    freeBatch(batch);
+    writeManifest("test.nes 1\n");
+    batch = loadBatch(manifest_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    runBatch(batch, 8);
+    CU_ASSERT_EQUAL(batch->workers, 1);
+    CU_ASSERT_EQUAL(batch->jobs[0].status, BATCH_DONE);
+}
+
+void test_batch_parallel() {
+    // Every worker starts its first machine at once, so run this under -fsanitize=thread to
+    // check that nothing in the core is shared between them
+    char line[64];
+    char contents[512] = "";
+    sprintf(line, "test.nes 60 %llx\n", (unsigned long long)romHash(60));
+    for (int i = 0; i < 8; i++) {
+        strcat(contents, line);
+    }
+    writeManifest(contents);
+
+    batch = loadBatch(manifest_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+    runBatch(batch, 8);
+    CU_ASSERT_EQUAL(batch->workers, 8);
+
+    // They all end where the machine run on its own did
+    for (uint32_t i = 0; i < batch->count; i++) {
+        CU_ASSERT_EQUAL(batch->jobs[i].status, BATCH_PASS);
+        CU_ASSERT_EQUAL(batch->jobs[i].frames_run, 60);
+    }
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_batch_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Batch Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Manifest", test_batch_manifest) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Rejects", test_batch_rejects) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Run", test_batch_run) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parallel", test_batch_parallel) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
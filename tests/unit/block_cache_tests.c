@@ -0,0 +1,172 @@
+#include "6502.h"
+#include "blockcache.h"
+#include "interpreter.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Processor cache_processor;
+static uint8_t* cache_memory;
+static Bus* cache_bus;
+static uint64_t cache_cycles;
+static BlockCache* cache;
+
+static void init_test() {
+    cache_processor.PC = 0x0600;
+    cache_processor.S = 0xFF;
+    cache_processor.P = 0x30;
+    cache_processor.A = 0x0;
+    cache_processor.X = 0x0;
+    cache_processor.Y = 0x0;
+    cache_processor.halted = false;
+    cache_processor.block_cache = NULL;
+
+    cache_memory = calloc(0x10000, sizeof(uint8_t));
+    cache_bus = createFlatBus(cache_memory);
+    cache_cycles = 0;
+    cache = createBlockCache();
+}
+
+static void clean_test() {
+    freeBus(cache_bus);
+    free(cache_memory);
+    freeBlockCache(cache);
+}
+
+static void loadProgram(const uint8_t* program, int size) {
+    memcpy(cache_memory + 0x0600, program, size);
+}
+
+// ---------- Tests ----------
+
+void test_block_ends_at_branch() {
+    // LDA #$01; INX; BNE -3; BRK
+    const uint8_t program[] = {0xA9, 0x01, 0xE8, 0xD0, 0xFD, 0x00};
+    loadProgram(program, sizeof(program));
+
+    Block* block = lookupBlock(cache, cache_bus, 0x0600);
+
+    CU_ASSERT_EQUAL(block->count, 3);
+    CU_ASSERT_EQUAL(block->length, 5);
+    CU_ASSERT_EQUAL(cache->misses, 1);
+    CU_ASSERT_EQUAL(cache->code_map[0x0604], 1);
+    CU_ASSERT_EQUAL(cache->code_map[0x0605], 0);
+
+    CU_ASSERT_EQUAL(lookupBlock(cache, cache_bus, 0x0600), block);
+    CU_ASSERT_EQUAL(cache->hits, 1);
+}
+
+void test_block_loop_hits() {
+    // LDX #$00; INX; BNE -3 (back to INX); BRK
+    const uint8_t program[] = {0xA2, 0x00, 0xE8, 0xD0, 0xFD, 0x00};
+    loadProgram(program, sizeof(program));
+
+    runBlocks(cache, cache_bus, &cache_processor, &cache_cycles, UINT64_MAX, 0x0605);
+
+    CU_ASSERT_EQUAL(cache_processor.PC, 0x0605);
+    CU_ASSERT_EQUAL(cache_processor.X, 0x00);
+    CU_ASSERT_EQUAL(cache->misses, 2);
+    CU_ASSERT_EQUAL(cache->hits, 254);
+    CU_ASSERT_EQUAL(cache->invalidations, 0);
+}
+
+void test_block_store_invalidates() {
+    // LDA #$E8; STA $0606; INX; NOP; BRK
+    const uint8_t program[] = {0xA9, 0xE8, 0x8D, 0x06, 0x06, 0xE8, 0xEA, 0x00};
+    loadProgram(program, sizeof(program));
+
+    runBlocks(cache, cache_bus, &cache_processor, &cache_cycles, UINT64_MAX, NO_STOP_PC);
+
+    // The NOP was replaced with an INX while its block was running
+    CU_ASSERT_EQUAL(cache_processor.X, 0x02);
+    CU_ASSERT_EQUAL(cache_processor.halted, true);
+    CU_ASSERT_EQUAL(cache->invalidations, 1);
+    CU_ASSERT_EQUAL(cache->misses, 2);
+}
+
+void test_block_store_outside_code() {
+    // LDA #$42; STA $0200; BRK
+    const uint8_t program[] = {0xA9, 0x42, 0x8D, 0x00, 0x02, 0x00};
+    loadProgram(program, sizeof(program));
+
+    runBlocks(cache, cache_bus, &cache_processor, &cache_cycles, UINT64_MAX, NO_STOP_PC);
+
+    CU_ASSERT_EQUAL(cache_memory[0x0200], 0x42);
+    CU_ASSERT_EQUAL(cache->invalidations, 0);
+    CU_ASSERT_EQUAL(cache->misses, 1);
+}
+
+void test_block_matches_run_instructions() {
+    // LDX #$10; loop: LDA $20,X; ADC #$03; STA $40,X; DEX; BNE loop; BRK
+    const uint8_t program[] = {0xA2, 0x10, 0xB5, 0x20, 0x69, 0x03, 0x95,
+                               0x40, 0xCA, 0xD0, 0xF7, 0x00};
+    loadProgram(program, sizeof(program));
+
+    uint8_t* other_memory = malloc(0x10000);
+    memcpy(other_memory, cache_memory, 0x10000);
+    Bus* other_bus = createFlatBus(other_memory);
+    Processor other_processor = cache_processor;
+    uint64_t other_cycles = 0;
+
+    runBlocks(cache, cache_bus, &cache_processor, &cache_cycles, UINT64_MAX, NO_STOP_PC);
+    runInstructions(other_bus, &other_processor, &other_cycles, UINT64_MAX, NO_STOP_PC);
+    syncFlags(&cache_processor);
+    syncFlags(&other_processor);
+
+    CU_ASSERT_EQUAL(cache_processor.PC, other_processor.PC);
+    CU_ASSERT_EQUAL(cache_processor.A, other_processor.A);
+    CU_ASSERT_EQUAL(cache_processor.X, other_processor.X);
+    CU_ASSERT_EQUAL(cache_processor.P, other_processor.P);
+    CU_ASSERT_EQUAL(cache_cycles, other_cycles);
+    CU_ASSERT_EQUAL(memcmp(cache_memory, other_memory, 0x10000), 0);
+
+    freeBus(other_bus);
+    free(other_memory);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_block_cache_suite_to_registry() {
+    CU_pSuite suite = CU_add_suite_with_setup_and_teardown("Block Cache Tests", NULL, NULL,
+                                                           init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Block Ends At Branch", test_block_ends_at_branch) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Loop Hits", test_block_loop_hits) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Store Invalidates Block", test_block_store_invalidates) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Store Outside Code", test_block_store_outside_code) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Matches runInstructions", test_block_matches_run_instructions) ==
+        NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
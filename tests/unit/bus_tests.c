@@ -0,0 +1,206 @@
+#include "6502.h"
+#include "bus.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static uint8_t* ram;
+static uint8_t* rom;
+
+// Registers of a fake device, mapped through handlers
+static uint8_t device_regs[8];
+static int device_reads;
+static int device_writes;
+
+static uint8_t readDevice(void* context, uint16_t addr) {
+    device_reads++;
+    return ((uint8_t*)context)[addr & 0x07];
+}
+
+static void writeDevice(void* context, uint16_t addr, uint8_t val) {
+    device_writes++;
+    ((uint8_t*)context)[addr & 0x07] = val;
+}
+
+static void init_test() {
+    test_bus = createBus();
+    ram = calloc(RAM_SIZE, sizeof(uint8_t));
+    rom = calloc(0x4000, sizeof(uint8_t));
+    for (int i = 0; i < 8; i++) {
+        device_regs[i] = 0;
+    }
+    device_reads = 0;
+    device_writes = 0;
+}
+
+static void clean_test() {
+    freeBus(test_bus);
+    free(ram);
+    free(rom);
+}
+
+// ---------- Tests ----------
+
+void test_bus_unmapped() {
+    busWrite(test_bus, 0x4020, 0x69);
+
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4020), 0x00);
+    CU_ASSERT_PTR_NULL(busFlatMemory(test_bus));
+}
+
+void test_bus_ram_mirroring() {
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+
+    busWrite(test_bus, 0x0801, 0x69);
+
+    CU_ASSERT_EQUAL(ram[0x0001], 0x69);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x0001), 0x69);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x1001), 0x69);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x1801), 0x69);
+}
+
+void test_bus_rom_is_read_only() {
+    rom[0x0000] = 0x4C;
+    rom[0x3FFC] = 0x00;
+    rom[0x3FFD] = 0x80;
+    busMapMemory(test_bus, 0x8000, 0x8000, rom, 0x4000, false);
+
+    busWrite(test_bus, 0x8000, 0x69);
+
+    CU_ASSERT_EQUAL(rom[0x0000], 0x4C);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 0x4C);
+
+    // A 16 KiB ROM is mirrored into $C000-$FFFF
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 0x4C);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xFFFC), 0x00);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xFFFD), 0x80);
+}
+
+void test_bus_handlers() {
+    busMapHandlers(test_bus, 0x2000, 0x2000, readDevice, writeDevice, device_regs);
+
+    busWrite(test_bus, 0x2006, 0x69);
+    busWrite(test_bus, 0x3FFF, 0x42);
+
+    CU_ASSERT_EQUAL(device_regs[6], 0x69);
+    CU_ASSERT_EQUAL(device_regs[7], 0x42);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x200E), 0x69);
+    CU_ASSERT_EQUAL(device_writes, 2);
+    CU_ASSERT_EQUAL(device_reads, 1);
+}
+
+void test_bus_write_handler_over_rom() {
+    rom[0x0000] = 0x4C;
+    busMapMemory(test_bus, 0x8000, 0x8000, rom, 0x4000, false);
+    busMapHandlers(test_bus, 0x8000, 0x8000, NULL, writeDevice, device_regs);
+
+    busWrite(test_bus, 0x8001, 0x69);
+
+    // Reads still come straight from ROM, writes go to the handler
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 0x4C);
+    CU_ASSERT_EQUAL(device_regs[1], 0x69);
+    CU_ASSERT_EQUAL(device_reads, 0);
+    CU_ASSERT_EQUAL(rom[0x0001], 0x00);
+}
+
+void test_bus_flat_memory() {
+    uint8_t* mem = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    Bus* flat_bus = createFlatBus(mem);
+
+    CU_ASSERT_PTR_EQUAL(busFlatMemory(flat_bus), mem);
+
+    busMapHandlers(flat_bus, 0x2000, 0x0100, readDevice, writeDevice, device_regs);
+    CU_ASSERT_PTR_NULL(busFlatMemory(flat_bus));
+
+    // Mapping the memory back makes it flat again, until a bank switch
+    busMapMemory(flat_bus, 0x2000, 0x0100, mem + 0x2000, 0x0100, true);
+    CU_ASSERT_PTR_EQUAL(busFlatMemory(flat_bus), mem);
+    busMapReadMemory(flat_bus, 0x8000, 0x4000, rom);
+    CU_ASSERT_PTR_NULL(busFlatMemory(flat_bus));
+
+    freeBus(flat_bus);
+    free(mem);
+}
+
+void test_bus_instructions_use_mirrors() {
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    busMapMemory(test_bus, 0x8000, 0x8000, rom, 0x4000, false);
+
+    // LDA #$69; STA $0810; LDX $1810; PHA
+    const uint8_t program[] = {0xA9, 0x69, 0x8D, 0x10, 0x08, 0xAE, 0x10, 0x18, 0x48};
+    for (int i = 0; i < (int)sizeof(program); i++) {
+        rom[i] = program[i];
+    }
+
+    Processor cpu = {0};
+    cpu.PC = 0x8000;
+    cpu.S = 0xFF;
+    cpu.P = 0x30;
+    for (int i = 0; i < 4; i++) {
+        Instruction instr = parseInstruction(test_bus, cpu.PC);
+        executeInstruction(instr, test_bus, &cpu);
+        cpu.PC += instr.length;
+    }
+
+    CU_ASSERT_EQUAL(ram[0x0010], 0x69);
+    CU_ASSERT_EQUAL(cpu.X, 0x69);
+    CU_ASSERT_EQUAL(ram[0x01FF], 0x69);
+    CU_ASSERT_EQUAL(cpu.S, 0xFE);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_bus_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Bus Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Unmapped", test_bus_unmapped) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "RAM Mirroring", test_bus_ram_mirroring) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "ROM Is Read Only", test_bus_rom_is_read_only) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Handlers", test_bus_handlers) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Write Handler Over ROM", test_bus_write_handler_over_rom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Flat Memory", test_bus_flat_memory) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Instructions Use Mirrors", test_bus_instructions_use_mirrors) ==
+        NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,160 @@
+#include "cartridge.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Cartridge cart;
+static char rom_path[64];
+
+/**
+ * Write a rom file with the given header, followed by 'size' bytes where each
+ * byte is the low byte of its offset from the end of the header
+ *
+ * @param header - The 16 byte header
+ * @param size - The number of bytes after the header
+ */
+static void writeRom(const uint8_t* header, int size) {
+    FILE* file = fopen(rom_path, "wb");
+    fwrite(header, 1, HEADER_SIZE, file);
+    for (int i = 0; i < size; i++) {
+        fputc(i & 0xFF, file);
+    }
+    fclose(file);
+}
+
+static void init_test() {
+    cart = (Cartridge){0};
+    strcpy(rom_path, "/tmp/madnes_rom_XXXXXX");
+    close(mkstemp(rom_path));
+}
+
+static void clean_test() {
+    unloadRom(&cart);
+    unlink(rom_path);
+}
+
+// ---------- Tests ----------
+
+void test_cart_ines_header() {
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 2, 1, 0x13, 0x00};
+
+    CU_ASSERT_EQUAL(parseHeader(&cart, header), 0);
+    CU_ASSERT_FALSE(cart.nes2);
+    CU_ASSERT_EQUAL(cart.mapper, 1);
+    CU_ASSERT_EQUAL(cart.prg_rom_bytes, 0x8000);
+    CU_ASSERT_EQUAL(cart.chr_rom_bytes, 0x2000);
+    CU_ASSERT_EQUAL(cart.prg_ram_size, 0);
+    CU_ASSERT_EQUAL(cart.prg_nvram_size, 0x2000);
+}
+
+void test_cart_nes2_header() {
+    // 4 MiB + 16 KiB of PRG-ROM, CHR-ROM in exponent notation (2^10 * 3),
+    // 8 KiB PRG-RAM, 32 KiB PRG-NVRAM, and 8 KiB CHR-RAM
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 0x01, 0x29, 0x40, 0x18,
+                                         0x31, 0xF1, 0x97, 0x07};
+
+    CU_ASSERT_EQUAL(parseHeader(&cart, header), 0);
+    CU_ASSERT_TRUE(cart.nes2);
+    CU_ASSERT_EQUAL(cart.mapper, 0x114);
+    CU_ASSERT_EQUAL(cart.submapper, 3);
+    CU_ASSERT_EQUAL(cart.prg_rom_bytes, 0x101 * 0x4000);
+    CU_ASSERT_EQUAL(cart.chr_rom_bytes, 1024 * 3);
+    CU_ASSERT_EQUAL(cart.prg_ram_size, 0x2000);
+    CU_ASSERT_EQUAL(cart.prg_nvram_size, 0x8000);
+    CU_ASSERT_EQUAL(cart.chr_ram_size, 0x2000);
+    CU_ASSERT_EQUAL(cart.chr_nvram_size, 0);
+}
+
+void test_cart_bad_magic() {
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'Z', 0x1A, 1, 1};
+
+    CU_ASSERT_EQUAL(parseHeader(&cart, header), -2);
+}
+
+void test_cart_load_rom() {
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1, 0x04};
+    writeRom(header, TRAINER_SIZE + 0x4000 + 0x2000);
+
+    CU_ASSERT_EQUAL(loadRom(&cart, rom_path), 0);
+
+    // The trainer, PRG-ROM, and CHR-ROM point into the mapped file
+    CU_ASSERT_PTR_NOT_NULL(cart.trainer);
+    CU_ASSERT_PTR_EQUAL(cart.prg_rom, cart.trainer + TRAINER_SIZE);
+    CU_ASSERT_PTR_EQUAL(cart.chr_rom, cart.prg_rom + 0x4000);
+    CU_ASSERT_EQUAL(cart.prg_rom[1], (TRAINER_SIZE + 1) & 0xFF);
+    CU_ASSERT_EQUAL(cart.chr_rom[0x1FFF], (TRAINER_SIZE + 0x5FFF) & 0xFF);
+
+    // CHR-ROM gets decoded up front. The first row of tile 1 is $10 and $18.
+    CU_ASSERT_PTR_NOT_NULL(cart.chr_tiles);
+    CU_ASSERT_EQUAL(cart.chr_tiles[64 + 2], 0);
+    CU_ASSERT_EQUAL(cart.chr_tiles[64 + 3], 3);
+    CU_ASSERT_EQUAL(cart.chr_tiles[64 + 4], 2);
+}
+
+void test_cart_truncated_rom() {
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 2, 1};
+    writeRom(header, 0x8000);
+
+    CU_ASSERT_EQUAL(loadRom(&cart, rom_path), -4);
+    CU_ASSERT_PTR_NULL(cart.prg_rom);
+    CU_ASSERT_PTR_NULL(cart.rom_data);
+}
+
+void test_cart_missing_rom() {
+    unlink(rom_path);
+
+    CU_ASSERT_EQUAL(loadRom(&cart, rom_path), -1);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_cartridge_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Cartridge Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "iNES Header", test_cart_ines_header) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "NES 2.0 Header", test_cart_nes2_header) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Bad Magic Number", test_cart_bad_magic) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Load ROM", test_cart_load_rom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Truncated ROM", test_cart_truncated_rom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Missing ROM", test_cart_missing_rom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,162 @@
+#include "bus.h"
+#include "controller.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Controllers controllers;
+
+static void init_test() {
+    test_bus = createBus();
+    initControllers(&controllers);
+    controllersMapRegisters(&controllers, test_bus);
+}
+
+static void clean_test() {
+    freeBus(test_bus);
+}
+
+/**
+ * Strobe the controllers and read 8 buttons from one of them
+ *
+ * @param addr - $4016 or $4017
+ *
+ * @returns The buttons, in the order of the BUTTON_ bits
+ */
+static uint8_t readButtons(uint16_t addr) {
+    busWrite(test_bus, 0x4016, 1);
+    busWrite(test_bus, 0x4016, 0);
+
+    uint8_t buttons = 0;
+    for (int i = 0; i < 8; i++) {
+        buttons |= (busRead(test_bus, addr) & 1) << i;
+    }
+    return buttons;
+}
+
+// ---------- Tests ----------
+
+void test_controller_read() {
+    controllers.buttons[0] = BUTTON_A | BUTTON_START | BUTTON_RIGHT;
+    controllers.buttons[1] = BUTTON_B | BUTTON_UP;
+
+    CU_ASSERT_EQUAL(readButtons(0x4016), BUTTON_A | BUTTON_START | BUTTON_RIGHT);
+    CU_ASSERT_EQUAL(readButtons(0x4017), BUTTON_B | BUTTON_UP);
+
+    // Reads past the eighth button return 1, and the upper bits are open bus
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4017), 0x41);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4017), 0x41);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x41);
+}
+
+void test_controller_strobe() {
+    controllers.buttons[0] = BUTTON_A | BUTTON_B;
+
+    // With the strobe held, every read is A
+    busWrite(test_bus, 0x4016, 1);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x41);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x41);
+
+    // The buttons are latched when the strobe is cleared, not when it's set
+    controllers.buttons[0] = BUTTON_SELECT;
+    busWrite(test_bus, 0x4016, 0);
+    controllers.buttons[0] = 0;
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x40);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x40);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x41);
+}
+
+void test_controller_shares_page() {
+    // OAMDMA at $4014 still reaches the PPU when the controllers are mapped
+    // over it
+    Cartridge cart = {0};
+    cart.prg_rom_size = 1;
+    cart.chr_rom_size = 1;
+    cart.prg_rom_bytes = 0x4000;
+    cart.chr_rom_bytes = 0x2000;
+    cart.prg_rom = calloc(0x4000, sizeof(uint8_t));
+    cart.chr_rom = calloc(0x2000, sizeof(uint8_t));
+
+    uint8_t ram[RAM_SIZE] = {0};
+    ram[0x200] = 0x42;
+
+    Bus* bus = createBus();
+    busMapMemory(bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    Mapper* mapper = createMapper(&cart, bus);
+    PPU* ppu = createPPU(mapper);
+    ppuMapRegisters(ppu, bus);
+    Controllers pads;
+    initControllers(&pads);
+    controllersMapRegisters(&pads, bus);
+
+    busWrite(bus, 0x4014, 0x02);
+    CU_ASSERT_EQUAL(ppu->oam[0], 0x42);
+    CU_ASSERT_EQUAL(busRead(bus, 0x4016), 0x40);
+    CU_ASSERT_EQUAL(busRead(bus, 0x4015), 0);
+
+    freePPU(ppu);
+    freeMapper(mapper);
+    freeBus(bus);
+    free(cart.prg_rom);
+    free(cart.chr_rom);
+}
+
+void test_controller_parse_buttons() {
+    uint8_t buttons;
+
+    CU_ASSERT_EQUAL(parseButtons("A+RIGHT", &buttons), 0);
+    CU_ASSERT_EQUAL(buttons, BUTTON_A | BUTTON_RIGHT);
+    CU_ASSERT_EQUAL(parseButtons("start", &buttons), 0);
+    CU_ASSERT_EQUAL(buttons, BUTTON_START);
+    CU_ASSERT_EQUAL(parseButtons(".", &buttons), 0);
+    CU_ASSERT_EQUAL(buttons, 0);
+    CU_ASSERT_EQUAL(parseButtons("Select+Up+Down+Left+B", &buttons), 0);
+    CU_ASSERT_EQUAL(buttons, BUTTON_SELECT | BUTTON_UP | BUTTON_DOWN | BUTTON_LEFT | BUTTON_B);
+
+    CU_ASSERT_EQUAL(parseButtons("C", &buttons), -1);
+    CU_ASSERT_EQUAL(parseButtons("A+", &buttons), -1);
+    CU_ASSERT_EQUAL(parseButtons("STARTX", &buttons), -1);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_controller_suite_to_registry() {
+    CU_pSuite suite = CU_add_suite_with_setup_and_teardown("Controller Tests", NULL, NULL,
+                                                           init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Read", test_controller_read) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Strobe", test_controller_strobe) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Shares Page", test_controller_shares_page) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parse Buttons", test_controller_parse_buttons) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
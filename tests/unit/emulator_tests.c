@@ -0,0 +1,232 @@
+#include "cartridge.h"
+#include "blockcache.h"
+#include "emulator.h"
+#include "jit.h"
+#include "savestate.h"
+#include "scheduler.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Emulator* emu;
+static Emulator* other;
+static char rom_path[64];
+
+/**
+ * Write an NROM rom that turns on NMIs, then spins. The NMI handler counts
+ * frames in $10.
+ */
+static void writeRom() {
+    uint8_t prg[0x4000] = {0};
+    const uint8_t reset[] = {
+        0xA9, 0x80,        // LDA #$80
+        0x8D, 0x00, 0x20,  // STA $2000
+        0xE8,              // INX
+        0x4C, 0x05, 0x80,  // JMP $8005
+    };
+    const uint8_t nmi[] = {
+        0xE6, 0x10,  // INC $10
+        0x40,        // RTI
+    };
+    memcpy(prg, reset, sizeof(reset));
+    memcpy(prg + 0x10, nmi, sizeof(nmi));
+    const uint8_t vectors[] = {0x10, 0x80, 0x00, 0x80, 0x10, 0x80};
+    memcpy(prg + 0x3FFA, vectors, sizeof(vectors));
+
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1};
+    FILE* file = fopen(rom_path, "wb");
+    fwrite(header, 1, HEADER_SIZE, file);
+    fwrite(prg, 1, sizeof(prg), file);
+    for (int i = 0; i < 0x2000; i++) {
+        fputc(0, file);
+    }
+    fclose(file);
+}
+
+static void init_test() {
+    emu = NULL;
+    other = NULL;
+    strcpy(rom_path, "/tmp/madnes_emu_XXXXXX");
+    close(mkstemp(rom_path));
+    writeRom();
+}
+
+static void clean_test() {
+    if (emu) {
+        freeEmulator(emu);
+    }
+    if (other) {
+        freeEmulator(other);
+    }
+    unlink(rom_path);
+}
+
+// ---------- Tests ----------
+
+void test_emulator_create() {
+    emu = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+    CU_ASSERT_EQUAL(emu->processor.PC, 0x8000);
+    CU_ASSERT_EQUAL(emu->mapper->number, 0);
+    CU_ASSERT_EQUAL(emu->cycles, 0);
+
+    CU_ASSERT_PTR_NULL(createEmulator("/tmp/madnes_no_such_rom.nes"));
+}
+
+void test_emulator_step() {
+    emu = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+
+    emulatorStep(emu);
+    CU_ASSERT_EQUAL(emu->processor.A, 0x80);
+    CU_ASSERT_EQUAL(emu->processor.PC, 0x8002);
+    CU_ASSERT_EQUAL(emu->cycles, 2);
+    CU_ASSERT_EQUAL(emu->instructions, 1);
+}
+
+void test_emulator_run_frames() {
+    emu = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+
+    // An NMI comes at the start of every vblank
+    CU_ASSERT_EQUAL(emulatorRunFrames(emu, 10), 10);
+    CU_ASSERT_EQUAL(emu->ppu->frame, 10);
+    CU_ASSERT_EQUAL(emu->ram[0x10], 10);
+    CU_ASSERT(emu->instructions > 10 * 1000);
+
+    CU_ASSERT_EQUAL(emulatorRunFrames(emu, 5), 5);
+    CU_ASSERT_EQUAL(emu->ram[0x10], 15);
+}
+
+void test_emulator_run() {
+    emu = createEmulator(rom_path);
+    other = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+
+    // Running up to each deadline ends in the same state as stepping
+    emulatorRunFrames(emu, 3);
+    while (other->ppu->frame < 3) {
+        emulatorStep(other);
+    }
+    schedulerSync(&other->scheduler);
+    CU_ASSERT_EQUAL(emu->cycles, other->cycles);
+    CU_ASSERT_EQUAL(emu->instructions, other->instructions);
+    CU_ASSERT_EQUAL(saveStateHash(&emu->machine), saveStateHash(&other->machine));
+
+#ifdef THREADED_CORE
+    // A run stops at the first instruction that touches a register (the
+    // fallback only ever runs one instruction on this bus)
+    freeEmulator(emu);
+    emu = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+    emulatorRun(emu);
+    CU_ASSERT_EQUAL(emu->processor.PC, 0x8005);
+    CU_ASSERT_EQUAL(emu->instructions, 2);
+    CU_ASSERT_EQUAL(emu->cycles, 6);
+
+    // then spins until the first vblank
+    uint64_t deadline = emu->scheduler.deadline;
+    emulatorRun(emu);
+    CU_ASSERT(emu->cycles >= deadline);
+    CU_ASSERT(emu->instructions > 1000);
+#endif
+}
+
+void test_emulator_jit() {
+    BlockCache* cache = createBlockCache();
+    Jit* jit = createJit(cache, false);
+    if (jit == NULL) {
+        freeBlockCache(cache);
+        return;  // Not an x86-64 host
+    }
+
+    emu = createEmulator(rom_path);
+    other = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+    emu->jit = jit;
+    emu->processor.block_cache = cache;
+
+    // Compiled code ends up in the same state as the interpreter
+    CU_ASSERT_EQUAL(emulatorRunFrames(emu, 5), 5);
+    emulatorRunFrames(other, 5);
+    CU_ASSERT_EQUAL(emu->cycles, other->cycles);
+    CU_ASSERT_EQUAL(emu->instructions, other->instructions);
+    CU_ASSERT_EQUAL(emu->ram[0x10], 5);
+    CU_ASSERT_EQUAL(saveStateHash(&emu->machine), saveStateHash(&other->machine));
+    CU_ASSERT(jit->native_runs > 0);
+
+    freeJit(jit);
+    freeBlockCache(cache);
+}
+
+void test_emulator_independent() {
+    emu = createEmulator(rom_path);
+    other = createEmulator(rom_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(emu);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(other);
+
+    // Running one emulator leaves the other where it was
+    emulatorRunFrames(emu, 3);
+    CU_ASSERT_EQUAL(other->cycles, 0);
+    CU_ASSERT_EQUAL(other->ram[0x10], 0);
+    CU_ASSERT_NOT_EQUAL(saveStateHash(&emu->machine), saveStateHash(&other->machine));
+
+    // and the same rom run for as long ends in the same state
+    emulatorRunFrames(other, 3);
+    CU_ASSERT_EQUAL(saveStateHash(&emu->machine), saveStateHash(&other->machine));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_emulator_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Emulator Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Create", test_emulator_create) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Step", test_emulator_step) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Run Frames", test_emulator_run_frames) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Run", test_emulator_run) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "JIT", test_emulator_jit) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Independent", test_emulator_independent) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
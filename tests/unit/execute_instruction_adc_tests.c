@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -85,7 +90,7 @@ void test_instr_adc_imm() {
     memory[0x0600] = 0x69;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -97,7 +102,7 @@ void test_instr_adc_zp() {
     memory[0x0600] = 0x65;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -110,7 +115,7 @@ void test_instr_adc_zpx() {
     memory[0x0600] = 0x75;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -122,7 +127,7 @@ void test_instr_adc_abs() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -136,7 +141,7 @@ void test_instr_adc_absx() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -150,7 +155,7 @@ void test_instr_adc_absy() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -165,7 +170,7 @@ void test_instr_adc_indx() {
     memory[0x0600] = 0x61;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -180,7 +185,7 @@ void test_instr_adc_indy() {
     memory[0x0600] = 0x71;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -192,7 +197,7 @@ void test_instr_adc_carry() {
     memory[0x0600] = 0x69;
     memory[0x0601] = 0x02;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x01);
     CU_ASSERT_EQUAL(processor.P, 0x31);
@@ -203,7 +208,7 @@ void test_instr_adc_zero() {
     memory[0x0600] = 0x69;
     memory[0x0601] = 0x00;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -215,7 +220,7 @@ void test_instr_adc_overflow() {
     memory[0x0600] = 0x69;
     memory[0x0601] = 0x50;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0xA0);
     CU_ASSERT_EQUAL(processor.P, 0xF0);
@@ -226,7 +231,7 @@ void test_instr_adc_neg() {
     memory[0x0600] = 0x69;
     memory[0x0601] = 0x80;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x80);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -240,7 +245,7 @@ void test_instr_adc_absx_page() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -254,7 +259,7 @@ void test_instr_adc_absy_page() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -269,7 +274,7 @@ void test_instr_adc_indy_page() {
     memory[0x0600] = 0x71;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -86,7 +91,7 @@ void test_instr_and_imm() {
     memory[0x0600] = 0x29;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -99,7 +104,7 @@ void test_instr_and_zp() {
     memory[0x0600] = 0x25;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -113,7 +118,7 @@ void test_instr_and_zpx() {
     memory[0x0600] = 0x35;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -127,7 +132,7 @@ void test_instr_and_abs() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -142,7 +147,7 @@ void test_instr_and_absx() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -157,7 +162,7 @@ void test_instr_and_absy() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -173,7 +178,7 @@ void test_instr_and_indx() {
     memory[0x0600] = 0x21;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -189,7 +194,7 @@ void test_instr_and_indy() {
     memory[0x0600] = 0x31;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -201,7 +206,7 @@ void test_instr_and_zero() {
     memory[0x0600] = 0x29;
     memory[0x0601] = 0xFF;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -213,7 +218,7 @@ void test_instr_and_neg() {
     memory[0x0600] = 0x29;
     memory[0x0601] = 0x80;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x80);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -228,7 +233,7 @@ void test_instr_and_absx_page() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -243,7 +248,7 @@ void test_instr_and_absy_page() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -259,7 +264,7 @@ void test_instr_and_indy_page() {
     memory[0x0600] = 0x31;
     memory[0x0601] = 0x20;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -85,7 +90,7 @@ void test_instr_asl_accum() {
     processor.A = 0x3F;
     memory[0x0600] = 0x0A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x7E);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -97,7 +102,7 @@ void test_instr_asl_zp() {
     memory[0x0600] = 0x06;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(memory[0x0010], 0x7E);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -110,7 +115,7 @@ void test_instr_asl_zpx() {
     memory[0x0600] = 0x16;
     memory[0x0601] = 0x08;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(memory[0x0010], 0x7E);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -123,7 +128,7 @@ void test_instr_asl_abs() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(memory[0x1020], 0x7E);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -137,7 +142,7 @@ void test_instr_asl_absx() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(memory[0x1025], 0x7E);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -148,7 +153,7 @@ void test_instr_asl_carry() {
     processor.A = 0xBE;
     memory[0x0600] = 0x0A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x7C);
     CU_ASSERT_EQUAL(processor.P, 0x31);
@@ -159,7 +164,7 @@ void test_instr_asl_zero() {
     processor.A = 0x80;
     memory[0x0600] = 0x0A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x33);
@@ -170,7 +175,7 @@ void test_instr_asl_neg() {
     processor.A = 0x7F;
     memory[0x0600] = 0x0A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0xFE);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
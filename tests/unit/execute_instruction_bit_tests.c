@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -87,7 +92,7 @@ void test_instr_bit_zp() {
     memory[0x0600] = 0x24;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x22);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -101,7 +106,7 @@ void test_instr_bit_abs() {
     memory[0x0601] = 0x20;
     memory[0x0602] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x22);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -114,7 +119,7 @@ void test_instr_bit_zero() {
     memory[0x0600] = 0x24;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -127,7 +132,7 @@ void test_instr_bit_v() {
     memory[0x0600] = 0x24;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x70);
@@ -140,13 +145,27 @@ void test_instr_bit_neg() {
     memory[0x0600] = 0x24;
     memory[0x0601] = 0x10;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
     CU_ASSERT_EQUAL(cycles, 3);
 }
 
+void test_instr_bit_nv_from_memory() {
+    processor.A = 0x01;
+    memory[0x0010] = 0xC0;
+    memory[0x0600] = 0x24;
+    memory[0x0601] = 0x10;
+
+    simulateMainloop(bus, &processor);
+
+    // N and V come from memory even when A masks them off
+    CU_ASSERT_EQUAL(processor.A, 0x01);
+    CU_ASSERT_EQUAL(processor.P, 0xF2);
+    CU_ASSERT_EQUAL(cycles, 3);
+}
+
 // ---------- Run Tests ----------
 
 CU_pSuite add_bit_suite_to_registry() {
@@ -183,5 +202,10 @@ CU_pSuite add_bit_suite_to_registry() {
         return NULL;
     }
 
+    if (CU_add_test(suite, "BIT N/V From Memory", test_instr_bit_nv_from_memory) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
     return suite;
 }
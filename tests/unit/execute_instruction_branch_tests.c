@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -86,7 +91,7 @@ void test_instr_bcc_clear() {
     memory[0x0600] = 0x90;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -98,7 +103,7 @@ void test_instr_bcc_set() {
     memory[0x0600] = 0x90;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x31);
@@ -112,8 +117,8 @@ void test_instr_bcc_page() {
     memory[0x06F1] = 0x90;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -125,7 +130,7 @@ void test_instr_bcs_clear() {
     memory[0x0600] = 0xB0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -137,7 +142,7 @@ void test_instr_bcs_set() {
     memory[0x0600] = 0xB0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x31);
@@ -151,8 +156,8 @@ void test_instr_bcs_page() {
     memory[0x06F1] = 0xB0;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x31);
@@ -164,7 +169,7 @@ void test_instr_beq_eq() {
     memory[0x0600] = 0xF0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -176,7 +181,7 @@ void test_instr_beq_neq() {
     memory[0x0600] = 0xF0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -190,8 +195,8 @@ void test_instr_beq_page() {
     memory[0x06F1] = 0xF0;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -203,7 +208,7 @@ void test_instr_bmi_neg() {
     memory[0x0600] = 0x30;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -215,7 +220,7 @@ void test_instr_bmi_pos() {
     memory[0x0600] = 0x30;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -229,8 +234,8 @@ void test_instr_bmi_page() {
     memory[0x06F1] = 0x30;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -242,7 +247,7 @@ void test_instr_bne_eq() {
     memory[0x0600] = 0xD0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -254,7 +259,7 @@ void test_instr_bne_neq() {
     memory[0x0600] = 0xD0;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -268,8 +273,8 @@ void test_instr_bne_page() {
     memory[0x06F1] = 0xD0;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -281,7 +286,7 @@ void test_instr_bpl_pos() {
     memory[0x0600] = 0x10;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -293,7 +298,7 @@ void test_instr_bpl_neg() {
     memory[0x0600] = 0x10;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -307,8 +312,8 @@ void test_instr_bpl_page() {
     memory[0x06F1] = 0x10;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -320,7 +325,7 @@ void test_instr_bvc_vclr() {
     memory[0x0600] = 0x50;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -332,7 +337,7 @@ void test_instr_bvc_vset() {
     memory[0x0600] = 0x50;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x70);
@@ -346,8 +351,8 @@ void test_instr_bvc_page() {
     memory[0x06F1] = 0x50;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -359,7 +364,7 @@ void test_instr_bvs_vclr() {
     memory[0x0600] = 0x70;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0602);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -371,7 +376,7 @@ void test_instr_bvs_vset() {
     memory[0x0600] = 0x70;
     memory[0x0601] = 0x42;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x0600 + 0x42);
     CU_ASSERT_EQUAL(processor.P, 0x70);
@@ -385,8 +390,8 @@ void test_instr_bvs_page() {
     memory[0x06F1] = 0x70;
     memory[0x06F2] = 0x0F;
 
-    simulateMainloop(&memory, &processor);
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.PC, 0x06F1 + 0x0F);
     CU_ASSERT_EQUAL(processor.P, 0x70);
@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -85,7 +90,7 @@ void test_instr_clc_set() {
     processor.P = 0x31;
     memory[0x0600] = 0x18;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -95,7 +100,7 @@ void test_instr_clc_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0x18;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -105,7 +110,7 @@ void test_instr_cld_set() {
     processor.P = 0x38;
     memory[0x0600] = 0xD8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -115,7 +120,7 @@ void test_instr_cld_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0xD8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -125,7 +130,7 @@ void test_instr_cli_set() {
     processor.P = 0x34;
     memory[0x0600] = 0x58;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -135,7 +140,7 @@ void test_instr_cli_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0x58;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -145,7 +150,7 @@ void test_instr_clv_set() {
     processor.P = 0x70;
     memory[0x0600] = 0xB8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -155,7 +160,7 @@ void test_instr_clv_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0xB8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x30);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -165,7 +170,7 @@ void test_instr_sec_set() {
     processor.P = 0x31;
     memory[0x0600] = 0x38;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x31);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -175,7 +180,7 @@ void test_instr_sec_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0x38;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x31);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -185,7 +190,7 @@ void test_instr_sed_set() {
     processor.P = 0x38;
     memory[0x0600] = 0xF8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x38);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -195,7 +200,7 @@ void test_instr_sed_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0xF8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x38);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -205,7 +210,7 @@ void test_instr_sei_set() {
     processor.P = 0x34;
     memory[0x0600] = 0x78;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x34);
     CU_ASSERT_EQUAL(cycles, 2);
@@ -215,7 +220,7 @@ void test_instr_sei_clear() {
     processor.P = 0x30;
     memory[0x0600] = 0x78;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.P, 0x34);
     CU_ASSERT_EQUAL(cycles, 2);
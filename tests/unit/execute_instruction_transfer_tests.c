@@ -11,33 +11,38 @@
 
 // ---------- Test Setup/Cleanup ----------
 
-Processor processor;
-uint8_t* memory;
-uint64_t cycles;
+static Processor processor;
+static uint8_t* memory;
+static Bus* bus;
+static uint64_t cycles;
 
 static void init_test() {
     // Set registers to default values
     processor.PC = 0x0600;
     processor.S = 0xFF;
     processor.P = 0x30;
+    processor.flags_lazy = false;
     processor.A = 0x0;
     processor.X = 0x0;
     processor.Y = 0x0;
 
     // Allocate system memory
     memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    bus = createFlatBus(memory);
     cycles = 0;
 }
 
 static void clean_test() {
+    freeBus(bus);
     free(memory);
 }
 
-static void simulateMainloop(uint8_t** memory, Processor* processor) {
+static void simulateMainloop(Bus* bus, Processor* processor) {
     uint16_t old_PC = processor->PC;
 
-    Instruction instr = parseInstruction(*memory, processor->PC);
-    executeInstruction(instr, memory, processor);
+    Instruction instr = parseInstruction(bus, processor->PC);
+    executeInstruction(instr, bus, processor);
+    syncFlags(processor);
     processor->PC += instr.length;
 
     // If the address mode is Absolute X, Absolute Y, Indirect Indexed, or
@@ -57,7 +62,7 @@ static void simulateMainloop(uint8_t** memory, Processor* processor) {
             }
             break;
         case INDY:
-            addr = concatenateBytes((*memory)[instr.addr + 1], (*memory)[instr.addr]);
+            addr = concatenateBytes(busRead(bus, instr.addr + 1), busRead(bus, instr.addr));
             if (((addr + processor->Y) & 0xFF00) != (addr & 0xFF00)) {
                 instr.cycles++;
             }
@@ -85,7 +90,7 @@ void test_instr_tax() {
     processor.A = 0x69;
     memory[0x0600] = 0xAA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -96,7 +101,7 @@ void test_instr_tax_zero() {
     processor.A = 0x00;
     memory[0x0600] = 0xAA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -107,7 +112,7 @@ void test_instr_tax_neg() {
     processor.A = 0x96;
     memory[0x0600] = 0xAA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -118,7 +123,7 @@ void test_instr_tay() {
     processor.A = 0x69;
     memory[0x0600] = 0xA8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.Y, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -129,7 +134,7 @@ void test_instr_tay_zero() {
     processor.A = 0x00;
     memory[0x0600] = 0xA8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.Y, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -140,7 +145,7 @@ void test_instr_tay_neg() {
     processor.A = 0x96;
     memory[0x0600] = 0xA8;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.Y, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -151,7 +156,7 @@ void test_instr_tsx() {
     processor.S = 0x69;
     memory[0x0600] = 0xBA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -162,7 +167,7 @@ void test_instr_tsx_zero() {
     processor.S = 0x00;
     memory[0x0600] = 0xBA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -173,7 +178,7 @@ void test_instr_tsx_neg() {
     processor.S = 0x96;
     memory[0x0600] = 0xBA;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.X, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -184,7 +189,7 @@ void test_instr_txa() {
     processor.X = 0x69;
     memory[0x0600] = 0x8A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -195,7 +200,7 @@ void test_instr_txa_zero() {
     processor.X = 0x00;
     memory[0x0600] = 0x8A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -206,7 +211,7 @@ void test_instr_txa_neg() {
     processor.X = 0x96;
     memory[0x0600] = 0x8A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
@@ -217,7 +222,7 @@ void test_instr_txs() {
     processor.X = 0x69;
     memory[0x0600] = 0x9A;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.S, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -228,7 +233,7 @@ void test_instr_tya() {
     processor.Y = 0x69;
     memory[0x0600] = 0x98;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x69);
     CU_ASSERT_EQUAL(processor.P, 0x30);
@@ -239,7 +244,7 @@ void test_instr_tya_zero() {
     processor.Y = 0x00;
     memory[0x0600] = 0x98;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x00);
     CU_ASSERT_EQUAL(processor.P, 0x32);
@@ -250,7 +255,7 @@ void test_instr_tya_neg() {
     processor.Y = 0x96;
     memory[0x0600] = 0x98;
 
-    simulateMainloop(&memory, &processor);
+    simulateMainloop(bus, &processor);
 
     CU_ASSERT_EQUAL(processor.A, 0x96);
     CU_ASSERT_EQUAL(processor.P, 0xB0);
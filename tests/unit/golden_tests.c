@@ -0,0 +1,303 @@
+#include "cartridge.h"
+#include "emulator.h"
+#include "golden.h"
+#include "trace.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define GOLDEN_TEST_STEPS (1000)
+
+// ---------- Test Setup/Cleanup ----------
+
+static Emulator* emu;
+static char rom_path[64];
+static char log_path[64];
+static char trace_path[64];
+
+/**
+ * Write an NROM rom that counts in X and Y, and stores X to $10
+ */
+static void writeRom() {
+    uint8_t prg[0x4000] = {0};
+    const uint8_t reset[] = {
+        0xE8,              // INX
+        0x86, 0x10,        // STX $10
+        0xC8,              // INY
+        0xC8,              // INY
+        0x4C, 0x00, 0x80,  // JMP $8000
+    };
+    memcpy(prg, reset, sizeof(reset));
+    const uint8_t vectors[] = {0x00, 0x80, 0x00, 0x80, 0x00, 0x80};
+    memcpy(prg + 0x3FFA, vectors, sizeof(vectors));
+
+    const uint8_t header[HEADER_SIZE] = {'N', 'E', 'S', 0x1A, 1, 1};
+    FILE* file = fopen(rom_path, "wb");
+    fwrite(header, 1, HEADER_SIZE, file);
+    fwrite(prg, 1, sizeof(prg), file);
+    for (int i = 0; i < 0x2000; i++) {
+        fputc(0, file);
+    }
+    fclose(file);
+}
+
+/**
+ * Record a trace file of the rom's first GOLDEN_TEST_STEPS instructions
+ */
+static void recordGolden() {
+    Emulator* recorded = createEmulator(rom_path);
+    recorded->tracer = createTracer(trace_path);
+    for (int i = 0; i < GOLDEN_TEST_STEPS; i++) {
+        emulatorStep(recorded);
+    }
+    CU_ASSERT_EQUAL(freeTracer(recorded->tracer), 0);
+    freeEmulator(recorded);
+}
+
+/**
+ * Run the rom against a golden log
+ *
+ * @param path - The golden log
+ * @param out - Where the result is printed
+ *
+ * @returns What validateGolden returned
+ */
+static long long validate(const char* path, FILE* out) {
+    emu = createEmulator(rom_path);
+    long long matched = validateGolden(emu, path, TRACE_FORMAT_NESTEST, out);
+    freeEmulator(emu);
+    emu = NULL;
+    return matched;
+}
+
+static void init_test() {
+    emu = NULL;
+    strcpy(rom_path, "/tmp/madnes_golden_XXXXXX");
+    close(mkstemp(rom_path));
+    strcpy(log_path, "/tmp/madnes_golden_log_XXXXXX");
+    close(mkstemp(log_path));
+    strcpy(trace_path, "/tmp/madnes_golden_trace_XXXXXX");
+    close(mkstemp(trace_path));
+    writeRom();
+}
+
+static void clean_test() {
+    if (emu) {
+        freeEmulator(emu);
+    }
+    unlink(rom_path);
+    unlink(log_path);
+    unlink(trace_path);
+}
+
+// ---------- Tests ----------
+
+void test_golden_parse_line() {
+    TraceRecord record;
+
+    // The first line of nestest.log
+    CU_ASSERT_EQUAL(parseTraceLine("C000  4C F5 C5  JMP $C5F5                       "
+                                   "A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7",
+                                   &record),
+                    3);
+    CU_ASSERT_EQUAL(record.pc, 0xC000);
+    CU_ASSERT_EQUAL(record.opcode, 0x4C);
+    CU_ASSERT_EQUAL(record.operands[0], 0xF5);
+    CU_ASSERT_EQUAL(record.operands[1], 0xC5);
+    CU_ASSERT_EQUAL(record.p, 0x24);
+    CU_ASSERT_EQUAL(record.s, 0xFD);
+    CU_ASSERT_EQUAL(record.cycles, 7);
+
+    // Unofficial opcodes are starred, and the mnemonic isn't mistaken for a byte
+    CU_ASSERT_EQUAL(parseTraceLine("C6BD  04 A9    *NOP $A9 = 00                    "
+                                   "A:AA X:97 Y:4E P:EF SP:F5 PPU: 10,107 CYC:1011",
+                                   &record),
+                    2);
+    CU_ASSERT_EQUAL(record.opcode, 0x04);
+    CU_ASSERT_EQUAL(record.a, 0xAA);
+    CU_ASSERT_EQUAL(record.x, 0x97);
+    CU_ASSERT_EQUAL(record.y, 0x4E);
+    CU_ASSERT_EQUAL(record.cycles, 1011);
+
+    // -t's text format has no bytes
+    CU_ASSERT_EQUAL(
+        parseTraceLine("$8000: LDA #$10         A:01 X:02 Y:03 P:b4 S:ff CYC:42", &record), 0);
+    CU_ASSERT_EQUAL(record.pc, 0x8000);
+    CU_ASSERT_EQUAL(record.a, 0x01);
+    CU_ASSERT_EQUAL(record.p, 0xB4);
+    CU_ASSERT_EQUAL(record.s, 0xFF);
+    CU_ASSERT_EQUAL(record.cycles, 42);
+
+    CU_ASSERT_EQUAL(parseTraceLine("C000  4C F5 C5  JMP $C5F5", &record), -1);
+    CU_ASSERT_EQUAL(parseTraceLine("A:00 X:00 Y:00 P:24 SP:FD CYC:7", &record), -1);
+    CU_ASSERT_EQUAL(parseTraceLine("", &record), -1);
+}
+
+void test_golden_read_text() {
+    // Enough lines for several chunks, with Windows line endings, a blank line
+    // and no newline at the end
+    const int count = GOLDEN_CHUNK * 2 + 3;
+    FILE* file = fopen(log_path, "wb");
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s%04X  EA        NOP  A:%02X X:00 Y:00 P:24 SP:FD CYC:%d%s",
+                i == 5 ? "\r\n" : "", i & 0xFFFF, i & 0xFF, i * 2, i + 1 < count ? "\r\n" : "");
+    }
+    fclose(file);
+
+    GoldenLog* log = openGoldenLog(log_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+    CU_ASSERT_TRUE(log->from_text);
+
+    const TraceRecord* record;
+    int read = 0;
+    bool in_order = true;
+    while ((record = goldenNext(log)) != NULL) {
+        in_order &= record->pc == (read & 0xFFFF) && record->a == (read & 0xFF) &&
+                    record->opcode == 0xEA && record->cycles == (uint64_t)read * 2;
+        read++;
+    }
+    CU_ASSERT_EQUAL(read, count);
+    CU_ASSERT_TRUE(in_order);
+    CU_ASSERT_TRUE(log->bytes);
+    CU_ASSERT_FALSE(log->failed);
+    closeGoldenLog(log);
+
+    // Encoded, the same records come back out of a trace file
+    CU_ASSERT_EQUAL(encodeTraceLog(log_path, trace_path), count);
+    log = openGoldenLog(trace_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+    CU_ASSERT_FALSE(log->from_text);
+    read = 0;
+    in_order = true;
+    while ((record = goldenNext(log)) != NULL) {
+        in_order &= record->pc == (read & 0xFFFF) && record->cycles == (uint64_t)read * 2;
+        read++;
+    }
+    CU_ASSERT_EQUAL(read, count);
+    CU_ASSERT_TRUE(in_order);
+    closeGoldenLog(log);
+}
+
+void test_golden_bad_log() {
+    FILE* file = fopen(log_path, "wb");
+    fputs("C000  4C F5 C5  JMP $C5F5  A:00 X:00 Y:00 P:24 SP:FD CYC:7\n", file);
+    fputs("not a trace line\n", file);
+    fclose(file);
+
+    GoldenLog* log = openGoldenLog(log_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(log);
+
+    // The lines before the one that can't be decoded still come out
+    CU_ASSERT_PTR_NOT_NULL(goldenNext(log));
+    CU_ASSERT_PTR_NULL(goldenNext(log));
+    CU_ASSERT_TRUE(log->failed);
+    closeGoldenLog(log);
+    CU_ASSERT_EQUAL(encodeTraceLog(log_path, trace_path), -1);
+
+    CU_ASSERT_PTR_NULL(openGoldenLog("/tmp/madnes_no_such_log"));
+}
+
+void test_golden_validate() {
+    recordGolden();
+
+    FILE* out = tmpfile();
+    CU_ASSERT_EQUAL(validate(trace_path, out), GOLDEN_TEST_STEPS);
+
+    // The same trace printed like nestest.log validates the same way
+    FILE* file = fopen(log_path, "wb");
+    CU_ASSERT_EQUAL(formatTraceFile(trace_path, TRACE_FORMAT_NESTEST, file), GOLDEN_TEST_STEPS);
+    fclose(file);
+    CU_ASSERT_EQUAL(validate(log_path, out), GOLDEN_TEST_STEPS);
+
+    // A log that goes on after the rom stops matching fails
+    file = fopen(log_path, "ab");
+    fputs("8000  E8        INX  A:00 X:00 Y:00 P:24 SP:FD CYC:1\n", file);
+    fclose(file);
+    CU_ASSERT_EQUAL(validate(log_path, out), -1);
+    fclose(out);
+}
+
+void test_golden_diverge() {
+    recordGolden();
+
+    // Change X in the 501st record
+    FILE* file = fopen(trace_path, "r+b");
+    TraceRecord record;
+    long offset = sizeof(TraceHeader) + 500 * sizeof(TraceRecord);
+    fseek(file, offset, SEEK_SET);
+    CU_ASSERT_EQUAL(fread(&record, sizeof(record), 1, file), 1);
+    uint8_t x = record.x;
+    record.x ^= 0x40;
+    fseek(file, offset, SEEK_SET);
+    fwrite(&record, sizeof(record), 1, file);
+    fclose(file);
+
+    FILE* out = tmpfile();
+    CU_ASSERT_EQUAL(validate(trace_path, out), -1);
+
+    // It stops there, with the instructions leading up to it
+    rewind(out);
+    char text[4096];
+    size_t length = fread(text, 1, sizeof(text) - 1, out);
+    text[length] = '\0';
+    fclose(out);
+
+    char expected[64];
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, "at instruction 501:"));
+    snprintf(expected, sizeof(expected), "X is $%02X, expected $%02X", x, x ^ 0x40);
+    CU_ASSERT_PTR_NOT_NULL(strstr(text, expected));
+    CU_ASSERT_PTR_NULL(strstr(text, "A is"));
+    CU_ASSERT_PTR_NULL(strstr(text, "Matched"));
+
+    int context = 0;
+    for (char* line = strstr(text, "\n  "); line != NULL; line = strstr(line + 1, "\n  ")) {
+        context++;
+    }
+    CU_ASSERT_EQUAL(context, GOLDEN_CONTEXT);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_golden_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Golden Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parse Line", test_golden_parse_line) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Read Text", test_golden_read_text) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Bad Log", test_golden_bad_log) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Validate", test_golden_validate) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Diverge", test_golden_diverge) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
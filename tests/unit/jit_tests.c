@@ -0,0 +1,412 @@
+#include "6502.h"
+#include "blockcache.h"
+#include "interpreter.h"
+#include "jit.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Processor jit_processor;
+static uint8_t* jit_memory;
+static Bus* jit_bus;
+static uint64_t jit_cycles;
+static BlockCache* cache;
+static Jit* jit;
+
+static void init_test() {
+    jit_processor.PC = 0x0600;
+    jit_processor.S = 0xFF;
+    jit_processor.P = 0x30;
+    jit_processor.A = 0x0;
+    jit_processor.X = 0x0;
+    jit_processor.Y = 0x0;
+    jit_processor.halted = false;
+    jit_processor.block_cache = NULL;
+
+    jit_memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    jit_bus = createFlatBus(jit_memory);
+    jit_cycles = 0;
+    cache = createBlockCache();
+    jit = NULL;
+    srand(6502);
+}
+
+static void clean_test() {
+    freeJit(jit);
+    freeBlockCache(cache);
+    freeBus(jit_bus);
+    free(jit_memory);
+}
+
+#define REGISTER_LOG_SIZE (1024)
+
+// Accesses made to a page of registers, and the cycle count each one saw
+typedef struct {
+    const uint64_t* clock;
+    uint16_t addrs[REGISTER_LOG_SIZE];
+    uint64_t cycles[REGISTER_LOG_SIZE];
+    int count;
+} RegisterLog;
+
+static void logAccess(RegisterLog* log, uint16_t addr) {
+    if (log->count < REGISTER_LOG_SIZE) {
+        log->addrs[log->count] = addr;
+        log->cycles[log->count] = *log->clock;
+        log->count++;
+    }
+}
+
+static uint8_t readRegister(void* context, uint16_t addr) {
+    logAccess(context, addr);
+    return (addr & 0xFF) ^ 0x5A;
+}
+
+static void writeRegister(void* context, uint16_t addr, uint8_t val) {
+    logAccess(context, addr);
+}
+
+static void loadProgram(const uint8_t* program, int size) {
+    memcpy(jit_memory + 0x0600, program, size);
+}
+
+/**
+ * Run the program with the JIT and with runInstructions and check that they
+ * end up in the same state
+ */
+static void checkMatchesRunInstructions() {
+    uint8_t* other_memory = malloc(MEMORY_SPACE);
+    memcpy(other_memory, jit_memory, MEMORY_SPACE);
+    Bus* other_bus = createFlatBus(other_memory);
+    Processor other_processor = jit_processor;
+    uint64_t other_cycles = 0;
+
+    uint64_t count = runJit(jit, jit_bus, &jit_processor, &jit_cycles, UINT64_MAX, NO_STOP_PC);
+    uint64_t other_count = runInstructions(other_bus, &other_processor, &other_cycles,
+                                           UINT64_MAX, NO_STOP_PC);
+    syncFlags(&jit_processor);
+    syncFlags(&other_processor);
+
+    CU_ASSERT_EQUAL(count, other_count);
+    CU_ASSERT_EQUAL(jit_processor.PC, other_processor.PC);
+    CU_ASSERT_EQUAL(jit_processor.A, other_processor.A);
+    CU_ASSERT_EQUAL(jit_processor.X, other_processor.X);
+    CU_ASSERT_EQUAL(jit_processor.Y, other_processor.Y);
+    CU_ASSERT_EQUAL(jit_processor.S, other_processor.S);
+    CU_ASSERT_EQUAL(jit_processor.P, other_processor.P);
+    CU_ASSERT_EQUAL(jit_cycles, other_cycles);
+    CU_ASSERT_EQUAL(memcmp(jit_memory, other_memory, MEMORY_SPACE), 0);
+
+    freeBus(other_bus);
+    free(other_memory);
+}
+
+// ---------- Tests ----------
+
+void test_jit_loop_matches_run_instructions() {
+    jit = createJit(cache, false);
+    if (jit == NULL) {
+        return;  // Not an x86-64 host
+    }
+
+    // LDX #$40
+    // loop: LDA $02F0,X; ADC #$07; STA $0400,X; PHA; PLA; SBC $10; CMP #$80; ROL A
+    //       DEX; BNE loop
+    // BRK
+    const uint8_t program[] = {0xA2, 0x40, 0xBD, 0xF0, 0x02, 0x69, 0x07, 0x9D, 0x00, 0x04, 0x48,
+                               0x68, 0xE5, 0x10, 0xC9, 0x80, 0x2A, 0xCA, 0xD0, 0xEE, 0x00};
+    loadProgram(program, sizeof(program));
+    for (int i = 0; i < 0x100; i++) {
+        jit_memory[0x0300 + i] = rand() & 0xFF;
+    }
+
+    checkMatchesRunInstructions();
+
+    CU_ASSERT_EQUAL(jit->compiled, 1);
+    CU_ASSERT(jit->native_runs > 0);
+    CU_ASSERT_EQUAL(jit->smc_exits, 0);
+}
+
+void test_jit_store_to_code() {
+    jit = createJit(cache, false);
+    if (jit == NULL) {
+        return;
+    }
+
+    // LDX #$00
+    // loop: LDA #$EA; STA $05E2,X; INX; CPX #$21; BNE loop
+    // BRK
+    // Once X reaches $1E the stores start overwriting the program with NOPs
+    const uint8_t program[] = {0xA2, 0x00, 0xA9, 0xEA, 0x9D, 0xE2, 0x05,
+                               0xE8, 0xE0, 0x21, 0xD0, 0xF6, 0x00};
+    loadProgram(program, sizeof(program));
+
+    checkMatchesRunInstructions();
+
+    CU_ASSERT(jit->compiled > 0);
+    CU_ASSERT(jit->smc_exits > 0);
+    CU_ASSERT(cache->invalidations > 0);
+}
+
+void test_jit_differential_random_programs() {
+    // Every documented opcode that doesn't end a block
+    uint8_t opcodes[256];
+    int opcode_count = 0;
+    for (int op = 0; op < 256; op++) {
+        Mnemonic mnemonic = opcode_table[op].mnemonic;
+        if (mnemonic != ILLEGAL && mnemonic != BRK && mnemonic != JMP && mnemonic != JSR &&
+            mnemonic != RTS && mnemonic != RTI && opcode_table[op].addr_mode != REL) {
+            opcodes[opcode_count++] = op;
+        }
+    }
+
+    uint64_t native_runs = 0;
+    for (int program = 0; program < 64; program++) {
+        // Memory is rewritten behind the cache's back, so start from scratch
+        freeJit(jit);
+        freeBlockCache(cache);
+        cache = createBlockCache();
+        jit = createJit(cache, true);
+        if (jit == NULL) {
+            return;  // Not an x86-64 host
+        }
+
+        for (int i = 0; i < MEMORY_SPACE; i++) {
+            jit_memory[i] = rand() & 0xFF;
+        }
+
+        // A straight run of random instructions followed by JMP $0600
+        uint16_t addr = 0x0600;
+        for (int i = 0; i < 12; i++) {
+            uint8_t op = opcodes[rand() % opcode_count];
+            jit_memory[addr] = op;
+            addr += opcode_table[op].length;
+        }
+        jit_memory[addr] = 0x4C;
+        jit_memory[addr + 1] = 0x00;
+        jit_memory[addr + 2] = 0x06;
+
+        jit_processor.PC = 0x0600;
+        jit_processor.A = rand() & 0xFF;
+        jit_processor.X = rand() & 0xFF;
+        jit_processor.Y = rand() & 0xFF;
+        jit_processor.S = rand() & 0xFF;
+        jit_processor.P = rand() & 0xFF;
+        jit_processor.halted = false;
+
+        runJit(jit, jit_bus, &jit_processor, &jit_cycles, jit_cycles + 5000, NO_STOP_PC);
+
+        CU_ASSERT_EQUAL(jit->mismatches, 0);
+        native_runs += jit->native_runs;
+    }
+
+    CU_ASSERT(native_runs > 0);
+}
+
+void test_jit_registers() {
+    jit = createJit(cache, false);
+    if (jit == NULL) {
+        return;
+    }
+
+    // LDY #$00
+    // loop: LDA $0300,Y; STA $1FF0,Y; LDA ($10),Y; ADC #$01; INY; CPY #$C0; BNE loop
+    // BRK
+    // The store reaches the registers at $2000 once Y gets to $10, and the
+    // indirect load once Y gets to $80
+    const uint8_t program[] = {0xA0, 0x00, 0xB9, 0x00, 0x03, 0x99, 0xF0, 0x1F, 0xB1,
+                               0x10, 0x69, 0x01, 0xC8, 0xC0, 0xC0, 0xD0, 0xF1, 0x00};
+    loadProgram(program, sizeof(program));
+    jit_memory[0x10] = 0x80;
+    jit_memory[0x11] = 0x1F;
+    for (int i = 0; i < 0x100; i++) {
+        jit_memory[0x0300 + i] = rand() & 0xFF;
+    }
+
+    uint8_t* other_memory = malloc(MEMORY_SPACE);
+    memcpy(other_memory, jit_memory, MEMORY_SPACE);
+    Bus* other_bus = createFlatBus(other_memory);
+    Processor other_processor = jit_processor;
+    uint64_t other_cycles = 0;
+
+    RegisterLog* jit_log = calloc(1, sizeof(RegisterLog));
+    RegisterLog* other_log = calloc(1, sizeof(RegisterLog));
+    jit_log->clock = &jit_cycles;
+    other_log->clock = &other_cycles;
+    busMapHandlers(jit_bus, 0x2000, BUS_PAGE_SIZE, readRegister, writeRegister, jit_log);
+    busMapHandlers(other_bus, 0x2000, BUS_PAGE_SIZE, readRegister, writeRegister, other_log);
+
+    // Every run ends after the instruction that touched a register
+    bool one_per_run = true;
+    while (!jit_processor.halted) {
+        int before = jit_log->count;
+        runJit(jit, jit_bus, &jit_processor, &jit_cycles, UINT64_MAX, NO_STOP_PC);
+        one_per_run &= jit_log->count - before <= 1;
+    }
+    while (!other_processor.halted) {
+        runInstructions(other_bus, &other_processor, &other_cycles, UINT64_MAX, NO_STOP_PC);
+    }
+    syncFlags(&jit_processor);
+    syncFlags(&other_processor);
+
+    CU_ASSERT_TRUE(one_per_run);
+    CU_ASSERT_EQUAL(jit_processor.PC, other_processor.PC);
+    CU_ASSERT_EQUAL(jit_processor.A, other_processor.A);
+    CU_ASSERT_EQUAL(jit_processor.Y, other_processor.Y);
+    CU_ASSERT_EQUAL(jit_processor.P, other_processor.P);
+    CU_ASSERT_EQUAL(jit_cycles, other_cycles);
+    CU_ASSERT_EQUAL(memcmp(jit_memory, other_memory, MEMORY_SPACE), 0);
+
+    // The registers saw the same accesses at the same cycles
+    CU_ASSERT_EQUAL(jit_log->count, (0xC0 - 0x10) + (0xC0 - 0x80));
+    CU_ASSERT_EQUAL(jit_log->count, other_log->count);
+    CU_ASSERT_EQUAL(memcmp(jit_log->addrs, other_log->addrs, sizeof(jit_log->addrs)), 0);
+    CU_ASSERT_EQUAL(memcmp(jit_log->cycles, other_log->cycles, sizeof(jit_log->cycles)), 0);
+
+    CU_ASSERT(jit->native_runs > 0);
+    CU_ASSERT(jit->register_exits > 0);
+
+    free(jit_log);
+    free(other_log);
+    freeBus(other_bus);
+    free(other_memory);
+}
+
+void test_jit_bank_switch() {
+    jit = createJit(cache, false);
+    if (jit == NULL) {
+        return;
+    }
+
+    // Two banks with different code at $0600: LDA #$11 (or #$22); BRK
+    uint8_t banks[2][BUS_PAGE_SIZE] = {{0xA9, 0x11, 0x00}, {0xA9, 0x22, 0x00}};
+
+    busMapReadMemory(jit_bus, 0x0600, BUS_PAGE_SIZE, banks[0]);
+    for (int i = 0; i < JIT_THRESHOLD * 2; i++) {
+        jit_processor.PC = 0x0600;
+        jit_processor.halted = false;
+        runJit(jit, jit_bus, &jit_processor, &jit_cycles, UINT64_MAX, NO_STOP_PC);
+    }
+    CU_ASSERT_EQUAL(jit_processor.A, 0x11);
+    CU_ASSERT_EQUAL(jit->compiled, 1);
+
+    // The block compiled from the first bank isn't run once the second is in
+    busMapReadMemory(jit_bus, 0x0600, BUS_PAGE_SIZE, banks[1]);
+    jit_processor.PC = 0x0600;
+    jit_processor.halted = false;
+    runJit(jit, jit_bus, &jit_processor, &jit_cycles, UINT64_MAX, NO_STOP_PC);
+    CU_ASSERT_EQUAL(jit_processor.A, 0x22);
+    CU_ASSERT(cache->invalidations > 0);
+}
+
+void test_jit_cycle_limit() {
+    jit = createJit(cache, false);
+    if (jit == NULL) {
+        return;
+    }
+
+    // loop: INX; INY; JMP loop (7 cycles)
+    const uint8_t program[] = {0xE8, 0xC8, 0x4C, 0x00, 0x06};
+    loadProgram(program, sizeof(program));
+    runJit(jit, jit_bus, &jit_processor, &jit_cycles, 7 * JIT_THRESHOLD * 2, NO_STOP_PC);
+    CU_ASSERT_EQUAL(jit->compiled, 1);
+
+    // A compiled block doesn't run past the limit, it's interpreted up to it
+    uint64_t limit = jit_cycles + 7 * 10 + 2;
+    runJit(jit, jit_bus, &jit_processor, &jit_cycles, limit, NO_STOP_PC);
+    CU_ASSERT_EQUAL(jit_cycles, limit);
+    CU_ASSERT_EQUAL(jit_processor.PC, 0x0601);
+}
+
+void test_jit_differential_mirrors() {
+    jit = createJit(cache, true);
+    if (jit == NULL) {
+        return;
+    }
+
+    // RAM mirrored up to $2000 the way the NES has it, and registers after it
+    RegisterLog* log = calloc(1, sizeof(RegisterLog));
+    log->clock = &jit_cycles;
+    busMapMemory(jit_bus, 0x0000, 0x2000, jit_memory, RAM_SIZE, true);
+    busMapHandlers(jit_bus, 0x2000, BUS_PAGE_SIZE, readRegister, writeRegister, log);
+
+    // LDX #$00
+    // loop: TXA; STA $0000,X; LDA $0800,X; ADC #$01; STA $1000,X; INX; BNE loop
+    // STA $2000; BRK
+    const uint8_t program[] = {0xA2, 0x00, 0x8A, 0x9D, 0x00, 0x00, 0xBD, 0x00, 0x08, 0x69, 0x01,
+                               0x9D, 0x00, 0x10, 0xE8, 0xD0, 0xF1, 0x8D, 0x00, 0x20, 0x00};
+    loadProgram(program, sizeof(program));
+    while (!jit_processor.halted) {
+        runJit(jit, jit_bus, &jit_processor, &jit_cycles, UINT64_MAX, NO_STOP_PC);
+    }
+
+    // Blocks are checked on a bus that isn't flat, and writes through one
+    // mirror aren't mistaken for differences in another
+    CU_ASSERT(jit->native_runs > 0);
+    CU_ASSERT_EQUAL(jit->mismatches, 0);
+    CU_ASSERT_EQUAL(log->count, 1);
+    bool counted = true;
+    for (int i = 0; i < 0x100; i++) {
+        counted &= jit_memory[i] == ((i + 1) & 0xFF);
+    }
+    CU_ASSERT_TRUE(counted);
+
+    free(log);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_jit_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("JIT Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Loop Matches runInstructions",
+                    test_jit_loop_matches_run_instructions) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Store To Code", test_jit_store_to_code) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Registers", test_jit_registers) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Differential Mirrors", test_jit_differential_mirrors) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Bank Switch", test_jit_bank_switch) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Cycle Limit", test_jit_cycle_limit) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Differential Random Programs",
+                    test_jit_differential_random_programs) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,142 @@
+#include "logger.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdio.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static FILE* log_out;
+
+/**
+ * Count the lines written to the log so far
+ *
+ * @returns The number of lines
+ */
+static int countLines() {
+    flushLog();
+    rewind(log_out);
+
+    char line[512];
+    int lines = 0;
+    while (fgets(line, sizeof(line), log_out) != NULL) {
+        lines++;
+    }
+    return lines;
+}
+
+/**
+ * Stand in for an expensive log argument
+ *
+ * @param calls - Counts the calls
+ *
+ * @returns 0
+ */
+static int countCall(int* calls) {
+    (*calls)++;
+    return 0;
+}
+
+static void init_test() {
+    log_out = tmpfile();
+    setLogFile(log_out);
+    setLogLevel(LEVEL_INFO);
+}
+
+static void clean_test() {
+    setLogFile(NULL);
+    setLogLevel(LEVEL_INFO);
+    fclose(log_out);
+}
+
+// ---------- Tests ----------
+
+void test_logger_format() {
+    LOG(COMP_PPU, LEVEL_WARNING, "Frame %d", 5);
+    flushLog();
+    rewind(log_out);
+
+    // e.x. "Sat Oct 17 02:54:14 2026 WARNING [PPU]: Frame 5"
+    char line[512];
+    CU_ASSERT_PTR_NOT_NULL(fgets(line, sizeof(line), log_out));
+    CU_ASSERT_PTR_NOT_NULL(strstr(line, " WARNING [PPU]: Frame 5\n"));
+}
+
+void test_logger_levels() {
+    int calls = 0;
+
+    // Arguments of skipped messages aren't evaluated
+    LOG(COMP_CPU, LEVEL_DEBUG, "Skipped %d", countCall(&calls));
+    CU_ASSERT_EQUAL(calls, 0);
+    LOG(COMP_CPU, LEVEL_INFO, "Logged %d", countCall(&calls));
+    CU_ASSERT_EQUAL(calls, 1);
+
+    setLogLevel(LEVEL_ERROR);
+    LOG(COMP_CPU, LEVEL_WARNING, "Skipped %d", countCall(&calls));
+    LOG(COMP_CPU, LEVEL_ERROR, "Logged %d", countCall(&calls));
+    CU_ASSERT_EQUAL(calls, 2);
+
+    setLogLevel(LEVEL_NONE);
+    LOG(COMP_CPU, LEVEL_ERROR, "Skipped %d", countCall(&calls));
+    CU_ASSERT_EQUAL(calls, 2);
+
+    CU_ASSERT_EQUAL(countLines(), 2);
+}
+
+void test_logger_rate_limit() {
+    for (int i = 0; i < LOG_RATE_INTERVAL * 2; i++) {
+        LOG_LIMITED(COMP_CPU, LEVEL_WARNING, "Invalid opcode %d", i);
+    }
+
+    // The first few, a note that the rest are being limited, then one every
+    // LOG_RATE_INTERVAL
+    CU_ASSERT_EQUAL(countLines(), LOG_RATE_BURST + 1 + 2);
+}
+
+void test_logger_parse_level() {
+    LogLevel level = LEVEL_INFO;
+
+    CU_ASSERT_EQUAL(parseLogLevel("debug", &level), 0);
+    CU_ASSERT_EQUAL(level, LEVEL_DEBUG);
+    CU_ASSERT_EQUAL(parseLogLevel("WARNING", &level), 0);
+    CU_ASSERT_EQUAL(level, LEVEL_WARNING);
+    CU_ASSERT_EQUAL(parseLogLevel("none", &level), 0);
+    CU_ASSERT_EQUAL(level, LEVEL_NONE);
+    CU_ASSERT_EQUAL(parseLogLevel("loud", &level), -1);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_logger_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Logger Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Format", test_logger_format) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Levels", test_logger_levels) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Rate Limit", test_logger_rate_limit) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parse Level", test_logger_parse_level) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,336 @@
+#include "bus.h"
+#include "cartridge.h"
+#include "mapper.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static Cartridge cart;
+
+/**
+ * Build a cartridge where the first byte of every 8 KiB PRG bank and every
+ * 1 KiB CHR bank holds the index of the bank
+ *
+ * @param mapper_num - The iNES mapper number
+ * @param prg_banks - PRG-ROM size (in 16 KiB units)
+ * @param chr_banks - CHR-ROM size (in 8 KiB units)
+ */
+static void makeCart(int mapper_num, int prg_banks, int chr_banks) {
+    cart = (Cartridge){0};
+    cart.prg_rom_size = prg_banks;
+    cart.chr_rom_size = chr_banks;
+    cart.prg_rom_bytes = prg_banks * 0x4000;
+    cart.chr_rom_bytes = chr_banks * 0x2000;
+    cart.flags6 = (mapper_num & 0x0F) << 4;
+    cart.flags7 = mapper_num & 0xF0;
+
+    cart.prg_rom = calloc(prg_banks * 0x4000, sizeof(uint8_t));
+    for (int bank = 0; bank < prg_banks * 2; bank++) {
+        cart.prg_rom[bank * 0x2000] = bank;
+    }
+
+    cart.chr_rom = calloc(chr_banks * 0x2000, sizeof(uint8_t));
+    for (int bank = 0; bank < chr_banks * 8; bank++) {
+        cart.chr_rom[bank * 0x400] = bank;
+    }
+
+    test_mapper = createMapper(&cart, test_bus);
+}
+
+// Write a value to an MMC1 register through its serial port
+static void mmc1Write(uint16_t addr, uint8_t val) {
+    for (int i = 0; i < 5; i++) {
+        busWrite(test_bus, addr, (val >> i) & 0x01);
+    }
+}
+
+static void init_test() {
+    test_bus = createBus();
+    test_mapper = NULL;
+    cart = (Cartridge){0};
+}
+
+static void clean_test() {
+    freeMapper(test_mapper);
+    freeBus(test_bus);
+    free(cart.prg_rom);
+    free(cart.chr_rom);
+}
+
+// ---------- Tests ----------
+
+void test_mapper_number() {
+    Cartridge header = {0};
+    header.flags6 = 0x41;
+    header.flags7 = 0x10;
+    header.flags8 = 0x02;
+
+    // Flags 8 only counts in NES 2.0 headers
+    CU_ASSERT_EQUAL(getMapperNumber(&header), 0x14);
+    header.flags7 |= 0x08;
+    CU_ASSERT_EQUAL(getMapperNumber(&header), 0x214);
+}
+
+void test_mapper_unsupported() {
+    makeCart(0x69, 1, 1);
+
+    CU_ASSERT_PTR_NULL(test_mapper);
+}
+
+void test_nrom_mirrors_16k() {
+    makeCart(0, 1, 1);
+    cart.prg_rom[0x3FFC] = 0x69;
+
+    CU_ASSERT_PTR_NOT_NULL(test_mapper);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xFFFC), 0x69);
+
+    // PRG-ROM is read only, PRG-RAM isn't
+    busWrite(test_bus, 0x8001, 0x42);
+    busWrite(test_bus, 0x6000, 0x42);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8001), 0x00);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x6000), 0x42);
+}
+
+void test_nrom_chr_ram() {
+    makeCart(0, 2, 0);
+
+    mapperPpuWrite(test_mapper, 0x1234, 0x69);
+
+    CU_ASSERT_TRUE(test_mapper->chr_writable);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1234), 0x69);
+}
+
+void test_chr_ram_tile_cache() {
+    makeCart(0, 2, 0);
+
+    mapperPpuWrite(test_mapper, 0x1230, 0xFF);
+    mapperPpuWrite(test_mapper, 0x1238, 0x0F);
+
+    const uint8_t* row = mapperTileRow(test_mapper, 0x1230);
+    CU_ASSERT_EQUAL(row[0], 1);
+    CU_ASSERT_EQUAL(row[7], 3);
+    CU_ASSERT_EQUAL(test_mapper->tile_rebuilds, 1);
+
+    // The tile is only decoded again once it's written to again
+    mapperTileRow(test_mapper, 0x1237);
+    CU_ASSERT_EQUAL(test_mapper->tile_rebuilds, 1);
+
+    mapperPpuWrite(test_mapper, 0x1230, 0x00);
+    row = mapperTileRow(test_mapper, 0x1230);
+    CU_ASSERT_EQUAL(row[0], 0);
+    CU_ASSERT_EQUAL(row[7], 2);
+    CU_ASSERT_EQUAL(test_mapper->tile_rebuilds, 2);
+    CU_ASSERT_EQUAL(test_mapper->frame_tile_rebuilds, 2);
+}
+
+void test_mmc1_prg_modes() {
+    makeCart(1, 8, 2);
+
+    // Power on in mode 3: switchable $8000, last bank fixed at $C000
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 14);
+
+    mmc1Write(0xE000, 3);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 6);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 14);
+
+    // Mode 2: first bank fixed at $8000, switchable $C000
+    mmc1Write(0x8000, 0x08);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 6);
+    CU_ASSERT_EQUAL(test_mapper->mirroring, MIRROR_SINGLE_LOW);
+
+    // Mode 0: 32 KiB banks
+    mmc1Write(0x8000, 0x02);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 4);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 6);
+    CU_ASSERT_EQUAL(test_mapper->mirroring, MIRROR_VERTICAL);
+}
+
+void test_mmc1_reset_shift() {
+    makeCart(1, 8, 2);
+
+    // A write with bit 7 set throws away the bits written so far
+    busWrite(test_bus, 0xE000, 0x01);
+    busWrite(test_bus, 0xE000, 0x01);
+    busWrite(test_bus, 0xE000, 0x80);
+    mmc1Write(0xE000, 2);
+
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 4);
+}
+
+void test_mmc1_chr_banks() {
+    makeCart(1, 2, 4);
+
+    mmc1Write(0x8000, 0x1C);
+    mmc1Write(0xA000, 3);
+    mmc1Write(0xC000, 5);
+
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0000), 12);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1000), 20);
+}
+
+void test_uxrom() {
+    makeCart(2, 8, 0);
+
+    busWrite(test_bus, 0x8000, 5);
+
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 10);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 14);
+}
+
+void test_cnrom() {
+    makeCart(3, 2, 4);
+
+    busWrite(test_bus, 0x8000, 2);
+
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0000), 16);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1C00), 23);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 2);
+
+    // The decoded tiles switch along with the banks (bank 23 is %00010111)
+    const uint8_t* row = mapperTileRow(test_mapper, 0x1C00);
+    CU_ASSERT_EQUAL(row[2], 0);
+    CU_ASSERT_EQUAL(row[3], 1);
+    CU_ASSERT_EQUAL(row[7], 1);
+    CU_ASSERT_EQUAL(test_mapper->tile_rebuilds, 0);
+}
+
+void test_mmc3_banks() {
+    makeCart(4, 8, 8);
+
+    // R6 = 3, R7 = 5
+    busWrite(test_bus, 0x8000, 0x06);
+    busWrite(test_bus, 0x8001, 3);
+    busWrite(test_bus, 0x8000, 0x07);
+    busWrite(test_bus, 0x8001, 5);
+
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 3);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xA000), 5);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 14);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xE000), 15);
+
+    // PRG mode 1 swaps $8000 and $C000
+    busWrite(test_bus, 0x8000, 0x46);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 14);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 3);
+
+    // R0 = 4 (2 KiB), R2 = 9 (1 KiB), then invert CHR
+    busWrite(test_bus, 0x8000, 0x00);
+    busWrite(test_bus, 0x8001, 4);
+    busWrite(test_bus, 0x8000, 0x02);
+    busWrite(test_bus, 0x8001, 9);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0000), 4);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0400), 5);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1000), 9);
+
+    busWrite(test_bus, 0x8000, 0x82);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1000), 4);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0000), 9);
+
+    busWrite(test_bus, 0xA000, 0x01);
+    CU_ASSERT_EQUAL(test_mapper->mirroring, MIRROR_HORIZONTAL);
+}
+
+void test_mmc3_irq() {
+    makeCart(4, 2, 1);
+
+    busWrite(test_bus, 0xC000, 2);  // Latch
+    busWrite(test_bus, 0xC001, 0);  // Reload
+    busWrite(test_bus, 0xE001, 0);  // Enable
+
+    mapperScanline(test_mapper);
+    mapperScanline(test_mapper);
+    CU_ASSERT_FALSE(mapperIrq(test_mapper));
+
+    mapperScanline(test_mapper);
+    CU_ASSERT_TRUE(mapperIrq(test_mapper));
+
+    // Disabling acknowledges the IRQ
+    busWrite(test_bus, 0xE000, 0);
+    CU_ASSERT_FALSE(mapperIrq(test_mapper));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_mapper_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Mapper Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Mapper Number", test_mapper_number) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Unsupported Mapper", test_mapper_unsupported) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "NROM Mirrors 16K", test_nrom_mirrors_16k) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "NROM CHR-RAM", test_nrom_chr_ram) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "CHR-RAM Tile Cache", test_chr_ram_tile_cache) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC1 PRG Modes", test_mmc1_prg_modes) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC1 Reset Shift", test_mmc1_reset_shift) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC1 CHR Banks", test_mmc1_chr_banks) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "UxROM", test_uxrom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "CNROM", test_cnrom) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC3 Banks", test_mmc3_banks) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC3 IRQ", test_mmc3_irq) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
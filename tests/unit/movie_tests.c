@@ -0,0 +1,229 @@
+#include "bus.h"
+#include "cartridge.h"
+#include "controller.h"
+#include "mapper.h"
+#include "movie.h"
+#include "ppu.h"
+#include "savestate.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static PPU* test_ppu;
+static Movie* movie;
+static Cartridge cart;
+
+static Processor processor;
+static uint8_t ram[RAM_SIZE];
+static uint64_t cycles;
+static Controllers controllers;
+static Machine machine;
+
+static char path[32];
+
+static void init_test() {
+    cart = (Cartridge){0};
+    cart.prg_rom_size = 1;
+    cart.chr_rom_size = 1;
+    cart.prg_rom_bytes = 0x4000;
+    cart.chr_rom_bytes = 0x2000;
+    cart.prg_rom = calloc(0x4000, sizeof(uint8_t));
+    cart.chr_rom = calloc(0x2000, sizeof(uint8_t));
+
+    test_bus = createBus();
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    test_mapper = createMapper(&cart, test_bus);
+    test_ppu = createPPU(test_mapper);
+    ppuMapRegisters(test_ppu, test_bus);
+    initControllers(&controllers);
+    controllersMapRegisters(&controllers, test_bus);
+    movie = NULL;
+
+    processor = (Processor){.PC = 0x8000, .S = 0xFD, .P = 0x24};
+    memset(ram, 0, sizeof(ram));
+    cycles = 0;
+    machine = (Machine){&processor, ram, test_ppu, test_mapper, &cycles, &controllers};
+
+    strcpy(path, "/tmp/madnes_movie_XXXXXX");
+    close(mkstemp(path));
+}
+
+static void clean_test() {
+    if (movie) {
+        freeMovie(movie);
+    }
+    freePPU(test_ppu);
+    freeMapper(test_mapper);
+    freeBus(test_bus);
+    free(cart.prg_rom);
+    free(cart.chr_rom);
+    unlink(path);
+}
+
+/**
+ * Write a file for a test to read
+ *
+ * @param contents - What to write to it
+ */
+static void writeFile(const char* contents) {
+    FILE* file = fopen(path, "w");
+    fputs(contents, file);
+    fclose(file);
+}
+
+// ---------- Tests ----------
+
+void test_movie_save_load() {
+    uint64_t rom_hash = hashRom(&cart);
+    processor.A = 0x12;
+    movie = createMovie(rom_hash, &machine);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(movie);
+
+    // Enough frames to grow the inputs a few times
+    for (int frame = 0; frame < 5000; frame++) {
+        uint8_t buttons[CONTROLLER_PORTS] = {frame & 0xFF, frame >> 8};
+        CU_ASSERT_EQUAL(movieRecordFrame(movie, buttons), 0);
+    }
+    movie->final_hash = 0x0123456789ABCDEF;
+    CU_ASSERT_EQUAL(saveMovie(movie, path), 0);
+    freeMovie(movie);
+
+    movie = loadMovie(path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(movie);
+    CU_ASSERT_EQUAL(movie->rom_hash, rom_hash);
+    CU_ASSERT_EQUAL(movie->final_hash, 0x0123456789ABCDEF);
+    CU_ASSERT_EQUAL(movie->frames, 5000);
+    CU_ASSERT_EQUAL(movieFrame(movie, 300)[0], 300 & 0xFF);
+    CU_ASSERT_EQUAL(movieFrame(movie, 300)[1], 1);
+    CU_ASSERT_EQUAL(movieFrame(movie, 4999)[1], 19);
+
+    // Starting the movie puts the machine back where the recording started
+    processor.A = 0;
+    CU_ASSERT_EQUAL(movieStart(movie, &machine, rom_hash), 0);
+    CU_ASSERT_EQUAL(processor.A, 0x12);
+
+    // but only for the same rom
+    CU_ASSERT_EQUAL(movieStart(movie, &machine, rom_hash + 1), -1);
+}
+
+void test_movie_rejects() {
+    writeFile("MADSTATE and then some more bytes to fill the header up");
+    CU_ASSERT_PTR_NULL(loadMovie(path));
+
+    movie = createMovie(hashRom(&cart), &machine);
+    uint8_t buttons[CONTROLLER_PORTS] = {BUTTON_A, 0};
+    movieRecordFrame(movie, buttons);
+    saveMovie(movie, path);
+
+    // Missing its last frame
+    truncate(path, 8 + 4 + 8 + 8 + 4 + 4 + movie->state_size + 1);
+    CU_ASSERT_PTR_NULL(loadMovie(path));
+}
+
+void test_movie_state_hash() {
+    uint64_t hash = saveStateHash(&machine);
+    CU_ASSERT_EQUAL(saveStateHash(&machine), hash);
+
+    // Half way through reading the controllers is a different state
+    controllers.buttons[0] = BUTTON_START;
+    busWrite(test_bus, 0x4016, 1);
+    busWrite(test_bus, 0x4016, 0);
+    busRead(test_bus, 0x4016);
+    uint64_t reading = saveStateHash(&machine);
+    CU_ASSERT_NOT_EQUAL(reading, hash);
+
+    // and it's restored by loading a state
+    uint8_t* state = malloc(saveStateSize(&machine));
+    saveState(&machine, state, saveStateSize(&machine));
+    initControllers(&controllers);
+    CU_ASSERT_EQUAL(loadState(&machine, state, saveStateSize(&machine)), 0);
+    CU_ASSERT_EQUAL(saveStateHash(&machine), reading);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x40);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x40);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x4016), 0x41);
+    free(state);
+}
+
+void test_movie_input_script() {
+    writeFile("# Title screen\n"
+              "0 .\n"
+              "120 START\n"
+              "\n"
+              "125 . A+B\n"
+              "300 a+right\n");
+
+    InputScript* script = loadInputScript(path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(script);
+    CU_ASSERT_EQUAL(script->count, 4);
+
+    uint8_t buttons[CONTROLLER_PORTS] = {0xFF, 0xFF};
+    inputScriptButtons(script, 0, buttons);
+    CU_ASSERT_EQUAL(buttons[0], 0);
+    CU_ASSERT_EQUAL(buttons[1], 0);
+
+    // Buttons stay held until the next line
+    inputScriptButtons(script, 121, buttons);
+    CU_ASSERT_EQUAL(buttons[0], BUTTON_START);
+    inputScriptButtons(script, 124, buttons);
+    CU_ASSERT_EQUAL(buttons[0], BUTTON_START);
+    inputScriptButtons(script, 125, buttons);
+    CU_ASSERT_EQUAL(buttons[0], 0);
+    CU_ASSERT_EQUAL(buttons[1], BUTTON_A | BUTTON_B);
+    inputScriptButtons(script, 1000, buttons);
+    CU_ASSERT_EQUAL(buttons[0], BUTTON_A | BUTTON_RIGHT);
+    CU_ASSERT_EQUAL(buttons[1], 0);
+    freeInputScript(script);
+
+    // Out of order, unknown buttons, and too many controllers
+    writeFile("10 A\n5 B\n");
+    CU_ASSERT_PTR_NULL(loadInputScript(path));
+    writeFile("10 Z\n");
+    CU_ASSERT_PTR_NULL(loadInputScript(path));
+    writeFile("10 A B C\n");
+    CU_ASSERT_PTR_NULL(loadInputScript(path));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_movie_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Movie Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Save and Load", test_movie_save_load) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Rejects", test_movie_rejects) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "State Hash", test_movie_state_hash) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Input Script", test_movie_input_script) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,124 @@
+#include "pacer.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Pacer pacer;
+
+static void init_test() {
+    pacer = (Pacer){0};
+}
+
+static void clean_test() {}
+
+// ---------- Tests ----------
+
+void test_pacer_parse_speed() {
+    double speed = -1;
+
+    CU_ASSERT_EQUAL(parseSpeed("unlimited", &speed), 0);
+    CU_ASSERT_DOUBLE_EQUAL(speed, 0.0, 0.0001);
+    CU_ASSERT_EQUAL(parseSpeed("2x", &speed), 0);
+    CU_ASSERT_DOUBLE_EQUAL(speed, 2.0, 0.0001);
+    CU_ASSERT_EQUAL(parseSpeed("0.5", &speed), 0);
+    CU_ASSERT_DOUBLE_EQUAL(speed, 0.5, 0.0001);
+
+    CU_ASSERT_EQUAL(parseSpeed("fast", &speed), -1);
+    CU_ASSERT_EQUAL(parseSpeed("0x", &speed), -1);
+    CU_ASSERT_EQUAL(parseSpeed("-1x", &speed), -1);
+    CU_ASSERT_EQUAL(parseSpeed("2xx", &speed), -1);
+    CU_ASSERT_EQUAL(parseSpeed("nan", &speed), -1);
+    CU_ASSERT_EQUAL(parseSpeed("infx", &speed), -1);
+}
+
+void test_pacer_frame_boundaries() {
+    initPacer(&pacer, 0, 0);
+
+    // Frames alternate between 29780 and 29781 cycles
+    CU_ASSERT_FALSE(pacerDue(&pacer, 29780));
+    CU_ASSERT_TRUE(pacerDue(&pacer, 29781));
+    pacerWait(&pacer, 29781);
+    CU_ASSERT_FALSE(pacerDue(&pacer, 59560));
+    CU_ASSERT_TRUE(pacerDue(&pacer, 59561));
+
+    // Skipping several boundaries at once counts them all
+    pacerWait(&pacer, 29781 * 4);
+    CU_ASSERT_EQUAL(pacer.frames, 4);
+    CU_ASSERT_EQUAL(pacer.sleeps, 0);
+}
+
+void test_pacer_deadline() {
+    initPacer(&pacer, 1.0, 1000);
+
+    // A second of CPU cycles is a second after the start, and twice as fast
+    // takes half as long
+    CU_ASSERT_EQUAL(pacerDeadline(&pacer, 1000 + CPU_CLOCK_HZ) - pacer.base_ns, 1000000000);
+    pacer.speed = 2.0;
+    CU_ASSERT_EQUAL(pacerDeadline(&pacer, 1000 + CPU_CLOCK_HZ) - pacer.base_ns, 500000000);
+}
+
+void test_pacer_sleeps_until_deadline() {
+    initPacer(&pacer, 1.0, 0);
+
+    // A frame at real speed lasts about 16.6 ms
+    pacerWait(&pacer, 29781);
+    CU_ASSERT_EQUAL(pacer.sleeps, 1);
+    CU_ASSERT_TRUE(pacerNow() >= pacerDeadline(&pacer, 29781));
+}
+
+void test_pacer_resync() {
+    initPacer(&pacer, 1.0, 0);
+
+    // Pretend the last frame took a whole second
+    pacer.base_ns -= 1000000000;
+    uint64_t now = pacerNow();
+    pacerWait(&pacer, 29781);
+
+    CU_ASSERT_EQUAL(pacer.resyncs, 1);
+    CU_ASSERT_EQUAL(pacer.sleeps, 0);
+    CU_ASSERT_EQUAL(pacer.base_cycle, 29781);
+    CU_ASSERT_TRUE(pacer.base_ns >= now);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_pacer_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Pacer Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parse Speed", test_pacer_parse_speed) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Frame Boundaries", test_pacer_frame_boundaries) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Deadline", test_pacer_deadline) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Sleeps Until Deadline", test_pacer_sleeps_until_deadline) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Resync", test_pacer_resync) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,272 @@
+#include "bus.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static PPU* test_ppu;
+static Cartridge cart;
+static uint8_t* ram;
+
+static void init_test() {
+    // NROM with 16 KiB of PRG-ROM and CHR-RAM
+    cart = (Cartridge){0};
+    cart.prg_rom_size = 1;
+    cart.prg_rom_bytes = 0x4000;
+    cart.flags6 = 0x01;
+    cart.prg_rom = calloc(0x4000, sizeof(uint8_t));
+
+    ram = calloc(RAM_SIZE, sizeof(uint8_t));
+    test_bus = createBus();
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    test_mapper = createMapper(&cart, test_bus);
+    test_ppu = createPPU(test_mapper);
+    ppuMapRegisters(test_ppu, test_bus);
+}
+
+static void clean_test() {
+    freePPU(test_ppu);
+    freeMapper(test_mapper);
+    freeBus(test_bus);
+    free(cart.prg_rom);
+    free(ram);
+}
+
+// Point v at a PPU address through PPUADDR
+static void setAddress(uint16_t addr) {
+    busWrite(test_bus, 0x2006, addr >> 8);
+    busWrite(test_bus, 0x2006, addr & 0xFF);
+}
+
+// Run the PPU up to the given dot of the given scanline in the current frame
+static void stepTo(int scanline, int cycle) {
+    int dots = (scanline - test_ppu->scanline) * PPU_DOTS_PER_SCANLINE + cycle - test_ppu->cycle;
+    ppuStep(test_ppu, dots);
+}
+
+// ---------- Tests ----------
+
+void test_ppu_data_read_buffer() {
+    setAddress(0x2000);
+    busWrite(test_bus, 0x2007, 0x69);
+    busWrite(test_bus, 0x2007, 0x42);
+
+    // Reads lag a byte behind, except for the palettes
+    setAddress(0x2000);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2007), 0x00);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2007), 0x69);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2007), 0x42);
+
+    setAddress(0x3F01);
+    busWrite(test_bus, 0x2007, 0x16);
+    setAddress(0x3F01);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2007) & 0x3F, 0x16);
+}
+
+void test_ppu_increment_32() {
+    busWrite(test_bus, 0x2000, 0x04);
+    setAddress(0x2000);
+    busWrite(test_bus, 0x2007, 0x01);
+    busWrite(test_bus, 0x2007, 0x02);
+
+    CU_ASSERT_EQUAL(test_ppu->v, 0x2040);
+    CU_ASSERT_EQUAL(test_ppu->vram[0x0020], 0x02);
+}
+
+void test_ppu_vertical_mirroring() {
+    setAddress(0x2801);
+    busWrite(test_bus, 0x2007, 0x69);
+
+    CU_ASSERT_EQUAL(test_ppu->vram[0x0001], 0x69);
+
+    // The registers are mirrored every 8 bytes up to $3FFF
+    setAddress(0x2001);
+    busRead(test_bus, 0x3FFF);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2FFF), 0x69);
+}
+
+void test_ppu_palette_mirroring() {
+    setAddress(0x3F10);
+    busWrite(test_bus, 0x2007, 0x2C);
+
+    CU_ASSERT_EQUAL(test_ppu->palette[0x00], 0x2C);
+}
+
+void test_ppu_scroll_registers() {
+    busWrite(test_bus, 0x2000, 0x03);
+    busWrite(test_bus, 0x2005, 0x7D);
+    busWrite(test_bus, 0x2005, 0x5E);
+
+    CU_ASSERT_EQUAL(test_ppu->t, 0x6D6F);
+    CU_ASSERT_EQUAL(test_ppu->x, 0x05);
+
+    // Reading PPUSTATUS resets the write toggle
+    busWrite(test_bus, 0x2005, 0x00);
+    busRead(test_bus, 0x2002);
+    CU_ASSERT_FALSE(test_ppu->w);
+}
+
+void test_ppu_vblank_nmi() {
+    busWrite(test_bus, 0x2000, 0x80);
+
+    stepTo(PPU_VBLANK_SCANLINE, 0);
+    CU_ASSERT_FALSE(test_ppu->status & 0x80);
+    CU_ASSERT_FALSE(test_ppu->nmi_pending);
+
+    stepTo(PPU_VBLANK_SCANLINE, 1);
+    CU_ASSERT_TRUE(test_ppu->nmi_pending);
+
+    // Reading PPUSTATUS clears the vblank flag
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2002) & 0x80, 0x80);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2002) & 0x80, 0x00);
+
+    stepTo(PPU_SCANLINES, 0);
+    CU_ASSERT_EQUAL(test_ppu->frame, 1);
+    CU_ASSERT_EQUAL(test_ppu->scanline, 0);
+}
+
+void test_ppu_oam_dma() {
+    for (int i = 0; i < 256; i++) {
+        ram[0x0200 + i] = i;
+    }
+    busWrite(test_bus, 0x2003, 0x10);
+    busWrite(test_bus, 0x4014, 0x02);
+
+    CU_ASSERT_EQUAL(test_ppu->oam[0x10], 0x00);
+    CU_ASSERT_EQUAL(test_ppu->oam[0x0F], 0xFF);
+    CU_ASSERT_EQUAL(test_ppu->dma_cycles, 513);
+}
+
+void test_ppu_render_background() {
+    // Tile 1 is solid color 3, tile 0 is empty
+    setAddress(0x0010);
+    for (int i = 0; i < 16; i++) {
+        busWrite(test_bus, 0x2007, 0xFF);
+    }
+
+    // Put tile 1 at the second tile of the first row, with palette 1
+    setAddress(0x2001);
+    busWrite(test_bus, 0x2007, 0x01);
+    setAddress(0x23C0);
+    busWrite(test_bus, 0x2007, 0x01);
+    setAddress(0x3F00);
+    busWrite(test_bus, 0x2007, 0x0F);
+    setAddress(0x3F07);
+    busWrite(test_bus, 0x2007, 0x30);
+
+    // Scroll 4 pixels right and enable the background
+    busWrite(test_bus, 0x2005, 0x04);
+    busWrite(test_bus, 0x2005, 0x00);
+    busWrite(test_bus, 0x2000, 0x00);
+    busWrite(test_bus, 0x2001, 0x0A);
+    stepTo(PPU_PRERENDER_LINE, 300);
+    stepTo(PPU_SCANLINES, 0);
+    stepTo(1, 0);
+
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[0][3], 0x0F);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[0][4], 0x30);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[0][11], 0x30);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[0][12], 0x0F);
+}
+
+void test_ppu_sprite_zero_hit() {
+    // Tile 1 is solid color 1 everywhere
+    setAddress(0x0010);
+    for (int i = 0; i < 8; i++) {
+        busWrite(test_bus, 0x2007, 0xFF);
+    }
+    setAddress(0x2000);
+    for (int i = 0; i < 32; i++) {
+        busWrite(test_bus, 0x2007, 0x01);
+    }
+    setAddress(0x3F11);
+    busWrite(test_bus, 0x2007, 0x16);
+
+    // Sprite 0 at (20, 1), in front of the background
+    test_ppu->oam[0] = 0;
+    test_ppu->oam[1] = 0x01;
+    test_ppu->oam[2] = 0x00;
+    test_ppu->oam[3] = 20;
+
+    busWrite(test_bus, 0x2005, 0x00);
+    busWrite(test_bus, 0x2005, 0x00);
+    busWrite(test_bus, 0x2000, 0x00);
+    busWrite(test_bus, 0x2001, 0x1E);
+    stepTo(PPU_PRERENDER_LINE, 300);
+    stepTo(PPU_SCANLINES, 0);
+    stepTo(0, 300);
+    CU_ASSERT_FALSE(test_ppu->status & 0x40);
+
+    stepTo(1, 300);
+    CU_ASSERT_TRUE(test_ppu->status & 0x40);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[1][20], 0x16);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[1][28], test_ppu->palette[1]);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_ppu_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("PPU Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "PPUDATA Read Buffer", test_ppu_data_read_buffer) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Increment 32", test_ppu_increment_32) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Vertical Mirroring", test_ppu_vertical_mirroring) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Palette Mirroring", test_ppu_palette_mirroring) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Scroll Registers", test_ppu_scroll_registers) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "VBlank NMI", test_ppu_vblank_nmi) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "OAM DMA", test_ppu_oam_dma) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Render Background", test_ppu_render_background) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Sprite Zero Hit", test_ppu_sprite_zero_hit) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
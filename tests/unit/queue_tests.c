@@ -0,0 +1,186 @@
+#include "queue.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define THREADED_PUSHES (200000)
+
+// ---------- Test Setup/Cleanup ----------
+
+static Queue* queue;
+
+static void init_test() {
+    queue = createQueue(sizeof(uint64_t), 4);
+}
+
+static void clean_test() {
+    if (queue) {
+        freeQueue(queue);
+    }
+}
+
+/**
+ * Push a number onto the queue
+ *
+ * @param val - The number to push
+ *
+ * @returns true if it was pushed
+ */
+static bool push(uint64_t val) {
+    uint64_t* slot = queueReserve(queue);
+    if (slot == NULL) {
+        return false;
+    }
+    *slot = val;
+    queuePublish(queue);
+    return true;
+}
+
+// Pops every number the producer pushes, checking they come out in order
+static void* consume(void* arg) {
+    _Atomic bool* done = arg;
+    uint64_t last = 0;
+    uint64_t* popped = malloc(sizeof(uint64_t));
+    *popped = 0;
+
+    while (true) {
+        bool finished = atomic_load_explicit(done, memory_order_acquire);
+        uint64_t* slot = queueFront(queue);
+        if (slot == NULL) {
+            if (finished) {
+                break;
+            }
+            continue;
+        }
+
+        if (*slot <= last) {
+            break;
+        }
+        last = *slot;
+        (*popped)++;
+        queuePop(queue);
+    }
+    return popped;
+}
+
+// ---------- Tests ----------
+
+void test_queue_create() {
+    CU_ASSERT_PTR_NOT_NULL_FATAL(queue);
+    CU_ASSERT_EQUAL(queue->capacity, 4);
+
+    // Slots are rounded up to whole cache lines
+    CU_ASSERT_EQUAL(queue->slot_size, 64);
+    CU_ASSERT_EQUAL((uintptr_t)queue->slots % 64, 0);
+
+    CU_ASSERT_PTR_NULL(createQueue(8, 3));
+    CU_ASSERT_PTR_NULL(createQueue(0, 4));
+}
+
+void test_queue_order() {
+    CU_ASSERT_PTR_NULL(queueFront(queue));
+    CU_ASSERT_EQUAL(queueLength(queue), 0);
+
+    // Go round the ring a few times
+    for (uint64_t i = 0; i < 10; i++) {
+        CU_ASSERT_TRUE(push(i * 2));
+        CU_ASSERT_TRUE(push(i * 2 + 1));
+        CU_ASSERT_EQUAL(queueLength(queue), 2);
+
+        uint64_t* slot = queueFront(queue);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(slot);
+        CU_ASSERT_EQUAL(*slot, i * 2);
+        queuePop(queue);
+        slot = queueFront(queue);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(slot);
+        CU_ASSERT_EQUAL(*slot, i * 2 + 1);
+        queuePop(queue);
+    }
+    CU_ASSERT_PTR_NULL(queueFront(queue));
+    CU_ASSERT_EQUAL(queue->pushed, 20);
+}
+
+void test_queue_drops() {
+    for (uint64_t i = 1; i <= 4; i++) {
+        CU_ASSERT_TRUE(push(i));
+    }
+
+    // A full queue drops new pushes instead of waiting or overwriting
+    CU_ASSERT_FALSE(push(5));
+    CU_ASSERT_FALSE(push(6));
+    CU_ASSERT_EQUAL(queue->dropped, 2);
+    CU_ASSERT_EQUAL(queue->pushed, 4);
+    CU_ASSERT_EQUAL(*(uint64_t*)queueFront(queue), 1);
+
+    // Popping makes room again
+    queuePop(queue);
+    CU_ASSERT_TRUE(push(7));
+    CU_ASSERT_EQUAL(queueLength(queue), 4);
+}
+
+void test_queue_threads() {
+    freeQueue(queue);
+    queue = createQueue(sizeof(uint64_t), 64);
+
+    _Atomic bool done;
+    atomic_init(&done, false);
+    pthread_t consumer;
+    int started = pthread_create(&consumer, NULL, consume, &done);
+    CU_ASSERT_EQUAL(started, 0);
+    if (started != 0) {
+        return;
+    }
+
+    // Whatever isn't dropped arrives in order
+    for (uint64_t i = 1; i <= THREADED_PUSHES; i++) {
+        push(i);
+    }
+    atomic_store_explicit(&done, true, memory_order_release);
+
+    uint64_t* popped;
+    pthread_join(consumer, (void**)&popped);
+    CU_ASSERT_EQUAL(*popped, queue->pushed);
+    CU_ASSERT_EQUAL(queue->pushed + queue->dropped, THREADED_PUSHES);
+    CU_ASSERT_EQUAL(queueLength(queue), 0);
+    free(popped);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_queue_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Queue Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Create", test_queue_create) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Order", test_queue_order) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Drops", test_queue_drops) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Threads", test_queue_threads) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,128 @@
+#include "apu.h"
+#include "recorder.h"
+#include "types.h"
+#include "wav.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PPM_SIZE (15 + SCREEN_WIDTH * SCREEN_HEIGHT * 3)  // "P6\n256 240\n255\n" and the pixels
+
+// ---------- Test Setup/Cleanup ----------
+
+static char video_path[64];
+static char wav_path[64];
+static uint8_t pixels[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+static void init_test() {
+    strcpy(video_path, "/tmp/madnes_video_XXXXXX");
+    close(mkstemp(video_path));
+    strcpy(wav_path, "/tmp/madnes_audio_XXXXXX");
+    close(mkstemp(wav_path));
+    memset(pixels, 0, sizeof(pixels));
+}
+
+static void clean_test() {
+    unlink(video_path);
+    unlink(wav_path);
+}
+
+/**
+ * Read a whole file
+ *
+ * @param path - The file to read
+ * @param size - Set to the size of the file
+ *
+ * @returns The file's contents (to be freed)
+ */
+static uint8_t* readFile(const char* path, long* size) {
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    rewind(file);
+    uint8_t* data = malloc(*size + 1);
+    *size = fread(data, 1, *size, file);
+    fclose(file);
+    return data;
+}
+
+// ---------- Tests ----------
+
+void test_recorder_write() {
+    Recorder* recorder = createRecorder(video_path, wav_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recorder);
+
+    // A few frames, each a different color
+    for (int frame = 0; frame < 3; frame++) {
+        memset(pixels, 0x30 + frame, sizeof(pixels));
+        CU_ASSERT_TRUE(recorderPushFrame(recorder, &pixels[0][0]));
+    }
+    int16_t samples[800];
+    for (int i = 0; i < 800; i++) {
+        samples[i] = i;
+    }
+    recorderPushAudio(recorder, samples, 800);
+    recorderPushAudio(recorder, samples, 100);
+
+    // Everything queued is written before the recorder stops
+    CU_ASSERT_EQUAL(freeRecorder(recorder), 0);
+
+    long size;
+    uint8_t* video = readFile(video_path, &size);
+    CU_ASSERT_EQUAL(size, 3 * PPM_SIZE);
+    CU_ASSERT_EQUAL(memcmp(video, "P6\n256 240\n255\n", 15), 0);
+    CU_ASSERT_EQUAL(memcmp(video + PPM_SIZE, "P6\n", 3), 0);
+
+    // $30 is white, $32 isn't
+    CU_ASSERT_EQUAL(video[15], 0xFF);
+    CU_ASSERT_NOT_EQUAL(video[2 * PPM_SIZE + 15], 0xFF);
+    free(video);
+
+    uint8_t* audio = readFile(wav_path, &size);
+    CU_ASSERT_EQUAL(size, WAV_HEADER_SIZE + 900 * 2);
+    CU_ASSERT_EQUAL(audio[WAV_HEADER_SIZE + 2 * 799], 799 & 0xFF);
+    CU_ASSERT_EQUAL(audio[WAV_HEADER_SIZE + 2 * 799 + 1], 799 >> 8);
+    CU_ASSERT_EQUAL(audio[WAV_HEADER_SIZE + 2 * 899], 99);
+    free(audio);
+}
+
+void test_recorder_optional() {
+    // Only audio, so frames are ignored
+    Recorder* recorder = createRecorder(NULL, wav_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recorder);
+    CU_ASSERT_TRUE(recorderPushFrame(recorder, &pixels[0][0]));
+    CU_ASSERT_EQUAL(recorder->frames->pushed, 0);
+    CU_ASSERT_EQUAL(freeRecorder(recorder), 0);
+
+    CU_ASSERT_PTR_NULL(createRecorder("/tmp/madnes_no_such_dir/video.ppm", NULL));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_recorder_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Recorder Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Write", test_recorder_write) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Optional", test_recorder_optional) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,197 @@
+#include "render.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static const RenderKernels* scalar;
+
+static void init_test() {
+    scalar = getRenderKernels(RENDER_SCALAR);
+    srand(0x6502);
+}
+
+static void clean_test() {}
+
+static void fillRandom(uint8_t* buf, int count, uint8_t mask) {
+    for (int i = 0; i < count; i++) {
+        buf[i] = rand() & mask;
+    }
+}
+
+// ---------- Tests ----------
+
+void test_render_decode_tiles() {
+    // Row 0: colors 0,1,2,3,0,1,2,3, with palette 2
+    uint8_t lo = 0x55, hi = 0x33, attr = 0x08;
+    uint8_t expected[8] = {0x00, 0x09, 0x0A, 0x0B, 0x00, 0x09, 0x0A, 0x0B};
+
+    for (RenderLevel level = RENDER_SCALAR; level <= RENDER_AVX2; level++) {
+        const RenderKernels* kernels = getRenderKernels(level);
+        if (kernels == NULL) {
+            continue;
+        }
+
+        uint8_t out[8];
+        kernels->decodeTiles(&lo, &hi, &attr, 1, out);
+        CU_ASSERT_EQUAL(memcmp(out, expected, sizeof(out)), 0);
+
+        const uint8_t decoded[8] = {0, 1, 2, 3, 0, 1, 2, 3};
+        const uint8_t* row = decoded;
+        kernels->attributeTiles(&row, &attr, 1, out);
+        CU_ASSERT_EQUAL(memcmp(out, expected, sizeof(out)), 0);
+    }
+}
+
+void test_render_composite_priority() {
+    uint8_t palette[32];
+    for (int i = 0; i < 32; i++) {
+        palette[i] = 0x20 + i;
+    }
+
+    uint8_t bg[SCREEN_WIDTH] = {0};
+    uint8_t sprites[SCREEN_WIDTH] = {0};
+    bg[1] = 0x05;                     // Background only
+    sprites[2] = 0x11;                // Sprite only
+    bg[3] = 0x05, sprites[3] = 0x16;  // Sprite in front
+    bg[4] = 0x05, sprites[4] = 0x36;  // Sprite behind
+    sprites[5] = 0x37;                // Sprite behind a transparent background
+
+    for (RenderLevel level = RENDER_SCALAR; level <= RENDER_AVX2; level++) {
+        const RenderKernels* kernels = getRenderKernels(level);
+        if (kernels == NULL) {
+            continue;
+        }
+
+        uint8_t out[SCREEN_WIDTH];
+        kernels->composite(bg, sprites, palette, 0x3F, out);
+        CU_ASSERT_EQUAL(out[0], 0x20);
+        CU_ASSERT_EQUAL(out[1], 0x25);
+        CU_ASSERT_EQUAL(out[2], 0x31);
+        CU_ASSERT_EQUAL(out[3], 0x36);
+        CU_ASSERT_EQUAL(out[4], 0x25);
+        CU_ASSERT_EQUAL(out[5], 0x37);
+
+        // Greyscale
+        kernels->composite(bg, sprites, palette, 0x30, out);
+        CU_ASSERT_EQUAL(out[3], 0x30);
+    }
+}
+
+void test_render_expand() {
+    uint8_t pixels[3] = {0x0F, 0x21, 0x30};
+    uint32_t argb[3];
+    scalar->expand(pixels, 3, argb);
+
+    CU_ASSERT_EQUAL(argb[0], 0xFF000000);
+    CU_ASSERT_EQUAL(argb[1], 0xFF64B0FF);
+    CU_ASSERT_EQUAL(argb[2], 0xFFFFFEFF);
+}
+
+// Every instruction set's kernels should match the scalar ones exactly
+void test_render_kernels_match_scalar() {
+    uint8_t lo[33], hi[33], attrs[33];
+    uint8_t bg[SCREEN_WIDTH], sprites[SCREEN_WIDTH], palette[32];
+    uint8_t pixels[SCREEN_WIDTH * 4 + 7];
+
+    for (RenderLevel level = RENDER_SSE2; level <= RENDER_AVX2; level++) {
+        const RenderKernels* kernels = getRenderKernels(level);
+        if (kernels == NULL) {
+            continue;
+        }
+
+        for (int round = 0; round < 64; round++) {
+            fillRandom(lo, 33, 0xFF);
+            fillRandom(hi, 33, 0xFF);
+            fillRandom(attrs, 33, 0x0C);
+            uint8_t expected[33 * 8], actual[33 * 8];
+            scalar->decodeTiles(lo, hi, attrs, 33, expected);
+            kernels->decodeTiles(lo, hi, attrs, 33, actual);
+            CU_ASSERT_EQUAL(memcmp(expected, actual, sizeof(expected)), 0);
+
+            // The same rows decoded ahead of time
+            uint8_t decoded[33 * 8];
+            const uint8_t* rows[33];
+            for (int tile = 0; tile < 33; tile++) {
+                uint8_t none = 0;
+                scalar->decodeTiles(&lo[tile], &hi[tile], &none, 1, decoded + tile * 8);
+                rows[tile] = decoded + (32 - tile) * 8;
+            }
+            scalar->attributeTiles(rows, attrs, 33, expected);
+            kernels->attributeTiles(rows, attrs, 33, actual);
+            CU_ASSERT_EQUAL(memcmp(expected, actual, sizeof(expected)), 0);
+
+            // Background entries are 0 or $01-$0F, sprites are 0 or $10-$1F plus the
+            // priority bit
+            fillRandom(bg, SCREEN_WIDTH, 0x0F);
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                int r = rand();
+                sprites[x] = (r & 0x03) ? 0x10 | ((r >> 2) & 0x2F) : 0;
+            }
+            fillRandom(palette, 32, 0x3F);
+            uint8_t mask = (round & 1) ? 0x30 : 0x3F;
+            scalar->composite(bg, sprites, palette, mask, expected);
+            kernels->composite(bg, sprites, palette, mask, actual);
+            CU_ASSERT_EQUAL(memcmp(expected, actual, SCREEN_WIDTH), 0);
+
+            // Odd lengths exercise the scalar tails
+            int count = sizeof(pixels) - round;
+            fillRandom(pixels, count, 0xFF);
+            uint32_t expected_argb[sizeof(pixels)], actual_argb[sizeof(pixels)];
+            scalar->expand(pixels, count, expected_argb);
+            kernels->expand(pixels, count, actual_argb);
+            CU_ASSERT_EQUAL(memcmp(expected_argb, actual_argb, count * sizeof(uint32_t)), 0);
+        }
+    }
+}
+
+void test_render_best_kernels() {
+    const RenderKernels* best = bestRenderKernels();
+    CU_ASSERT_PTR_NOT_NULL(best);
+    CU_ASSERT_PTR_NOT_NULL(getRenderKernels(RENDER_SCALAR));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_render_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Render Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Decode Tiles", test_render_decode_tiles) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Composite Priority", test_render_composite_priority) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Expand", test_render_expand) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Kernels Match Scalar", test_render_kernels_match_scalar) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Best Kernels", test_render_best_kernels) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,223 @@
+#include "bus.h"
+#include "cartridge.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static PPU* test_ppu;
+static Rewind* history;
+static Cartridge cart;
+
+static Processor processor;
+static uint8_t ram[RAM_SIZE];
+static uint64_t cycles;
+static Machine machine;
+
+static void init_test() {
+    cart = (Cartridge){0};
+    cart.prg_rom_size = 1;
+    cart.chr_rom_size = 1;
+    cart.prg_rom_bytes = 0x4000;
+    cart.chr_rom_bytes = 0x2000;
+    cart.prg_rom = calloc(0x4000, sizeof(uint8_t));
+    cart.chr_rom = calloc(0x2000, sizeof(uint8_t));
+
+    test_bus = createBus();
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    test_mapper = createMapper(&cart, test_bus);
+    test_ppu = createPPU(test_mapper);
+    history = NULL;
+
+    processor = (Processor){.PC = 0x8000, .S = 0xFD, .P = 0x24};
+    memset(ram, 0, sizeof(ram));
+    cycles = 0;
+    machine = (Machine){&processor, ram, test_ppu, test_mapper, &cycles};
+}
+
+static void clean_test() {
+    if (history) {
+        freeRewind(history);
+    }
+    freePPU(test_ppu);
+    freeMapper(test_mapper);
+    freeBus(test_bus);
+    free(cart.prg_rom);
+    free(cart.chr_rom);
+}
+
+/**
+ * Run a fake frame: the frame count, the cycle count and a RAM byte all move
+ * on, and the given number of other RAM bytes are scribbled over
+ *
+ * @param scribble - How many RAM bytes to change
+ */
+static void nextFrame(int scribble) {
+    test_ppu->frame++;
+    cycles += 29781;
+    ram[0] = test_ppu->frame;
+    for (int i = 0; i < scribble; i++) {
+        ram[1 + (test_ppu->frame * 7 + i * 13) % (RAM_SIZE - 1)] ^= 0x5A;
+    }
+}
+
+// ---------- Tests ----------
+
+void test_rewind_step() {
+    history = createRewind(&machine, 10, 1, REWIND_ARENA_SIZE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(history);
+    CU_ASSERT_EQUAL(rewindDepth(history), 0);
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 1), -1);
+
+    for (int frame = 0; frame < 20; frame++) {
+        nextFrame(4);
+        rewindPush(history, &machine);
+    }
+    CU_ASSERT_EQUAL(rewindDepth(history), 20);
+    CU_ASSERT_TRUE(rewindDue(history, 21));
+    CU_ASSERT_FALSE(rewindDue(history, 20));
+
+    // The newest state is frame 20, so 5 back is frame 15
+    uint8_t expected[RAM_SIZE];
+    memcpy(expected, ram, RAM_SIZE);
+    for (int frame = 20; frame > 15; frame--) {
+        for (int i = 0; i < 4; i++) {
+            expected[1 + (frame * 7 + i * 13) % (RAM_SIZE - 1)] ^= 0x5A;
+        }
+    }
+    expected[0] = 15;
+
+    nextFrame(100);
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 5), 5);
+    CU_ASSERT_EQUAL(test_ppu->frame, 15);
+    CU_ASSERT_EQUAL(cycles, 15 * 29781);
+    CU_ASSERT_EQUAL(memcmp(ram, expected, RAM_SIZE), 0);
+    CU_ASSERT_EQUAL(rewindDepth(history), 15);
+
+    // Carrying on from there replaces the states that were stepped back over
+    nextFrame(4);
+    rewindPush(history, &machine);
+    CU_ASSERT_EQUAL(rewindDepth(history), 16);
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 1), 1);
+    CU_ASSERT_EQUAL(test_ppu->frame, 15);
+}
+
+void test_rewind_step_limits() {
+    history = createRewind(&machine, 10, 1, REWIND_ARENA_SIZE);
+    for (int frame = 0; frame < 3; frame++) {
+        nextFrame(1);
+        rewindPush(history, &machine);
+    }
+
+    // Going back 0 states restores the newest one
+    nextFrame(1);
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 0), 0);
+    CU_ASSERT_EQUAL(test_ppu->frame, 3);
+
+    // The history only goes back to the first state
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 10), 2);
+    CU_ASSERT_EQUAL(test_ppu->frame, 1);
+    CU_ASSERT_EQUAL(ram[0], 1);
+    CU_ASSERT_EQUAL(rewindDepth(history), 1);
+}
+
+void test_rewind_seconds() {
+    // 1 second at 6 frames a state is 11 deltas (60.1 / 6, rounded up)
+    history = createRewind(&machine, 1, 6, REWIND_ARENA_SIZE);
+    CU_ASSERT_EQUAL(history->capacity, 11);
+
+    for (int frame = 0; frame < 30; frame++) {
+        nextFrame(1);
+        rewindPush(history, &machine);
+    }
+    CU_ASSERT_EQUAL(rewindDepth(history), 12);
+    CU_ASSERT_EQUAL(history->evictions, 18);
+
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, 100), 11);
+    CU_ASSERT_EQUAL(test_ppu->frame, 19);
+}
+
+void test_rewind_arena() {
+    // Deltas are small when little changes between states
+    history = createRewind(&machine, 60, 1, REWIND_ARENA_SIZE);
+    for (int frame = 0; frame < 100; frame++) {
+        nextFrame(2);
+        rewindPush(history, &machine);
+    }
+    CU_ASSERT_EQUAL(rewindDepth(history), 100);
+    CU_ASSERT_TRUE(rewindUsage(history) < 100 * 64);
+    freeRewind(history);
+    test_ppu->frame = 0;
+
+    // A small arena drops the oldest deltas, but the rest still restore
+    history = createRewind(&machine, 60, 1, 4096);
+    for (int frame = 0; frame < 100; frame++) {
+        nextFrame(200);
+        rewindPush(history, &machine);
+    }
+    CU_ASSERT_TRUE(history->evictions > 0);
+    CU_ASSERT_TRUE(rewindUsage(history) <= 4096);
+
+    uint32_t depth = rewindDepth(history);
+    CU_ASSERT_TRUE(depth > 1 && depth < 100);
+    CU_ASSERT_EQUAL(rewindStep(history, &machine, depth - 1), depth - 1);
+    CU_ASSERT_EQUAL(test_ppu->frame, 100 - depth + 1);
+    CU_ASSERT_EQUAL(ram[0], 100 - depth + 1);
+}
+
+void test_rewind_invalid() {
+    CU_ASSERT_PTR_NULL(createRewind(&machine, 0, 1, REWIND_ARENA_SIZE));
+    CU_ASSERT_PTR_NULL(createRewind(&machine, 10, 0, REWIND_ARENA_SIZE));
+    CU_ASSERT_PTR_NULL(createRewind(&machine, 10, 1, 0));
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_rewind_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Rewind Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Step Back", test_rewind_step) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Step Limits", test_rewind_step_limits) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Seconds of History", test_rewind_seconds) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Bounded Arena", test_rewind_arena) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Invalid", test_rewind_invalid) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,211 @@
+#include "6502.h"
+#include "interpreter.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Processor ref_processor;
+static Processor run_processor;
+static uint8_t* ref_memory;
+static uint8_t* run_memory;
+static Bus* ref_bus;
+static Bus* run_bus;
+static uint64_t ref_cycles;
+static uint64_t run_cycles;
+
+static void init_test() {
+    ref_memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    run_memory = calloc(MEMORY_SPACE, sizeof(uint8_t));
+    ref_bus = createFlatBus(ref_memory);
+    run_bus = createFlatBus(run_memory);
+    ref_cycles = 0;
+    run_cycles = 0;
+    srand(6502);
+
+    // Start every test without any lazily evaluated flags left over
+    memset(&ref_processor, 0, sizeof(Processor));
+    memset(&run_processor, 0, sizeof(Processor));
+}
+
+static void clean_test() {
+    freeBus(ref_bus);
+    freeBus(run_bus);
+    free(ref_memory);
+    free(run_memory);
+}
+
+/**
+ * Fill memory and registers with random values and place the given opcode at
+ * the PC
+ */
+static void randomizeState(uint8_t opcode) {
+    for (int i = 0; i < MEMORY_SPACE; i++) {
+        ref_memory[i] = rand() & 0xFF;
+    }
+
+    ref_processor.PC = 0x0200 + (rand() % 0xF000);
+    ref_processor.A = rand() & 0xFF;
+    ref_processor.X = rand() & 0xFF;
+    ref_processor.Y = rand() & 0xFF;
+    ref_processor.S = rand() & 0xFF;
+    ref_processor.P = rand() & 0xFF;
+    ref_processor.halted = false;
+    ref_memory[ref_processor.PC] = opcode;
+
+    memcpy(run_memory, ref_memory, MEMORY_SPACE);
+    run_processor = ref_processor;
+    ref_cycles = 0;
+    run_cycles = 0;
+}
+
+static void stepReference() {
+    uint16_t old_PC = ref_processor.PC;
+
+    Instruction instr = parseInstruction(ref_bus, ref_processor.PC);
+    executeInstruction(instr, ref_bus, &ref_processor);
+    syncFlags(&ref_processor);
+    ref_processor.PC += instr.length;
+
+    addAdditionalCycles(&instr, ref_bus, &ref_processor, old_PC);
+    ref_cycles += instr.cycles;
+}
+
+// ---------- Tests ----------
+
+void test_run_matches_execute_instruction() {
+    for (int opcode = 0; opcode < 256; opcode++) {
+        if (opcode_table[opcode].mnemonic == ILLEGAL) {
+            continue;
+        }
+
+        for (int i = 0; i < 32; i++) {
+            randomizeState(opcode);
+
+            stepReference();
+            uint64_t count = runInstructions(run_bus, &run_processor, &run_cycles, 1,
+                                             NO_STOP_PC);
+            syncFlags(&run_processor);
+
+            CU_ASSERT_EQUAL(count, 1);
+            CU_ASSERT_EQUAL(run_processor.PC, ref_processor.PC);
+            CU_ASSERT_EQUAL(run_processor.A, ref_processor.A);
+            CU_ASSERT_EQUAL(run_processor.X, ref_processor.X);
+            CU_ASSERT_EQUAL(run_processor.Y, ref_processor.Y);
+            CU_ASSERT_EQUAL(run_processor.S, ref_processor.S);
+            CU_ASSERT_EQUAL(run_processor.P, ref_processor.P);
+            CU_ASSERT_EQUAL(run_processor.halted, ref_processor.halted);
+            CU_ASSERT_EQUAL(run_cycles, ref_cycles);
+            CU_ASSERT_EQUAL(memcmp(run_memory, ref_memory, 0x10000), 0);
+        }
+    }
+}
+
+void test_run_stop_pc() {
+    run_processor.PC = 0x0600;
+    run_processor.A = 0x00;
+    run_processor.X = 0x00;
+    run_processor.Y = 0x00;
+    run_processor.S = 0xFF;
+    run_processor.P = 0x30;
+    run_processor.halted = false;
+
+    // INX; INX; INX
+    run_memory[0x0600] = 0xE8;
+    run_memory[0x0601] = 0xE8;
+    run_memory[0x0602] = 0xE8;
+
+    uint64_t count = runInstructions(run_bus, &run_processor, &run_cycles, UINT64_MAX, 0x0602);
+
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(run_processor.PC, 0x0602);
+    CU_ASSERT_EQUAL(run_processor.X, 0x02);
+    CU_ASSERT_EQUAL(run_cycles, 4);
+}
+
+void test_run_cycle_limit() {
+    run_processor.PC = 0x0600;
+    run_processor.A = 0x00;
+    run_processor.X = 0x00;
+    run_processor.Y = 0x00;
+    run_processor.S = 0xFF;
+    run_processor.P = 0x30;
+    run_processor.halted = false;
+
+    // JMP $0600
+    run_memory[0x0600] = 0x4C;
+    run_memory[0x0601] = 0x00;
+    run_memory[0x0602] = 0x06;
+
+    uint64_t count = runInstructions(run_bus, &run_processor, &run_cycles, 10, NO_STOP_PC);
+
+    CU_ASSERT_EQUAL(count, 4);
+    CU_ASSERT_EQUAL(run_processor.PC, 0x0600);
+    CU_ASSERT_EQUAL(run_cycles, 12);
+}
+
+void test_run_brk_halts() {
+    run_processor.PC = 0x0600;
+    run_processor.A = 0x00;
+    run_processor.X = 0x00;
+    run_processor.Y = 0x00;
+    run_processor.S = 0xFF;
+    run_processor.P = 0x30;
+    run_processor.halted = false;
+
+    // LDA #$01; BRK; LDA #$02
+    run_memory[0x0600] = 0xA9;
+    run_memory[0x0601] = 0x01;
+    run_memory[0x0602] = 0x00;
+    run_memory[0x0603] = 0xA9;
+    run_memory[0x0604] = 0x02;
+
+    uint64_t count = runInstructions(run_bus, &run_processor, &run_cycles, UINT64_MAX,
+                                     NO_STOP_PC);
+
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(run_processor.halted, true);
+    CU_ASSERT_EQUAL(run_processor.A, 0x01);
+    CU_ASSERT_EQUAL(run_cycles, 9);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_run_instructions_suite_to_registry() {
+    CU_pSuite suite = CU_add_suite_with_setup_and_teardown("runInstructions Tests", NULL, NULL,
+                                                           init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Matches executeInstruction", test_run_matches_execute_instruction) ==
+        NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Stop PC", test_run_stop_pc) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Cycle Limit", test_run_cycle_limit) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "BRK Halts", test_run_brk_halts) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,361 @@
+#include "apu.h"
+#include "bus.h"
+#include "cartridge.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "savestate.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static PPU* test_ppu;
+static Cartridge cart;
+
+static Processor processor;
+static uint8_t ram[RAM_SIZE];
+static uint64_t cycles;
+static Machine machine;
+
+static uint8_t* state;
+static size_t state_size;
+
+/**
+ * Build a machine around a cartridge where the first byte of every 8 KiB PRG
+ * bank and every 1 KiB CHR bank holds the index of the bank
+ *
+ * @param mapper_num - The iNES mapper number
+ * @param prg_banks - PRG-ROM size (in 16 KiB units)
+ * @param chr_banks - CHR-ROM size (in 8 KiB units, 0 for CHR-RAM)
+ */
+static void makeMachine(int mapper_num, int prg_banks, int chr_banks) {
+    cart = (Cartridge){0};
+    cart.prg_rom_size = prg_banks;
+    cart.chr_rom_size = chr_banks;
+    cart.prg_rom_bytes = prg_banks * 0x4000;
+    cart.chr_rom_bytes = chr_banks * 0x2000;
+    cart.flags6 = (mapper_num & 0x0F) << 4;
+    cart.flags7 = mapper_num & 0xF0;
+
+    cart.prg_rom = calloc(prg_banks * 0x4000, sizeof(uint8_t));
+    for (int bank = 0; bank < prg_banks * 2; bank++) {
+        cart.prg_rom[bank * 0x2000] = bank;
+    }
+    cart.chr_rom = calloc(chr_banks * 0x2000 + 1, sizeof(uint8_t));
+    for (int bank = 0; bank < chr_banks * 8; bank++) {
+        cart.chr_rom[bank * 0x400] = bank;
+    }
+
+    busMapMemory(test_bus, 0x0000, 0x2000, ram, RAM_SIZE, true);
+    test_mapper = createMapper(&cart, test_bus);
+    test_ppu = createPPU(test_mapper);
+    ppuMapRegisters(test_ppu, test_bus);
+
+    machine = (Machine){&processor, ram, test_ppu, test_mapper, &cycles};
+    state_size = saveStateSize(&machine);
+    state = malloc(state_size);
+}
+
+static void init_test() {
+    test_bus = createBus();
+    test_mapper = NULL;
+    test_ppu = NULL;
+    state = NULL;
+
+    processor = (Processor){.PC = 0x8000, .S = 0xFD, .P = 0x24};
+    memset(ram, 0, sizeof(ram));
+    cycles = 0;
+}
+
+static void clean_test() {
+    free(state);
+    freePPU(test_ppu);
+    freeMapper(test_mapper);
+    freeBus(test_bus);
+    free(cart.prg_rom);
+    free(cart.chr_rom);
+}
+
+// ---------- Tests ----------
+
+void test_state_round_trip() {
+    // UxROM with 64 KiB of PRG-ROM and CHR-RAM
+    makeMachine(2, 4, 0);
+
+    processor = (Processor){.PC = 0xC123, .S = 0xF0, .P = 0xA5, .A = 1, .X = 2, .Y = 3};
+    cycles = 123456789;
+    ram[0x10] = 0x42;
+    busWrite(test_bus, 0x8000, 2);
+    mapperPpuWrite(test_mapper, 0x0000, 0x80);
+    test_ppu->v = 0x2345;
+    test_ppu->scanline = 100;
+    test_ppu->framebuffer[10][20] = 0x21;
+
+    CU_ASSERT_EQUAL(saveState(&machine, state, state_size), state_size);
+
+    // Change everything the state covers
+    processor = (Processor){0};
+    cycles = 0;
+    ram[0x10] = 0;
+    busWrite(test_bus, 0x8000, 1);
+    mapperPpuWrite(test_mapper, 0x0000, 0x01);
+    CU_ASSERT_EQUAL(mapperTileRow(test_mapper, 0x0000)[7], 1);
+    test_ppu->v = 0;
+    test_ppu->scanline = 0;
+    test_ppu->framebuffer[10][20] = 0;
+
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), 0);
+    CU_ASSERT_EQUAL(processor.PC, 0xC123);
+    CU_ASSERT_EQUAL(processor.S, 0xF0);
+    CU_ASSERT_EQUAL(processor.P, 0xA5);
+    CU_ASSERT_EQUAL(processor.Y, 3);
+    CU_ASSERT_EQUAL(cycles, 123456789);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x0010), 0x42);
+    CU_ASSERT_EQUAL(test_ppu->v, 0x2345);
+    CU_ASSERT_EQUAL(test_ppu->scanline, 100);
+    CU_ASSERT_EQUAL(test_ppu->framebuffer[10][20], 0x21);
+
+    // UxROM doesn't keep its bank number anywhere, but the bank is mapped back in
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 4);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0xC000), 6);
+
+    // CHR-RAM tiles are decoded again from the restored pattern tables
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x0000), 0x80);
+    CU_ASSERT_EQUAL(mapperTileRow(test_mapper, 0x0000)[0], 1);
+    CU_ASSERT_EQUAL(mapperTileRow(test_mapper, 0x0000)[7], 0);
+}
+
+void test_state_mmc3() {
+    makeMachine(4, 8, 8);
+
+    // R6 = 5 at $8000, R2 = 9 at $1000, IRQ latch 30
+    busWrite(test_bus, 0x8000, 0x06);
+    busWrite(test_bus, 0x8001, 5);
+    busWrite(test_bus, 0x8000, 0x02);
+    busWrite(test_bus, 0x8001, 9);
+    busWrite(test_bus, 0xC000, 30);
+    saveState(&machine, state, state_size);
+
+    busWrite(test_bus, 0x8000, 0x46);
+    busWrite(test_bus, 0x8001, 0);
+    busWrite(test_bus, 0xC000, 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 14);
+
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), 0);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x8000), 5);
+    CU_ASSERT_EQUAL(mapperPpuRead(test_mapper, 0x1000), 9);
+    CU_ASSERT_EQUAL(test_mapper->mmc3.bank_select, 0x02);
+    CU_ASSERT_EQUAL(test_mapper->mmc3.irq_latch, 30);
+}
+
+void test_state_little_endian() {
+    makeMachine(0, 1, 1);
+    processor.PC = 0x1234;
+    cycles = 0x0102030405060708;
+    saveState(&machine, state, state_size);
+
+    // Magic, version, then the CPU section's tag and length
+    CU_ASSERT_EQUAL(memcmp(state, STATE_MAGIC, 8), 0);
+    CU_ASSERT_EQUAL(state[8], STATE_VERSION);
+    CU_ASSERT_EQUAL(memcmp(state + 12, "CPU ", 4), 0);
+    CU_ASSERT_EQUAL(state[20], 0x34);
+    CU_ASSERT_EQUAL(state[21], 0x12);
+    CU_ASSERT_EQUAL(state[27], 0x08);
+    CU_ASSERT_EQUAL(state[34], 0x01);
+}
+
+void test_state_rejects() {
+    makeMachine(0, 1, 1);
+    saveState(&machine, state, state_size);
+    processor.PC = 0x4321;
+
+    // Cut short
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size - 1), -1);
+
+    // From a newer version
+    state[8]++;
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), -1);
+    state[8]--;
+
+    // From another cartridge (twice the PRG-ROM)
+    const uint8_t* mapper_section = NULL;
+    for (size_t i = 0; i + 4 <= state_size; i++) {
+        if (memcmp(state + i, "MAPR", 4) == 0) {
+            mapper_section = state + i;
+            break;
+        }
+    }
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mapper_section);
+    state[mapper_section - state + 8 + 2 + 2]++;
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), -1);
+
+    // None of those changed anything
+    CU_ASSERT_EQUAL(processor.PC, 0x4321);
+}
+
+void test_state_ppu_bounds() {
+    makeMachine(0, 1, 1);
+
+    // The PPU past the last scanline, or past the last dot of one, is turned away
+    test_ppu->scanline = PPU_SCANLINES;
+    saveState(&machine, state, state_size);
+    test_ppu->scanline = 10;
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), -1);
+    CU_ASSERT_EQUAL(test_ppu->scanline, 10);
+
+    test_ppu->cycle = PPU_DOTS_PER_SCANLINE;
+    saveState(&machine, state, state_size);
+    test_ppu->cycle = 0;
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), -1);
+
+    // Fine X only has 3 bits
+    test_ppu->cycle = PPU_DOTS_PER_SCANLINE - 1;
+    test_ppu->x = 0xFF;
+    saveState(&machine, state, state_size);
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), 0);
+    CU_ASSERT_EQUAL(test_ppu->x, 0x07);
+    CU_ASSERT_EQUAL(test_ppu->cycle, PPU_DOTS_PER_SCANLINE - 1);
+}
+
+void test_state_unknown_sections() {
+    makeMachine(0, 1, 1);
+    processor.PC = 0xABCD;
+
+    // A section from some later version is skipped over
+    uint8_t* bigger = calloc(state_size + 12, sizeof(uint8_t));
+    size_t size = saveState(&machine, bigger, state_size + 12);
+    memcpy(bigger + size, "NEW \x04\x00\x00\x00\xDE\xAD\xBE\xEF", 12);
+
+    processor.PC = 0;
+    CU_ASSERT_EQUAL(loadState(&machine, bigger, size + 12), 0);
+    CU_ASSERT_EQUAL(processor.PC, 0xABCD);
+    free(bigger);
+}
+
+void test_state_apu() {
+    makeMachine(0, 1, 1);
+    APU* apu = createAPU();
+    machine.apu = apu;
+    size_t size = saveStateSize(&machine);
+    CU_ASSERT_EQUAL(size, state_size + 8 + 116);
+    uint8_t* with_apu = malloc(size);
+
+    apuWriteRegister(apu, 0x4015, 0x0F);
+    apuWriteRegister(apu, 0x4002, 0xAB);
+    apuWriteRegister(apu, 0x4007, 0x0A);
+    apuWriteRegister(apu, 0x400E, 0x85);
+    apuWriteRegister(apu, 0x4012, 0x10);
+    apuCatchUp(apu, 40000);
+    CU_ASSERT_EQUAL(saveState(&machine, with_apu, size), size);
+    APU saved = *apu;
+
+    apuWriteRegister(apu, 0x4015, 0x00);
+    apuWriteRegister(apu, 0x4002, 0);
+    apuWriteRegister(apu, 0x400E, 0);
+    apuCatchUp(apu, 60000);
+
+    CU_ASSERT_EQUAL(loadState(&machine, with_apu, size), 0);
+    CU_ASSERT_EQUAL(apu->enabled, 0x0F);
+    CU_ASSERT_EQUAL(apu->pulse[0].period, 0xAB);
+    CU_ASSERT_EQUAL(apu->pulse[1].length, saved.pulse[1].length);
+    CU_ASSERT_EQUAL(apu->noise.lfsr, saved.noise.lfsr);
+    CU_ASSERT_TRUE(apu->noise.short_mode);
+    CU_ASSERT_EQUAL(apu->dmc.sample_addr, 0xC400);
+    CU_ASSERT_EQUAL(apu->frame_step, saved.frame_step);
+    CU_ASSERT_EQUAL(apu->frame_start, saved.frame_start);
+    CU_ASSERT_EQUAL(apu->synced_cycle, 40000);
+
+    // States from before there was an APU leave it as it is
+    apuWriteRegister(apu, 0x4015, 0x00);
+    machine.apu = NULL;
+    saveState(&machine, state, state_size);
+    machine.apu = apu;
+    CU_ASSERT_EQUAL(loadState(&machine, state, state_size), 0);
+    CU_ASSERT_EQUAL(apu->enabled, 0x00);
+
+    free(with_apu);
+    freeAPU(apu);
+}
+
+void test_state_file() {
+    makeMachine(1, 2, 1);
+    char path[] = "/tmp/madnes_state_XXXXXX";
+    close(mkstemp(path));
+
+    ram[0x7FF] = 0x99;
+    test_mapper->prg_ram[0] = 0x77;
+    CU_ASSERT_EQUAL(saveStateFile(&machine, path), 0);
+
+    ram[0x7FF] = 0;
+    test_mapper->prg_ram[0] = 0;
+    CU_ASSERT_EQUAL(loadStateFile(&machine, path), 0);
+    CU_ASSERT_EQUAL(ram[0x7FF], 0x99);
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x6000), 0x77);
+
+    unlink(path);
+    CU_ASSERT_EQUAL(loadStateFile(&machine, path), -1);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_savestate_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Save State Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Round Trip", test_state_round_trip) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "MMC3", test_state_mmc3) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Little Endian", test_state_little_endian) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Rejects", test_state_rejects) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "PPU Bounds", test_state_ppu_bounds) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Unknown Sections", test_state_unknown_sections) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "APU", test_state_apu) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "File", test_state_file) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -0,0 +1,214 @@
+#include "bus.h"
+#include "mapper.h"
+#include "ppu.h"
+#include "scheduler.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static uint64_t clock;
+static Scheduler scheduler;
+
+// A component that remembers the cycle it was caught up to, with an event at a
+// fixed cycle
+typedef struct {
+    uint64_t synced;
+    uint64_t event;
+    int catch_ups;
+} FakeComponent;
+
+static FakeComponent fake_a, fake_b;
+
+static void fakeCatchUp(void* context, uint64_t cycle) {
+    FakeComponent* fake = context;
+    fake->synced = cycle;
+    fake->catch_ups++;
+}
+
+static uint64_t fakeNextEvent(void* context) {
+    return ((FakeComponent*)context)->event;
+}
+
+static SchedulerComponent fakeComponent(FakeComponent* fake) {
+    return (SchedulerComponent){
+        .name = "Fake",
+        .context = fake,
+        .catchUp = fakeCatchUp,
+        .nextEvent = fakeNextEvent,
+    };
+}
+
+static bool noIrq(const Mapper* mapper) {
+    return false;
+}
+
+static Bus* test_bus;
+static Mapper* test_mapper;
+static PPU* test_ppu;
+static Cartridge cart;
+
+// UxROM with CHR-RAM, so writes to $8000+ go to the mapper
+static void setupPPU() {
+    cart = (Cartridge){0};
+    cart.prg_rom_size = 2;
+    cart.prg_rom_bytes = 0x8000;
+    cart.flags6 = 0x20;
+    cart.prg_rom = calloc(0x8000, sizeof(uint8_t));
+
+    test_bus = createBus();
+    test_mapper = createMapper(&cart, test_bus);
+    test_ppu = createPPU(test_mapper);
+    ppuMapRegisters(test_ppu, test_bus);
+    ppuSchedule(test_ppu, &scheduler);
+}
+
+static void init_test() {
+    clock = 0;
+    initScheduler(&scheduler, &clock);
+    fake_a = (FakeComponent){0};
+    fake_b = (FakeComponent){0};
+    test_ppu = NULL;
+}
+
+static void clean_test() {
+    if (test_ppu != NULL) {
+        freePPU(test_ppu);
+        freeMapper(test_mapper);
+        freeBus(test_bus);
+        free(cart.prg_rom);
+    }
+}
+
+// ---------- Tests ----------
+
+void test_scheduler_deadline() {
+    fake_a.event = 500;
+    fake_b.event = SCHEDULER_NO_EVENT;
+    CU_ASSERT_EQUAL(schedulerAdd(&scheduler, fakeComponent(&fake_a)), 0);
+    CU_ASSERT_EQUAL(schedulerAdd(&scheduler, fakeComponent(&fake_b)), 0);
+    CU_ASSERT_EQUAL(scheduler.deadline, 500);
+
+    // Nothing runs until the CPU gets to the deadline
+    clock = 499;
+    CU_ASSERT_FALSE(schedulerDue(&scheduler));
+
+    clock = 503;
+    CU_ASSERT_TRUE(schedulerDue(&scheduler));
+    fake_a.event = 1000;
+    schedulerSync(&scheduler);
+    CU_ASSERT_EQUAL(fake_a.synced, 503);
+    CU_ASSERT_EQUAL(fake_b.synced, 503);
+    CU_ASSERT_EQUAL(scheduler.deadline, 1000);
+
+    // A component's event can move without it running
+    fake_b.event = 700;
+    schedulerReschedule(&scheduler);
+    CU_ASSERT_EQUAL(scheduler.deadline, 700);
+}
+
+void test_scheduler_full() {
+    for (int i = 0; i < SCHEDULER_MAX_COMPONENTS; i++) {
+        CU_ASSERT_EQUAL(schedulerAdd(&scheduler, fakeComponent(&fake_a)), 0);
+    }
+    CU_ASSERT_EQUAL(schedulerAdd(&scheduler, fakeComponent(&fake_b)), -1);
+}
+
+void test_scheduler_ppu_vblank_event() {
+    setupPPU();
+
+    // Vblank starts at dot 1 of line 241, 82182 dots (27394 CPU cycles) in
+    CU_ASSERT_EQUAL(scheduler.deadline, 27394);
+
+    busWrite(test_bus, 0x2000, 0x80);
+    clock = 27393;
+    CU_ASSERT_FALSE(schedulerDue(&scheduler));
+    CU_ASSERT_EQUAL(test_ppu->scanline, 0);
+
+    clock = 27394;
+    CU_ASSERT_TRUE(schedulerDue(&scheduler));
+    schedulerSync(&scheduler);
+    CU_ASSERT_TRUE(test_ppu->nmi_pending);
+
+    // Then the end of the frame, 89342 dots in
+    CU_ASSERT_EQUAL(scheduler.deadline, 29781);
+}
+
+void test_scheduler_ppu_register_sync() {
+    setupPPU();
+
+    // Reading PPUSTATUS catches the PPU up first
+    clock = 28000;
+    CU_ASSERT_EQUAL(busRead(test_bus, 0x2002) & 0x80, 0x80);
+    CU_ASSERT_EQUAL(test_ppu->synced_cycle, 28000);
+    CU_ASSERT_EQUAL(test_ppu->scanline, 28000 * 3 / 341);
+
+    // So does a mapper register write
+    clock = 29000;
+    busWrite(test_bus, 0x8000, 0x01);
+    CU_ASSERT_EQUAL(test_ppu->synced_cycle, 29000);
+}
+
+void test_scheduler_ppu_mapper_scanlines() {
+    setupPPU();
+
+    // Rendering with a mapper that has IRQs needs the PPU run for every scanline.
+    // UxROM doesn't have any, so the next event stays at vblank.
+    busWrite(test_bus, 0x2001, 0x08);
+    CU_ASSERT_EQUAL(scheduler.deadline, 27394);
+
+    MapperOps ops = *test_mapper->ops;
+    ops.irq = noIrq;
+    test_mapper->ops = &ops;
+    schedulerReschedule(&scheduler);
+    CU_ASSERT_EQUAL(scheduler.deadline, 87);
+
+    // After dot 260, the next one is on the following line
+    clock = 87;
+    schedulerSync(&scheduler);
+    CU_ASSERT_EQUAL(scheduler.deadline, 87 + 113);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_scheduler_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Scheduler Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Deadline", test_scheduler_deadline) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Full", test_scheduler_full) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "PPU VBlank Event", test_scheduler_ppu_vblank_event) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "PPU Register Sync", test_scheduler_ppu_register_sync) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "PPU Mapper Scanlines", test_scheduler_ppu_mapper_scanlines) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}
@@ -31,6 +31,28 @@ extern CU_pSuite add_sta_suite_to_registry();
 extern CU_pSuite add_stxy_suite_to_registry();
 extern CU_pSuite add_transfer_suite_to_registry();
 extern CU_pSuite add_unofficial_suite_to_registry();
+extern CU_pSuite add_run_instructions_suite_to_registry();
+extern CU_pSuite add_block_cache_suite_to_registry();
+extern CU_pSuite add_jit_suite_to_registry();
+extern CU_pSuite add_bus_suite_to_registry();
+extern CU_pSuite add_mapper_suite_to_registry();
+extern CU_pSuite add_cartridge_suite_to_registry();
+extern CU_pSuite add_ppu_suite_to_registry();
+extern CU_pSuite add_render_suite_to_registry();
+extern CU_pSuite add_scheduler_suite_to_registry();
+extern CU_pSuite add_pacer_suite_to_registry();
+extern CU_pSuite add_trace_suite_to_registry();
+extern CU_pSuite add_logger_suite_to_registry();
+extern CU_pSuite add_savestate_suite_to_registry();
+extern CU_pSuite add_rewind_suite_to_registry();
+extern CU_pSuite add_controller_suite_to_registry();
+extern CU_pSuite add_movie_suite_to_registry();
+extern CU_pSuite add_emulator_suite_to_registry();
+extern CU_pSuite add_batch_suite_to_registry();
+extern CU_pSuite add_apu_suite_to_registry();
+extern CU_pSuite add_queue_suite_to_registry();
+extern CU_pSuite add_recorder_suite_to_registry();
+extern CU_pSuite add_golden_suite_to_registry();
 
 int main() {
     if (CU_initialize_registry() != CUE_SUCCESS) {
@@ -51,7 +73,18 @@ int main() {
         add_rti_suite_to_registry() == NULL || add_rts_suite_to_registry() == NULL ||
         add_sbc_suite_to_registry() == NULL || add_sta_suite_to_registry() == NULL ||
         add_stxy_suite_to_registry() == NULL || add_transfer_suite_to_registry() == NULL ||
-        add_unofficial_suite_to_registry() == NULL) {
+        add_unofficial_suite_to_registry() == NULL || add_run_instructions_suite_to_registry() == NULL ||
+        add_block_cache_suite_to_registry() == NULL || add_jit_suite_to_registry() == NULL ||
+        add_bus_suite_to_registry() == NULL || add_mapper_suite_to_registry() == NULL ||
+        add_cartridge_suite_to_registry() == NULL || add_ppu_suite_to_registry() == NULL ||
+        add_render_suite_to_registry() == NULL || add_scheduler_suite_to_registry() == NULL ||
+        add_pacer_suite_to_registry() == NULL || add_trace_suite_to_registry() == NULL ||
+        add_logger_suite_to_registry() == NULL || add_savestate_suite_to_registry() == NULL ||
+        add_rewind_suite_to_registry() == NULL || add_controller_suite_to_registry() == NULL ||
+        add_movie_suite_to_registry() == NULL || add_emulator_suite_to_registry() == NULL ||
+        add_batch_suite_to_registry() == NULL || add_apu_suite_to_registry() == NULL ||
+        add_queue_suite_to_registry() == NULL || add_recorder_suite_to_registry() == NULL ||
+        add_golden_suite_to_registry() == NULL) {
         CU_cleanup_registry();
         return CU_get_error();
     }
@@ -0,0 +1,202 @@
+#include "trace.h"
+#include "types.h"
+
+#include <CUnit/Basic.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/TestDB.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---------- Test Setup/Cleanup ----------
+
+static char trace_path[64];
+static Processor processor;
+
+/**
+ * Trace 'count' instructions, each with its index as the cycle count and the
+ * low byte of its index in A
+ *
+ * @param tracer - The tracer to record the instructions with
+ * @param count - The number of instructions
+ */
+static void traceInstructions(Tracer* tracer, int count) {
+    Instruction instr = {.opcode = 0xAD, .addr = 0x1234, .length = 3};
+
+    for (int i = 0; i < count; i++) {
+        processor.A = i & 0xFF;
+        traceInstruction(tracer, &instr, &processor, i);
+    }
+}
+
+static void init_test() {
+    processor = (Processor){.PC = 0xC000, .S = 0xFD, .P = 0x24};
+    strcpy(trace_path, "/tmp/madnes_trace_XXXXXX");
+    close(mkstemp(trace_path));
+}
+
+static void clean_test() {
+    unlink(trace_path);
+}
+
+// ---------- Tests ----------
+
+void test_trace_ring_wraps() {
+    // Several times more records than the ring holds, so it wraps (and the CPU
+    // side most likely has to wait for the writer)
+    const int count = TRACE_RING_SIZE * 3 + 5;
+    Tracer* tracer = createTracer(trace_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tracer);
+    traceInstructions(tracer, count);
+    CU_ASSERT_EQUAL(freeTracer(tracer), 0);
+
+    FILE* file = fopen(trace_path, "rb");
+    TraceHeader header;
+    CU_ASSERT_EQUAL(fread(&header, sizeof(header), 1, file), 1);
+    CU_ASSERT_EQUAL(memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)), 0);
+    CU_ASSERT_EQUAL(header.record_size, sizeof(TraceRecord));
+
+    // Every record made it out, in order, and with nothing left over in the padding
+    TraceRecord record;
+    const uint8_t zeros[sizeof(record.reserved)] = {0};
+    int read = 0;
+    bool in_order = true;
+    bool padded = true;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        in_order &= record.cycles == (uint64_t)read && record.a == (read & 0xFF);
+        padded &= memcmp(record.reserved, zeros, sizeof(zeros)) == 0;
+        read++;
+    }
+    fclose(file);
+
+    CU_ASSERT_EQUAL(read, count);
+    CU_ASSERT_TRUE(in_order);
+    CU_ASSERT_TRUE(padded);
+    CU_ASSERT_EQUAL(record.pc, 0xC000);
+    CU_ASSERT_EQUAL(record.opcode, 0xAD);
+    CU_ASSERT_EQUAL(record.operands[0], 0x34);
+    CU_ASSERT_EQUAL(record.operands[1], 0x12);
+}
+
+void test_trace_write_fails() {
+    // Nothing fits on /dev/full, so every write fails, but the CPU side never
+    // waits forever on the writer
+    Tracer* tracer = createTracer("/dev/full");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tracer);
+    traceInstructions(tracer, TRACE_RING_SIZE * 2);
+    CU_ASSERT_EQUAL(freeTracer(tracer), -1);
+}
+
+void test_trace_format_nestest() {
+    char line[TRACE_LINE_LENGTH];
+
+    // The first line of nestest.log
+    TraceRecord jmp = {
+        .cycles = 7, .pc = 0xC000, .opcode = 0x4C, .operands = {0xF5, 0xC5}, .p = 0x24, .s = 0xFD};
+    formatTraceRecord(&jmp, TRACE_FORMAT_NESTEST, line);
+    CU_ASSERT_STRING_EQUAL(line, "C000  4C F5 C5  JMP $C5F5                       "
+                                 "A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7");
+
+    // Branches show their target, and the PPU wraps onto the next scanline
+    TraceRecord bcs = {.cycles = 120, .pc = 0xC72C, .opcode = 0xB0, .operands = {0x04}};
+    formatTraceRecord(&bcs, TRACE_FORMAT_NESTEST, line);
+    CU_ASSERT_STRING_EQUAL(line, "C72C  B0 04     BCS $C732                       "
+                                 "A:00 X:00 Y:00 P:00 SP:00 PPU:  1, 19 CYC:120");
+
+    // Unofficial opcodes are starred
+    TraceRecord nop = {.cycles = 7, .pc = 0xC000, .opcode = 0x1A};
+    formatTraceRecord(&nop, TRACE_FORMAT_NESTEST, line);
+    CU_ASSERT_EQUAL(strncmp(line, "C000  1A       *NOP ", 20), 0);
+}
+
+void test_trace_format_text() {
+    char line[TRACE_LINE_LENGTH];
+
+    TraceRecord lda = {
+        .cycles = 42, .pc = 0x8000, .opcode = 0xA9, .operands = {0x10}, .a = 0x01, .s = 0xFF};
+    formatTraceRecord(&lda, TRACE_FORMAT_TEXT, line);
+    CU_ASSERT_STRING_EQUAL(line, "$8000: LDA #$10         A:01 X:00 Y:00 P:00 S:ff CYC:42");
+}
+
+void test_trace_format_file() {
+    Tracer* tracer = createTracer(trace_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tracer);
+    traceInstructions(tracer, 10);
+    CU_ASSERT_EQUAL(freeTracer(tracer), 0);
+
+    FILE* out = tmpfile();
+    CU_ASSERT_EQUAL(formatTraceFile(trace_path, TRACE_FORMAT_NESTEST, out), 10);
+
+    // One line per record
+    rewind(out);
+    char line[TRACE_LINE_LENGTH];
+    int lines = 0;
+    while (fgets(line, sizeof(line), out) != NULL) {
+        lines++;
+    }
+    CU_ASSERT_EQUAL(lines, 10);
+    CU_ASSERT_EQUAL(strncmp(line, "C000  AD 34 12  LDA $1234", 25), 0);
+    fclose(out);
+
+    // Anything else is turned away
+    FILE* file = fopen(trace_path, "wb");
+    fputs("C000  4C F5 C5  JMP $C5F5\n", file);
+    fclose(file);
+    CU_ASSERT_EQUAL(formatTraceFile(trace_path, TRACE_FORMAT_NESTEST, stdout), -1);
+}
+
+void test_trace_parse_format() {
+    TraceFormat format = TRACE_FORMAT_TEXT;
+
+    CU_ASSERT_EQUAL(parseTraceFormat("nestest", &format), 0);
+    CU_ASSERT_EQUAL(format, TRACE_FORMAT_NESTEST);
+    CU_ASSERT_EQUAL(parseTraceFormat("text", &format), 0);
+    CU_ASSERT_EQUAL(format, TRACE_FORMAT_TEXT);
+    CU_ASSERT_EQUAL(parseTraceFormat("json", &format), -1);
+}
+
+// ---------- Run Tests ----------
+
+CU_pSuite add_trace_suite_to_registry() {
+    CU_pSuite suite =
+        CU_add_suite_with_setup_and_teardown("Trace Tests", NULL, NULL, init_test, clean_test);
+
+    if (suite == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Ring Wraps", test_trace_ring_wraps) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Write Fails", test_trace_write_fails) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Format nestest", test_trace_format_nestest) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Format Text", test_trace_format_text) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Format File", test_trace_format_file) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    if (CU_add_test(suite, "Parse Format", test_trace_parse_format) == NULL) {
+        CU_cleanup_registry();
+        return NULL;
+    }
+
+    return suite;
+}